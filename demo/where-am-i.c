@@ -82,7 +82,7 @@ static void
 print_location (GClueSimple *simple)
 {
         GClueLocation *location;
-        gdouble altitude, speed, heading;
+        gdouble altitude, speed, heading, climb, error;
         GVariant *timestamp;
         const char *desc;
 
@@ -94,14 +94,32 @@ print_location (GClueSimple *simple)
                  gclue_location_get_accuracy (location));
 
         altitude = gclue_location_get_altitude (location);
-        if (altitude != -G_MAXDOUBLE)
-                g_print ("Altitude:    %f meters\n", altitude);
+        if (altitude != -G_MAXDOUBLE) {
+                g_print ("Altitude:    %f meters", altitude);
+                error = gclue_location_get_altitude_accuracy (location);
+                if (error > 0)
+                        g_print (" (± %f meters)", error);
+                g_print ("\n");
+        }
         speed = gclue_location_get_speed (location);
-        if (speed >= 0)
-                g_print ("Speed:       %f meters/second\n", speed);
+        if (speed >= 0) {
+                g_print ("Speed:       %f meters/second", speed);
+                error = gclue_location_get_speed_accuracy (location);
+                if (error > 0)
+                        g_print (" (± %f meters/second)", error);
+                g_print ("\n");
+        }
         heading = gclue_location_get_heading (location);
-        if (heading >= 0)
-                g_print ("Heading:     %f°\n", heading);
+        if (heading >= 0) {
+                g_print ("Heading:     %f°", heading);
+                error = gclue_location_get_heading_accuracy (location);
+                if (error > 0)
+                        g_print (" (± %f°)", error);
+                g_print ("\n");
+        }
+        climb = gclue_location_get_climb (location);
+        if (climb != -G_MAXDOUBLE)
+                g_print ("Climb:       %f meters/second\n", climb);
 
         desc = gclue_location_get_description (location);
         if (strlen (desc) > 0)
@@ -0,0 +1,147 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-clock.c
+ *
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include "gclue-clock.h"
+
+/**
+ * SECTION:gclue-clock
+ * @short_description: The daemon's clock
+ *
+ * All of geoclue's notions of the current time come from here, so they can
+ * be switched to a virtual clock together, e.g. to test time dependent code
+ * without waiting for the time to pass. Like the rest of the daemon, these
+ * are only to be used from the main thread.
+ **/
+
+static gboolean virtual_clock = FALSE;
+static gint64 virtual_real_time;
+static gint64 virtual_monotonic_time;
+
+/* UTC midnight of the day the clock was last read in. Computed again only
+ * when the clock leaves that day, forwards or backwards.
+ */
+static gint64 midnight = G_MAXINT64;
+
+/**
+ * gclue_clock_get_real_time:
+ *
+ * Returns: the current time, in microseconds since the Epoch.
+ **/
+gint64
+gclue_clock_get_real_time (void)
+{
+        if (virtual_clock)
+                return virtual_real_time;
+
+        return g_get_real_time ();
+}
+
+/**
+ * gclue_clock_get_monotonic_time:
+ *
+ * Returns: the current monotonic time, in microseconds. Only meaningful to
+ * tell how much time passed between two calls.
+ **/
+gint64
+gclue_clock_get_monotonic_time (void)
+{
+        if (virtual_clock)
+                return virtual_monotonic_time;
+
+        return g_get_monotonic_time ();
+}
+
+/**
+ * gclue_clock_get_utc_midnight:
+ *
+ * Returns: the start of the current UTC day, in microseconds since the
+ * Epoch.
+ **/
+gint64
+gclue_clock_get_utc_midnight (void)
+{
+        gint64 now = gclue_clock_get_real_time ();
+
+        /* UNIX time has no leap seconds, every day is as long as the others */
+        if (now < midnight || now - midnight >= G_TIME_SPAN_DAY) {
+                midnight = now - now % G_TIME_SPAN_DAY;
+                if (now < 0 && midnight != now)
+                        midnight -= G_TIME_SPAN_DAY;
+        }
+
+        return midnight;
+}
+
+/**
+ * gclue_clock_set_virtual:
+ * @real_time: the time to start at, in microseconds since the Epoch
+ *
+ * Switches to a virtual clock, which stands still at @real_time until
+ * gclue_clock_advance() moves it. Timeouts on the main loop still run on
+ * the system clock.
+ **/
+void
+gclue_clock_set_virtual (gint64 real_time)
+{
+        if (!virtual_clock)
+                virtual_monotonic_time = g_get_monotonic_time ();
+
+        virtual_clock = TRUE;
+        virtual_real_time = real_time;
+}
+
+/**
+ * gclue_clock_advance:
+ * @delta: the time to move the virtual clock forward by
+ **/
+void
+gclue_clock_advance (GTimeSpan delta)
+{
+        g_return_if_fail (virtual_clock);
+        g_return_if_fail (delta >= 0);
+
+        virtual_real_time += delta;
+        virtual_monotonic_time += delta;
+}
+
+/**
+ * gclue_clock_set_system:
+ *
+ * Switches back to the system clock. Monotonic times taken from the virtual
+ * clock can't be compared with the ones after this.
+ **/
+void
+gclue_clock_set_system (void)
+{
+        virtual_clock = FALSE;
+}
+
+/**
+ * gclue_clock_is_virtual:
+ *
+ * Returns: whether the clock is a virtual one.
+ **/
+gboolean
+gclue_clock_is_virtual (void)
+{
+        return virtual_clock;
+}
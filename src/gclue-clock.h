@@ -0,0 +1,41 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-clock.h
+ *
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#ifndef GCLUE_CLOCK_H
+#define GCLUE_CLOCK_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gint64           gclue_clock_get_real_time       (void);
+gint64           gclue_clock_get_monotonic_time  (void);
+gint64           gclue_clock_get_utc_midnight    (void);
+
+void             gclue_clock_set_virtual         (gint64     real_time);
+void             gclue_clock_advance             (GTimeSpan  delta);
+void             gclue_clock_set_system          (void);
+gboolean         gclue_clock_is_virtual          (void);
+
+G_END_DECLS
+
+#endif /* GCLUE_CLOCK_H */
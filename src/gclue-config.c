@@ -48,9 +48,23 @@ struct _GClueConfigPrivate
         gboolean enable_compass;
         gboolean enable_static_source;
         gboolean enable_gpsd_source;
+        gboolean enable_ubx_source;
+        gboolean enable_replay_source;
         char *wifi_submit_url;
         char *wifi_submit_nick;
         char *nmea_socket;
+        guint nmea_max_services;
+        char *nmea_serial_device;
+        guint nmea_baud_rate;
+        char *nmea_record_file;
+        char *gpsd_transport;
+        char **gpsd_endpoints;
+        char **nmea_talkers;
+        char *ubx_device;
+        guint ubx_baud_rate;
+        char *replay_file;
+        gdouble replay_speed;
+        gboolean replay_loop;
 
         GList *app_configs;
 };
@@ -90,6 +104,13 @@ gclue_config_finalize (GObject *object)
         g_clear_pointer (&priv->wifi_submit_url, g_free);
         g_clear_pointer (&priv->wifi_submit_nick, g_free);
         g_clear_pointer (&priv->nmea_socket, g_free);
+        g_clear_pointer (&priv->nmea_serial_device, g_free);
+        g_clear_pointer (&priv->gpsd_transport, g_free);
+        g_clear_pointer (&priv->gpsd_endpoints, g_strfreev);
+        g_clear_pointer (&priv->nmea_talkers, g_strfreev);
+        g_clear_pointer (&priv->ubx_device, g_free);
+        g_clear_pointer (&priv->nmea_record_file, g_free);
+        g_clear_pointer (&priv->replay_file, g_free);
 
         g_list_foreach (priv->app_configs, (GFunc) app_config_free, NULL);
 
@@ -136,7 +157,8 @@ load_app_configs (GClueConfig *config)
 {
         const char *known_groups[] = { "agent", "wifi", "3g", "cdma",
                                        "modem-gps", "network-nmea", "compass",
-                                       "static-source", "gpsd", NULL };
+                                       "static-source", "gpsd", "nmea",
+                                       "ubx", "replay", NULL };
         GClueConfigPrivate *priv = config->priv;
         gsize num_groups = 0, i;
         g_auto(GStrv) groups = NULL;
@@ -388,14 +410,52 @@ load_modem_gps_config (GClueConfig *config, gboolean initial)
                                            config->priv->enable_modem_gps_source);
 }
 
+#define DEFAULT_GPSD_TRANSPORT "libgps"
+
 static void
 load_gpsd_config (GClueConfig *config, gboolean initial)
 {
+        g_autoptr(GError) error = NULL;
+        g_autofree char *transport = NULL;
+        g_auto(GStrv) endpoints = NULL;
+
         config->priv->enable_gpsd_source =
                 load_enable_source_config (config, "gpsd", initial,
                                            config->priv->enable_gpsd_source);
+
+        if (initial)
+                config->priv->gpsd_transport = g_strdup (DEFAULT_GPSD_TRANSPORT);
+
+        if (g_key_file_has_key (config->priv->key_file, "gpsd", "transport", NULL)) {
+                transport = g_key_file_get_string (config->priv->key_file,
+                                                   "gpsd",
+                                                   "transport",
+                                                   &error);
+                if (error == NULL) {
+                        g_clear_pointer (&config->priv->gpsd_transport, g_free);
+                        config->priv->gpsd_transport = g_steal_pointer (&transport);
+                } else
+                        g_warning ("Failed to get config \"gpsd/transport\": %s", error->message);
+                g_clear_error (&error);
+        }
+
+        if (g_key_file_has_key (config->priv->key_file, "gpsd", "endpoints", NULL)) {
+                endpoints = g_key_file_get_string_list (config->priv->key_file,
+                                                        "gpsd",
+                                                        "endpoints",
+                                                        NULL,
+                                                        &error);
+                if (error == NULL) {
+                        g_clear_pointer (&config->priv->gpsd_endpoints, g_strfreev);
+                        config->priv->gpsd_endpoints = g_steal_pointer (&endpoints);
+                } else
+                        g_warning ("Failed to get config \"gpsd/endpoints\": %s", error->message);
+        }
 }
 
+#define DEFAULT_NMEA_MAX_SERVICES 1
+#define DEFAULT_NMEA_BAUD_RATE 9600
+
 static void
 load_network_nmea_config (GClueConfig *config, gboolean initial)
 {
@@ -416,6 +476,232 @@ load_network_nmea_config (GClueConfig *config, gboolean initial)
                         config->priv->nmea_socket = g_steal_pointer (&nmea_socket);
                 } else
                         g_warning ("Failed to get config \"nmea-socket\": %s", error->message);
+                g_clear_error (&error);
+        }
+
+        if (g_key_file_has_key (config->priv->key_file, "network-nmea", "serial-device", NULL)) {
+                g_autofree char *serial_device = NULL;
+
+                serial_device = g_key_file_get_string (config->priv->key_file,
+                                                       "network-nmea",
+                                                       "serial-device",
+                                                       &error);
+                if (error == NULL) {
+                        g_clear_pointer (&config->priv->nmea_serial_device, g_free);
+                        config->priv->nmea_serial_device = g_steal_pointer (&serial_device);
+                } else
+                        g_warning ("Failed to get config \"network-nmea/serial-device\": %s", error->message);
+                g_clear_error (&error);
+        }
+
+        if (initial)
+                config->priv->nmea_baud_rate = DEFAULT_NMEA_BAUD_RATE;
+
+        if (g_key_file_has_key (config->priv->key_file, "network-nmea", "baud-rate", NULL)) {
+                gint baud_rate;
+
+                baud_rate = g_key_file_get_integer (config->priv->key_file,
+                                                    "network-nmea",
+                                                    "baud-rate",
+                                                    &error);
+                if (error != NULL)
+                        g_warning ("Failed to get config \"network-nmea/baud-rate\": %s", error->message);
+                else if (baud_rate <= 0)
+                        g_warning ("Invalid config \"network-nmea/baud-rate\": %d", baud_rate);
+                else
+                        config->priv->nmea_baud_rate = baud_rate;
+                g_clear_error (&error);
+        }
+
+        if (initial)
+                config->priv->nmea_max_services = DEFAULT_NMEA_MAX_SERVICES;
+
+        if (g_key_file_has_key (config->priv->key_file, "network-nmea", "max-services", NULL)) {
+                gint max_services;
+
+                max_services = g_key_file_get_integer (config->priv->key_file,
+                                                       "network-nmea",
+                                                       "max-services",
+                                                       &error);
+                if (error != NULL)
+                        g_warning ("Failed to get config \"network-nmea/max-services\": %s", error->message);
+                else if (max_services < 1)
+                        g_warning ("Invalid config \"network-nmea/max-services\": %d", max_services);
+                else
+                        config->priv->nmea_max_services = max_services;
+                g_clear_error (&error);
+        }
+
+        if (g_key_file_has_key (config->priv->key_file, "network-nmea", "record-file", NULL)) {
+                g_autofree char *record_file = NULL;
+
+                record_file = g_key_file_get_string (config->priv->key_file,
+                                                     "network-nmea",
+                                                     "record-file",
+                                                     &error);
+                if (error == NULL) {
+                        g_clear_pointer (&config->priv->nmea_record_file, g_free);
+                        config->priv->nmea_record_file = g_steal_pointer (&record_file);
+                } else
+                        g_warning ("Failed to get config \"network-nmea/record-file\": %s", error->message);
+        }
+}
+
+#define DEFAULT_NMEA_TALKERS "GN;GP;GL;GA;GB"
+
+static gboolean
+is_nmea_talker (const char *talker)
+{
+        return g_ascii_isupper (talker[0]) &&
+               g_ascii_isupper (talker[1]) &&
+               talker[2] == '\0';
+}
+
+static void
+load_nmea_config (GClueConfig *config, gboolean initial)
+{
+        g_autoptr(GError) error = NULL;
+        g_auto(GStrv) talkers = NULL;
+        gsize i;
+
+        if (initial)
+                config->priv->nmea_talkers = g_strsplit (DEFAULT_NMEA_TALKERS,
+                                                         ";",
+                                                         -1);
+
+        if (!g_key_file_has_key (config->priv->key_file, "nmea", "talker-priority", NULL))
+                return;
+
+        talkers = g_key_file_get_string_list (config->priv->key_file,
+                                              "nmea",
+                                              "talker-priority",
+                                              NULL,
+                                              &error);
+        if (error != NULL) {
+                g_warning ("Failed to get config \"nmea/talker-priority\": %s",
+                           error->message);
+                return;
+        }
+
+        if (talkers[0] == NULL) {
+                g_warning ("Empty config \"nmea/talker-priority\", ignoring");
+                return;
+        }
+
+        for (i = 0; talkers[i] != NULL; i++) {
+                if (!is_nmea_talker (talkers[i])) {
+                        g_warning ("Invalid NMEA talker ID '%s' in config "
+                                   "\"nmea/talker-priority\", ignoring",
+                                   talkers[i]);
+                        return;
+                }
+        }
+
+        g_clear_pointer (&config->priv->nmea_talkers, g_strfreev);
+        config->priv->nmea_talkers = g_steal_pointer (&talkers);
+}
+
+#define DEFAULT_UBX_BAUD_RATE 9600
+
+static void
+load_ubx_config (GClueConfig *config, gboolean initial)
+{
+        g_autoptr(GError) error = NULL;
+
+        config->priv->enable_ubx_source =
+                load_enable_source_config (config, "ubx", initial,
+                                           config->priv->enable_ubx_source);
+
+        if (g_key_file_has_key (config->priv->key_file, "ubx", "device", NULL)) {
+                g_autofree char *device = NULL;
+
+                device = g_key_file_get_string (config->priv->key_file,
+                                                "ubx",
+                                                "device",
+                                                &error);
+                if (error == NULL) {
+                        g_clear_pointer (&config->priv->ubx_device, g_free);
+                        config->priv->ubx_device = g_steal_pointer (&device);
+                } else
+                        g_warning ("Failed to get config \"ubx/device\": %s", error->message);
+                g_clear_error (&error);
+        }
+
+        if (initial)
+                config->priv->ubx_baud_rate = DEFAULT_UBX_BAUD_RATE;
+
+        if (g_key_file_has_key (config->priv->key_file, "ubx", "baud-rate", NULL)) {
+                gint baud_rate;
+
+                baud_rate = g_key_file_get_integer (config->priv->key_file,
+                                                    "ubx",
+                                                    "baud-rate",
+                                                    &error);
+                if (error != NULL)
+                        g_warning ("Failed to get config \"ubx/baud-rate\": %s", error->message);
+                else if (baud_rate <= 0)
+                        g_warning ("Invalid config \"ubx/baud-rate\": %d", baud_rate);
+                else
+                        config->priv->ubx_baud_rate = baud_rate;
+        }
+}
+
+#define DEFAULT_REPLAY_SPEED 1.0
+
+static void
+load_replay_config (GClueConfig *config, gboolean initial)
+{
+        g_autoptr(GError) error = NULL;
+
+        config->priv->enable_replay_source =
+                load_enable_source_config (config, "replay", initial,
+                                           config->priv->enable_replay_source);
+
+        if (g_key_file_has_key (config->priv->key_file, "replay", "file", NULL)) {
+                g_autofree char *file = NULL;
+
+                file = g_key_file_get_string (config->priv->key_file,
+                                              "replay",
+                                              "file",
+                                              &error);
+                if (error == NULL) {
+                        g_clear_pointer (&config->priv->replay_file, g_free);
+                        config->priv->replay_file = g_steal_pointer (&file);
+                } else
+                        g_warning ("Failed to get config \"replay/file\": %s", error->message);
+                g_clear_error (&error);
+        }
+
+        if (initial)
+                config->priv->replay_speed = DEFAULT_REPLAY_SPEED;
+
+        if (g_key_file_has_key (config->priv->key_file, "replay", "speed", NULL)) {
+                gdouble speed;
+
+                speed = g_key_file_get_double (config->priv->key_file,
+                                               "replay",
+                                               "speed",
+                                               &error);
+                if (error != NULL)
+                        g_warning ("Failed to get config \"replay/speed\": %s", error->message);
+                else if (speed < 0)
+                        g_warning ("Invalid config \"replay/speed\": %f", speed);
+                else
+                        config->priv->replay_speed = speed;
+                g_clear_error (&error);
+        }
+
+        if (g_key_file_has_key (config->priv->key_file, "replay", "loop", NULL)) {
+                gboolean loop;
+
+                loop = g_key_file_get_boolean (config->priv->key_file,
+                                               "replay",
+                                               "loop",
+                                               &error);
+                if (error == NULL)
+                        config->priv->replay_loop = loop;
+                else
+                        g_warning ("Failed to get config \"replay/loop\": %s", error->message);
         }
 }
 
@@ -458,6 +744,9 @@ load_config_file (GClueConfig *config, const char *path, gboolean initial) {
         load_modem_gps_config (config, initial);
         load_gpsd_config (config, initial);
         load_network_nmea_config (config, initial);
+        load_nmea_config (config, initial);
+        load_ubx_config (config, initial);
+        load_replay_config (config, initial);
         load_compass_config (config, initial);
         load_static_source_config (config, initial);
 }
@@ -519,6 +808,14 @@ gclue_config_print (GClueConfig *config)
                  config->priv->enable_nmea_source? "enabled": "disabled");
         g_debug ("Network NMEA socket: %s",
                  config->priv->nmea_socket == NULL? "none": config->priv->nmea_socket);
+        if (config->priv->nmea_serial_device != NULL)
+                g_debug ("Network NMEA serial device: %s at %u baud",
+                         config->priv->nmea_serial_device,
+                         config->priv->nmea_baud_rate);
+        else
+                g_debug ("Network NMEA serial device: none");
+        g_debug ("Network NMEA services used at once: %u",
+                 config->priv->nmea_max_services);
         g_debug ("3G source: %s",
                  config->priv->enable_3g_source? "enabled": "disabled");
         g_debug ("CDMA source: %s",
@@ -527,6 +824,37 @@ gclue_config_print (GClueConfig *config)
                  config->priv->enable_modem_gps_source? "enabled": "disabled");
         g_debug ("GPSD source: %s",
                  config->priv->enable_gpsd_source? "enabled": "disabled");
+        g_debug ("GPSD transport: %s", config->priv->gpsd_transport);
+        if (config->priv->gpsd_endpoints != NULL &&
+            config->priv->gpsd_endpoints[0] != NULL) {
+                g_debug ("GPSD endpoints:");
+                for (i = 0; config->priv->gpsd_endpoints[i] != NULL; i++)
+                        g_debug ("\t%s", config->priv->gpsd_endpoints[i]);
+        } else
+                g_debug ("GPSD endpoints: default");
+        g_debug ("NMEA talker priority:");
+        for (i = 0; config->priv->nmea_talkers[i] != NULL; i++)
+                g_debug ("\t%s", config->priv->nmea_talkers[i]);
+        g_debug ("UBX source: %s",
+                 config->priv->enable_ubx_source? "enabled": "disabled");
+        if (config->priv->ubx_device != NULL)
+                g_debug ("UBX device: %s at %u baud",
+                         config->priv->ubx_device,
+                         config->priv->ubx_baud_rate);
+        else
+                g_debug ("UBX device: none");
+        g_debug ("Replay source: %s",
+                 config->priv->enable_replay_source? "enabled": "disabled");
+        if (config->priv->replay_file != NULL)
+                g_debug ("Replay file: %s at %gx speed%s",
+                         config->priv->replay_file,
+                         config->priv->replay_speed,
+                         config->priv->replay_loop? ", looping": "");
+        else
+                g_debug ("Replay file: none");
+        g_debug ("NMEA record file: %s",
+                 config->priv->nmea_record_file == NULL ?
+                 "none" : config->priv->nmea_record_file);
         g_debug ("WiFi source: %s",
                  config->priv->enable_wifi_source? "enabled": "disabled");
         redacted_locate_url = redact_api_key (config->priv->wifi_url);
@@ -713,6 +1041,30 @@ gclue_config_get_nmea_socket (GClueConfig *config)
         return config->priv->nmea_socket;
 }
 
+const char *
+gclue_config_get_nmea_serial_device (GClueConfig *config)
+{
+        return config->priv->nmea_serial_device;
+}
+
+guint
+gclue_config_get_nmea_baud_rate (GClueConfig *config)
+{
+        return config->priv->nmea_baud_rate;
+}
+
+guint
+gclue_config_get_nmea_max_services (GClueConfig *config)
+{
+        return config->priv->nmea_max_services;
+}
+
+const char *
+gclue_config_get_nmea_record_file (GClueConfig *config)
+{
+        return config->priv->nmea_record_file;
+}
+
 const char *
 gclue_config_get_wifi_url (GClueConfig *config)
 {
@@ -788,6 +1140,66 @@ gclue_config_get_enable_gpsd_source (GClueConfig *config)
         return config->priv->enable_gpsd_source;
 }
 
+const char *
+gclue_config_get_gpsd_transport (GClueConfig *config)
+{
+        return config->priv->gpsd_transport;
+}
+
+const char * const *
+gclue_config_get_gpsd_endpoints (GClueConfig *config)
+{
+        return (const char * const *) config->priv->gpsd_endpoints;
+}
+
+const char * const *
+gclue_config_get_nmea_talker_priority (GClueConfig *config)
+{
+        return (const char * const *) config->priv->nmea_talkers;
+}
+
+gboolean
+gclue_config_get_enable_ubx_source (GClueConfig *config)
+{
+        return config->priv->enable_ubx_source;
+}
+
+const char *
+gclue_config_get_ubx_device (GClueConfig *config)
+{
+        return config->priv->ubx_device;
+}
+
+guint
+gclue_config_get_ubx_baud_rate (GClueConfig *config)
+{
+        return config->priv->ubx_baud_rate;
+}
+
+gboolean
+gclue_config_get_enable_replay_source (GClueConfig *config)
+{
+        return config->priv->enable_replay_source;
+}
+
+const char *
+gclue_config_get_replay_file (GClueConfig *config)
+{
+        return config->priv->replay_file;
+}
+
+gdouble
+gclue_config_get_replay_speed (GClueConfig *config)
+{
+        return config->priv->replay_speed;
+}
+
+gboolean
+gclue_config_get_replay_loop (GClueConfig *config)
+{
+        return config->priv->replay_loop;
+}
+
 void
 gclue_config_set_nmea_socket (GClueConfig *config,
                               const char  *nmea_socket)
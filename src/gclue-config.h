@@ -76,6 +76,10 @@ gboolean            gclue_config_is_system_component    (GClueConfig     *config
 const char *        gclue_config_get_nmea_socket        (GClueConfig     *config);
 void                gclue_config_set_nmea_socket        (GClueConfig     *config,
                                                          const char  *nmea_socket);
+const char *        gclue_config_get_nmea_serial_device (GClueConfig     *config);
+guint               gclue_config_get_nmea_baud_rate     (GClueConfig     *config);
+guint               gclue_config_get_nmea_max_services  (GClueConfig     *config);
+const char *        gclue_config_get_nmea_record_file   (GClueConfig     *config);
 
 const char *        gclue_config_get_wifi_url           (GClueConfig     *config);
 const char *        gclue_config_get_wifi_submit_url    (GClueConfig     *config);
@@ -96,6 +100,20 @@ gboolean            gclue_config_get_enable_static_source
                                                         (GClueConfig *config);
 gboolean            gclue_config_get_enable_gpsd_source
                                                         (GClueConfig *config);
+const char *        gclue_config_get_gpsd_transport     (GClueConfig     *config);
+const char * const *
+                    gclue_config_get_gpsd_endpoints     (GClueConfig     *config);
+const char * const *
+                    gclue_config_get_nmea_talker_priority
+                                                        (GClueConfig     *config);
+gboolean            gclue_config_get_enable_ubx_source  (GClueConfig     *config);
+const char *        gclue_config_get_ubx_device         (GClueConfig     *config);
+guint               gclue_config_get_ubx_baud_rate      (GClueConfig     *config);
+gboolean            gclue_config_get_enable_replay_source
+                                                        (GClueConfig     *config);
+const char *        gclue_config_get_replay_file        (GClueConfig     *config);
+gdouble             gclue_config_get_replay_speed       (GClueConfig     *config);
+gboolean            gclue_config_get_replay_loop        (GClueConfig     *config);
 
 G_END_DECLS
 
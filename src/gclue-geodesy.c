@@ -0,0 +1,211 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include "gclue-geodesy.h"
+#include <math.h>
+
+/* The WGS-84 ellipsoid, the one GNSS receivers give coordinates on */
+#define WGS84_A 6378137.0
+#define WGS84_F (1 / 298.257223563)
+#define WGS84_B (WGS84_A * (1 - WGS84_F))
+
+/* Vincenty's iteration converges in a handful of steps, except for nearly
+ * antipodal points where it may not at all.
+ */
+#define VINCENTY_MAX_ITERATIONS 100
+#define VINCENTY_TOLERANCE 1e-12
+
+#define DEG_TO_RAD(deg) ((deg) * M_PI / 180.0)
+#define RAD_TO_DEG(rad) ((rad) * 180.0 / M_PI)
+
+static gdouble
+normalize_bearing (gdouble bearing)
+{
+        bearing = fmod (bearing, 360.0);
+        if (bearing < 0)
+                bearing += 360.0;
+
+        return bearing;
+}
+
+static gdouble
+longitude_difference (gdouble longitude1,
+                      gdouble longitude2)
+{
+        gdouble diff = DEG_TO_RAD (longitude2 - longitude1);
+
+        if (diff > M_PI)
+                diff -= 2 * M_PI;
+        else if (diff < -M_PI)
+                diff += 2 * M_PI;
+
+        return diff;
+}
+
+/**
+ * gclue_geodesy_ellipsoid_inverse:
+ * @latitude1: latitude of the first point
+ * @longitude1: longitude of the first point
+ * @latitude2: latitude of the second point
+ * @longitude2: longitude of the second point
+ * @distance: (out) (optional): the distance between the points
+ * @bearing: (out) (optional): the initial bearing from the first point to
+ *           the second, NAN if they are the same
+ *
+ * Solves the inverse geodesic problem on the WGS-84 ellipsoid with
+ * Vincenty's formulae, accurate to well under a millimeter.
+ *
+ * Returns: %FALSE if the points are too close to antipodal for the
+ *          formulae to converge, leaving @distance and @bearing unset.
+ **/
+gboolean
+gclue_geodesy_ellipsoid_inverse (gdouble  latitude1,
+                                 gdouble  longitude1,
+                                 gdouble  latitude2,
+                                 gdouble  longitude2,
+                                 gdouble *distance,
+                                 gdouble *bearing)
+{
+        gdouble l, u1, u2, sin_u1, cos_u1, sin_u2, cos_u2;
+        gdouble lambda, lambda_prev;
+        gdouble sin_lambda, cos_lambda;
+        gdouble sin_sigma = 0, cos_sigma = 0, sigma = 0;
+        gdouble sin_alpha, cos_sq_alpha = 0, cos_2sigma_m = 0;
+        gdouble u_sq, a, b, c, delta_sigma;
+        guint i;
+
+        l = longitude_difference (longitude1, longitude2);
+        u1 = atan ((1 - WGS84_F) * tan (DEG_TO_RAD (latitude1)));
+        u2 = atan ((1 - WGS84_F) * tan (DEG_TO_RAD (latitude2)));
+        sin_u1 = sin (u1);
+        cos_u1 = cos (u1);
+        sin_u2 = sin (u2);
+        cos_u2 = cos (u2);
+
+        lambda = l;
+        for (i = 0; i < VINCENTY_MAX_ITERATIONS; i++) {
+                gdouble x, y;
+
+                sin_lambda = sin (lambda);
+                cos_lambda = cos (lambda);
+
+                x = cos_u2 * sin_lambda;
+                y = cos_u1 * sin_u2 - sin_u1 * cos_u2 * cos_lambda;
+                sin_sigma = sqrt (x * x + y * y);
+                if (sin_sigma == 0) {
+                        /* The same point */
+                        if (distance != NULL)
+                                *distance = 0;
+                        if (bearing != NULL)
+                                *bearing = NAN;
+
+                        return TRUE;
+                }
+
+                cos_sigma = sin_u1 * sin_u2 + cos_u1 * cos_u2 * cos_lambda;
+                sigma = atan2 (sin_sigma, cos_sigma);
+                sin_alpha = cos_u1 * cos_u2 * sin_lambda / sin_sigma;
+                cos_sq_alpha = 1 - sin_alpha * sin_alpha;
+
+                /* Both points on the equator */
+                if (cos_sq_alpha != 0)
+                        cos_2sigma_m = cos_sigma -
+                                       2 * sin_u1 * sin_u2 / cos_sq_alpha;
+                else
+                        cos_2sigma_m = 0;
+
+                c = WGS84_F / 16 * cos_sq_alpha *
+                    (4 + WGS84_F * (4 - 3 * cos_sq_alpha));
+                lambda_prev = lambda;
+                lambda = l + (1 - c) * WGS84_F * sin_alpha *
+                         (sigma + c * sin_sigma *
+                          (cos_2sigma_m + c * cos_sigma *
+                           (-1 + 2 * cos_2sigma_m * cos_2sigma_m)));
+
+                if (fabs (lambda) > M_PI)
+                        return FALSE;
+                if (fabs (lambda - lambda_prev) < VINCENTY_TOLERANCE)
+                        break;
+        }
+
+        if (i == VINCENTY_MAX_ITERATIONS)
+                return FALSE;
+
+        u_sq = cos_sq_alpha * (WGS84_A * WGS84_A - WGS84_B * WGS84_B) /
+               (WGS84_B * WGS84_B);
+        a = 1 + u_sq / 16384 *
+            (4096 + u_sq * (-768 + u_sq * (320 - 175 * u_sq)));
+        b = u_sq / 1024 * (256 + u_sq * (-128 + u_sq * (74 - 47 * u_sq)));
+        delta_sigma = b * sin_sigma *
+                      (cos_2sigma_m + b / 4 *
+                       (cos_sigma * (-1 + 2 * cos_2sigma_m * cos_2sigma_m) -
+                        b / 6 * cos_2sigma_m *
+                        (-3 + 4 * sin_sigma * sin_sigma) *
+                        (-3 + 4 * cos_2sigma_m * cos_2sigma_m)));
+
+        if (distance != NULL)
+                *distance = WGS84_B * a * (sigma - delta_sigma);
+        if (bearing != NULL) {
+                gdouble alpha1;
+
+                alpha1 = atan2 (cos_u2 * sin (lambda),
+                                cos_u1 * sin_u2 -
+                                sin_u1 * cos_u2 * cos (lambda));
+                *bearing = normalize_bearing (RAD_TO_DEG (alpha1));
+        }
+
+        return TRUE;
+}
+
+/**
+ * gclue_geodesy_sphere_bearing:
+ * @latitude1: latitude of the first point
+ * @longitude1: longitude of the first point
+ * @latitude2: latitude of the second point
+ * @longitude2: longitude of the second point
+ *
+ * Calculates the initial bearing of the great circle from the first point
+ * to the second, on a spherical Earth. Cheaper than
+ * gclue_geodesy_ellipsoid_inverse() and within a fraction of a degree of
+ * it.
+ *
+ * Returns: the bearing, NAN if the points are the same.
+ **/
+gdouble
+gclue_geodesy_sphere_bearing (gdouble latitude1,
+                              gdouble longitude1,
+                              gdouble latitude2,
+                              gdouble longitude2)
+{
+        gdouble lat1, lat2, dlon, x, y;
+
+        if (latitude1 == latitude2 && longitude1 == longitude2)
+                return NAN;
+
+        lat1 = DEG_TO_RAD (latitude1);
+        lat2 = DEG_TO_RAD (latitude2);
+        dlon = longitude_difference (longitude1, longitude2);
+
+        y = sin (dlon) * cos (lat2);
+        x = cos (lat1) * sin (lat2) - sin (lat1) * cos (lat2) * cos (dlon);
+
+        return normalize_bearing (RAD_TO_DEG (atan2 (y, x)));
+}
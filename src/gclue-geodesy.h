@@ -0,0 +1,49 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#ifndef GCLUE_GEODESY_H
+#define GCLUE_GEODESY_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Distances are in meters, angles in degrees and bearings clockwise from
+ * North, in [0, 360).
+ */
+
+gboolean
+gclue_geodesy_ellipsoid_inverse (gdouble  latitude1,
+                                 gdouble  longitude1,
+                                 gdouble  latitude2,
+                                 gdouble  longitude2,
+                                 gdouble *distance,
+                                 gdouble *bearing);
+
+gdouble
+gclue_geodesy_sphere_bearing (gdouble latitude1,
+                              gdouble longitude1,
+                              gdouble latitude2,
+                              gdouble longitude2);
+
+G_END_DECLS
+
+#endif /* GCLUE_GEODESY_H */
@@ -0,0 +1,712 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "gclue-gpsd-json.h"
+
+/* gpsd reports never nest deeper than an array of objects inside the
+ * report object, anything beyond this is not something we want to walk.
+ */
+#define JSON_MAX_DEPTH 8
+
+/* The parser below works directly on the NUL-terminated report line and
+ * never allocates: keys and string values are compared in place and
+ * numbers are checked against JSON's grammar, then converted with
+ * g_ascii_strtod().
+ */
+
+static const char *
+skip_ws (const char *p)
+{
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+                p++;
+
+        return p;
+}
+
+static gboolean
+json_string (const char **p,
+             const char **str,
+             gsize       *len)
+{
+        const char *s = *p;
+
+        if (*s != '"')
+                return FALSE;
+        s++;
+
+        *str = s;
+        while (*s != '"') {
+                if (*s == '\0')
+                        return FALSE;
+                if (*s == '\\') {
+                        s++;
+                        if (*s == '\0')
+                                return FALSE;
+                }
+                s++;
+        }
+        *len = s - *str;
+        *p = s + 1;
+
+        return TRUE;
+}
+
+static const char *
+skip_digits (const char *p)
+{
+        while (g_ascii_isdigit (*p))
+                p++;
+
+        return p;
+}
+
+/* g_ascii_strtod() also takes a leading '+', hexadecimal, "nan" and "inf",
+ * none of which is JSON.
+ */
+static gboolean
+json_number (const char **p,
+             gdouble     *value)
+{
+        const char *s = *p;
+        char *end;
+
+        if (*s == '-')
+                s++;
+        if (*s == '0')
+                s++;
+        else if (g_ascii_isdigit (*s))
+                s = skip_digits (s);
+        else
+                return FALSE;
+
+        if (*s == '.') {
+                s++;
+                if (!g_ascii_isdigit (*s))
+                        return FALSE;
+                s = skip_digits (s);
+        }
+
+        if (*s == 'e' || *s == 'E') {
+                s++;
+                if (*s == '+' || *s == '-')
+                        s++;
+                if (!g_ascii_isdigit (*s))
+                        return FALSE;
+                s = skip_digits (s);
+        }
+
+        *value = g_ascii_strtod (*p, &end);
+        if (end != s || !isfinite (*value))
+                return FALSE;
+        *p = s;
+
+        return TRUE;
+}
+
+static gboolean
+json_int (const char **p,
+          gint        *value)
+{
+        gdouble number;
+
+        if (!json_number (p, &number))
+                return FALSE;
+        if (!isfinite (number) || number < G_MININT || number > G_MAXINT)
+                return FALSE;
+        *value = (gint) number;
+
+        return TRUE;
+}
+
+static gboolean
+json_literal (const char **p,
+              const char  *literal)
+{
+        gsize len = strlen (literal);
+
+        if (strncmp (*p, literal, len) != 0)
+                return FALSE;
+        *p += len;
+
+        return TRUE;
+}
+
+static gboolean
+json_skip_value (const char **p,
+                 guint        depth)
+{
+        const char *s = skip_ws (*p);
+        const char *str;
+        gsize len;
+        gdouble number;
+        char close;
+
+        switch (*s) {
+        case '"':
+                if (!json_string (&s, &str, &len))
+                        return FALSE;
+                break;
+        case 't':
+                if (!json_literal (&s, "true"))
+                        return FALSE;
+                break;
+        case 'f':
+                if (!json_literal (&s, "false"))
+                        return FALSE;
+                break;
+        case 'n':
+                if (!json_literal (&s, "null"))
+                        return FALSE;
+                break;
+        case '{':
+        case '[':
+                if (depth >= JSON_MAX_DEPTH)
+                        return FALSE;
+
+                close = (*s == '{') ? '}' : ']';
+                s = skip_ws (s + 1);
+                if (*s == close) {
+                        s++;
+                        break;
+                }
+
+                while (TRUE) {
+                        if (close == '}') {
+                                if (!json_string (&s, &str, &len))
+                                        return FALSE;
+                                s = skip_ws (s);
+                                if (*s != ':')
+                                        return FALSE;
+                                s++;
+                        }
+                        if (!json_skip_value (&s, depth + 1))
+                                return FALSE;
+                        s = skip_ws (s);
+                        if (*s == ',') {
+                                s = skip_ws (s + 1);
+                                continue;
+                        }
+                        if (*s != close)
+                                return FALSE;
+                        s++;
+                        break;
+                }
+                break;
+        default:
+                if (!json_number (&s, &number))
+                        return FALSE;
+                break;
+        }
+        *p = s;
+
+        return TRUE;
+}
+
+static gboolean
+json_bool (const char **p,
+           gboolean    *value)
+{
+        if (json_literal (p, "true")) {
+                *value = TRUE;
+                return TRUE;
+        }
+        if (json_literal (p, "false")) {
+                *value = FALSE;
+                return TRUE;
+        }
+
+        return FALSE;
+}
+
+static gboolean
+key_is (const char *key,
+        gsize       len,
+        const char *name)
+{
+        return strlen (name) == len && memcmp (key, name, len) == 0;
+}
+
+static gint
+parse_digits (const char *s,
+              guint       n)
+{
+        gint value = 0;
+        guint i;
+
+        for (i = 0; i < n; i++) {
+                if (!g_ascii_isdigit (s[i]))
+                        return -1;
+                value = value * 10 + (s[i] - '0');
+        }
+
+        return value;
+}
+
+/* Days between 1970-01-01 and the given proleptic Gregorian date */
+static gint64
+days_from_civil (gint year,
+                 gint month,
+                 gint day)
+{
+        gint era, yoe, doy, doe;
+
+        year -= month <= 2;
+        era = (year >= 0 ? year : year - 399) / 400;
+        yoe = year - era * 400;
+        doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+        return (gint64) era * 146097 + doe - 719468;
+}
+
+/* Parses gpsd's "2024-05-01T12:34:56.789Z" into microseconds since the
+ * epoch, returns 0 if the string isn't in that form.
+ */
+static gint64
+parse_iso8601 (const char *str,
+               gsize       len)
+{
+        gint year, month, day, hour, minute, second;
+        gint64 usec = 0, scale = G_USEC_PER_SEC;
+        gsize i;
+
+        if (len < 20 || str[4] != '-' || str[7] != '-' || str[10] != 'T' ||
+            str[13] != ':' || str[16] != ':')
+                return 0;
+
+        year = parse_digits (str, 4);
+        month = parse_digits (str + 5, 2);
+        day = parse_digits (str + 8, 2);
+        hour = parse_digits (str + 11, 2);
+        minute = parse_digits (str + 14, 2);
+        second = parse_digits (str + 17, 2);
+        if (year < 0 || month < 1 || month > 12 || day < 1 || day > 31 ||
+            hour < 0 || hour > 23 || minute < 0 || minute > 59 ||
+            second < 0 || second > 60)
+                return 0;
+
+        i = 19;
+        if (str[i] == '.') {
+                for (i++; i < len && g_ascii_isdigit (str[i]); i++) {
+                        scale /= 10;
+                        usec += (str[i] - '0') * scale;
+                }
+        }
+        if (i >= len || str[i] != 'Z')
+                return 0;
+
+        return ((days_from_civil (year, month, day) * 24 + hour) * 60 +
+                minute) * 60 * G_USEC_PER_SEC +
+               (gint64) second * G_USEC_PER_SEC + usec;
+}
+
+static gboolean
+parse_time (const char **p,
+            gint64      *time)
+{
+        const char *str;
+        gsize len;
+        gdouble seconds;
+
+        /* Protocol versions before 3.10 sent the time as seconds */
+        if (**p != '"') {
+                if (!json_number (p, &seconds))
+                        return FALSE;
+                *time = isfinite (seconds) && seconds > 0 ?
+                        (gint64) (seconds * G_USEC_PER_SEC) : 0;
+
+                return TRUE;
+        }
+
+        if (!json_string (p, &str, &len))
+                return FALSE;
+        *time = parse_iso8601 (str, len);
+
+        return TRUE;
+}
+
+static gboolean
+parse_satellite (const char         **p,
+                 GClueGpsdSatellite  *satellite)
+{
+        const char *s = *p;
+
+        satellite->prn = 0;
+        satellite->elevation = NAN;
+        satellite->azimuth = NAN;
+        satellite->snr = NAN;
+        satellite->used = FALSE;
+
+        if (*s != '{')
+                return FALSE;
+        s = skip_ws (s + 1);
+        if (*s == '}') {
+                *p = s + 1;
+                return TRUE;
+        }
+
+        while (TRUE) {
+                const char *key;
+                gsize key_len;
+
+                if (!json_string (&s, &key, &key_len))
+                        return FALSE;
+                s = skip_ws (s);
+                if (*s != ':')
+                        return FALSE;
+                s = skip_ws (s + 1);
+
+                if (key_is (key, key_len, "PRN")) {
+                        if (!json_int (&s, &satellite->prn))
+                                return FALSE;
+                } else if (key_is (key, key_len, "el")) {
+                        if (!json_number (&s, &satellite->elevation))
+                                return FALSE;
+                } else if (key_is (key, key_len, "az")) {
+                        if (!json_number (&s, &satellite->azimuth))
+                                return FALSE;
+                } else if (key_is (key, key_len, "ss")) {
+                        if (!json_number (&s, &satellite->snr))
+                                return FALSE;
+                } else if (key_is (key, key_len, "used")) {
+                        if (!json_bool (&s, &satellite->used))
+                                return FALSE;
+                } else if (!json_skip_value (&s, 2)) {
+                        return FALSE;
+                }
+
+                s = skip_ws (s);
+                if (*s == ',') {
+                        s = skip_ws (s + 1);
+                        continue;
+                }
+                if (*s != '}')
+                        return FALSE;
+                *p = s + 1;
+
+                return TRUE;
+        }
+}
+
+static gboolean
+parse_satellites (const char      **p,
+                  GClueGpsdReport  *report)
+{
+        const char *s = *p;
+
+        if (*s != '[')
+                return FALSE;
+        s = skip_ws (s + 1);
+        if (*s == ']') {
+                *p = s + 1;
+                return TRUE;
+        }
+
+        while (TRUE) {
+                if (report->n_satellites < GCLUE_GPSD_JSON_MAX_SATELLITES) {
+                        GClueGpsdSatellite *satellite;
+
+                        satellite = &report->satellites[report->n_satellites];
+                        if (!parse_satellite (&s, satellite))
+                                return FALSE;
+                        report->n_satellites++;
+                } else if (!json_skip_value (&s, 1)) {
+                        return FALSE;
+                }
+
+                s = skip_ws (s);
+                if (*s == ',') {
+                        s = skip_ws (s + 1);
+                        continue;
+                }
+                if (*s != ']')
+                        return FALSE;
+                *p = s + 1;
+
+                return TRUE;
+        }
+}
+
+static gdouble *
+number_field (GClueGpsdReport *report,
+              const char      *key,
+              gsize            key_len)
+{
+        static const struct {
+                const char *name;
+                gsize offset;
+        } fields[] = {
+                { "eph", G_STRUCT_OFFSET (GClueGpsdReport, eph) },
+                { "epx", G_STRUCT_OFFSET (GClueGpsdReport, epx) },
+                { "epy", G_STRUCT_OFFSET (GClueGpsdReport, epy) },
+                { "epv", G_STRUCT_OFFSET (GClueGpsdReport, epv) },
+                { "speed", G_STRUCT_OFFSET (GClueGpsdReport, speed) },
+                { "eps", G_STRUCT_OFFSET (GClueGpsdReport, eps) },
+                { "track", G_STRUCT_OFFSET (GClueGpsdReport, track) },
+                { "epd", G_STRUCT_OFFSET (GClueGpsdReport, epd) },
+                { "climb", G_STRUCT_OFFSET (GClueGpsdReport, climb) },
+                { "epc", G_STRUCT_OFFSET (GClueGpsdReport, epc) },
+                { "hdop", G_STRUCT_OFFSET (GClueGpsdReport, hdop) },
+                { "vdop", G_STRUCT_OFFSET (GClueGpsdReport, vdop) },
+                { "pdop", G_STRUCT_OFFSET (GClueGpsdReport, pdop) },
+                { "rms", G_STRUCT_OFFSET (GClueGpsdReport, rms) },
+        };
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (fields); i++) {
+                if (key_is (key, key_len, fields[i].name))
+                        return G_STRUCT_MEMBER_P (report, fields[i].offset);
+        }
+
+        return NULL;
+}
+
+/**
+ * gclue_gpsd_report_init:
+ * @report: a #GClueGpsdReport
+ *
+ * Resets all the fields of @report to unknown.
+ **/
+void
+gclue_gpsd_report_init (GClueGpsdReport *report)
+{
+        report->report_class = GCLUE_GPSD_REPORT_UNKNOWN;
+        report->mode = 0;
+        report->time = 0;
+        report->latitude = NAN;
+        report->longitude = NAN;
+        report->altitude = NAN;
+        report->eph = NAN;
+        report->epx = NAN;
+        report->epy = NAN;
+        report->epv = NAN;
+        report->speed = NAN;
+        report->eps = NAN;
+        report->track = NAN;
+        report->epd = NAN;
+        report->climb = NAN;
+        report->epc = NAN;
+        report->hdop = NAN;
+        report->vdop = NAN;
+        report->pdop = NAN;
+        report->n_satellites = 0;
+        report->rms = NAN;
+        report->lat_err = NAN;
+        report->lon_err = NAN;
+        report->alt_err = NAN;
+}
+
+/**
+ * gclue_gpsd_json_parse:
+ * @line: a NUL-terminated JSON report from gpsd
+ * @report: (out caller-allocates): the parsed report
+ *
+ * Parses a TPV, SKY or GST report. Other report classes are recognized as
+ * valid JSON but leave @report's class as %GCLUE_GPSD_REPORT_UNKNOWN.
+ *
+ * Returns: %TRUE if @line was a well-formed JSON object.
+ **/
+gboolean
+gclue_gpsd_json_parse (const char      *line,
+                       GClueGpsdReport *report)
+{
+        const char *s = skip_ws (line);
+        gdouble lat = NAN, lon = NAN, alt = NAN, alt_msl = NAN;
+
+        gclue_gpsd_report_init (report);
+
+        if (*s != '{')
+                return FALSE;
+        s = skip_ws (s + 1);
+
+        while (*s != '}') {
+                const char *key, *str;
+                gsize key_len, len;
+                gdouble *field;
+
+                if (!json_string (&s, &key, &key_len))
+                        return FALSE;
+                s = skip_ws (s);
+                if (*s != ':')
+                        return FALSE;
+                s = skip_ws (s + 1);
+
+                if (key_is (key, key_len, "class")) {
+                        if (!json_string (&s, &str, &len))
+                                return FALSE;
+
+                        if (key_is (str, len, "TPV"))
+                                report->report_class = GCLUE_GPSD_REPORT_TPV;
+                        else if (key_is (str, len, "SKY"))
+                                report->report_class = GCLUE_GPSD_REPORT_SKY;
+                        else if (key_is (str, len, "GST"))
+                                report->report_class = GCLUE_GPSD_REPORT_GST;
+                } else if (key_is (key, key_len, "mode")) {
+                        if (!json_int (&s, &report->mode))
+                                return FALSE;
+                } else if (key_is (key, key_len, "time")) {
+                        if (!parse_time (&s, &report->time))
+                                return FALSE;
+                } else if (key_is (key, key_len, "lat")) {
+                        if (!json_number (&s, &lat))
+                                return FALSE;
+                } else if (key_is (key, key_len, "lon")) {
+                        if (!json_number (&s, &lon))
+                                return FALSE;
+                } else if (key_is (key, key_len, "alt")) {
+                        if (!json_number (&s, &alt))
+                                return FALSE;
+                } else if (key_is (key, key_len, "altMSL")) {
+                        if (!json_number (&s, &alt_msl))
+                                return FALSE;
+                } else if (key_is (key, key_len, "satellites")) {
+                        if (!parse_satellites (&s, report))
+                                return FALSE;
+                } else if ((field = number_field (report, key, key_len))) {
+                        if (!json_number (&s, field))
+                                return FALSE;
+                } else if (!json_skip_value (&s, 1)) {
+                        return FALSE;
+                }
+
+                s = skip_ws (s);
+                if (*s == ',') {
+                        s = skip_ws (s + 1);
+                        if (*s == '}')
+                                return FALSE;
+                } else if (*s != '}') {
+                        return FALSE;
+                }
+        }
+
+        if (*skip_ws (s + 1) != '\0')
+                return FALSE;
+
+        /* "lat", "lon" and "alt" are the position in a TPV but the
+         * standard deviation of its error in a GST.
+         */
+        if (report->report_class == GCLUE_GPSD_REPORT_GST) {
+                report->lat_err = lat;
+                report->lon_err = lon;
+                report->alt_err = alt;
+        } else {
+                report->latitude = lat;
+                report->longitude = lon;
+                report->altitude = isfinite (alt_msl) ? alt_msl : alt;
+        }
+
+        return TRUE;
+}
+
+/**
+ * gclue_gpsd_json_reader_init:
+ * @reader: a #GClueGpsdJsonReader
+ *
+ * Prepares @reader for a new connection, dropping anything buffered.
+ **/
+void
+gclue_gpsd_json_reader_init (GClueGpsdJsonReader *reader)
+{
+        reader->len = 0;
+        reader->pos = 0;
+        reader->discarding = FALSE;
+}
+
+/**
+ * gclue_gpsd_json_reader_fill:
+ * @reader: a #GClueGpsdJsonReader
+ * @fd: the gpsd socket
+ *
+ * Reads whatever is available on @fd into @reader's buffer, after the
+ * part of the last line that hasn't been completed yet.
+ *
+ * Returns: what read() returned.
+ **/
+gssize
+gclue_gpsd_json_reader_fill (GClueGpsdJsonReader *reader,
+                             gint                 fd)
+{
+        gssize ret;
+
+        if (reader->pos > 0) {
+                memmove (reader->data,
+                         reader->data + reader->pos,
+                         reader->len - reader->pos);
+                reader->len -= reader->pos;
+                reader->pos = 0;
+        }
+
+        /* A line that doesn't fit is of no use to us, drop what we have
+         * of it and skip the rest up to the next newline.
+         */
+        if (reader->len == sizeof (reader->data) - 1) {
+                reader->len = 0;
+                reader->discarding = TRUE;
+        }
+
+        do {
+                ret = read (fd,
+                            reader->data + reader->len,
+                            sizeof (reader->data) - 1 - reader->len);
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret > 0)
+                reader->len += ret;
+
+        return ret;
+}
+
+/**
+ * gclue_gpsd_json_reader_next_line:
+ * @reader: a #GClueGpsdJsonReader
+ *
+ * Returns: (transfer none) (nullable): the next complete line in the
+ * buffer, NUL-terminated in place, or %NULL if there isn't one yet. The
+ * line stays valid until the next call to gclue_gpsd_json_reader_fill().
+ **/
+const char *
+gclue_gpsd_json_reader_next_line (GClueGpsdJsonReader *reader)
+{
+        while (reader->pos < reader->len) {
+                char *line = reader->data + reader->pos;
+                char *newline;
+
+                newline = memchr (line, '\n', reader->len - reader->pos);
+                if (newline == NULL)
+                        return NULL;
+
+                *newline = '\0';
+                reader->pos = newline - reader->data + 1;
+
+                if (reader->discarding) {
+                        reader->discarding = FALSE;
+                        continue;
+                }
+
+                return line;
+        }
+
+        return NULL;
+}
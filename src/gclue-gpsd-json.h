@@ -0,0 +1,114 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#ifndef GCLUE_GPSD_JSON_H
+#define GCLUE_GPSD_JSON_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Longest report line we accept from gpsd. gpsd itself caps its JSON
+ * reports well below this, a SKY report with every satellite of a
+ * multi-constellation receiver is the largest we usually see.
+ */
+#define GCLUE_GPSD_JSON_MAX_LINE 8192
+
+#define GCLUE_GPSD_JSON_MAX_SATELLITES 64
+
+typedef enum {
+        GCLUE_GPSD_REPORT_UNKNOWN,
+        GCLUE_GPSD_REPORT_TPV,
+        GCLUE_GPSD_REPORT_SKY,
+        GCLUE_GPSD_REPORT_GST,
+} GClueGpsdReportClass;
+
+typedef struct {
+        gint     prn;
+        gdouble  elevation;
+        gdouble  azimuth;
+        gdouble  snr;
+        gboolean used;
+} GClueGpsdSatellite;
+
+/* A single gpsd report, normalized. Any value gpsd didn't send is left
+ * at NAN (or 0 for integers), so callers don't need to track which of the
+ * fields were present.
+ */
+typedef struct {
+        GClueGpsdReportClass report_class;
+
+        /* TPV */
+        gint     mode;
+        gint64   time;          /* Microseconds since the epoch */
+        gdouble  latitude;
+        gdouble  longitude;
+        gdouble  altitude;      /* Above mean sea level */
+        gdouble  eph;
+        gdouble  epx;
+        gdouble  epy;
+        gdouble  epv;
+        gdouble  speed;
+        gdouble  eps;
+        gdouble  track;
+        gdouble  epd;
+        gdouble  climb;
+        gdouble  epc;
+
+        /* SKY */
+        gdouble  hdop;
+        gdouble  vdop;
+        gdouble  pdop;
+        guint    n_satellites;
+        GClueGpsdSatellite satellites[GCLUE_GPSD_JSON_MAX_SATELLITES];
+
+        /* GST */
+        gdouble  rms;
+        gdouble  lat_err;
+        gdouble  lon_err;
+        gdouble  alt_err;
+} GClueGpsdReport;
+
+void
+gclue_gpsd_report_init (GClueGpsdReport *report);
+
+gboolean
+gclue_gpsd_json_parse (const char      *line,
+                       GClueGpsdReport *report);
+
+typedef struct {
+        char  data[GCLUE_GPSD_JSON_MAX_LINE];
+        gsize len;
+        gsize pos;
+        gboolean discarding;
+} GClueGpsdJsonReader;
+
+void
+gclue_gpsd_json_reader_init (GClueGpsdJsonReader *reader);
+gssize
+gclue_gpsd_json_reader_fill (GClueGpsdJsonReader *reader,
+                             gint                 fd);
+const char *
+gclue_gpsd_json_reader_next_line (GClueGpsdJsonReader *reader);
+
+G_END_DECLS
+
+#endif /* GCLUE_GPSD_JSON_H */
@@ -21,22 +21,168 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <glib.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
 #include <gps.h>
-#include <dbus/dbus.h>
-#include <dbus/dbus-glib-lowlevel.h>
 #include "gclue-gpsd-source.h"
+#include "gclue-gpsd-json.h"
 #include "gclue-location.h"
+#include "gclue-clock.h"
+#include "gclue-config.h"
 #include "config.h"
 #include "gclue-enum-types.h"
 
+/* How long to wait before trying to reach gpsd again after failing to
+ * connect or losing the connection.
+ * In seconds.
+ */
+#define GPSD_RECONNECT_TIME 5
+
+/* Upper bound on the reports handled in a single wakeup, so a flood of
+ * buffered reports can't starve the rest of the main loop.
+ */
+#define GPSD_MAX_REPORTS_PER_WAKEUP 16
+
+/* How often to look at gpsd's shared memory segment when no client asked
+ * for a specific update rate.
+ * In milliseconds.
+ */
+#define GPSD_SHM_POLL_INTERVAL 100
+
+/* An endpoint that hasn't given us a fix for this long is considered to
+ * have lost it, and any other endpoint with a fix takes over.
+ * In microseconds.
+ */
+#define GPSD_ENDPOINT_STALE_TIME (3 * G_USEC_PER_SEC)
+
+/* While streaming, a receiver that hasn't had a fix for this long since
+ * its last one is considered to have lost it and we stop claiming any
+ * accuracy. There is no limit on the time to the first fix, which can
+ * take minutes with a weak signal or no almanac.
+ * In microseconds.
+ */
+#define GPSD_FIX_LOST_TIME (60 * G_USEC_PER_SEC)
+
+/* How long the fixes have to be worse than the accuracy level we claim
+ * before we lower it.
+ * In microseconds.
+ */
+#define GPSD_LEVEL_DOWN_TIME (30 * G_USEC_PER_SEC)
+
+/* How long to wait after losing the fix before looking for one again.
+ * In seconds.
+ */
+#define GPSD_FIX_RETRY_TIME 60
+
+/* Used when no endpoints are configured */
+#define GPSD_DEFAULT_ENDPOINT "localhost:" DEFAULT_GPSD_PORT
+
+/* What we tell gpsd listening on a UNIX socket, where we talk to it
+ * without libgps.
+ */
+#define GPSD_WATCH_ENABLE  "?WATCH={\"enable\":true,\"json\":true};\n"
+#define GPSD_WATCH_DISABLE "?WATCH={\"enable\":false};\n"
+
+/* gpsd only opens and powers its devices while a client watches them,
+ * listening to its fix signals doesn't count. Over D-Bus we watch the
+ * local gpsd while streaming, without asking for any reports since the
+ * fixes come as signals.
+ */
+#define GPSD_WATCH_POWER   "?WATCH={\"enable\":true,\"json\":false};\n"
+
+/* How gpsd reports are read off the socket */
+typedef enum {
+        GPSD_TRANSPORT_LIBGPS,  /* Let libgps parse them into gps_data */
+        GPSD_TRANSPORT_JSON,    /* Parse the WATCH_JSON stream ourselves */
+        GPSD_TRANSPORT_SHM,     /* Poll gpsd's shared memory export */
+        GPSD_TRANSPORT_DBUS,    /* Listen to gpsd's D-Bus fix signals */
+} GpsdTransport;
+
+#define GPSD_DBUS_INTERFACE "org.gpsd"
+#define GPSD_DBUS_PATH      "/org/gpsd"
+
+/* time, mode, ept, latitude, longitude, eph, altitude, epv, track, epd,
+ * speed, eps, climb, epc and the device name, as sent by gpsd.
+ */
+#define GPSD_DBUS_FIX_TYPE  "(didddddddddddds)"
+
+/* A single gpsd instance we read from */
+typedef struct {
+        GClueGpsdSource     *source;
+
+        char                *address;
+        char                *host;      /* Socket path for UNIX sockets */
+        char                *port;
+        gboolean             unix_socket;
+
+        struct gps_data_t    gps_data;
+        gint                 fd;
+        gboolean             opened;
+
+        /* Whether gpsd is sending us reports. The connection is kept
+         * while we are stopped, only the stream is turned off so that
+         * gpsd can power down the receiver.
+         */
+        gboolean             streaming;
+
+        /* Only used by the D-Bus transport, which keeps its watcher of
+         * the local gpsd in @gps_data and @fd while streaming.
+         */
+        GDBusConnection     *bus;
+        GCancellable        *bus_cancellable;
+        guint                fix_subscription;
+
+        /* Only set for endpoints whose reports we parse ourselves */
+        GClueGpsdJsonReader *json_reader;
+
+        /* Horizontal error from the latest GST report, for receivers
+         * that don't give us eph in their TPVs.
+         */
+        gdouble              gst_accuracy;
+
+        /* Quality of the last fix from this endpoint, and when we got it
+         * (monotonic time, in microseconds).
+         */
+        gint                 mode;
+        gdouble              accuracy;
+        gint64               last_fix_seen;
+
+        /* Time of the last fix from this endpoint, in microseconds */
+        gint64               last_fix_time;
+
+        guint                watch_id;
+        guint                shm_poll_timer;
+        guint                reconnect_timer;
+} GpsdEndpoint;
+
 struct _GClueGpsdSourcePrivate {
-        GCancellable         *cancellable;
+        GpsdTransport        transport;
 
-        DBusConnection       *system_bus;
+        GPtrArray           *endpoints;
 
-        GThread              *gpsd_thread;
-        gboolean             gpsd_thread_running;
+        /* The endpoint whose fixes we are publishing */
+        GpsdEndpoint        *active;
+
+        /* When any endpoint last gave us a fix since we were started, 0
+         * if none has yet (monotonic time, in microseconds).
+         */
+        gint64               last_fix_seen;
+        guint                fix_retry_timer;
+
+        /* When we last had a fix good enough for the accuracy level we
+         * claim (monotonic time, in microseconds).
+         */
+        gint64               level_fix_seen;
+
+        GClueGpsdReport      report;
 };
 
 G_DEFINE_TYPE_WITH_CODE (GClueGpsdSource,
@@ -50,191 +196,1189 @@ static GClueLocationSourceStopResult
 gclue_gpsd_source_stop (GClueLocationSource *source);
 
 static void
-connect_to_service (GClueGpsdSource *source);
+connect_to_endpoint (GpsdEndpoint *endpoint);
+static void
+disconnect_from_endpoint (GpsdEndpoint *endpoint);
+static void
+open_gpsd_watcher (GpsdEndpoint *endpoint);
+
+static gdouble
+gpsd_value_or (gdouble value,
+               gdouble unknown)
+{
+        return isfinite (value) ? value : unknown;
+}
+
 static void
-disconnect_from_service (GClueGpsdSource *source);
+report_from_gps_data (GClueGpsdReport         *report,
+                      const struct gps_data_t *gps_data)
+{
+        const struct gps_fix_t *fix = &gps_data->fix;
 
-#define GPSD_SERVER        "localhost"
-#define GPSD_PORT          "2947"
+        gclue_gpsd_report_init (report);
+        report->report_class = GCLUE_GPSD_REPORT_TPV;
+
+        report->mode = fix->mode;
+        report->latitude = fix->latitude;
+        report->longitude = fix->longitude;
+        report->speed = fix->speed;
+        report->track = fix->track;
+        report->climb = fix->climb;
+        report->epx = fix->epx;
+        report->epy = fix->epy;
+        report->epv = fix->epv;
+        report->eps = fix->eps;
+        report->epd = fix->epd;
+        report->epc = fix->epc;
+#if GPSD_API_MAJOR_VERSION >= 9
+        report->time = (gint64) fix->time.tv_sec * G_USEC_PER_SEC +
+                       fix->time.tv_nsec / 1000;
+        report->altitude = fix->altMSL;
+        report->eph = fix->eph;
+#else
+        if (isfinite (fix->time))
+                report->time = (gint64) (fix->time * G_USEC_PER_SEC);
+        report->altitude = fix->altitude;
+#endif
+}
 
 static void
-start_gpsd_search (void)
+report_from_gps_skyview (GClueGpsdReport         *report,
+                         const struct gps_data_t *gps_data)
 {
-        struct gps_data_t gps_data;
-        int ret;
+        guint i, n;
+
+        gclue_gpsd_report_init (report);
+        report->report_class = GCLUE_GPSD_REPORT_SKY;
+
+        report->hdop = gps_data->dop.hdop;
+        report->vdop = gps_data->dop.vdop;
+        report->pdop = gps_data->dop.pdop;
+
+        n = MIN (MAX (gps_data->satellites_visible, 0),
+                 GCLUE_GPSD_JSON_MAX_SATELLITES);
+        for (i = 0; i < n; i++) {
+                const struct satellite_t *in = &gps_data->skyview[i];
+                GClueGpsdSatellite *out = &report->satellites[i];
+
+                out->prn = in->PRN;
+                out->elevation = in->elevation;
+                out->azimuth = in->azimuth;
+                out->snr = in->ss;
+                out->used = in->used;
+        }
+        report->n_satellites = n;
+}
 
-        if ((ret = gps_open (GPSD_SERVER, GPSD_PORT, &gps_data)) == -1)
+static gdouble
+gpsd_report_get_accuracy (GpsdEndpoint          *endpoint,
+                          const GClueGpsdReport *report)
+{
+        if (isfinite (report->eph))
+                return report->eph;
+
+        if (isfinite (report->epx) && isfinite (report->epy))
+                return MAX (report->epx, report->epy);
+
+        return gpsd_value_or (endpoint->gst_accuracy,
+                              GCLUE_LOCATION_ACCURACY_UNKNOWN);
+}
+
+static void
+set_accuracy_level (GClueGpsdSource    *source,
+                    GClueAccuracyLevel  level)
+{
+        GClueAccuracyLevel existing;
+
+        existing = gclue_location_source_get_available_accuracy_level
+                        (GCLUE_LOCATION_SOURCE (source));
+        if (level == existing)
                 return;
 
-        gps_stream (&gps_data, WATCH_ENABLE | WATCH_JSON, NULL);
+        g_debug ("Available accuracy level from %s: %u",
+                 G_OBJECT_TYPE_NAME (source), level);
+        g_object_set (G_OBJECT (source),
+                      "available-accuracy-level", level,
+                      NULL);
+}
 
-        while (1)
-                sleep (1); // keep gpsd active
+static GClueAccuracyLevel
+accuracy_level_from_accuracy (gdouble accuracy)
+{
+        if (accuracy <= GCLUE_LOCATION_ACCURACY_EXACT)
+                return GCLUE_ACCURACY_LEVEL_EXACT;
+        if (accuracy <= GCLUE_LOCATION_ACCURACY_STREET)
+                return GCLUE_ACCURACY_LEVEL_STREET;
+        if (accuracy <= GCLUE_LOCATION_ACCURACY_NEIGHBORHOOD)
+                return GCLUE_ACCURACY_LEVEL_NEIGHBORHOOD;
+        if (accuracy <= GCLUE_LOCATION_ACCURACY_CITY)
+                return GCLUE_ACCURACY_LEVEL_CITY;
 
-        gps_stream (&gps_data, WATCH_DISABLE, NULL);
-        gps_close (&gps_data);
+        return GCLUE_ACCURACY_LEVEL_COUNTRY;
 }
 
-static gpointer
-gpsd_thread_func (gpointer data)
+/* Called for every fix, with its horizontal uncertainty. Any change of
+ * the level can get the locator to start or stop us, so it goes up as
+ * soon as a fix is good enough but only comes down once the fixes have
+ * been worse for a while, not for the odd bad one.
+ */
+static void
+update_accuracy_level (GClueGpsdSource *source,
+                       gdouble          accuracy)
 {
-        GClueGpsdSource *source = GCLUE_GPSD_SOURCE (data);
         GClueGpsdSourcePrivate *priv = source->priv;
+        GClueAccuracyLevel level, existing;
+        gint64 now = gclue_clock_get_monotonic_time ();
+
+        existing = gclue_location_source_get_available_accuracy_level
+                        (GCLUE_LOCATION_SOURCE (source));
+
+        /* Without an estimate of the error, all we know is that the
+         * receiver has a fix.
+         */
+        if (accuracy == GCLUE_LOCATION_ACCURACY_UNKNOWN) {
+                if (existing == GCLUE_ACCURACY_LEVEL_NONE)
+                        level = GCLUE_ACCURACY_LEVEL_EXACT;
+                else
+                        level = existing;
+        } else {
+                level = accuracy_level_from_accuracy (accuracy);
+        }
+
+        if (level < existing &&
+            now - priv->level_fix_seen < GPSD_LEVEL_DOWN_TIME)
+                return;
+
+        priv->level_fix_seen = now;
+        set_accuracy_level (source, level);
+}
+
+static gboolean
+any_endpoint_opened (GClueGpsdSource *source)
+{
+        GPtrArray *endpoints = source->priv->endpoints;
+        guint i;
+
+        for (i = 0; i < endpoints->len; i++) {
+                GpsdEndpoint *endpoint = g_ptr_array_index (endpoints, i);
+
+                if (endpoint->opened)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+static gboolean
+on_fix_retry_timer (gpointer user_data)
+{
+        GClueGpsdSource *source = user_data;
+
+        source->priv->fix_retry_timer = 0;
+
+        /* Gets the locator to start us again if it still wants us */
+        if (any_endpoint_opened (source))
+                set_accuracy_level (source, GCLUE_ACCURACY_LEVEL_EXACT);
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Called for every report without a fix. Dropping the level stops us,
+ * so it only happens once a fix we had has been gone for a while, and we
+ * bring it back up later to have another look. Until the first fix, the
+ * receiver is still acquiring and is left alone.
+ */
+static void
+check_fix_lost (GClueGpsdSource *source)
+{
+        GClueGpsdSourcePrivate *priv = source->priv;
+
+        if (priv->last_fix_seen == 0 ||
+            gclue_clock_get_monotonic_time () - priv->last_fix_seen <
+            GPSD_FIX_LOST_TIME)
+                return;
+
+        /* Over D-Bus, gpsd's next fix brings the level back up */
+        if (priv->fix_retry_timer == 0 &&
+            priv->transport != GPSD_TRANSPORT_DBUS) {
+                g_debug ("No fix from gpsd, looking again in %u seconds",
+                         GPSD_FIX_RETRY_TIME);
+                priv->fix_retry_timer = g_timeout_add_seconds
+                        (GPSD_FIX_RETRY_TIME, on_fix_retry_timer, source);
+        }
+
+        set_accuracy_level (source, GCLUE_ACCURACY_LEVEL_NONE);
+}
+
+static gboolean
+endpoint_is_better (const GpsdEndpoint *endpoint,
+                    const GpsdEndpoint *other)
+{
+        if (endpoint->mode != other->mode)
+                return endpoint->mode > other->mode;
+
+        if (endpoint->accuracy == GCLUE_LOCATION_ACCURACY_UNKNOWN)
+                return FALSE;
+        if (other->accuracy == GCLUE_LOCATION_ACCURACY_UNKNOWN)
+                return TRUE;
+
+        /* Don't keep switching between receivers of similar quality */
+        return endpoint->accuracy * 2 < other->accuracy;
+}
 
-        while (priv->gpsd_thread_running)
-                start_gpsd_search ();
+/* Returns TRUE if fixes from @endpoint are to be published, switching
+ * over to it if it has become the best one we have.
+ */
+static gboolean
+endpoint_take_over (GpsdEndpoint *endpoint)
+{
+        GClueGpsdSourcePrivate *priv = endpoint->source->priv;
+        GpsdEndpoint *active = priv->active;
+
+        if (active == endpoint)
+                return TRUE;
+
+        if (active != NULL &&
+            active->opened &&
+            endpoint->last_fix_seen - active->last_fix_seen < GPSD_ENDPOINT_STALE_TIME &&
+            !endpoint_is_better (endpoint, active))
+                return FALSE;
+
+        g_debug ("Using fixes from gpsd at %s", endpoint->address);
+        priv->active = endpoint;
+
+        return TRUE;
+}
+
+static void
+on_gpsd_tpv (GpsdEndpoint          *endpoint,
+             const GClueGpsdReport *report)
+{
+        GClueGpsdSource *source = endpoint->source;
+        GClueLocationData location;
+        gdouble accuracy;
+
+        /* gpsd keeps sending TPVs while the receiver is searching, with
+         * whatever position it had last or none at all.
+         */
+        if (report->mode < MODE_2D) {
+                check_fix_lost (source);
+                return;
+        }
+
+        if (!isfinite (report->latitude) || !isfinite (report->longitude))
+                return;
+
+        if (report->time != 0 && report->time <= endpoint->last_fix_time) {
+                g_debug ("Ignoring repeated or out of order fix from gpsd at %s",
+                         endpoint->address);
+                return;
+        }
+        endpoint->last_fix_time = report->time;
+
+        accuracy = gpsd_report_get_accuracy (endpoint, report);
+        endpoint->mode = report->mode;
+        endpoint->accuracy = accuracy;
+        endpoint->last_fix_seen = gclue_clock_get_monotonic_time ();
+        source->priv->last_fix_seen = endpoint->last_fix_seen;
+
+        if (!endpoint_take_over (endpoint))
+                return;
+
+        /* The level is updated before the fix is published so that a
+         * client that asked for a lower level doesn't get to see it.
+         */
+        update_accuracy_level (source, accuracy);
+
+        location = (GClueLocationData) {
+                .latitude = report->latitude,
+                .longitude = report->longitude,
+                .accuracy = accuracy,
+                .altitude = gpsd_value_or (report->altitude,
+                                           GCLUE_LOCATION_ALTITUDE_UNKNOWN),
+                .altitude_accuracy = gpsd_value_or (report->epv,
+                                                    GCLUE_LOCATION_ACCURACY_UNKNOWN),
+                .speed = gpsd_value_or (report->speed,
+                                        GCLUE_LOCATION_SPEED_UNKNOWN),
+                .speed_accuracy = gpsd_value_or (report->eps,
+                                                 GCLUE_LOCATION_ACCURACY_UNKNOWN),
+                .heading = gpsd_value_or (report->track,
+                                          GCLUE_LOCATION_HEADING_UNKNOWN),
+                .heading_accuracy = gpsd_value_or (report->epd,
+                                                   GCLUE_LOCATION_ACCURACY_UNKNOWN),
+                .climb = gpsd_value_or (report->climb,
+                                        GCLUE_LOCATION_CLIMB_UNKNOWN),
+                .timestamp = report->time,
+                .description = "GPSD location",
+        };
+
+        g_debug ("GPSD (%s): Mode: %d, Latitude: %f, Longitude: %f, "
+                 "Accuracy: %f meters",
+                 endpoint->address,
+                 report->mode,
+                 report->latitude,
+                 report->longitude,
+                 accuracy);
+
+        gclue_location_source_set_location_data (GCLUE_LOCATION_SOURCE (source),
+                                                 &location);
+}
+
+static void
+on_gpsd_sky (GpsdEndpoint          *endpoint,
+             const GClueGpsdReport *report)
+{
+        GClueGpsdSourcePrivate *priv = endpoint->source->priv;
+        GVariantBuilder builder;
+        guint i, used = 0;
+
+        g_debug ("GPSD (%s): %u satellites visible, HDOP %f",
+                 endpoint->address, report->n_satellites, report->hdop);
+
+        /* Only the sky of the receiver whose fixes we publish */
+        if (priv->active != NULL && priv->active != endpoint)
+                return;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(udddb)"));
+        for (i = 0; i < report->n_satellites; i++) {
+                const GClueGpsdSatellite *satellite = &report->satellites[i];
+
+                g_variant_builder_add
+                        (&builder,
+                         "(udddb)",
+                         (guint32) MAX (satellite->prn, 0),
+                         gpsd_value_or (satellite->elevation, GCLUE_SATELLITES_UNKNOWN),
+                         gpsd_value_or (satellite->azimuth, GCLUE_SATELLITES_UNKNOWN),
+                         gpsd_value_or (satellite->snr, GCLUE_SATELLITES_UNKNOWN),
+                         satellite->used);
+                if (satellite->used)
+                        used++;
+        }
+
+        g_debug ("GPSD (%s): %u satellites used", endpoint->address, used);
+        gclue_location_source_set_satellites
+                (GCLUE_LOCATION_SOURCE (endpoint->source),
+                 g_variant_new (GCLUE_SATELLITES_VARIANT_TYPE,
+                                gpsd_value_or (report->hdop, GCLUE_SATELLITES_UNKNOWN),
+                                gpsd_value_or (report->vdop, GCLUE_SATELLITES_UNKNOWN),
+                                gpsd_value_or (report->pdop, GCLUE_SATELLITES_UNKNOWN),
+                                &builder));
+}
+
+static void
+on_gpsd_report (GpsdEndpoint          *endpoint,
+                const GClueGpsdReport *report)
+{
+        /* Left over from before we were stopped */
+        if (!endpoint->streaming)
+                return;
+
+        switch (report->report_class) {
+        case GCLUE_GPSD_REPORT_TPV:
+                on_gpsd_tpv (endpoint, report);
+                break;
+
+        case GCLUE_GPSD_REPORT_SKY:
+                on_gpsd_sky (endpoint, report);
+                break;
+
+        case GCLUE_GPSD_REPORT_GST:
+                if (isfinite (report->lat_err) && isfinite (report->lon_err))
+                        endpoint->gst_accuracy = sqrt (report->lat_err * report->lat_err +
+                                                       report->lon_err * report->lon_err);
+                break;
+
+        default:
+                break;
+        }
+}
+
+static gboolean
+on_reconnect_timer (gpointer user_data)
+{
+        GpsdEndpoint *endpoint = user_data;
+
+        endpoint->reconnect_timer = 0;
+
+        /* Only the D-Bus transport is opened with something to retry,
+         * its watcher.
+         */
+        if (endpoint->opened)
+                open_gpsd_watcher (endpoint);
+        else
+                connect_to_endpoint (endpoint);
 
-        return NULL;
+        return G_SOURCE_REMOVE;
 }
 
 static void
-set_location (GClueLocation *location,
-               gpointer user_data)
+schedule_reconnect (GpsdEndpoint *endpoint)
+{
+        if (endpoint->reconnect_timer)
+                return;
+
+        g_debug ("Retrying gpsd at %s in %u seconds",
+                 endpoint->address, GPSD_RECONNECT_TIME);
+        endpoint->reconnect_timer = g_timeout_add_seconds (GPSD_RECONNECT_TIME,
+                                                           on_reconnect_timer,
+                                                           endpoint);
+}
+
+/* Hands what libgps just decoded over to on_gpsd_report() */
+static void
+on_gps_data (GpsdEndpoint *endpoint)
+{
+        GClueGpsdSourcePrivate *priv = endpoint->source->priv;
+        gps_mask_t set = endpoint->gps_data.set;
+
+        if (set & SATELLITE_SET) {
+                report_from_gps_skyview (&priv->report, &endpoint->gps_data);
+                on_gpsd_report (endpoint, &priv->report);
+                if (!endpoint->streaming)
+                        return;
+        }
+
+        if (set & LATLON_SET) {
+                report_from_gps_data (&priv->report, &endpoint->gps_data);
+                on_gpsd_report (endpoint, &priv->report);
+        }
+}
+
+/* Returns FALSE if the connection to gpsd is gone */
+static gboolean
+read_libgps_reports (GpsdEndpoint *endpoint)
+{
+        guint i;
+
+        for (i = 0; i < GPSD_MAX_REPORTS_PER_WAKEUP; i++) {
+                int ret;
+
+#if GPSD_API_MAJOR_VERSION >= 7
+                ret = gps_read (&endpoint->gps_data, NULL, 0);
+#else
+                ret = gps_read (&endpoint->gps_data);
+#endif
+                if (ret < 0)
+                        return FALSE;
+
+                /* Partial report, rest of it is yet to arrive */
+                if (ret == 0)
+                        break;
+
+                on_gps_data (endpoint);
+
+                /* The locator may have stopped us in the meantime */
+                if (!endpoint->streaming)
+                        break;
+
+                if (!gps_waiting (&endpoint->gps_data, 0))
+                        break;
+        }
+
+        return TRUE;
+}
+
+/* Returns FALSE if the connection to gpsd is gone */
+static gboolean
+read_json_reports (GpsdEndpoint *endpoint)
+{
+        GClueGpsdSourcePrivate *priv = endpoint->source->priv;
+        const char *line;
+        gssize ret;
+
+        ret = gclue_gpsd_json_reader_fill (endpoint->json_reader,
+                                           endpoint->fd);
+        if (ret == 0)
+                return FALSE;
+        if (ret < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+
+        while ((line = gclue_gpsd_json_reader_next_line (endpoint->json_reader))) {
+                if (!gclue_gpsd_json_parse (line, &priv->report)) {
+                        g_debug ("Ignoring malformed gpsd report: %s", line);
+                        continue;
+                }
+
+                on_gpsd_report (endpoint, &priv->report);
+                if (!endpoint->streaming)
+                        break;
+        }
+
+        return TRUE;
+}
+
+static void
+close_gpsd_watcher (GpsdEndpoint *endpoint)
+{
+        if (endpoint->watch_id) {
+                g_source_remove (endpoint->watch_id);
+                endpoint->watch_id = 0;
+        }
+
+        /* gpsd forgets a watcher once its connection is gone */
+        if (endpoint->fd >= 0) {
+                gps_close (&endpoint->gps_data);
+                endpoint->fd = -1;
+        }
+}
+
+static void
+close_endpoint (GpsdEndpoint *endpoint)
+{
+        if (endpoint->source->priv->transport == GPSD_TRANSPORT_DBUS) {
+                if (endpoint->bus_cancellable != NULL) {
+                        g_cancellable_cancel (endpoint->bus_cancellable);
+                        g_clear_object (&endpoint->bus_cancellable);
+                }
+                if (endpoint->fix_subscription) {
+                        g_dbus_connection_signal_unsubscribe
+                                (endpoint->bus, endpoint->fix_subscription);
+                        endpoint->fix_subscription = 0;
+                }
+                g_clear_object (&endpoint->bus);
+                close_gpsd_watcher (endpoint);
+        } else if (endpoint->unix_socket)
+                close (endpoint->fd);
+        else
+                gps_close (&endpoint->gps_data);
+        endpoint->fd = -1;
+        endpoint->opened = FALSE;
+        endpoint->streaming = FALSE;
+
+        if (endpoint->source->priv->active == endpoint)
+                endpoint->source->priv->active = NULL;
+}
+
+static gboolean
+on_gpsd_readable (gint         fd,
+                  GIOCondition condition,
+                  gpointer     user_data)
+{
+        GpsdEndpoint *endpoint = user_data;
+        GClueGpsdSource *source = endpoint->source;
+        gboolean connected;
+
+        if (endpoint->json_reader != NULL)
+                connected = read_json_reports (endpoint);
+        else
+                connected = read_libgps_reports (endpoint);
+
+        /* Disconnected while handling a report, the watch is gone already */
+        if (!endpoint->opened)
+                return G_SOURCE_REMOVE;
+
+        if (!connected) {
+                g_debug ("Connection to gpsd at %s lost", endpoint->address);
+                goto broken;
+        }
+
+        if (condition & (G_IO_HUP | G_IO_ERR)) {
+                g_debug ("gpsd at %s closed the connection", endpoint->address);
+                goto broken;
+        }
+
+        return G_SOURCE_CONTINUE;
+
+broken:
+        /* Returning G_SOURCE_REMOVE drops the watch for us and there is no
+         * point in telling a dead socket to stop streaming.
+         */
+        endpoint->watch_id = 0;
+        close_endpoint (endpoint);
+        schedule_reconnect (endpoint);
+
+        /* Any other endpoint with a fix takes over with its next one,
+         * close_endpoint() took care of that.
+         */
+        if (!any_endpoint_opened (source))
+                set_accuracy_level (source, GCLUE_ACCURACY_LEVEL_NONE);
+
+        return G_SOURCE_REMOVE;
+}
+
+static gboolean
+on_shm_poll (gpointer user_data)
+{
+        GpsdEndpoint *endpoint = user_data;
+        int ret;
+
+        /* Both only compare the segment's update counter and copy it out,
+         * nothing here goes through the kernel.
+         */
+        if (!gps_waiting (&endpoint->gps_data, 0))
+                return G_SOURCE_CONTINUE;
+
+#if GPSD_API_MAJOR_VERSION >= 7
+        ret = gps_read (&endpoint->gps_data, NULL, 0);
+#else
+        ret = gps_read (&endpoint->gps_data);
+#endif
+        if (ret > 0)
+                on_gps_data (endpoint);
+
+        return G_SOURCE_CONTINUE;
+}
+
+static void
+schedule_shm_poll (GpsdEndpoint *endpoint)
+{
+        GClueMinUINT *threshold;
+        guint interval;
+
+        if (endpoint->shm_poll_timer) {
+                g_source_remove (endpoint->shm_poll_timer);
+                endpoint->shm_poll_timer = 0;
+        }
+
+        threshold = gclue_location_source_get_time_threshold
+                        (GCLUE_LOCATION_SOURCE (endpoint->source));
+        interval = gclue_min_uint_get_value (threshold) * 1000;
+        if (interval == 0)
+                interval = GPSD_SHM_POLL_INTERVAL;
+
+        g_debug ("Polling gpsd shared memory every %u ms", interval);
+        endpoint->shm_poll_timer = g_timeout_add (interval,
+                                                  on_shm_poll,
+                                                  endpoint);
+}
+
+static void
+on_time_threshold_changed (GObject    *gobject,
+                           GParamSpec *pspec,
+                           gpointer    user_data)
 {
         GClueGpsdSource *source = GCLUE_GPSD_SOURCE (user_data);
-        gclue_location_source_set_location (GCLUE_LOCATION_SOURCE (source), location);
-}
-
-static int
-on_signal (int unused,
-           DBusMessage *msg,
-           gpointer obj)
-{
-        DBusError error;
-        double time;
-        int mode;
-        double time_uncertainty;
-        double latitude;
-        double longitude;
-        double horizontal_uncertainty;
-        double altitude;
-        double altitude_uncertainty;
-        double course;
-        double course_uncertainty;
-        double speed;
-        double speed_uncertainty;
-        double climb;
-        double climb_uncertainty;
-        const char* name;
-        const char *member;
-
-        (void) obj;
-        (void) unused;
-
-        member = dbus_message_get_member (msg);
-        if (strcmp (member, "fix") != 0)
-                return 0;
-
-        dbus_error_init (&error);
-
-        if (!dbus_message_get_args (msg, &error,
-                                    DBUS_TYPE_DOUBLE, &time,
-                                    DBUS_TYPE_INT32, &mode,
-                                    DBUS_TYPE_DOUBLE, &time_uncertainty,
-                                    DBUS_TYPE_DOUBLE, &latitude,
-                                    DBUS_TYPE_DOUBLE, &longitude,
-                                    DBUS_TYPE_DOUBLE, &horizontal_uncertainty,
-                                    DBUS_TYPE_DOUBLE, &altitude,
-                                    DBUS_TYPE_DOUBLE, &altitude_uncertainty,
-                                    DBUS_TYPE_DOUBLE, &course,
-                                    DBUS_TYPE_DOUBLE, &course_uncertainty,
-                                    DBUS_TYPE_DOUBLE, &speed,
-                                    DBUS_TYPE_DOUBLE, &speed_uncertainty,
-                                    DBUS_TYPE_DOUBLE, &climb,
-                                    DBUS_TYPE_DOUBLE, &climb_uncertainty,
-                                    DBUS_TYPE_STRING, &name,
-                                    NULL)) {
-                dbus_error_free (&error);
-        } else {
-                GClueLocation *location;
-                location = gclue_location_new_full (latitude,
-                                                    longitude,
-                                                    horizontal_uncertainty,
-                                                    speed,
-                                                    course,
-                                                    altitude,
-                                                    time,
-                                                    "GPSD location");
-
-                g_debug ("GPSD: Location timestamp: %" G_GUINT64_FORMAT, (guint64) time);
-                g_debug ("GPSD: Latitude: %f, Longitude: %f", latitude, longitude);
-                g_debug ("GPSD: Altitude: %f meters", altitude);
-                g_debug ("GPSD: Speed: %f knots", speed);
-                g_debug ("GPSD: Bearing: %f degrees", course);
-                g_debug ("GPSD: Horizontal Accuracy: %f meters", horizontal_uncertainty);
-                g_debug ("GPSD: Vertical Accuracy: %f meters", altitude_uncertainty);
-                g_debug ("GPSD: Mode: %d", mode);
-                g_debug ("GPSD: Time Uncertainty: %f", time_uncertainty);
-                g_debug ("GPSD: Course Uncertainty: %f", course_uncertainty);
-                g_debug ("GPSD: Speed Uncertainty: %f", speed_uncertainty);
-                g_debug ("GPSD: Climb: %f", climb);
-                g_debug ("GPSD: Climb Uncertainty: %f", climb_uncertainty);
-                g_debug ("GPSD: Source Name: %s", name);
-
-                set_location (location, obj);
-                g_object_unref (location);
-        }
-
-        return 0;
+        GPtrArray *endpoints = source->priv->endpoints;
+        guint i;
+
+        for (i = 0; i < endpoints->len; i++) {
+                GpsdEndpoint *endpoint = g_ptr_array_index (endpoints, i);
+
+                if (endpoint->shm_poll_timer)
+                        schedule_shm_poll (endpoint);
+        }
+}
+
+static gboolean
+open_shm (GpsdEndpoint *endpoint)
+{
+#ifdef GPSD_SHARED_MEMORY
+        if (gps_open (GPSD_SHARED_MEMORY, NULL, &endpoint->gps_data) != 0) {
+                g_debug ("Failed to attach to gpsd shared memory: %s",
+                         gps_errstr (errno));
+                return FALSE;
+        }
+
+        g_debug ("Attached to gpsd shared memory");
+
+        return TRUE;
+#else
+        return FALSE;
+#endif
 }
 
 static void
-connect_to_service (GClueGpsdSource *source)
+on_gpsd_fix_signal (GDBusConnection *connection,
+                    const char      *sender_name,
+                    const char      *object_path,
+                    const char      *interface_name,
+                    const char      *signal_name,
+                    GVariant        *parameters,
+                    gpointer         user_data)
 {
-        GClueGpsdSourcePrivate *priv = source->priv;
+        GpsdEndpoint *endpoint = user_data;
+        GClueGpsdReport *report = &endpoint->source->priv->report;
+        gdouble time, ept;
+        const char *device;
+
+        if (!g_variant_is_of_type (parameters,
+                                   G_VARIANT_TYPE (GPSD_DBUS_FIX_TYPE))) {
+                g_debug ("Ignoring gpsd fix signal of type '%s'",
+                         g_variant_get_type_string (parameters));
+                return;
+        }
 
-        g_cancellable_reset (priv->cancellable);
+        gclue_gpsd_report_init (report);
+        report->report_class = GCLUE_GPSD_REPORT_TPV;
+        g_variant_get (parameters,
+                       GPSD_DBUS_FIX_TYPE,
+                       &time,
+                       &report->mode,
+                       &ept,
+                       &report->latitude,
+                       &report->longitude,
+                       &report->eph,
+                       &report->altitude,
+                       &report->epv,
+                       &report->track,
+                       &report->epd,
+                       &report->speed,
+                       &report->eps,
+                       &report->climb,
+                       &report->epc,
+                       &device);
+        if (isfinite (time))
+                report->time = (gint64) (time * G_USEC_PER_SEC);
 
-	priv->system_bus = dbus_bus_get_private (DBUS_BUS_SYSTEM, NULL);
-	dbus_connection_setup_with_g_main (priv->system_bus, NULL);
+        /* Being on the bus tells us nothing about gpsd, only its signals
+         * do. This may get the locator to start us right away.
+         */
+        if (report->mode >= MODE_2D)
+                update_accuracy_level (endpoint->source,
+                                       gpsd_report_get_accuracy (endpoint,
+                                                                 report));
 
-	dbus_bus_add_match (priv->system_bus,
-                            "type='signal',interface='org.gpsd'",
-                            NULL);
+        on_gpsd_report (endpoint, report);
+}
 
-	dbus_connection_add_filter (priv->system_bus,
-                                    (DBusHandleMessageFunction) on_signal,
-                                    source,
-                                    NULL);
+static void
+on_bus_got (GObject      *source_object,
+            GAsyncResult *res,
+            gpointer      user_data)
+{
+        GpsdEndpoint *endpoint = user_data;
+        g_autoptr(GError) error = NULL;
+        GDBusConnection *bus;
 
-        priv->gpsd_thread_running = TRUE;
-        priv->gpsd_thread = g_thread_new ("gpsd-thread", gpsd_thread_func, source);
+        bus = g_bus_get_finish (res, &error);
+        if (bus == NULL &&
+            g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                return;
+
+        g_clear_object (&endpoint->bus_cancellable);
+        if (bus == NULL) {
+                g_warning ("Failed to connect to system D-Bus: %s",
+                           error->message);
+                close_endpoint (endpoint);
+                schedule_reconnect (endpoint);
+                return;
+        }
+        endpoint->bus = bus;
+
+        /* gpsd sends its fixes whether anyone listens or not, so we keep
+         * listening while stopped to find out when it has one. Matching
+         * on the member makes the bus daemon drop every other signal gpsd
+         * sends, before they reach us.
+         */
+        endpoint->fix_subscription = g_dbus_connection_signal_subscribe
+                (endpoint->bus,
+                 NULL,
+                 GPSD_DBUS_INTERFACE,
+                 "fix",
+                 GPSD_DBUS_PATH,
+                 NULL,
+                 G_DBUS_SIGNAL_FLAGS_NONE,
+                 on_gpsd_fix_signal,
+                 endpoint,
+                 NULL);
+}
+
+static gboolean
+open_dbus (GpsdEndpoint *endpoint)
+{
+        /* Counts as opened from here on, close_endpoint() cancels this
+         * if we get closed before the bus is there.
+         */
+        endpoint->bus_cancellable = g_cancellable_new ();
+        g_bus_get (G_BUS_TYPE_SYSTEM,
+                   endpoint->bus_cancellable,
+                   on_bus_got,
+                   endpoint);
+
+        return TRUE;
+}
+
+static gboolean
+on_gpsd_watcher_readable (gint         fd,
+                          GIOCondition condition,
+                          gpointer     user_data)
+{
+        GpsdEndpoint *endpoint = user_data;
+        char buf[512];
+        gssize ret;
+
+        /* Only gpsd's answers to our WATCH, we have no use for them */
+        while ((ret = read (fd, buf, sizeof (buf))) > 0)
+                ;
+
+        if (ret == 0 ||
+            (errno != EAGAIN && errno != EWOULDBLOCK) ||
+            condition & (G_IO_HUP | G_IO_ERR)) {
+                g_debug ("gpsd at %s:%s dropped our watcher",
+                         endpoint->host, endpoint->port);
+                endpoint->watch_id = 0;
+                close_gpsd_watcher (endpoint);
+                schedule_reconnect (endpoint);
+
+                return G_SOURCE_REMOVE;
+        }
+
+        return G_SOURCE_CONTINUE;
 }
 
 static void
-disconnect_from_service (GClueGpsdSource *source)
+open_gpsd_watcher (GpsdEndpoint *endpoint)
 {
-        GClueGpsdSourcePrivate *priv = source->priv;
+        gsize len = strlen (GPSD_WATCH_POWER);
+        int flags;
 
-        g_cancellable_cancel (priv->cancellable);
+        if (!endpoint->streaming || endpoint->fd >= 0)
+                return;
+
+        if (gps_open (endpoint->host, endpoint->port, &endpoint->gps_data) != 0) {
+                g_debug ("Failed to connect to gpsd at %s:%s to watch it: %s",
+                         endpoint->host, endpoint->port, gps_errstr (errno));
+                schedule_reconnect (endpoint);
+                return;
+        }
+        endpoint->fd = endpoint->gps_data.gps_fd;
 
-        if (priv->system_bus) {
-                dbus_connection_close (priv->system_bus);
-                dbus_connection_unref (priv->system_bus);
-                priv->system_bus = NULL;
+        if (write (endpoint->fd, GPSD_WATCH_POWER, len) != (gssize) len) {
+                g_debug ("Failed to watch gpsd at %s:%s: %s",
+                         endpoint->host, endpoint->port, g_strerror (errno));
+                close_gpsd_watcher (endpoint);
+                schedule_reconnect (endpoint);
+                return;
         }
+
+        flags = fcntl (endpoint->fd, F_GETFL);
+        if (flags != -1)
+                fcntl (endpoint->fd, F_SETFL, flags | O_NONBLOCK);
+
+        endpoint->watch_id = g_unix_fd_add (endpoint->fd,
+                                            G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                            on_gpsd_watcher_readable,
+                                            endpoint);
+        g_debug ("Watching gpsd at %s:%s", endpoint->host, endpoint->port);
+}
+
+static gboolean
+open_unix_socket (GpsdEndpoint *endpoint)
+{
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        int fd;
+
+        if (strlen (endpoint->host) >= sizeof (addr.sun_path)) {
+                g_warning ("gpsd socket path '%s' is too long", endpoint->host);
+                return FALSE;
+        }
+        strcpy (addr.sun_path, endpoint->host);
+
+        fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+                g_warning ("Failed to create socket: %s", g_strerror (errno));
+                return FALSE;
+        }
+
+        if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0) {
+                g_debug ("Failed to connect to gpsd at %s: %s",
+                         endpoint->address, g_strerror (errno));
+                close (fd);
+                return FALSE;
+        }
+
+        endpoint->fd = fd;
+
+        return TRUE;
+}
+
+static gboolean
+open_tcp_socket (GpsdEndpoint *endpoint)
+{
+        if (gps_open (endpoint->host, endpoint->port, &endpoint->gps_data) != 0) {
+                g_debug ("Failed to connect to gpsd at %s: %s",
+                         endpoint->address, gps_errstr (errno));
+                return FALSE;
+        }
+
+        endpoint->fd = endpoint->gps_data.gps_fd;
+
+        return TRUE;
+}
+
+static gboolean
+open_socket (GpsdEndpoint *endpoint)
+{
+        gboolean opened;
+        int flags;
+
+        if (endpoint->unix_socket)
+                opened = open_unix_socket (endpoint);
+        else
+                opened = open_tcp_socket (endpoint);
+        if (!opened)
+                return FALSE;
+
+        if (endpoint->json_reader != NULL)
+                gclue_gpsd_json_reader_init (endpoint->json_reader);
+
+        /* libgps reads whatever the socket has, we want it to never block
+         * the main loop when only part of a report has arrived.
+         */
+        flags = fcntl (endpoint->fd, F_GETFL);
+        if (flags != -1)
+                fcntl (endpoint->fd, F_SETFL, flags | O_NONBLOCK);
+
+        endpoint->watch_id = g_unix_fd_add (endpoint->fd,
+                                            G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                            on_gpsd_readable,
+                                            endpoint);
+        g_debug ("Connected to gpsd at %s", endpoint->address);
+
+        return TRUE;
+}
+
+static gboolean
+send_watch_command (GpsdEndpoint *endpoint,
+                    const char   *command)
+{
+        gsize len = strlen (command);
+
+        if (write (endpoint->fd, command, len) != (gssize) len) {
+                g_debug ("Failed to send '%s' to gpsd at %s: %s",
+                         command, endpoint->address, g_strerror (errno));
+                return FALSE;
+        }
+
+        return TRUE;
 }
 
 static void
-gclue_gpsd_source_finalize (GObject *ggpsd)
+start_streaming (GpsdEndpoint *endpoint)
 {
-        GClueGpsdSourcePrivate *priv = GCLUE_GPSD_SOURCE (ggpsd)->priv;
+        GClueGpsdSourcePrivate *priv = endpoint->source->priv;
 
-        G_OBJECT_CLASS (gclue_gpsd_source_parent_class)->finalize (ggpsd);
+        if (!endpoint->opened || endpoint->streaming)
+                return;
+
+        switch (priv->transport) {
+        case GPSD_TRANSPORT_SHM:
+                schedule_shm_poll (endpoint);
+                break;
+
+        case GPSD_TRANSPORT_DBUS:
+                /* Subscribed to its fixes since open_dbus(), we only
+                 * have to get gpsd to power the receiver.
+                 */
+                endpoint->streaming = TRUE;
+                open_gpsd_watcher (endpoint);
+                break;
+
+        default:
+                if (endpoint->unix_socket) {
+                        if (!send_watch_command (endpoint, GPSD_WATCH_ENABLE))
+                                return;
+                } else if (gps_stream (&endpoint->gps_data,
+                                       WATCH_ENABLE | WATCH_JSON,
+                                       NULL) != 0) {
+                        g_debug ("Failed to start gpsd at %s streaming",
+                                 endpoint->address);
+                        return;
+                }
+                break;
+        }
+
+        endpoint->streaming = TRUE;
+        g_debug ("Streaming from gpsd at %s", endpoint->address);
+}
+
+static void
+stop_streaming (GpsdEndpoint *endpoint)
+{
+        GClueGpsdSourcePrivate *priv = endpoint->source->priv;
+
+        if (!endpoint->streaming)
+                return;
+
+        switch (priv->transport) {
+        case GPSD_TRANSPORT_SHM:
+                if (endpoint->shm_poll_timer) {
+                        g_source_remove (endpoint->shm_poll_timer);
+                        endpoint->shm_poll_timer = 0;
+                }
+                break;
+
+        case GPSD_TRANSPORT_DBUS:
+                /* Fixes may keep coming from a gpsd started with -n,
+                 * on_gpsd_report() ignores them.
+                 */
+                close_gpsd_watcher (endpoint);
+                break;
+
+        default:
+                /* Once its last watcher is gone, gpsd is free to power
+                 * down the receiver.
+                 */
+                if (endpoint->unix_socket)
+                        send_watch_command (endpoint, GPSD_WATCH_DISABLE);
+                else
+                        gps_stream (&endpoint->gps_data, WATCH_DISABLE, NULL);
+                break;
+        }
+
+        endpoint->streaming = FALSE;
+        if (priv->active == endpoint)
+                priv->active = NULL;
+        g_debug ("Stopped streaming from gpsd at %s", endpoint->address);
+}
+
+static void
+connect_to_endpoint (GpsdEndpoint *endpoint)
+{
+        GClueGpsdSource *source = endpoint->source;
+        gboolean opened;
+
+        if (endpoint->opened)
+                return;
+
+        if (source->priv->transport == GPSD_TRANSPORT_SHM)
+                opened = open_shm (endpoint);
+        else if (source->priv->transport == GPSD_TRANSPORT_DBUS)
+                opened = open_dbus (endpoint);
+        else
+                opened = open_socket (endpoint);
+
+        if (!opened) {
+                schedule_reconnect (endpoint);
+                return;
+        }
+        endpoint->opened = TRUE;
+        endpoint->gst_accuracy = NAN;
+        endpoint->mode = MODE_NOT_SEEN;
+        endpoint->accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
+        endpoint->last_fix_seen = 0;
+        endpoint->last_fix_time = 0;
+
+        if (gclue_location_source_get_active (GCLUE_LOCATION_SOURCE (source)))
+                start_streaming (endpoint);
+
+        /* Until we have seen a fix, assume gpsd's receiver does GPS. Over
+         * D-Bus we don't know that gpsd is there until it sends one.
+         */
+        if (source->priv->transport != GPSD_TRANSPORT_DBUS &&
+            gclue_location_source_get_available_accuracy_level
+                        (GCLUE_LOCATION_SOURCE (source)) == GCLUE_ACCURACY_LEVEL_NONE)
+                set_accuracy_level (source, GCLUE_ACCURACY_LEVEL_EXACT);
+}
+
+static void
+disconnect_from_endpoint (GpsdEndpoint *endpoint)
+{
+        if (endpoint->watch_id) {
+                g_source_remove (endpoint->watch_id);
+                endpoint->watch_id = 0;
+        }
+
+        if (!endpoint->opened)
+                return;
+
+        stop_streaming (endpoint);
+        close_endpoint (endpoint);
+}
+
+static void
+cancel_reconnect (GpsdEndpoint *endpoint)
+{
+        if (endpoint->reconnect_timer) {
+                g_source_remove (endpoint->reconnect_timer);
+                endpoint->reconnect_timer = 0;
+        }
+}
+
+static void
+connect_to_service (GClueGpsdSource *source)
+{
+        g_ptr_array_foreach (source->priv->endpoints,
+                             (GFunc) connect_to_endpoint,
+                             NULL);
+}
 
-        g_clear_object (&priv->cancellable);
+static void
+gpsd_endpoint_free (GpsdEndpoint *endpoint)
+{
+        disconnect_from_endpoint (endpoint);
+        cancel_reconnect (endpoint);
+
+        g_free (endpoint->json_reader);
+        g_free (endpoint->address);
+        g_free (endpoint->host);
+        g_free (endpoint->port);
+        g_free (endpoint);
+}
+
+/* Takes "host", "host:port", "[address]:port" or "/path/to/socket" */
+static GpsdEndpoint *
+gpsd_endpoint_new (GClueGpsdSource *source,
+                   const char      *address)
+{
+        GpsdEndpoint *endpoint;
+        const char *port = NULL;
+
+        endpoint = g_new0 (GpsdEndpoint, 1);
+        endpoint->source = source;
+        endpoint->address = g_strdup (address);
+        endpoint->fd = -1;
 
-        if (priv->system_bus) {
-                dbus_connection_close (priv->system_bus);
-                dbus_connection_unref (priv->system_bus);
-                priv->system_bus = NULL;
+        /* Shared memory and D-Bus have no address to parse, @address
+         * only names them in our messages. Over D-Bus we still watch
+         * the local gpsd, see GPSD_WATCH_POWER.
+         */
+        if (source->priv->transport == GPSD_TRANSPORT_SHM)
+                return endpoint;
+        if (source->priv->transport == GPSD_TRANSPORT_DBUS) {
+                endpoint->host = g_strdup ("localhost");
+                endpoint->port = g_strdup (DEFAULT_GPSD_PORT);
+                return endpoint;
         }
 
-        priv->gpsd_thread_running = FALSE;
-        if (priv->gpsd_thread) {
-                g_thread_join (priv->gpsd_thread);
-                priv->gpsd_thread = NULL;
+        if (address[0] == '/') {
+                endpoint->unix_socket = TRUE;
+                endpoint->host = g_strdup (address);
+        } else if (address[0] == '[') {
+                const char *end = strchr (address, ']');
+
+                if (end == NULL) {
+                        g_warning ("Invalid gpsd endpoint '%s'", address);
+                        gpsd_endpoint_free (endpoint);
+                        return NULL;
+                }
+                endpoint->host = g_strndup (address + 1, end - address - 1);
+                if (end[1] == ':')
+                        port = end + 2;
+        } else {
+                const char *colon = strchr (address, ':');
+
+                /* More than one colon is an IPv6 address without a port */
+                if (colon != NULL && strchr (colon + 1, ':') == NULL) {
+                        endpoint->host = g_strndup (address, colon - address);
+                        port = colon + 1;
+                } else
+                        endpoint->host = g_strdup (address);
         }
+
+        if (!endpoint->unix_socket)
+                endpoint->port = g_strdup (port != NULL && *port != '\0' ?
+                                           port : DEFAULT_GPSD_PORT);
+
+        /* libgps can't talk to UNIX sockets, we always parse their
+         * reports ourselves.
+         */
+        if (endpoint->unix_socket ||
+            source->priv->transport == GPSD_TRANSPORT_JSON)
+                endpoint->json_reader = g_new0 (GClueGpsdJsonReader, 1);
+
+        return endpoint;
+}
+
+static void
+gclue_gpsd_source_finalize (GObject *ggpsd)
+{
+        GClueGpsdSource *source = GCLUE_GPSD_SOURCE (ggpsd);
+
+        g_clear_handle_id (&source->priv->fix_retry_timer, g_source_remove);
+        g_clear_pointer (&source->priv->endpoints, g_ptr_array_unref);
+
+        G_OBJECT_CLASS (gclue_gpsd_source_parent_class)->finalize (ggpsd);
 }
 
 static void
@@ -249,23 +1393,98 @@ gclue_gpsd_source_class_init (GClueGpsdSourceClass *klass)
         source_class->stop = gclue_gpsd_source_stop;
 }
 
+static GpsdTransport
+get_transport_from_config (void)
+{
+        GClueConfig *config = gclue_config_get_singleton ();
+        const char *transport;
+
+        transport = gclue_config_get_gpsd_transport (config);
+        if (g_strcmp0 (transport, "json") == 0)
+                return GPSD_TRANSPORT_JSON;
+
+        if (g_strcmp0 (transport, "dbus") == 0)
+                return GPSD_TRANSPORT_DBUS;
+
+        if (g_strcmp0 (transport, "shm") == 0) {
+#ifdef GPSD_SHARED_MEMORY
+                return GPSD_TRANSPORT_SHM;
+#else
+                g_warning ("libgps was built without shared memory support, "
+                           "using libgps");
+                return GPSD_TRANSPORT_LIBGPS;
+#endif
+        }
+
+        if (g_strcmp0 (transport, "libgps") != 0)
+                g_warning ("Unknown gpsd transport '%s', using libgps",
+                           transport);
+
+        return GPSD_TRANSPORT_LIBGPS;
+}
+
+static void
+add_endpoints_from_config (GClueGpsdSource *source)
+{
+        GClueGpsdSourcePrivate *priv = source->priv;
+        GClueConfig *config = gclue_config_get_singleton ();
+        const char * const *addresses;
+        guint i;
+
+        /* Shared memory is only ever exported by the local gpsd */
+        if (priv->transport == GPSD_TRANSPORT_SHM) {
+                g_ptr_array_add (priv->endpoints,
+                                 gpsd_endpoint_new (source, "localhost"));
+                return;
+        }
+
+        /* Any gpsd on the system bus, they all send the same signal */
+        if (priv->transport == GPSD_TRANSPORT_DBUS) {
+                g_ptr_array_add (priv->endpoints,
+                                 gpsd_endpoint_new (source, "D-Bus"));
+                return;
+        }
+
+        addresses = gclue_config_get_gpsd_endpoints (config);
+        for (i = 0; addresses != NULL && addresses[i] != NULL; i++) {
+                GpsdEndpoint *endpoint;
+
+                if (addresses[i][0] == '\0')
+                        continue;
+
+                endpoint = gpsd_endpoint_new (source, addresses[i]);
+                if (endpoint != NULL)
+                        g_ptr_array_add (priv->endpoints, endpoint);
+        }
+
+        if (priv->endpoints->len == 0)
+                g_ptr_array_add (priv->endpoints,
+                                 gpsd_endpoint_new (source,
+                                                    GPSD_DEFAULT_ENDPOINT));
+}
+
 static void
 gclue_gpsd_source_init (GClueGpsdSource *source)
 {
         GClueGpsdSourcePrivate *priv;
+        GClueMinUINT *threshold;
 
         source->priv = gclue_gpsd_source_get_instance_private (source);
         priv = source->priv;
 
-        priv->cancellable = g_cancellable_new ();
+        priv->transport = get_transport_from_config ();
+        priv->endpoints = g_ptr_array_new_with_free_func
+                ((GDestroyNotify) gpsd_endpoint_free);
+        add_endpoints_from_config (source);
 
-        GClueAccuracyLevel level;
-        level = GCLUE_ACCURACY_LEVEL_EXACT;
-        g_debug ("Setting accuracy level to %s: %u",
-                 G_OBJECT_TYPE_NAME (source), level);
-        g_object_set (G_OBJECT (source),
-                      "available-accuracy-level", level, NULL);
+        threshold = gclue_location_source_get_time_threshold
+                        (GCLUE_LOCATION_SOURCE (source));
+        g_signal_connect_object (threshold,
+                                 "notify::value",
+                                 G_CALLBACK (on_time_threshold_changed),
+                                 source, 0);
 
+        /* Stays at NONE until gpsd can be reached */
         connect_to_service (source);
 }
 
@@ -303,12 +1522,20 @@ gclue_gpsd_source_start (GClueLocationSource *source)
 
         base_class = GCLUE_LOCATION_SOURCE_CLASS (gclue_gpsd_source_parent_class);
         base_result = base_class->start (source);
-        if (base_result == GCLUE_LOCATION_SOURCE_START_RESULT_FAILED)
+        if (base_result != GCLUE_LOCATION_SOURCE_START_RESULT_OK)
                 return base_result;
 
-        connect_to_service (GCLUE_GPSD_SOURCE (source));
+        /* However long the receiver takes to get its first fix */
+        GCLUE_GPSD_SOURCE (source)->priv->last_fix_seen = 0;
 
-        return TRUE;
+        /* Endpoints that aren't connected yet start streaming as soon
+         * as they are.
+         */
+        g_ptr_array_foreach (GCLUE_GPSD_SOURCE (source)->priv->endpoints,
+                             (GFunc) start_streaming,
+                             NULL);
+
+        return base_result;
 }
 
 static GClueLocationSourceStopResult
@@ -321,10 +1548,13 @@ gclue_gpsd_source_stop (GClueLocationSource *source)
 
         base_class = GCLUE_LOCATION_SOURCE_CLASS (gclue_gpsd_source_parent_class);
         base_result = base_class->stop (source);
-        if (base_result == GCLUE_LOCATION_SOURCE_STOP_RESULT_STILL_USED)
+        if (base_result != GCLUE_LOCATION_SOURCE_STOP_RESULT_OK)
                 return base_result;
 
-        disconnect_from_service (GCLUE_GPSD_SOURCE (source));
+        /* We stay connected, to keep track of whether gpsd is there */
+        g_ptr_array_foreach (GCLUE_GPSD_SOURCE (source)->priv->endpoints,
+                             (GFunc) stop_streaming,
+                             NULL);
 
-        return TRUE;
+        return base_result;
 }
@@ -0,0 +1,230 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include "gclue-location-history.h"
+#include <math.h>
+
+static const GClueLocationData *
+get_fix (const GClueLocationHistory *history,
+         guint                       index)
+{
+        return &history->fixes[(history->first + index) %
+                               GCLUE_LOCATION_HISTORY_SIZE];
+}
+
+/**
+ * gclue_location_history_init:
+ * @history: a #GClueLocationHistory
+ *
+ * Initializes @history to an empty one.
+ **/
+void
+gclue_location_history_init (GClueLocationHistory *history)
+{
+        history->first = 0;
+        history->len = 0;
+}
+
+/**
+ * gclue_location_history_add:
+ * @history: a #GClueLocationHistory
+ * @fix: the new fix
+ *
+ * Adds @fix to @history, dropping the oldest fix if it's full. A fix with
+ * the same timestamp as the latest one replaces it, and one older than it,
+ * e.g. after the clock was set back, starts the history over. The
+ * description of @fix isn't kept.
+ **/
+void
+gclue_location_history_add (GClueLocationHistory    *history,
+                            const GClueLocationData *fix)
+{
+        GClueLocationData *slot;
+
+        if (history->len > 0) {
+                guint64 latest;
+
+                latest = get_fix (history, history->len - 1)->timestamp;
+                if (fix->timestamp == latest)
+                        history->len--;
+                else if (fix->timestamp < latest)
+                        gclue_location_history_init (history);
+        }
+
+        if (history->len == GCLUE_LOCATION_HISTORY_SIZE) {
+                history->first = (history->first + 1) %
+                                 GCLUE_LOCATION_HISTORY_SIZE;
+                history->len--;
+        }
+
+        slot = &history->fixes[(history->first + history->len) %
+                               GCLUE_LOCATION_HISTORY_SIZE];
+        *slot = *fix;
+        slot->description = NULL;
+        history->len++;
+}
+
+/**
+ * gclue_location_history_get_length:
+ * @history: a #GClueLocationHistory
+ *
+ * Returns: the number of fixes in @history.
+ **/
+guint
+gclue_location_history_get_length (const GClueLocationHistory *history)
+{
+        return history->len;
+}
+
+/**
+ * gclue_location_history_get:
+ * @history: a #GClueLocationHistory
+ * @index: the index of the fix, 0 being the oldest
+ *
+ * Returns: (transfer none): the fix at @index.
+ **/
+const GClueLocationData *
+gclue_location_history_get (const GClueLocationHistory *history,
+                            guint                       index)
+{
+        g_return_val_if_fail (index < history->len, NULL);
+
+        return get_fix (history, index);
+}
+
+/**
+ * gclue_location_history_find:
+ * @history: a #GClueLocationHistory
+ * @timestamp: microseconds since the Epoch
+ *
+ * Finds the oldest fix of @history that isn't older than @timestamp.
+ *
+ * Returns: the index of that fix, or the length of @history if there's
+ *          none.
+ **/
+guint
+gclue_location_history_find (const GClueLocationHistory *history,
+                             guint64                     timestamp)
+{
+        guint low = 0, high = history->len;
+
+        while (low < high) {
+                guint mid = low + (high - low) / 2;
+
+                if (get_fix (history, mid)->timestamp < timestamp)
+                        low = mid + 1;
+                else
+                        high = mid;
+        }
+
+        return low;
+}
+
+/**
+ * gclue_location_history_get_velocity:
+ * @history: a #GClueLocationHistory
+ * @start: the index of the oldest fix to use
+ * @latest: a fix that's about to be added to @history
+ * @speed: (out): the speed in meters per second
+ * @heading: (out): the heading in degrees, or
+ *           %GCLUE_LOCATION_HEADING_UNKNOWN if @speed is 0
+ *
+ * Works out the velocity at @latest over it and the fixes from @start
+ * that are older than it, by fitting a straight line through them, with
+ * least squares. Unlike the difference between the last two fixes, this
+ * evens out their noise.
+ *
+ * Returns: %FALSE if there are less than 2 fixes to work from.
+ **/
+gboolean
+gclue_location_history_get_velocity (const GClueLocationHistory *history,
+                                     guint                       start,
+                                     const GClueLocationData    *latest,
+                                     gdouble                    *speed,
+                                     gdouble                    *heading)
+{
+        gdouble sum_t = 0, sum_x = 0, sum_y = 0;
+        gdouble sum_tt = 0, sum_tx = 0, sum_ty = 0;
+        gdouble n, var_t, east, north;
+        guint i, end;
+
+        /* Adding @latest would start the history over */
+        if (history->len > 0 &&
+            get_fix (history, history->len - 1)->timestamp > latest->timestamp)
+                return FALSE;
+
+        /* One with the same timestamp would be replaced by it */
+        end = gclue_location_history_find (history, latest->timestamp);
+        if (start >= end)
+                return FALSE;
+
+        /* Positions east and north in meters and times in seconds, from
+         * the latest fix. The positions keep their distance and bearing
+         * from it, on the WGS-84 ellipsoid for exact fixes, so the heading
+         * is the one at the latest fix and, with two fixes, the speed is
+         * their distance over their time apart. @latest itself is at 0 in
+         * both and adds nothing to the sums.
+         */
+        for (i = start; i < end; i++) {
+                const GClueLocationData *fix = get_fix (history, i);
+                gdouble distance, bearing, t, x = 0, y = 0;
+
+                distance = gclue_location_data_get_distance_from (latest, fix);
+                bearing = gclue_location_data_get_bearing_from (latest, fix);
+                if (bearing != GCLUE_LOCATION_HEADING_UNKNOWN) {
+                        bearing *= M_PI / 180.0;
+                        x = distance * sin (bearing);
+                        y = distance * cos (bearing);
+                }
+
+                t = -(gdouble) (latest->timestamp - fix->timestamp) /
+                    G_USEC_PER_SEC;
+
+                sum_t += t;
+                sum_x += x;
+                sum_y += y;
+                sum_tt += t * t;
+                sum_tx += t * x;
+                sum_ty += t * y;
+        }
+
+        n = end - start + 1;
+        var_t = sum_tt - sum_t * sum_t / n;
+        if (var_t <= 0)
+                return FALSE;
+
+        east = (sum_tx - sum_t * sum_x / n) / var_t;
+        north = (sum_ty - sum_t * sum_y / n) / var_t;
+
+        *speed = sqrt (east * east + north * north);
+        if (*speed > 0) {
+                *heading = atan2 (east, north) * 180.0 / M_PI;
+                /* A hair west of north rounds up to 360 */
+                if (*heading < 0)
+                        *heading += 360.0;
+                if (*heading >= 360.0)
+                        *heading -= 360.0;
+        } else {
+                *heading = GCLUE_LOCATION_HEADING_UNKNOWN;
+        }
+
+        return TRUE;
+}
@@ -0,0 +1,64 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#ifndef GCLUE_LOCATION_HISTORY_H
+#define GCLUE_LOCATION_HISTORY_H
+
+#include <glib.h>
+#include "gclue-location.h"
+
+G_BEGIN_DECLS
+
+/* A minute of fixes at 2 Hz, or a few seconds at 10 Hz */
+#define GCLUE_LOCATION_HISTORY_SIZE 64
+
+/* The latest fixes of a source, oldest first and with increasing
+ * timestamps. Once full, adding a fix drops the oldest one.
+ */
+typedef struct {
+        GClueLocationData fixes[GCLUE_LOCATION_HISTORY_SIZE];
+        guint             first;        /* Index of the oldest fix */
+        guint             len;
+} GClueLocationHistory;
+
+void
+gclue_location_history_init (GClueLocationHistory *history);
+void
+gclue_location_history_add (GClueLocationHistory    *history,
+                            const GClueLocationData *fix);
+guint
+gclue_location_history_get_length (const GClueLocationHistory *history);
+const GClueLocationData *
+gclue_location_history_get (const GClueLocationHistory *history,
+                            guint                       index);
+guint
+gclue_location_history_find (const GClueLocationHistory *history,
+                             guint64                     timestamp);
+gboolean
+gclue_location_history_get_velocity (const GClueLocationHistory *history,
+                                     guint                       start,
+                                     const GClueLocationData    *latest,
+                                     gdouble                    *speed,
+                                     gdouble                    *heading);
+
+G_END_DECLS
+
+#endif /* GCLUE_LOCATION_HISTORY_H */
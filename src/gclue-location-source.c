@@ -22,6 +22,7 @@
 #include <glib.h>
 #include <config.h>
 #include "gclue-location-source.h"
+#include "gclue-clock.h"
 
 #if GCLUE_USE_COMPASS
 #include "gclue-compass.h"
@@ -43,7 +44,20 @@ stop_source (GClueLocationSource *source);
 
 struct _GClueLocationSourcePrivate
 {
-        GClueLocation *location;
+        /* The current location, if has_location. Its description points to
+         * our own copy.
+         */
+        GClueLocationData location;
+        gboolean has_location;
+        char *description;
+
+        /* The latest locations, location being the last one */
+        GClueLocationHistory history;
+
+        /* Made from location when someone asks for it */
+        GClueLocation *location_object;
+
+        GVariant *satellites;
 
         guint active_counter;
         GClueMinUINT *time_threshold;
@@ -76,6 +90,7 @@ enum
         PROP_COMPUTE_MOVEMENT,
         PROP_SCRAMBLE_LOCATION,
         PROP_PRIORITY_SOURCE,
+        PROP_SATELLITES,
         LAST_PROP
 };
 
@@ -84,7 +99,7 @@ static GParamSpec *gParamSpecs[LAST_PROP];
 #if GCLUE_USE_COMPASS
 static gboolean
 set_heading_from_compass (GClueLocationSource *source,
-                          GClueLocation       *location)
+                          GClueLocationData   *location)
 {
         GClueLocationSourcePrivate *priv = source->priv;
         gdouble heading, curr_heading;
@@ -93,7 +108,7 @@ set_heading_from_compass (GClueLocationSource *source,
                 return FALSE;
 
         heading = gclue_compass_get_heading (priv->compass);
-        curr_heading = gclue_location_get_heading (location);
+        curr_heading = location->heading;
 
         if (heading == GCLUE_LOCATION_HEADING_UNKNOWN  ||
             heading == curr_heading)
@@ -104,7 +119,8 @@ set_heading_from_compass (GClueLocationSource *source,
         /* We trust heading from compass more than any other source so we always
          * override existing heading
          */
-        gclue_location_set_heading (location, heading);
+        location->heading = heading;
+        location->heading_accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
 
         return TRUE;
 }
@@ -116,11 +132,13 @@ on_compass_heading_changed (GObject    *gobject,
 {
         GClueLocationSource* source = GCLUE_LOCATION_SOURCE (user_data);
 
-        if (source->priv->location == NULL)
+        if (!source->priv->has_location)
                 return;
 
-        if (set_heading_from_compass (source, source->priv->location))
+        if (set_heading_from_compass (source, &source->priv->location)) {
+                g_clear_object (&source->priv->location_object);
                 g_object_notify (G_OBJECT (source), "location");
+        }
 }
 #endif /* GCLUE_USE_COMPASS */
 
@@ -134,7 +152,8 @@ gclue_location_source_get_property (GObject    *object,
 
         switch (prop_id) {
         case PROP_LOCATION:
-                g_value_set_object (value, source->priv->location);
+                g_value_set_object (value,
+                                    gclue_location_source_get_location (source));
                 break;
 
         case PROP_ACTIVE:
@@ -162,6 +181,10 @@ gclue_location_source_get_property (GObject    *object,
                 g_value_set_boolean (value, source->priv->priority_source);
                 break;
 
+        case PROP_SATELLITES:
+                g_value_set_variant (value, source->priv->satellites);
+                break;
+
         default:
                 G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         }
@@ -200,6 +223,11 @@ gclue_location_source_set_property (GObject      *object,
                 source->priv->priority_source = g_value_get_boolean (value);
                 break;
 
+        case PROP_SATELLITES:
+                gclue_location_source_set_satellites
+                        (source, g_value_get_variant (value));
+                break;
+
         default:
                 G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         }
@@ -211,7 +239,9 @@ gclue_location_source_finalize (GObject *object)
         GClueLocationSourcePrivate *priv = GCLUE_LOCATION_SOURCE (object)->priv;
 
         gclue_location_source_stop (GCLUE_LOCATION_SOURCE (object));
-        g_clear_object (&priv->location);
+        g_clear_object (&priv->location_object);
+        g_clear_pointer (&priv->description, g_free);
+        g_clear_pointer (&priv->satellites, g_variant_unref);
         g_clear_object (&priv->time_threshold);
 
         G_OBJECT_CLASS (gclue_location_source_parent_class)->finalize (object);
@@ -303,6 +333,16 @@ gclue_location_source_class_init (GClueLocationSourceClass *klass)
                                          PROP_PRIORITY_SOURCE,
                                          gParamSpecs[PROP_PRIORITY_SOURCE]);
 
+        gParamSpecs[PROP_SATELLITES] =
+                g_param_spec_variant ("satellites",
+                                      "Satellites",
+                                      "Satellites in view",
+                                      G_VARIANT_TYPE (GCLUE_SATELLITES_VARIANT_TYPE),
+                                      NULL,
+                                      G_PARAM_READWRITE);
+        g_object_class_install_property (object_class,
+                                         PROP_SATELLITES,
+                                         gParamSpecs[PROP_SATELLITES]);
 }
 
 static void
@@ -312,6 +352,7 @@ gclue_location_source_init (GClueLocationSource *source)
         source->priv->compute_movement = TRUE;
         source->priv->time_threshold = gclue_min_uint_new ();
         source->priv->priority_source = FALSE;
+        gclue_location_history_init (&source->priv->history);
 }
 
 static GClueLocationSourceStartResult
@@ -414,15 +455,93 @@ gclue_location_source_stop (GClueLocationSource *source)
  **/
 GClueLocation *
 gclue_location_source_get_location (GClueLocationSource *source)
+{
+        GClueLocationSourcePrivate *priv;
+
+        g_return_val_if_fail (GCLUE_IS_LOCATION_SOURCE (source), NULL);
+        priv = source->priv;
+
+        if (!priv->has_location)
+                return NULL;
+
+        if (priv->location_object == NULL)
+                priv->location_object =
+                        gclue_location_new_from_data (&priv->location);
+
+        return priv->location_object;
+}
+
+/**
+ * gclue_location_source_get_location_data:
+ * @source: a #GClueLocationSource
+ *
+ * The same as gclue_location_source_get_location(), without making a
+ * #GClueLocation. The data stays valid until the location changes.
+ *
+ * Returns: (transfer none): The location, or NULL if unknown.
+ **/
+const GClueLocationData *
+gclue_location_source_get_location_data (GClueLocationSource *source)
 {
         g_return_val_if_fail (GCLUE_IS_LOCATION_SOURCE (source), NULL);
 
-        return source->priv->location;
+        if (!source->priv->has_location)
+                return NULL;
+
+        return &source->priv->location;
+}
+
+/**
+ * gclue_location_source_get_history:
+ * @source: a #GClueLocationSource
+ *
+ * Gets the latest locations of @source, the current one included.
+ *
+ * Returns: (transfer none): The history of @source.
+ **/
+const GClueLocationHistory *
+gclue_location_source_get_history (GClueLocationSource *source)
+{
+        g_return_val_if_fail (GCLUE_IS_LOCATION_SOURCE (source), NULL);
+
+        return &source->priv->history;
 }
 
 /* 1 km in latitude is always .00899928005759539236 degrees */
 #define LATITUDE_IN_KM .00899928005759539236
 
+/* Speed and heading are worked out from the locations of this long before
+ * the new one, in microseconds, or from the previous one if it's older.
+ */
+#define MOVEMENT_WINDOW (5 * G_USEC_PER_SEC)
+
+static gboolean
+get_velocity (GClueLocationSource *source,
+              gdouble             *speed,
+              gdouble             *heading)
+{
+        GClueLocationHistory *history = &source->priv->history;
+        const GClueLocationData *location = &source->priv->location;
+        guint start, end;
+
+        /* The fixes before the new one, which isn't in the history yet */
+        end = gclue_location_history_find (history, location->timestamp);
+        if (end == 0)
+                return FALSE;
+
+        start = 0;
+        if (location->timestamp > MOVEMENT_WINDOW)
+                start = gclue_location_history_find
+                        (history, location->timestamp - MOVEMENT_WINDOW);
+        start = MIN (start, end - 1);
+
+        return gclue_location_history_get_velocity (history,
+                                                    start,
+                                                    location,
+                                                    speed,
+                                                    heading);
+}
+
 /**
  * gclue_location_source_set_location:
  * @source: a #GClueLocationSource
@@ -433,19 +552,50 @@ gclue_location_source_get_location (GClueLocationSource *source)
 void
 gclue_location_source_set_location (GClueLocationSource *source,
                                     GClueLocation       *location)
+{
+        g_return_if_fail (GCLUE_IS_LOCATION (location));
+
+        gclue_location_source_set_location_data
+                (source, gclue_location_peek_data (location));
+}
+
+/**
+ * gclue_location_source_set_location_data:
+ * @source: a #GClueLocationSource
+ * @location: the new location
+ *
+ * The same as gclue_location_source_set_location(), for sources that have
+ * their fixes as #GClueLocationData. A timestamp of 0 is taken as the
+ * current time. Its meant to be only used by subclasses.
+ **/
+void
+gclue_location_source_set_location_data (GClueLocationSource     *source,
+                                         const GClueLocationData *location)
 {
         GClueLocationSourcePrivate *priv = source->priv;
-        GClueLocation *cur_location;
         gdouble speed, heading;
+        gboolean has_velocity = FALSE;
+
+        priv->location = *location;
+        priv->has_location = TRUE;
+        g_clear_object (&priv->location_object);
 
-        cur_location = priv->location;
-        priv->location = gclue_location_duplicate (location);
+        /* As with #GClueLocation, 0 is now */
+        if (priv->location.timestamp == 0)
+                priv->location.timestamp = gclue_clock_get_real_time ();
+
+        /* Most sources give the same string literal for every fix */
+        if (g_strcmp0 (location->description, priv->description) != 0) {
+                g_free (priv->description);
+                priv->description = g_strdup (location->description);
+        }
+        priv->location.description = priv->description;
 
         if (priv->scramble_location) {
                 gdouble latitude, distance, accuracy, scramble_range;
 
-                latitude = gclue_location_get_latitude (priv->location);
-                accuracy = gclue_location_get_accuracy (priv->location);
+                latitude = priv->location.latitude;
+                accuracy = priv->location.accuracy;
 
                 scramble_range = GCLUE_LOCATION_ACCURACY_NEIGHBORHOOD;
                 if (accuracy >= scramble_range) {
@@ -467,44 +617,29 @@ gclue_location_source_set_location (GClueLocationSource *source,
                         latitude -= distance * LATITUDE_IN_KM;
                 accuracy += scramble_range;
 
-                g_object_set (G_OBJECT (priv->location),
-                              "latitude", latitude,
-                              "accuracy", accuracy,
-                              NULL);
+                priv->location.latitude = CLAMP (latitude, -90.0, 90.0);
+                priv->location.accuracy = accuracy;
                 g_debug ("%s location scrambled", G_OBJECT_TYPE_NAME (source));
         }
 
-        speed = gclue_location_get_speed (location);
-        if (speed == GCLUE_LOCATION_SPEED_UNKNOWN) {
-                if (cur_location != NULL && priv->compute_movement) {
-                        guint64 cur_timestamp, timestamp;
-
-                        timestamp = gclue_location_get_timestamp (location);
-                        cur_timestamp = gclue_location_get_timestamp
-                                        (cur_location);
+        if (priv->compute_movement)
+                has_velocity = get_velocity (source, &speed, &heading);
 
-                        if (timestamp != cur_timestamp)
-                                gclue_location_set_speed_from_prev_location
-                                        (priv->location, cur_location);
-                }
-        } else {
-                gclue_location_set_speed (priv->location, speed);
-        }
+        if (location->speed == GCLUE_LOCATION_SPEED_UNKNOWN && has_velocity)
+                priv->location.speed = speed;
 
 #if GCLUE_USE_COMPASS
-        set_heading_from_compass (source, location);
+        set_heading_from_compass (source, &priv->location);
 #endif
-        heading = gclue_location_get_heading (location);
-        if (heading == GCLUE_LOCATION_HEADING_UNKNOWN) {
-                if (cur_location != NULL && priv->compute_movement)
-                        gclue_location_set_heading_from_prev_location
-                                (priv->location, cur_location);
-        } else {
-                gclue_location_set_heading (priv->location, heading);
-        }
+        if (priv->location.heading == GCLUE_LOCATION_HEADING_UNKNOWN &&
+            has_velocity)
+                priv->location.heading = heading;
 
-        g_object_notify (G_OBJECT (source), "location");
-        g_clear_object (&cur_location);
+        /* Once, with its speed and heading */
+        gclue_location_history_add (&priv->history, &priv->location);
+
+        g_object_notify_by_pspec (G_OBJECT (source),
+                                  gParamSpecs[PROP_LOCATION]);
 }
 
 /**
@@ -596,3 +731,45 @@ gclue_location_source_get_time_threshold (GClueLocationSource *source)
 
         return source->priv->time_threshold;
 }
+
+/**
+ * gclue_location_source_get_satellites
+ * @source: a #GClueLocationSource
+ *
+ * Returns: (transfer none): The satellites in view, as a
+ * %GCLUE_SATELLITES_VARIANT_TYPE #GVariant, or NULL if unknown.
+ **/
+GVariant *
+gclue_location_source_get_satellites (GClueLocationSource *source)
+{
+        g_return_val_if_fail (GCLUE_IS_LOCATION_SOURCE (source), NULL);
+
+        return source->priv->satellites;
+}
+
+/**
+ * gclue_location_source_set_satellites
+ * @source: a #GClueLocationSource
+ * @satellites: a %GCLUE_SATELLITES_VARIANT_TYPE #GVariant
+ *
+ * Set the satellites in view. Its meant to be only used by subclasses.
+ * If @satellites is floating, @source takes its ownership.
+ **/
+void
+gclue_location_source_set_satellites (GClueLocationSource *source,
+                                      GVariant            *satellites)
+{
+        GClueLocationSourcePrivate *priv = source->priv;
+
+        g_return_if_fail (satellites == NULL ||
+                          g_variant_is_of_type (satellites,
+                                                G_VARIANT_TYPE (GCLUE_SATELLITES_VARIANT_TYPE)));
+
+        if (satellites != NULL)
+                g_variant_ref_sink (satellites);
+        g_clear_pointer (&priv->satellites, g_variant_unref);
+        priv->satellites = satellites;
+
+        g_object_notify_by_pspec (G_OBJECT (source),
+                                  gParamSpecs[PROP_SATELLITES]);
+}
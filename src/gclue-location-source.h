@@ -26,6 +26,7 @@
 #include <gio/gio.h>
 #include "gclue-enum-types.h"
 #include "gclue-location.h"
+#include "gclue-location-history.h"
 #include "gclue-min-uint.h"
 
 G_BEGIN_DECLS
@@ -38,6 +39,23 @@ G_BEGIN_DECLS
 #define GCLUE_IS_LOCATION_SOURCE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GCLUE_TYPE_LOCATION_SOURCE))
 #define GCLUE_LOCATION_SOURCE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GCLUE_TYPE_LOCATION_SOURCE, GClueLocationSourceClass))
 
+/*
+ * GCLUE_SATELLITES_VARIANT_TYPE:
+ *
+ * The type of the satellites reported by sources: HDOP, VDOP, PDOP and
+ * the satellites in view, each as its PRN, elevation (degrees), azimuth
+ * (degrees), signal to noise ratio (dB-Hz) and whether it was used in the
+ * fix.
+ */
+#define GCLUE_SATELLITES_VARIANT_TYPE "(ddda(udddb))"
+
+/*
+ * GCLUE_SATELLITES_UNKNOWN:
+ *
+ * Used for any of the values in satellites that isn't known.
+ */
+#define GCLUE_SATELLITES_UNKNOWN -G_MAXDOUBLE
+
 typedef enum {
         GCLUE_LOCATION_SOURCE_START_RESULT_FAILED = 0,
         GCLUE_LOCATION_SOURCE_START_RESULT_ALREADY_STARTED,
@@ -82,6 +100,15 @@ GClueLocation    *gclue_location_source_get_location
 void              gclue_location_source_set_location
                                               (GClueLocationSource *source,
                                                GClueLocation       *location);
+const GClueLocationData *
+                  gclue_location_source_get_location_data
+                                              (GClueLocationSource *source);
+void              gclue_location_source_set_location_data
+                                              (GClueLocationSource     *source,
+                                               const GClueLocationData *location);
+const GClueLocationHistory *
+                  gclue_location_source_get_history
+                                              (GClueLocationSource *source);
 gboolean          gclue_location_source_get_active
                                               (GClueLocationSource *source);
 gboolean          gclue_location_source_get_priority_source
@@ -92,6 +119,12 @@ GClueAccuracyLevel
 GClueMinUINT     *gclue_location_source_get_time_threshold
                                               (GClueLocationSource *source);
 
+GVariant         *gclue_location_source_get_satellites
+                                              (GClueLocationSource *source);
+void              gclue_location_source_set_satellites
+                                              (GClueLocationSource *source,
+                                               GVariant            *satellites);
+
 gboolean
 gclue_location_source_get_compute_movement (GClueLocationSource *source);
 void
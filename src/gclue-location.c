@@ -24,6 +24,8 @@
  */
 
 #include "gclue-location.h"
+#include "gclue-clock.h"
+#include "gclue-geodesy.h"
 #include "gclue-nmea-utils.h"
 #include <math.h>
 #include <string.h>
@@ -31,20 +33,26 @@
 
 #define TIME_DIFF_THRESHOLD (60 * G_USEC_PER_SEC) /* 60 seconds */
 #define EARTH_RADIUS_KM 6372.795
+/* Up to this distance, in meters, and 80 degrees of latitude, the Earth
+ * is flat enough for the equirectangular approximation to be off by less
+ * than 5 mm. Together, they keep the longitudes it's used across within a
+ * third of a degree of each other.
+ */
+#define FLAT_EARTH_DISTANCE 5000.0
+#define FLAT_EARTH_MIN_COS_LATITUDE 0.17364817766693 /* cos (80°) */
 #define KNOTS_IN_METERS_PER_SECOND 0.51444
-#define RMC_TIME_DIFF_THRESHOLD 5 /* 5 seconds */
-#define RMC_DEFAULT_ACCURACY 5    /* 5 meters */
+#define RMC_TIME_DIFF_THRESHOLD (5 * G_USEC_PER_SEC) /* 5 seconds */
+#define NMEA_DEFAULT_ACCURACY 5    /* 5 meters */
+/* User equivalent range error of a typical receiver: the error in meters
+ * that a DOP of 1 amounts to.
+ */
+#define NMEA_UERE 5.0
 
 struct _GClueLocationPrivate {
-        char   *description;
+        GClueLocationData data;
 
-        gdouble longitude;
-        gdouble latitude;
-        gdouble altitude;
-        gdouble accuracy;
-        guint64 timestamp;
-        gdouble speed;
-        gdouble heading;
+        /* What data.description points to */
+        char *description;
 };
 
 enum {
@@ -55,9 +63,14 @@ enum {
         PROP_ACCURACY,
         PROP_DESCRIPTION,
         PROP_TIMESTAMP,
+        PROP_TIMESTAMP_USEC,
         PROP_ALTITUDE,
         PROP_SPEED,
         PROP_HEADING,
+        PROP_ALTITUDE_ACCURACY,
+        PROP_SPEED_ACCURACY,
+        PROP_HEADING_ACCURACY,
+        PROP_CLIMB,
 };
 
 G_DEFINE_TYPE_WITH_CODE (GClueLocation,
@@ -103,6 +116,12 @@ gclue_location_get_property (GObject    *object,
                 g_value_set_uint64 (value,
                                     gclue_location_get_timestamp (location));
                 break;
+
+        case PROP_TIMESTAMP_USEC:
+                g_value_set_uint64 (value,
+                                    gclue_location_get_timestamp_usec (location));
+                break;
+
         case PROP_SPEED:
                 g_value_set_double (value,
                                     gclue_location_get_speed (location));
@@ -113,6 +132,26 @@ gclue_location_get_property (GObject    *object,
                                     gclue_location_get_heading (location));
                 break;
 
+        case PROP_ALTITUDE_ACCURACY:
+                g_value_set_double
+                        (value, gclue_location_get_altitude_accuracy (location));
+                break;
+
+        case PROP_SPEED_ACCURACY:
+                g_value_set_double
+                        (value, gclue_location_get_speed_accuracy (location));
+                break;
+
+        case PROP_HEADING_ACCURACY:
+                g_value_set_double
+                        (value, gclue_location_get_heading_accuracy (location));
+                break;
+
+        case PROP_CLIMB:
+                g_value_set_double (value,
+                                    gclue_location_get_climb (location));
+                break;
+
         default:
                 /* We don't have any other property... */
                 G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -126,7 +165,7 @@ gclue_location_set_latitude (GClueLocation *loc,
 {
         g_return_if_fail (latitude >= -90.0 && latitude <= 90.0);
 
-        loc->priv->latitude = latitude;
+        loc->priv->data.latitude = latitude;
 }
 
 static void
@@ -135,14 +174,14 @@ gclue_location_set_longitude (GClueLocation *loc,
 {
         g_return_if_fail (longitude >= -180.0 && longitude <= 180.0);
 
-        loc->priv->longitude = longitude;
+        loc->priv->data.longitude = longitude;
 }
 
 static void
 gclue_location_set_altitude (GClueLocation *loc,
                              gdouble        altitude)
 {
-        loc->priv->altitude = altitude;
+        loc->priv->data.altitude = altitude;
 }
 
 static void
@@ -151,16 +190,23 @@ gclue_location_set_accuracy (GClueLocation *loc,
 {
         g_return_if_fail (accuracy >= GCLUE_LOCATION_ACCURACY_UNKNOWN);
 
-        loc->priv->accuracy = accuracy;
+        loc->priv->data.accuracy = accuracy;
 }
 
 static void
-gclue_location_set_timestamp (GClueLocation *loc,
-                              guint64        timestamp)
+gclue_location_set_timestamp_usec (GClueLocation *loc,
+                                   guint64        timestamp)
 {
         g_return_if_fail (GCLUE_IS_LOCATION (loc));
 
-        loc->priv->timestamp = timestamp;
+        /* Both timestamp properties are construct-only and get their 0
+         * default applied in no particular order, so 0 must not override
+         * a value given through the other one.
+         */
+        if (timestamp == 0)
+                return;
+
+        loc->priv->data.timestamp = timestamp;
 }
 
 void
@@ -171,6 +217,7 @@ gclue_location_set_description (GClueLocation *loc,
 
         g_free (loc->priv->description);
         loc->priv->description = g_strdup (description);
+        loc->priv->data.description = loc->priv->description;
 }
 
 static void
@@ -208,9 +255,15 @@ gclue_location_set_property (GObject      *object,
                 break;
 
         case PROP_TIMESTAMP:
-                gclue_location_set_timestamp (location,
-                                              g_value_get_uint64 (value));
+                gclue_location_set_timestamp_usec
+                        (location, g_value_get_uint64 (value) * G_USEC_PER_SEC);
+                break;
+
+        case PROP_TIMESTAMP_USEC:
+                gclue_location_set_timestamp_usec (location,
+                                                   g_value_get_uint64 (value));
                 break;
+
         case PROP_SPEED:
                 gclue_location_set_speed (location,
                                           g_value_get_double (value));
@@ -221,6 +274,22 @@ gclue_location_set_property (GObject      *object,
                                             g_value_get_double (value));
                 break;
 
+        case PROP_ALTITUDE_ACCURACY:
+                location->priv->data.altitude_accuracy = g_value_get_double (value);
+                break;
+
+        case PROP_SPEED_ACCURACY:
+                location->priv->data.speed_accuracy = g_value_get_double (value);
+                break;
+
+        case PROP_HEADING_ACCURACY:
+                location->priv->data.heading_accuracy = g_value_get_double (value);
+                break;
+
+        case PROP_CLIMB:
+                location->priv->data.climb = g_value_get_double (value);
+                break;
+
         default:
                 /* We don't have any other property... */
                 G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -232,13 +301,12 @@ static void
 gclue_location_constructed (GObject *object)
 {
         GClueLocation *location = GCLUE_LOCATION (object);
-        gint64 timestamp;
 
-        if (location->priv->timestamp != 0)
+        if (location->priv->data.timestamp != 0)
                 return;
 
-        timestamp = g_get_real_time () / G_USEC_PER_SEC;
-        gclue_location_set_timestamp (location, timestamp);
+        gclue_location_set_timestamp_usec (location,
+                                           gclue_clock_get_real_time ());
 }
 
 static void
@@ -356,6 +424,28 @@ gclue_location_class_init (GClueLocationClass *klass)
                                      G_PARAM_STATIC_STRINGS);
         g_object_class_install_property (glocation_class, PROP_TIMESTAMP, pspec);
 
+        /**
+         * GClueLocation:timestamp-usec:
+         *
+         * The same as #GClueLocation:timestamp but in microseconds, for
+         * sources that resolve more than one location per second.
+         *
+         * A value of 0 (zero) will be interpreted as the current time.
+         */
+        pspec = g_param_spec_uint64 ("timestamp-usec",
+                                     "TimestampUsec",
+                                     "The timestamp of this location "
+                                     "in microseconds since Epoch",
+                                     0,
+                                     G_MAXINT64,
+                                     0,
+                                     G_PARAM_READWRITE |
+                                     G_PARAM_CONSTRUCT_ONLY |
+                                     G_PARAM_STATIC_STRINGS);
+        g_object_class_install_property (glocation_class,
+                                         PROP_TIMESTAMP_USEC,
+                                         pspec);
+
         /**
          * GClueLocation:speed
          *
@@ -389,6 +479,72 @@ gclue_location_class_init (GClueLocationClass *klass)
                                      G_PARAM_READWRITE |
                                      G_PARAM_STATIC_STRINGS);
         g_object_class_install_property (glocation_class, PROP_HEADING, pspec);
+
+        /**
+         * GClueLocation:altitude-accuracy
+         *
+         * The accuracy of #GClueLocation:altitude, in meters.
+         */
+        pspec = g_param_spec_double ("altitude-accuracy",
+                                     "AltitudeAccuracy",
+                                     "Accuracy of altitude in meters",
+                                     GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                                     G_MAXDOUBLE,
+                                     GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                                     G_PARAM_READWRITE |
+                                     G_PARAM_STATIC_STRINGS);
+        g_object_class_install_property (glocation_class,
+                                         PROP_ALTITUDE_ACCURACY,
+                                         pspec);
+
+        /**
+         * GClueLocation:speed-accuracy
+         *
+         * The accuracy of #GClueLocation:speed, in meters per second.
+         */
+        pspec = g_param_spec_double ("speed-accuracy",
+                                     "SpeedAccuracy",
+                                     "Accuracy of speed in meters per second",
+                                     GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                                     G_MAXDOUBLE,
+                                     GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                                     G_PARAM_READWRITE |
+                                     G_PARAM_STATIC_STRINGS);
+        g_object_class_install_property (glocation_class,
+                                         PROP_SPEED_ACCURACY,
+                                         pspec);
+
+        /**
+         * GClueLocation:heading-accuracy
+         *
+         * The accuracy of #GClueLocation:heading, in degrees.
+         */
+        pspec = g_param_spec_double ("heading-accuracy",
+                                     "HeadingAccuracy",
+                                     "Accuracy of heading in degrees",
+                                     GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                                     G_MAXDOUBLE,
+                                     GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                                     G_PARAM_READWRITE |
+                                     G_PARAM_STATIC_STRINGS);
+        g_object_class_install_property (glocation_class,
+                                         PROP_HEADING_ACCURACY,
+                                         pspec);
+
+        /**
+         * GClueLocation:climb
+         *
+         * The vertical speed in meters per second, positive when going up.
+         */
+        pspec = g_param_spec_double ("climb",
+                                     "Climb",
+                                     "Vertical speed in meters per second",
+                                     -G_MAXDOUBLE,
+                                     G_MAXDOUBLE,
+                                     GCLUE_LOCATION_CLIMB_UNKNOWN,
+                                     G_PARAM_READWRITE |
+                                     G_PARAM_STATIC_STRINGS);
+        g_object_class_install_property (glocation_class, PROP_CLIMB, pspec);
 }
 
 static void
@@ -396,138 +552,160 @@ gclue_location_init (GClueLocation *location)
 {
         location->priv = gclue_location_get_instance_private (location);
 
-        location->priv->altitude = GCLUE_LOCATION_ALTITUDE_UNKNOWN;
-        location->priv->accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
-        location->priv->speed = GCLUE_LOCATION_SPEED_UNKNOWN;
-        location->priv->heading = GCLUE_LOCATION_HEADING_UNKNOWN;
+        gclue_location_data_init (&location->priv->data);
 }
 
-static gdouble
-get_accuracy_from_hdop (gdouble hdop)
+/**
+ * gclue_location_data_init:
+ * @data: a #GClueLocationData
+ *
+ * Initializes @data to a location at 0, 0 with everything else unknown,
+ * and a timestamp of 0.
+ **/
+void
+gclue_location_data_init (GClueLocationData *data)
 {
-        /* FIXME: These are really just rough estimates based on:
-         *        http://en.wikipedia.org/wiki/Dilution_of_precision_%28GPS%29#Meaning_of_DOP_Values
-         */
-        if (hdop <= 1)
-                return 0;
-        else if (hdop <= 2)
-                return 1;
-        else if (hdop <= 5)
-                return 3;
-        else if (hdop <= 10)
-                return 50;
-        else if (hdop <= 20)
-                return 100;
-        else
-                return 300;
+        data->latitude = 0.0;
+        data->longitude = 0.0;
+        data->accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
+        data->altitude = GCLUE_LOCATION_ALTITUDE_UNKNOWN;
+        data->altitude_accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
+        data->speed = GCLUE_LOCATION_SPEED_UNKNOWN;
+        data->speed_accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
+        data->heading = GCLUE_LOCATION_HEADING_UNKNOWN;
+        data->heading_accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
+        data->climb = GCLUE_LOCATION_CLIMB_UNKNOWN;
+        data->timestamp = 0;
+        data->description = NULL;
 }
 
 static gdouble
-parse_coordinate_string (const char *coordinate,
-                         const char *direction)
+parse_coordinate_field (const GClueNMEAFields *fields,
+                        guint                  i)
 {
-        gdouble minutes, degrees, out;
-        g_autofree gchar *degrees_str = NULL;
-        gchar *dot_str;
-        gint dot_offset;
-
-        if (coordinate[0] == '\0' ||
-            direction[0] == '\0' ||
-            direction[0] == '\0')
+        gdouble minutes, out;
+        const char *coordinate, *dot_str;
+        gsize len, j;
+        char direction;
+        gint degrees = 0;
+        gchar *end;
+
+        coordinate = gclue_nmea_fields_get (fields, i, &len);
+        direction = gclue_nmea_fields_get_char (fields, i + 1);
+        if (len == 0 || direction == '\0')
                 return INVALID_COORDINATE;
 
-        if (direction[0] != 'N' &&
-            direction[0] != 'S' &&
-            direction[0] != 'E' &&
-            direction[0] != 'W') {
-                g_warning ("Unknown direction '%s' for coordinates, ignoring..",
+        if (direction != 'N' &&
+            direction != 'S' &&
+            direction != 'E' &&
+            direction != 'W') {
+                g_warning ("Unknown direction '%c' for coordinates, ignoring..",
                            direction);
                 return INVALID_COORDINATE;
         }
 
-        dot_str = g_strstr_len (coordinate, 6, ".");
-        if (dot_str == NULL)
+        /* [d]ddmm.mmmm, the degrees are all but the last two digits before
+         * the dot.
+         */
+        dot_str = memchr (coordinate, '.', MIN (len, 6));
+        if (dot_str == NULL || dot_str - coordinate < 2)
                 return INVALID_COORDINATE;
-        dot_offset = dot_str - coordinate;
 
-        degrees_str = g_strndup (coordinate, dot_offset - 2);
-        degrees = g_ascii_strtod (degrees_str, NULL);
+        for (j = 0; j < (gsize) (dot_str - coordinate - 2); j++) {
+                if (!g_ascii_isdigit (coordinate[j]))
+                        return INVALID_COORDINATE;
+                degrees = degrees * 10 + (coordinate[j] - '0');
+        }
 
-        minutes = g_ascii_strtod (dot_str - 2, NULL);
+        minutes = g_ascii_strtod (dot_str - 2, &end);
+        if (end != coordinate + len)
+                return INVALID_COORDINATE;
 
         /* Include the minutes as part of the degrees */
         out = degrees + (minutes / 60.0);
 
-        if (direction[0] == 'S' || direction[0] == 'W')
+        if (direction == 'S' || direction == 'W')
                 out = 0 - out;
 
         return out;
 }
 
 static gdouble
-parse_altitude_string (const char *altitude,
-                       const char *unit)
+parse_altitude_field (const GClueNMEAFields *fields,
+                      guint                  i)
 {
-        if (altitude[0] == '\0' || unit[0] == '\0')
+        gdouble altitude;
+        char unit;
+
+        unit = gclue_nmea_fields_get_char (fields, i + 1);
+        if (!gclue_nmea_fields_get_double (fields, i, &altitude) ||
+            unit == '\0')
                 return GCLUE_LOCATION_ALTITUDE_UNKNOWN;
 
-        if (unit[0] != 'M') {
-                g_warning ("Unknown unit '%s' for altitude, ignoring..",
+        if (unit != 'M') {
+                g_warning ("Unknown unit '%c' for altitude, ignoring..",
                            unit);
 
                 return GCLUE_LOCATION_ALTITUDE_UNKNOWN;
         }
 
-        return g_ascii_strtod (altitude, NULL);
+        return altitude;
 }
 
-/* Return a timestamp derived from the NMEA timestamp and system date as
- * seconds since epoch.
- * If system time cannot be retrieved, return 0.
- * If timestamp parsing fails, return system time.
- * If the parsed time is in the future when compared to the system time,
+/* Return a timestamp derived from the NMEA timestamp and the current date as
+ * microseconds since epoch.
+ * If timestamp parsing fails, return the current time.
+ * If the parsed time is in the future when compared to the current time,
  * return the parsed time yesterday.
+ *
+ * With a @reference time, e.g. that of the previous fix of a recording, the
+ * date is that of the closest time to @reference with the same time of day
+ * instead, so the time of day wrapping around at midnight moves on to the
+ * next day.
  */
 static gint64
-parse_nmea_timestamp (const char *nmea_ts)
+parse_nmea_timestamp (const GClueNMEAFields *fields,
+                      guint                  i,
+                      gint64                 reference)
 {
-        g_autoptr(GDateTime) now = NULL;
-        g_autoptr(GDateTime) midnight = NULL;
-        g_autoptr(GDateTime) ts = NULL;
+        gint64 now, ts;
         GTimeSpan timespan;
+        const char *nmea_ts;
+        gsize len;
 
-        now = g_date_time_new_now_utc ();
-        if (now == NULL) {
-                g_warning ("Failed to get the current UTC time");
-                return 0;
-        }
+        now = reference > 0 ? reference : gclue_clock_get_real_time ();
 
-        if (!nmea_ts || !*nmea_ts) {  /* Empty timestamp, no warning */
-                return g_date_time_to_unix (now);
+        nmea_ts = gclue_nmea_fields_get (fields, i, &len);
+        if (len == 0) {  /* Empty timestamp, no warning */
+                return now;
         }
 
-        timespan = gclue_nmea_timestamp_to_timespan (nmea_ts);
+        timespan = gclue_nmea_fields_get_timespan (fields, i);
         if (timespan < 0) {
-                g_warning ("Failed to parse NMEA timestamp '%s'", nmea_ts);
-                return g_date_time_to_unix (now);
+                g_warning ("Failed to parse NMEA timestamp '%.*s'",
+                           (int) len, nmea_ts);
+                return now;
+        }
+
+        if (reference > 0) {
+                ts = reference - reference % G_TIME_SPAN_DAY + timespan;
+                if (ts - reference >= G_TIME_SPAN_DAY / 2)
+                        ts -= G_TIME_SPAN_DAY;
+                else if (reference - ts > G_TIME_SPAN_DAY / 2)
+                        ts += G_TIME_SPAN_DAY;
+
+                return ts;
         }
 
-        midnight = g_date_time_new_utc (g_date_time_get_year (now),
-                                        g_date_time_get_month (now),
-                                        g_date_time_get_day_of_month (now),
-                                        0,
-                                        0,
-                                        0);
-        ts = g_date_time_add (midnight, timespan);
-
-        if (g_date_time_difference (ts, now) > TIME_DIFF_THRESHOLD) {
-                g_debug ("NMEA timestamp '%s' in future. Assuming yesterday's.",
-                         nmea_ts);
-                g_clear_pointer (&ts, g_date_time_unref);
-                ts = g_date_time_add (midnight, timespan - G_TIME_SPAN_DAY);
+        ts = gclue_clock_get_utc_midnight () + timespan;
+
+        if (ts - now > TIME_DIFF_THRESHOLD) {
+                g_debug ("NMEA timestamp '%.*s' in future. Assuming yesterday's.",
+                         (int) len, nmea_ts);
+                ts -= G_TIME_SPAN_DAY;
         }
 
-        return g_date_time_to_unix (ts);
+        return ts;
 }
 
 /**
@@ -547,12 +725,15 @@ gclue_location_new (gdouble latitude,
                     gdouble accuracy,
                     const char *description)
 {
-        return g_object_new (GCLUE_TYPE_LOCATION,
-                             "latitude", latitude,
-                             "longitude", longitude,
-                             "accuracy", accuracy,
-                             "description", description,
-                             NULL);
+        GClueLocationData data;
+
+        gclue_location_data_init (&data);
+        data.latitude = latitude;
+        data.longitude = longitude;
+        data.accuracy = accuracy;
+        data.description = description;
+
+        return gclue_location_new_from_data (&data);
 }
 
 /**
@@ -563,7 +744,11 @@ gclue_location_new (gdouble latitude,
  * @speed: speed in meters per second
  * @heading: heading in degrees
  * @altitude: altitude of location in meters
- * @timestamp: timestamp in seconds since the Epoch
+ * @altitude_accuracy: accuracy of @altitude in meters
+ * @speed_accuracy: accuracy of @speed in meters per second
+ * @heading_accuracy: accuracy of @heading in degrees
+ * @climb: vertical speed in meters per second
+ * @timestamp: timestamp in microseconds since the Epoch, or 0 for now
  * @description: a description for the location
  *
  * Creates a new #GClueLocation object.
@@ -577,106 +762,281 @@ gclue_location_new_full (gdouble     latitude,
                          gdouble     speed,
                          gdouble     heading,
                          gdouble     altitude,
+                         gdouble     altitude_accuracy,
+                         gdouble     speed_accuracy,
+                         gdouble     heading_accuracy,
+                         gdouble     climb,
                          guint64     timestamp,
                          const char *description)
 {
-        return g_object_new (GCLUE_TYPE_LOCATION,
-                             "latitude", latitude,
-                             "longitude", longitude,
-                             "accuracy", accuracy,
-                             "speed", speed,
-                             "heading", heading,
-                             "altitude", altitude,
-                             "timestamp", timestamp,
-                             "description", description,
-                             NULL);
+        GClueLocationData data = {
+                .latitude = latitude,
+                .longitude = longitude,
+                .accuracy = accuracy,
+                .altitude = altitude,
+                .altitude_accuracy = altitude_accuracy,
+                .speed = speed,
+                .speed_accuracy = speed_accuracy,
+                .heading = heading,
+                .heading_accuracy = heading_accuracy,
+                .climb = climb,
+                .timestamp = timestamp,
+                .description = description,
+        };
+
+        return gclue_location_new_from_data (&data);
 }
 
-static GClueLocation *
-gclue_location_create_from_gga (const char *gga)
+/**
+ * gclue_location_new_from_data:
+ * @data: the location
+ *
+ * Creates a new #GClueLocation object holding a copy of @data. A timestamp
+ * of 0 is taken as the current time.
+ *
+ * Returns: a new #GClueLocation object. Use g_object_unref() when done.
+ **/
+GClueLocation *
+gclue_location_new_from_data (const GClueLocationData *data)
 {
         GClueLocation *location;
-        gdouble latitude, longitude, accuracy, altitude;
+        guint64 now;
+
+        g_return_val_if_fail (data != NULL, NULL);
+
+        /* No construct properties, so no property lookups either */
+        location = g_object_new (GCLUE_TYPE_LOCATION, NULL);
+        now = location->priv->data.timestamp;
+
+        location->priv->data = *data;
+        if (data->timestamp == 0)
+                location->priv->data.timestamp = now;
+        location->priv->data.description = NULL;
+        gclue_location_set_description (location, data->description);
+
+        return location;
+}
+
+/**
+ * gclue_location_peek_data:
+ * @location: a #GClueLocation
+ *
+ * Gets the values of @location. Its description belongs to @location.
+ *
+ * Returns: (transfer none): the values of @location.
+ **/
+const GClueLocationData *
+gclue_location_peek_data (GClueLocation *location)
+{
+        g_return_val_if_fail (GCLUE_IS_LOCATION (location), NULL);
+
+        return &location->priv->data;
+}
+
+/* Whether two fixes are accurate enough for the difference between the
+ * WGS-84 ellipsoid and a sphere to matter.
+ */
+static gboolean
+use_ellipsoid (const GClueLocationData *loca,
+               const GClueLocationData *locb)
+{
+        return loca->accuracy >= 0 &&
+               loca->accuracy <= GCLUE_LOCATION_ACCURACY_EXACT &&
+               locb->accuracy >= 0 &&
+               locb->accuracy <= GCLUE_LOCATION_ACCURACY_EXACT;
+}
+
+/* Error estimates for a fix, from the GST and GSA sentences of its epoch */
+typedef struct {
+        gdouble  accuracy;
+        gdouble  altitude_accuracy;
+        gboolean no_altitude;
+        gboolean have_gsa;
+} NMEAFixErrors;
+
+static void
+nmea_fix_errors_init (NMEAFixErrors *errors)
+{
+        errors->accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
+        errors->altitude_accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
+        errors->no_altitude = FALSE;
+        errors->have_gsa = FALSE;
+}
+
+static void
+nmea_fix_errors_add_gst (NMEAFixErrors *errors,
+                         const char    *gst,
+                         GTimeSpan      epoch)
+{
+        GClueNMEAFields fields;
+        gdouble lat_err, lon_err, alt_err;
+        GTimeSpan time;
+
+        if (!gclue_nmea_fields_parse (&fields, gst) || fields.n_fields < 9) {
+                g_warning ("Invalid NMEA GST sentence.");
+                return;
+        }
+
+        time = gclue_nmea_fields_get_timespan (&fields, 1);
+        if (epoch >= 0 && time >= 0 && time != epoch) {
+                g_debug ("NMEA GST sentence is for another fix, ignoring");
+                return;
+        }
+
+        /* Standard deviations of the latitude, longitude and altitude
+         * errors, in meters.
+         */
+        if (gclue_nmea_fields_get_double (&fields, 6, &lat_err) &&
+            gclue_nmea_fields_get_double (&fields, 7, &lon_err))
+                errors->accuracy = sqrt (lat_err * lat_err +
+                                         lon_err * lon_err);
+        if (gclue_nmea_fields_get_double (&fields, 8, &alt_err))
+                errors->altitude_accuracy = alt_err;
+}
+
+static void
+nmea_fix_errors_add_gsa (NMEAFixErrors *errors,
+                         const char    *gsa)
+{
+        GClueNMEAFields fields;
+        gdouble hdop, vdop;
+        guint fix_type;
+
+        if (!gclue_nmea_fields_parse (&fields, gsa) || fields.n_fields < 18) {
+                g_warning ("Invalid NMEA GSA sentence.");
+                return;
+        }
+
+        /* 1 is no fix, 2 a 2D and 3 a 3D one. With a GSA sentence for
+         * each satellite system, the ones of systems that had no part in
+         * the fix may say there's none.
+         */
+        if (!gclue_nmea_fields_get_uint (&fields, 2, &fix_type) ||
+            fix_type < 2)
+                return;
+        if (!errors->have_gsa)
+                errors->no_altitude = fix_type == 2;
+        else if (fix_type == 3)
+                errors->no_altitude = FALSE;
+        errors->have_gsa = TRUE;
+
+        /* The receiver's error statistics from GST beat the DOPs */
+        if (errors->accuracy == GCLUE_LOCATION_ACCURACY_UNKNOWN &&
+            gclue_nmea_fields_get_double (&fields, 16, &hdop))
+                errors->accuracy = hdop * NMEA_UERE;
+        if (errors->altitude_accuracy == GCLUE_LOCATION_ACCURACY_UNKNOWN &&
+            gclue_nmea_fields_get_double (&fields, 17, &vdop))
+                errors->altitude_accuracy = vdop * NMEA_UERE;
+}
+
+static gboolean
+coordinates_are_valid (gdouble latitude,
+                       gdouble longitude)
+{
+        return latitude >= -90.0 && latitude <= 90.0 &&
+               longitude >= -180.0 && longitude <= 180.0;
+}
+
+static gboolean
+location_data_from_gga (const char          *gga,
+                        gint64               reference,
+                        const NMEAFixErrors *errors,
+                        GClueLocationData   *data)
+{
+        gdouble latitude, longitude, accuracy;
         gdouble hdop; /* Horizontal Dilution Of Precision */
-        guint64 timestamp;
-        g_auto(GStrv) parts = NULL;
+        GClueNMEAFields fields;
+        guint quality;
 
-        parts = g_strsplit (gga, ",", -1);
-        if (g_strv_length (parts) < 14) {
+        if (!gclue_nmea_fields_parse (&fields, gga) || fields.n_fields < 14) {
                 g_warning ("Invalid NMEA GGA sentence.");
-                return NULL;
+                return FALSE;
         }
 
-        if (g_ascii_strtoll (parts[6], NULL, 10) == 0) {
+        if (!gclue_nmea_fields_get_uint (&fields, 6, &quality) ||
+            quality == 0) {
                 /* No fix, ignore. */
-                return NULL;
+                return FALSE;
         }
 
         /* For syntax of GGA sentences:
          * http://www.gpsinformation.org/dale/nmea.htm#GGA
          */
-        timestamp = parse_nmea_timestamp (parts[1]);
-        latitude = parse_coordinate_string (parts[2], parts[3]);
-        longitude = parse_coordinate_string (parts[4], parts[5]);
-        if (latitude == INVALID_COORDINATE || longitude == INVALID_COORDINATE) {
+        latitude = parse_coordinate_field (&fields, 2);
+        longitude = parse_coordinate_field (&fields, 4);
+        if (latitude == INVALID_COORDINATE ||
+            longitude == INVALID_COORDINATE ||
+            !coordinates_are_valid (latitude, longitude)) {
                 g_warning ("Invalid coordinate on NMEA GGA sentence.");
-                return NULL;
+                return FALSE;
         }
 
-        altitude = parse_altitude_string (parts[9], parts[10]);
-
-        hdop = g_ascii_strtod (parts[8], NULL);
-        accuracy = get_accuracy_from_hdop (hdop);
-
-        location = g_object_new (GCLUE_TYPE_LOCATION,
-                                 "latitude", latitude,
-                                 "longitude", longitude,
-                                 "accuracy", accuracy,
-                                 "timestamp", timestamp,
-                                 "description", "GPS GGA",
-                                 NULL);
-        if (altitude != GCLUE_LOCATION_ALTITUDE_UNKNOWN)
-                g_object_set (location, "altitude", altitude, NULL);
+        if (errors->accuracy != GCLUE_LOCATION_ACCURACY_UNKNOWN)
+                accuracy = errors->accuracy;
+        else if (gclue_nmea_fields_get_double (&fields, 8, &hdop))
+                accuracy = hdop * NMEA_UERE;
+        else
+                accuracy = NMEA_DEFAULT_ACCURACY;
+
+        gclue_location_data_init (data);
+        data->latitude = latitude;
+        data->longitude = longitude;
+        data->accuracy = accuracy;
+        data->timestamp = parse_nmea_timestamp (&fields, 1, reference);
+        data->description = "GPS GGA";
+
+        if (!errors->no_altitude) {
+                data->altitude = parse_altitude_field (&fields, 9);
+                if (data->altitude != GCLUE_LOCATION_ALTITUDE_UNKNOWN)
+                        data->altitude_accuracy = errors->altitude_accuracy;
+        }
 
-        return location;
+        return TRUE;
 }
 
-static GClueLocation *
-gclue_location_create_from_rmc (const char     *rmc,
-                                GClueLocation  *prev_location)
+static gboolean
+location_data_from_rmc (const char              *rmc,
+                        const GClueLocationData *prev_location,
+                        gint64                   reference,
+                        const NMEAFixErrors     *errors,
+                        GClueLocationData       *data)
 {
-        GClueLocation *location;
-        g_auto(GStrv) parts = NULL;
+        GClueNMEAFields fields;
+        gsize status_len;
         gdouble accuracy;
         gdouble altitude;
 
-        parts = g_strsplit (rmc, ",", -1);
-        if (g_strv_length (parts) < 13) {
+        if (!gclue_nmea_fields_parse (&fields, rmc) || fields.n_fields < 13) {
                 g_warning ("Invalid NMEA RMC sentence.");
-                return NULL;
+                return FALSE;
         }
 
         /* RMC sentence is invalid */
-        if (g_strcmp0 (parts[2], "A") != 0) {
-                return NULL;
+        gclue_nmea_fields_get (&fields, 2, &status_len);
+        if (status_len != 1 || gclue_nmea_fields_get_char (&fields, 2) != 'A') {
+                return FALSE;
         }
 
-        guint64 timestamp = parse_nmea_timestamp (parts[1]);
-        gdouble lat = parse_coordinate_string (parts[3], parts[4]);
-        gdouble lon = parse_coordinate_string (parts[5], parts[6]);
+        guint64 timestamp = parse_nmea_timestamp (&fields, 1, reference);
+        gdouble lat = parse_coordinate_field (&fields, 3);
+        gdouble lon = parse_coordinate_field (&fields, 5);
 
-        if (lat == INVALID_COORDINATE || lon == INVALID_COORDINATE) {
+        if (lat == INVALID_COORDINATE ||
+            lon == INVALID_COORDINATE ||
+            !coordinates_are_valid (lat, lon)) {
                 g_warning ("Invalid coordinate on NMEA RMC sentence.");
-                return NULL;
+                return FALSE;
         }
 
-        gdouble speed = GCLUE_LOCATION_SPEED_UNKNOWN;
-        if (parts[7][0] != '\0')
-                speed = g_ascii_strtod (parts[7], NULL) * KNOTS_IN_METERS_PER_SECOND;
+        gdouble speed;
+        if (gclue_nmea_fields_get_double (&fields, 7, &speed))
+                speed *= KNOTS_IN_METERS_PER_SECOND;
+        else
+                speed = GCLUE_LOCATION_SPEED_UNKNOWN;
 
-        gdouble heading = GCLUE_LOCATION_HEADING_UNKNOWN;
-        if (parts[8][0] != '\0')
-                heading = g_ascii_strtod (parts[8], NULL);
+        gdouble heading;
+        if (!gclue_nmea_fields_get_double (&fields, 8, &heading))
+                heading = GCLUE_LOCATION_HEADING_UNKNOWN;
 
         /* Some receivers use '0.0,0.0' as invalid speed and heading */
         if (speed == 0.0 && heading == 0.0) {
@@ -684,35 +1044,181 @@ gclue_location_create_from_rmc (const char     *rmc,
                 heading = GCLUE_LOCATION_HEADING_UNKNOWN;
         }
 
-        accuracy = RMC_DEFAULT_ACCURACY;
+        accuracy = NMEA_DEFAULT_ACCURACY;
         altitude = GCLUE_LOCATION_ALTITUDE_UNKNOWN;
         if (prev_location != NULL) {
-                guint64 prev_loc_timestamp;
-
-                prev_loc_timestamp = gclue_location_get_timestamp (prev_location);
+                guint64 prev_loc_timestamp = prev_location->timestamp;
 
                 /* Sentence is older then previous location, reject */
                 if (timestamp < prev_loc_timestamp)
-                        return NULL;
+                        return FALSE;
 
                 if (timestamp - prev_loc_timestamp < RMC_TIME_DIFF_THRESHOLD) {
-                        accuracy = gclue_location_get_accuracy (prev_location);
-                        altitude = gclue_location_get_altitude (prev_location);
+                        accuracy = prev_location->accuracy;
+                        altitude = prev_location->altitude;
                 }
         }
 
-        location = g_object_new (GCLUE_TYPE_LOCATION,
-                                 "latitude", lat,
-                                 "longitude", lon,
-                                 "timestamp", timestamp,
-                                 "speed", speed,
-                                 "heading", heading,
-                                 "description", "GPS RMC",
-                                 "accuracy", accuracy,
-                                 "altitude", altitude,
-                                 NULL);
+        if (errors->accuracy != GCLUE_LOCATION_ACCURACY_UNKNOWN)
+                accuracy = errors->accuracy;
 
-        return location;
+        gclue_location_data_init (data);
+        data->latitude = lat;
+        data->longitude = lon;
+        data->timestamp = timestamp;
+        data->speed = speed;
+        data->heading = heading;
+        data->description = "GPS RMC";
+        data->accuracy = accuracy;
+        data->altitude = altitude;
+
+        return TRUE;
+}
+
+/* Takes the speed and heading of @data from a VTG sentence */
+static void
+nmea_apply_vtg (GClueLocationData *data,
+                const char        *vtg)
+{
+        GClueNMEAFields fields;
+        gdouble speed, heading;
+
+        if (!gclue_nmea_fields_parse (&fields, vtg) || fields.n_fields < 9) {
+                g_warning ("Invalid NMEA VTG sentence.");
+                return;
+        }
+
+        /* NMEA 2.3 added the mode indicator, N being no fix */
+        if (gclue_nmea_fields_get_char (&fields, 9) == 'N')
+                return;
+
+        /* Speed over ground in km/h and true course */
+        if (gclue_nmea_fields_get_double (&fields, 7, &speed))
+                data->speed = speed / 3.6;
+        if (gclue_nmea_fields_get_double (&fields, 1, &heading))
+                data->heading = heading;
+}
+
+/* The time of the GGA or RMC sentence @msg, for matching it with others */
+static GTimeSpan
+nmea_sentence_time (const char *msg)
+{
+        GClueNMEAFields fields;
+
+        if (msg == NULL || !gclue_nmea_fields_parse (&fields, msg))
+                return -1;
+
+        return gclue_nmea_fields_get_timespan (&fields, 1);
+}
+
+/**
+ * gclue_location_data_from_nmeas:
+ * @nmeas: A NULL terminated array NMEA sentence strings
+ * @prev_location: (nullable): Previous location provided from the location
+ * source
+ * @data: (out): the location
+ *
+ * Like gclue_location_create_from_nmeas() but fills in @data instead of
+ * creating an object. The description of @data is a static string.
+ *
+ * Returns: %TRUE if GGA or RMC sentences are found, %FALSE on all other
+ * cases and errors.
+ **/
+gboolean
+gclue_location_data_from_nmeas (const char              *nmeas[],
+                                const GClueLocationData *prev_location,
+                                GClueLocationData       *data)
+{
+        return gclue_location_data_from_nmeas_at (nmeas,
+                                                  prev_location,
+                                                  0,
+                                                  data);
+}
+
+/**
+ * gclue_location_data_from_nmeas_at:
+ * @nmeas: A NULL terminated array NMEA sentence strings
+ * @prev_location: (nullable): Previous location provided from the location
+ * source
+ * @reference: the time the sentences are from, give or take half a day, in
+ * microseconds since the Epoch. 0 for the current time.
+ * @data: (out): the location
+ *
+ * Like gclue_location_data_from_nmeas(), for sentences that weren't just
+ * received, e.g. from a recording. NMEA sentences only have the time of
+ * day, @reference tells which day it is.
+ *
+ * Returns: %TRUE if GGA or RMC sentences are found, %FALSE on all other
+ * cases and errors.
+ **/
+gboolean
+gclue_location_data_from_nmeas_at (const char              *nmeas[],
+                                   const GClueLocationData *prev_location,
+                                   gint64                   reference,
+                                   GClueLocationData       *data)
+{
+        GClueLocationData rmc_data;
+        gboolean have_gga = FALSE, have_rmc = FALSE;
+        const char *gga = NULL, *rmc = NULL, *gst = NULL, *vtg = NULL;
+        const char **iter;
+        NMEAFixErrors errors;
+        GTimeSpan epoch;
+
+        for (iter = nmeas; *iter != NULL; iter++) {
+                if (!gga && gclue_nmea_type_is (*iter, "GGA"))
+                        gga = *iter;
+                else if (!rmc && gclue_nmea_type_is (*iter, "RMC"))
+                        rmc = *iter;
+                else if (!gst && gclue_nmea_type_is (*iter, "GST"))
+                        gst = *iter;
+                else if (!vtg && gclue_nmea_type_is (*iter, "VTG"))
+                        vtg = *iter;
+        }
+
+        epoch = nmea_sentence_time (gga != NULL ? gga : rmc);
+
+        nmea_fix_errors_init (&errors);
+        if (gst)
+                nmea_fix_errors_add_gst (&errors, gst, epoch);
+        for (iter = nmeas; *iter != NULL; iter++) {
+                if (gclue_nmea_type_is (*iter, "GSA"))
+                        nmea_fix_errors_add_gsa (&errors, *iter);
+        }
+
+        if (gga)
+                have_gga = location_data_from_gga (gga,
+                                                   reference,
+                                                   &errors,
+                                                   data);
+        if (rmc)
+                have_rmc = location_data_from_rmc (rmc,
+                                                   prev_location,
+                                                   reference,
+                                                   &errors,
+                                                   &rmc_data);
+
+        if (have_gga && have_rmc) {
+                data->speed = rmc_data.speed;
+                data->heading = rmc_data.heading;
+                data->description = "GPS GGA+RMC";
+
+                return TRUE;
+        }
+        if (have_gga) {
+                /* Without RMC, VTG is where speed and heading come from */
+                if (vtg)
+                        nmea_apply_vtg (data, vtg);
+
+                return TRUE;
+        }
+        if (have_rmc) {
+                *data = rmc_data;
+
+                return TRUE;
+        }
+
+        g_debug ("Valid NMEA GGA or RMC sentence not found");
+        return FALSE;
 }
 
 /**
@@ -721,7 +1227,8 @@ gclue_location_create_from_rmc (const char     *rmc,
  * @prev_location: Previous location provided from the location source
  *
  * Creates a new #GClueLocation object by combining data from multiple NMEA
- * sentences.
+ * sentences of the same epoch. The accuracy comes from GST sentences if
+ * there are any, otherwise from the DOPs of GSA or GGA sentences.
  *
  * Returns: a new #GClueLocation object if GGA or RMC sentences are found,
  * a %NULL on all other cases and errors. Unref using #g_object_unref() when
@@ -731,37 +1238,16 @@ GClueLocation *
 gclue_location_create_from_nmeas (const char     *nmeas[],
                                   GClueLocation  *prev_location)
 {
-        GClueLocation *gga_loc = NULL;
-        GClueLocation *rmc_loc = NULL;
-        const char **iter;
-
-        for (iter = nmeas; *iter != NULL; iter++) {
-                if (!gga_loc && gclue_nmea_type_is (*iter, "GGA"))
-                        gga_loc = gclue_location_create_from_gga (*iter);
-                if (!rmc_loc && gclue_nmea_type_is (*iter, "RMC"))
-                        rmc_loc = gclue_location_create_from_rmc
-                                (*iter, prev_location);
-                if (gga_loc && rmc_loc)
-                    break;
-        }
-
-        if (gga_loc && rmc_loc) {
-                gclue_location_set_speed
-                        (gga_loc, gclue_location_get_speed(rmc_loc));
-                gclue_location_set_heading
-                        (gga_loc, gclue_location_get_heading(rmc_loc));
-                g_object_set (gga_loc, "description", "GPS GGA+RMC", NULL);
-                g_object_unref (rmc_loc);
+        GClueLocationData data;
 
-                return gga_loc;
-        }
-        if (gga_loc)
-                return gga_loc;
-        if (rmc_loc)
-                return rmc_loc;
+        if (!gclue_location_data_from_nmeas
+                        (nmeas,
+                         prev_location != NULL ?
+                         gclue_location_peek_data (prev_location) : NULL,
+                         &data))
+                return NULL;
 
-        g_debug ("Valid NMEA GGA or RMC sentence not found");
-        return NULL;
+        return gclue_location_new_from_data (&data);
 }
 
 /**
@@ -777,42 +1263,26 @@ gclue_location_duplicate (GClueLocation *location)
 {
         g_return_val_if_fail (GCLUE_IS_LOCATION (location), NULL);
 
-        return g_object_new
-                (GCLUE_TYPE_LOCATION,
-                 "latitude", location->priv->latitude,
-                 "longitude", location->priv->longitude,
-                 "accuracy", location->priv->accuracy,
-                 "altitude", location->priv->altitude,
-                 "timestamp", location->priv->timestamp,
-                 "speed", location->priv->speed,
-                 "heading", location->priv->heading,
-                 "description", location->priv->description,
-                 NULL);
+        return gclue_location_new_from_data (&location->priv->data);
 }
 
 /**
  * gclue_location_duplicate_fresh:
  * @location: the #GClueLocation instance to duplicate.
+ * @data: (out caller-allocates): the copy
  *
- * Creates a new copy of @location object with a refreshed timestamp.
- *
- * Returns: a new #GClueLocation object. Use g_object_unref() when done.
+ * Copies the data of @location into @data with a refreshed timestamp,
+ * without allocating a new #GClueLocation. The description in @data
+ * belongs to @location.
  **/
-GClueLocation *
-gclue_location_duplicate_fresh (GClueLocation *location)
+void
+gclue_location_duplicate_fresh (GClueLocation     *location,
+                                GClueLocationData *data)
 {
-        g_return_val_if_fail (GCLUE_IS_LOCATION (location), NULL);
+        g_return_if_fail (GCLUE_IS_LOCATION (location));
 
-        return g_object_new
-                (GCLUE_TYPE_LOCATION,
-                 "latitude", location->priv->latitude,
-                 "longitude", location->priv->longitude,
-                 "accuracy", location->priv->accuracy,
-                 "altitude", location->priv->altitude,
-                 "speed", location->priv->speed,
-                 "heading", location->priv->heading,
-                 "description", location->priv->description,
-                 NULL);
+        *data = location->priv->data;
+        data->timestamp = gclue_clock_get_real_time ();
 }
 
 const char *
@@ -836,7 +1306,7 @@ gclue_location_get_latitude (GClueLocation *loc)
 {
         g_return_val_if_fail (GCLUE_IS_LOCATION (loc), 0.0);
 
-        return loc->priv->latitude;
+        return loc->priv->data.latitude;
 }
 
 /**
@@ -852,7 +1322,7 @@ gclue_location_get_longitude (GClueLocation *loc)
 {
         g_return_val_if_fail (GCLUE_IS_LOCATION (loc), 0.0);
 
-        return loc->priv->longitude;
+        return loc->priv->data.longitude;
 }
 
 /**
@@ -869,7 +1339,7 @@ gclue_location_get_altitude (GClueLocation *loc)
         g_return_val_if_fail (GCLUE_IS_LOCATION (loc),
                               GCLUE_LOCATION_ALTITUDE_UNKNOWN);
 
-        return loc->priv->altitude;
+        return loc->priv->data.altitude;
 }
 
 /**
@@ -886,7 +1356,7 @@ gclue_location_get_accuracy (GClueLocation *loc)
         g_return_val_if_fail (GCLUE_IS_LOCATION (loc),
                               GCLUE_LOCATION_ACCURACY_UNKNOWN);
 
-        return loc->priv->accuracy;
+        return loc->priv->data.accuracy;
 }
 
 /**
@@ -903,81 +1373,123 @@ gclue_location_get_timestamp (GClueLocation *loc)
 {
         g_return_val_if_fail (GCLUE_IS_LOCATION (loc), 0);
 
-        return loc->priv->timestamp;
+        return loc->priv->data.timestamp / G_USEC_PER_SEC;
 }
 
 /**
- * gclue_location_get_speed:
- * @location: a #GClueLocation
+ * gclue_location_get_timestamp_usec:
+ * @loc: a #GClueLocation
  *
- * Gets the speed in meters per second.
+ * Gets the timestamp (in microseconds since the Epoch) of location @loc.
+ * See #GClueLocation:timestamp-usec.
  *
- * Returns: The speed, or %GCLUE_LOCATION_SPEED_UNKNOWN if speed in unknown.
+ * Returns: The timestamp of location @loc.
  **/
-gdouble
-gclue_location_get_speed (GClueLocation *location)
+guint64
+gclue_location_get_timestamp_usec (GClueLocation *loc)
 {
-        g_return_val_if_fail (GCLUE_IS_LOCATION (location),
-                              GCLUE_LOCATION_SPEED_UNKNOWN);
+        g_return_val_if_fail (GCLUE_IS_LOCATION (loc), 0);
 
-        return location->priv->speed;
+        return loc->priv->data.timestamp;
 }
 
 /**
- * gclue_location_set_speed:
- * @location: a #GClueLocation
- * @speed: speed in meters per second
+ * gclue_location_get_altitude_accuracy:
+ * @loc: a #GClueLocation
  *
- * Sets the speed.
+ * Gets the accuracy (in meters) of the altitude of location @loc.
+ *
+ * Returns: The altitude accuracy, or %GCLUE_LOCATION_ACCURACY_UNKNOWN.
  **/
-void
-gclue_location_set_speed (GClueLocation *location,
-                          gdouble        speed)
+gdouble
+gclue_location_get_altitude_accuracy (GClueLocation *loc)
 {
-        location->priv->speed = speed;
+        g_return_val_if_fail (GCLUE_IS_LOCATION (loc),
+                              GCLUE_LOCATION_ACCURACY_UNKNOWN);
 
-        g_object_notify (G_OBJECT (location), "speed");
+        return loc->priv->data.altitude_accuracy;
 }
 
 /**
- * gclue_location_set_speed_from_prev_location:
- * @location: a #GClueLocation
- * @prev_location: a #GClueLocation
+ * gclue_location_get_speed_accuracy:
+ * @loc: a #GClueLocation
+ *
+ * Gets the accuracy (in meters per second) of the speed of location @loc.
  *
- * Calculates the speed based on provided previous location @prev_location
- * and sets it on @location.
+ * Returns: The speed accuracy, or %GCLUE_LOCATION_ACCURACY_UNKNOWN.
  **/
-void
-gclue_location_set_speed_from_prev_location (GClueLocation *location,
-                                             GClueLocation *prev_location)
+gdouble
+gclue_location_get_speed_accuracy (GClueLocation *loc)
 {
-        gdouble speed;
-        guint64 timestamp, prev_timestamp;
+        g_return_val_if_fail (GCLUE_IS_LOCATION (loc),
+                              GCLUE_LOCATION_ACCURACY_UNKNOWN);
 
-        g_return_if_fail (GCLUE_IS_LOCATION (location));
-        g_return_if_fail (prev_location == NULL ||
-                          GCLUE_IS_LOCATION (prev_location));
+        return loc->priv->data.speed_accuracy;
+}
 
-        if (prev_location == NULL) {
-               speed = GCLUE_LOCATION_SPEED_UNKNOWN;
+/**
+ * gclue_location_get_heading_accuracy:
+ * @loc: a #GClueLocation
+ *
+ * Gets the accuracy (in degrees) of the heading of location @loc.
+ *
+ * Returns: The heading accuracy, or %GCLUE_LOCATION_ACCURACY_UNKNOWN.
+ **/
+gdouble
+gclue_location_get_heading_accuracy (GClueLocation *loc)
+{
+        g_return_val_if_fail (GCLUE_IS_LOCATION (loc),
+                              GCLUE_LOCATION_ACCURACY_UNKNOWN);
 
-               goto out;
-        }
+        return loc->priv->data.heading_accuracy;
+}
 
-        timestamp = gclue_location_get_timestamp (location);
-        prev_timestamp = gclue_location_get_timestamp (prev_location);
+/**
+ * gclue_location_get_climb:
+ * @loc: a #GClueLocation
+ *
+ * Gets the vertical speed in meters per second, positive when going up.
+ *
+ * Returns: The climb, or %GCLUE_LOCATION_CLIMB_UNKNOWN.
+ **/
+gdouble
+gclue_location_get_climb (GClueLocation *loc)
+{
+        g_return_val_if_fail (GCLUE_IS_LOCATION (loc),
+                              GCLUE_LOCATION_CLIMB_UNKNOWN);
 
-        if (timestamp <= prev_timestamp) {
-               speed = GCLUE_LOCATION_SPEED_UNKNOWN;
+        return loc->priv->data.climb;
+}
 
-               goto out;
-        }
+/**
+ * gclue_location_get_speed:
+ * @location: a #GClueLocation
+ *
+ * Gets the speed in meters per second.
+ *
+ * Returns: The speed, or %GCLUE_LOCATION_SPEED_UNKNOWN if speed in unknown.
+ **/
+gdouble
+gclue_location_get_speed (GClueLocation *location)
+{
+        g_return_val_if_fail (GCLUE_IS_LOCATION (location),
+                              GCLUE_LOCATION_SPEED_UNKNOWN);
 
-        speed = gclue_location_get_distance_from (location, prev_location) /
-                (timestamp - prev_timestamp);
+        return location->priv->data.speed;
+}
 
-out:
-        location->priv->speed = speed;
+/**
+ * gclue_location_set_speed:
+ * @location: a #GClueLocation
+ * @speed: speed in meters per second
+ *
+ * Sets the speed.
+ **/
+void
+gclue_location_set_speed (GClueLocation *location,
+                          gdouble        speed)
+{
+        location->priv->data.speed = speed;
 
         g_object_notify (G_OBJECT (location), "speed");
 }
@@ -998,7 +1510,7 @@ gclue_location_get_heading (GClueLocation *location)
         g_return_val_if_fail (GCLUE_IS_LOCATION (location),
                               GCLUE_LOCATION_HEADING_UNKNOWN);
 
-        return location->priv->heading;
+        return location->priv->data.heading;
 }
 
 /**
@@ -1012,78 +1524,46 @@ void
 gclue_location_set_heading (GClueLocation *location,
                             gdouble        heading)
 {
-        location->priv->heading = heading;
+        location->priv->data.heading = heading;
 
         g_object_notify (G_OBJECT (location), "heading");
 }
 
 /**
- * gclue_location_set_heading_from_prev_location:
- * @location: a #GClueLocation
- * @prev_location: a #GClueLocation
+ * gclue_location_data_get_bearing_from:
+ * @from: a #GClueLocationData
+ * @to: a #GClueLocationData
+ *
+ * Calculates the direction from @from to @to in degrees, clockwise from
+ * North. Like gclue_location_data_get_distance_from(), fixes of
+ * %GCLUE_LOCATION_ACCURACY_EXACT level are taken on the WGS-84 ellipsoid,
+ * others on a sphere.
  *
- * Calculates the heading direction in degrees with respect to North direction
- * based on provided @prev_location and sets it on @location.
+ * Returns: The bearing, or %GCLUE_LOCATION_HEADING_UNKNOWN if @from and @to
+ *          are the same.
  **/
-void
-gclue_location_set_heading_from_prev_location (GClueLocation *location,
-                                               GClueLocation *prev_location)
+gdouble
+gclue_location_data_get_bearing_from (const GClueLocationData *from,
+                                      const GClueLocationData *to)
 {
-        gdouble dlat, dlon, x, y, angle, lat, lon, prev_lat, prev_lon;
-
-        g_return_if_fail (GCLUE_IS_LOCATION (location));
-        g_return_if_fail (prev_location == NULL ||
-                          GCLUE_IS_LOCATION (prev_location));
-
-        if (prev_location == NULL) {
-               location->priv->heading = GCLUE_LOCATION_HEADING_UNKNOWN;
-
-               return;
-        }
-
-        lat = gclue_location_get_latitude (location);
-        lon = gclue_location_get_longitude (location);
-        prev_lat = gclue_location_get_latitude (prev_location);
-        prev_lon = gclue_location_get_longitude (prev_location);
-
-        if (lat == prev_lat && lon == prev_lon) {
-               location->priv->heading = GCLUE_LOCATION_HEADING_UNKNOWN;
-
-               return;
-        }
-
-        /* atan2(y, x) is a function which takes in coordinate values of
-         * a 2D point and returns the angle of line from origin to that
-         * coordinate makes with the positive X-axis, in the range (-PI,+PI].
-         *
-         * We want to match the inclusive end (+PI) of atan2's range to our
-         * desired zero direction (north), so we take the vector pointing
-         * south as our X-axis and the vector pointing east as our Y-axis
-         * and measure our movement vector coordinates */
-        dlon = (lon - prev_lon);
-        dlat = (lat - prev_lat);
-        /* in that basis.
-         *
-         * Latitudes decrease towards the south and longitudes
-         * increase towards the east, so: */
-        x = -dlat;
-        y = dlon;
-        angle = atan2(y, x) * 180.0 / M_PI;
-        /* We now have the angle of our movement vector measured from the
-         * vector pointing south in degrees, with the positive direction
-         * being counterclockwise.
-         *
-         * We want to convert it to heading: Degrees from from north with
-         * positive values only and positive direction being clockwise.
-         *
-         * If angle is positive (the movement is more towards east than
-         * west), we need to subtract it from the heading of our reference
-         * vector (south == 180 deg). If the angle is negative, we need to
-         * add its negative to the heading of the reference vector. Both
-         * cases result in */
-        location->priv->heading = 180.0 - angle;
-
-        g_object_notify (G_OBJECT (location), "heading");
+        gdouble bearing;
+
+        if (!use_ellipsoid (from, to) ||
+            !gclue_geodesy_ellipsoid_inverse (from->latitude,
+                                              from->longitude,
+                                              to->latitude,
+                                              to->longitude,
+                                              NULL,
+                                              &bearing))
+                bearing = gclue_geodesy_sphere_bearing (from->latitude,
+                                                        from->longitude,
+                                                        to->latitude,
+                                                        to->longitude);
+
+        if (isnan (bearing))
+                return GCLUE_LOCATION_HEADING_UNKNOWN;
+
+        return bearing;
 }
 
 /**
@@ -1101,22 +1581,151 @@ double
 gclue_location_get_distance_from (GClueLocation *loca,
                                   GClueLocation *locb)
 {
-        gdouble dlat, dlon, lat1, lat2;
-        gdouble a, c;
-
         g_return_val_if_fail (GCLUE_IS_LOCATION (loca), 0.0);
         g_return_val_if_fail (GCLUE_IS_LOCATION (locb), 0.0);
 
-        /* Algorithm from:
-         * http://www.movable-type.co.uk/scripts/latlong.html */
+        return gclue_location_data_get_distance_from (&loca->priv->data,
+                                                      &locb->priv->data);
+}
+
+/**
+ * gclue_location_data_get_distance_from:
+ * @loca: a #GClueLocationData
+ * @locb: a #GClueLocationData
+ *
+ * Like gclue_location_get_distance_from(), for #GClueLocationData. Fixes
+ * of %GCLUE_LOCATION_ACCURACY_EXACT level are measured on the WGS-84
+ * ellipsoid, others on a sphere.
+ *
+ * Returns: a distance in meters.
+ **/
+double
+gclue_location_data_get_distance_from (const GClueLocationData *loca,
+                                       const GClueLocationData *locb)
+{
+        gdouble latitude, longitude, cos_latitude;
+        gdouble distance;
+        GClueLocationPoints points = {
+                .n_points = 1,
+                .latitude = &latitude,
+                .longitude = &longitude,
+                .cos_latitude = &cos_latitude,
+        };
+
+        if (use_ellipsoid (loca, locb) &&
+            gclue_geodesy_ellipsoid_inverse (loca->latitude,
+                                             loca->longitude,
+                                             locb->latitude,
+                                             locb->longitude,
+                                             &distance,
+                                             NULL))
+                return distance;
+
+        gclue_location_points_set (&points,
+                                   0,
+                                   loca->latitude,
+                                   loca->longitude);
+        gclue_location_data_get_distances (locb, &points, &distance);
+
+        return distance;
+}
+
+/**
+ * gclue_location_points_set:
+ * @points: a #GClueLocationPoints
+ * @index: the index of the point to set, below @points.n_points
+ * @latitude: the latitude of the point in degrees
+ * @longitude: the longitude of the point in degrees
+ *
+ * Sets a point of @points, along with the cosine of its latitude.
+ **/
+void
+gclue_location_points_set (GClueLocationPoints *points,
+                           guint                index,
+                           gdouble              latitude,
+                           gdouble              longitude)
+{
+        g_return_if_fail (index < points->n_points);
+
+        points->latitude[index] = latitude * M_PI / 180.0;
+        points->longitude[index] = longitude * M_PI / 180.0;
+        points->cos_latitude[index] = cos (points->latitude[index]);
+}
+
+/* The haversine formula, from:
+ * http://www.movable-type.co.uk/scripts/latlong.html
+ * In radians of arc.
+ */
+static inline gdouble
+haversine (gdouble dlat,
+           gdouble dlon,
+           gdouble cos_lat1,
+           gdouble cos_lat2)
+{
+        gdouble sin_dlat = sin (dlat / 2);
+        gdouble sin_dlon = sin (dlon / 2);
+        gdouble a;
 
-        dlat = (locb->priv->latitude - loca->priv->latitude) * M_PI / 180.0;
-        dlon = (locb->priv->longitude - loca->priv->longitude) * M_PI / 180.0;
-        lat1 = loca->priv->latitude * M_PI / 180.0;
-        lat2 = locb->priv->latitude * M_PI / 180.0;
+        a = sin_dlat * sin_dlat + sin_dlon * sin_dlon * cos_lat1 * cos_lat2;
 
-        a = sin (dlat / 2) * sin (dlat / 2) +
-            sin (dlon / 2) * sin (dlon / 2) * cos (lat1) * cos (lat2);
-        c = 2 * atan2 (sqrt (a), sqrt (1-a));
-        return 1000.0 * EARTH_RADIUS_KM * c;
+        return 2 * atan2 (sqrt (a), sqrt (1 - a));
+}
+
+/**
+ * gclue_location_data_get_distances:
+ * @location: a #GClueLocationData
+ * @points: the points to measure the distance of @location from
+ * @distances: (out caller-allocates): room for @points.n_points distances
+ *
+ * Calculates the distance in meters of @location from each of @points,
+ * like gclue_location_data_get_distance_from() does, but without redoing
+ * the trigonometry of @location for each of them.
+ **/
+void
+gclue_location_data_get_distances (const GClueLocationData   *location,
+                                   const GClueLocationPoints *points,
+                                   gdouble                   *distances)
+{
+        const gdouble radius = 1000.0 * EARTH_RADIUS_KM;
+        gdouble latitude, longitude, cos_latitude;
+        guint i;
+
+        latitude = location->latitude * M_PI / 180.0;
+        longitude = location->longitude * M_PI / 180.0;
+        cos_latitude = cos (latitude);
+
+        /* Plain loops over plain arrays, so that the compiler can vectorize
+         * them. The first one is the equirectangular approximation, good
+         * for the few meters between the fixes of a slow moving device.
+         * Closer to the poles, a short distance can span a wide range of
+         * longitudes and it falls apart, so the second one redoes those
+         * with the haversine formula too.
+         */
+        for (i = 0; i < points->n_points; i++) {
+                gdouble dlat = points->latitude[i] - latitude;
+                gdouble dlon = points->longitude[i] - longitude;
+                gdouble x, y;
+
+                if (dlon > M_PI)
+                        dlon -= 2 * M_PI;
+                else if (dlon < -M_PI)
+                        dlon += 2 * M_PI;
+
+                x = dlon * (points->cos_latitude[i] + cos_latitude) / 2;
+                y = dlat;
+                distances[i] = radius * sqrt (x * x + y * y);
+        }
+
+        for (i = 0; i < points->n_points; i++) {
+                if (distances[i] < FLAT_EARTH_DISTANCE &&
+                    points->cos_latitude[i] >= FLAT_EARTH_MIN_COS_LATITUDE &&
+                    cos_latitude >= FLAT_EARTH_MIN_COS_LATITUDE)
+                        continue;
+
+                distances[i] = radius *
+                               haversine (points->latitude[i] - latitude,
+                                          points->longitude[i] - longitude,
+                                          points->cos_latitude[i],
+                                          cos_latitude);
+        }
 }
@@ -143,6 +143,96 @@ GType gclue_location_get_type (void);
  */
 #define GCLUE_LOCATION_SPEED_UNKNOWN -1.0
 
+/**
+ * GCLUE_LOCATION_CLIMB_UNKNOWN:
+ *
+ * Constant representing unknown climb.
+ */
+#define GCLUE_LOCATION_CLIMB_UNKNOWN -G_MAXDOUBLE
+
+/**
+ * GClueLocationData:
+ * @latitude: the latitude in degrees
+ * @longitude: the longitude in degrees
+ * @accuracy: the accuracy in meters
+ * @altitude: the altitude in meters
+ * @altitude_accuracy: the accuracy of @altitude in meters
+ * @speed: the speed in meters per second
+ * @speed_accuracy: the accuracy of @speed in meters per second
+ * @heading: the heading in degrees
+ * @heading_accuracy: the accuracy of @heading in degrees
+ * @climb: the vertical speed in meters per second
+ * @timestamp: microseconds since the Epoch
+ * @description: a description, not owned by the struct
+ *
+ * The values of a #GClueLocation, as a plain struct that can be copied
+ * around. Fixes are passed along this way from the sources to the clients,
+ * #GClueLocation objects are only made where one is asked for.
+ *
+ * The @description must outlive the struct, sources usually give a string
+ * literal.
+ */
+typedef struct {
+        gdouble     latitude;
+        gdouble     longitude;
+        gdouble     accuracy;
+        gdouble     altitude;
+        gdouble     altitude_accuracy;
+        gdouble     speed;
+        gdouble     speed_accuracy;
+        gdouble     heading;
+        gdouble     heading_accuracy;
+        gdouble     climb;
+        guint64     timestamp;
+        const char *description;
+} GClueLocationData;
+
+void gclue_location_data_init     (GClueLocationData *data);
+
+gboolean gclue_location_data_from_nmeas
+                                  (const char              *nmeas[],
+                                   const GClueLocationData *prev_location,
+                                   GClueLocationData       *data);
+gboolean gclue_location_data_from_nmeas_at
+                                  (const char              *nmeas[],
+                                   const GClueLocationData *prev_location,
+                                   gint64                   reference,
+                                   GClueLocationData       *data);
+
+gdouble gclue_location_data_get_bearing_from
+                                  (const GClueLocationData *from,
+                                   const GClueLocationData *to);
+double gclue_location_data_get_distance_from
+                                  (const GClueLocationData *loca,
+                                   const GClueLocationData *locb);
+
+/**
+ * GClueLocationPoints:
+ * @n_points: the number of points
+ * @latitude: the latitudes of the points, in radians
+ * @longitude: the longitudes of the points, in radians
+ * @cos_latitude: the cosines of @latitude
+ *
+ * Points to measure the distance of a location from in one go, see
+ * gclue_location_data_get_distances(). The arrays belong to the caller,
+ * gclue_location_points_set() fills them in.
+ */
+typedef struct {
+        guint    n_points;
+        gdouble *latitude;
+        gdouble *longitude;
+        gdouble *cos_latitude;
+} GClueLocationPoints;
+
+void gclue_location_points_set    (GClueLocationPoints     *points,
+                                   guint                    index,
+                                   gdouble                  latitude,
+                                   gdouble                  longitude);
+void gclue_location_data_get_distances
+                                  (const GClueLocationData   *location,
+                                   const GClueLocationPoints *points,
+                                   gdouble                   *distances);
+
 GClueLocation *gclue_location_new (gdouble latitude,
                                    gdouble longitude,
                                    gdouble accuracy,
@@ -155,17 +245,27 @@ GClueLocation *gclue_location_new_full
                                    gdouble     speed,
                                    gdouble     heading,
                                    gdouble     altitude,
+                                   gdouble     altitude_accuracy,
+                                   gdouble     speed_accuracy,
+                                   gdouble     heading_accuracy,
+                                   gdouble     climb,
                                    guint64     timestamp,
                                    const char *description);
 
+GClueLocation *gclue_location_new_from_data
+                                  (const GClueLocationData *data);
+const GClueLocationData *gclue_location_peek_data
+                                  (GClueLocation *location);
+
 GClueLocation *gclue_location_create_from_nmeas
                                   (const char     *nmeas[],
                                    GClueLocation  *prev_location);
 
 GClueLocation *gclue_location_duplicate
                                   (GClueLocation *location);
-GClueLocation *gclue_location_duplicate_fresh
-                                  (GClueLocation *location);
+void gclue_location_duplicate_fresh
+                                  (GClueLocation     *location,
+                                   GClueLocationData *data);
 
 void gclue_location_set_description
                                   (GClueLocation *loc,
@@ -183,23 +283,23 @@ gdouble gclue_location_get_accuracy
                                   (GClueLocation *loc);
 guint64 gclue_location_get_timestamp
                                   (GClueLocation *loc);
+guint64 gclue_location_get_timestamp_usec
+                                  (GClueLocation *loc);
+gdouble gclue_location_get_altitude_accuracy
+                                  (GClueLocation *loc);
+gdouble gclue_location_get_speed_accuracy
+                                  (GClueLocation *loc);
+gdouble gclue_location_get_heading_accuracy
+                                  (GClueLocation *loc);
+gdouble gclue_location_get_climb  (GClueLocation *loc);
 void gclue_location_set_speed     (GClueLocation *loc,
                                    gdouble        speed);
 
-void gclue_location_set_speed_from_prev_location
-                                  (GClueLocation *location,
-                                   GClueLocation *prev_location);
-
 gdouble gclue_location_get_speed  (GClueLocation *loc);
 
 void gclue_location_set_heading   (GClueLocation *loc,
                                    gdouble        heading);
 
-void gclue_location_set_heading_from_prev_location
-                                  (GClueLocation *location,
-                                   GClueLocation *prev_location);
-
-
 gdouble gclue_location_get_heading
                                   (GClueLocation *loc);
 double gclue_location_get_distance_from
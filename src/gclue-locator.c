@@ -51,6 +51,12 @@
 #if GCLUE_USE_GPSD_SOURCE
 #include "gclue-gpsd-source.h"
 #endif
+#if GCLUE_USE_UBX_SOURCE
+#include "gclue-ubx-source.h"
+#endif
+#if GCLUE_USE_REPLAY_SOURCE
+#include "gclue-replay-source.h"
+#endif
 
 /* This class is like a master location source that hides all individual
  * location sources from rest of the code
@@ -66,6 +72,9 @@ struct _GClueLocatorPrivate
         GList *sources;
         GList *active_sources;
 
+        /* The source our location comes from, one of sources */
+        GClueLocationSource *location_source;
+
         GClueAccuracyLevel accuracy_level;
         gboolean priority_source_lock;
         guint64 priority_source_lock_timestamp;
@@ -86,51 +95,51 @@ enum
 static GParamSpec *gParamSpecs[LAST_PROP];
 
 #define MAX_SPEED        500       /* Meters per second */
-#define MAX_LOCATION_AGE (30 * 60) /* Seconds. */
-#define MAX_PRIORITY_SOURCE_AGE         30        /* Seconds. */
+#define MAX_LOCATION_AGE (30 * 60 * G_USEC_PER_SEC) /* Microseconds. */
+#define MAX_PRIORITY_SOURCE_AGE (30 * G_USEC_PER_SEC) /* Microseconds. */
 #define PRIORITY_ACCURACY_THRESHOLD 20        /* Meters */
 
 static void
 set_location (GClueLocator  *locator,
               GClueLocationSource *source)
 {
-        GClueLocation *cur_location;
-        GClueLocation *location;
+        const GClueLocationData *cur_location;
+        const GClueLocationData *location;
         const char *src_name = NULL;
         gboolean update_priority_source = FALSE;
 
-        location = gclue_location_source_get_location (source);
+        location = gclue_location_source_get_location_data (source);
         src_name = G_OBJECT_TYPE_NAME (source);
 
-        if (gclue_location_get_accuracy (location) ==
-            GCLUE_LOCATION_ACCURACY_UNKNOWN) {
+        if (location->accuracy == GCLUE_LOCATION_ACCURACY_UNKNOWN) {
                 /* If we do not know the accuracy, discard the update */
                 g_debug ("Discarding %s location with unknown accuracy",
                          src_name);
                 return;
         }
 
-        cur_location = gclue_location_source_get_location
+        cur_location = gclue_location_source_get_location_data
                         (GCLUE_LOCATION_SOURCE (locator));
 
         if (cur_location != NULL) {
             guint64 cur_timestamp, new_timestamp;
             double dist, speed;
 
-            cur_timestamp = gclue_location_get_timestamp (cur_location);
-            new_timestamp = gclue_location_get_timestamp (location);
+            cur_timestamp = cur_location->timestamp;
+            new_timestamp = location->timestamp;
             if (new_timestamp < cur_timestamp) {
                     g_debug ("New %s location older than current, ignoring.",
                              src_name);
                     return;
             }
 
-            dist = gclue_location_get_distance_from (location, cur_location);
+            dist = gclue_location_data_get_distance_from (location,
+                                                          cur_location);
             if (new_timestamp > cur_timestamp) {
                 guint64 age = new_timestamp - cur_timestamp;
 
                 if (age < MAX_LOCATION_AGE) {
-                    speed = dist / age;
+                    speed = dist * G_USEC_PER_SEC / age;
                 } else {
                     /* The previous location is too old?
                      * Force the speed to be within the allowed range then.
@@ -142,7 +151,7 @@ set_location (GClueLocator  *locator,
             }
 
             update_priority_source = gclue_location_source_get_priority_source (source) &&
-                                     (gclue_location_get_accuracy (location) < PRIORITY_ACCURACY_THRESHOLD);
+                                     (location->accuracy < PRIORITY_ACCURACY_THRESHOLD);
 
             if (update_priority_source) {
                      if (!locator->priv->priority_source_lock)
@@ -157,18 +166,18 @@ set_location (GClueLocator  *locator,
 
             if (locator->priv->priority_source_lock &&
                 !gclue_location_source_get_priority_source (source)) {
-                     g_debug ("Priority Source Lock (age %lu) active, ignoring new %s location",
-                              new_timestamp - locator->priv->priority_source_lock_timestamp, src_name);
+                     g_debug ("Priority Source Lock (age %" G_GUINT64_FORMAT " s) active, ignoring new %s location",
+                              (new_timestamp - locator->priv->priority_source_lock_timestamp) / G_USEC_PER_SEC,
+                              src_name);
                      return;
             }
 
             if (update_priority_source) {
                      /* A priority source is updating, let it though */
                      g_debug ("Priority Source Lock Active");
-            } else if ((dist <= gclue_location_get_accuracy (location) ||
+            } else if ((dist <= location->accuracy ||
                        speed > MAX_SPEED) &&
-                       gclue_location_get_accuracy (location) >
-                       gclue_location_get_accuracy (cur_location)) {
+                       location->accuracy > cur_location->accuracy) {
                     /* We only take the new location if either the previous one
                      * lies outside its accuracy circle and was reachable with
                      * a reasonable speed, OR it is more or as accurate as
@@ -180,8 +189,17 @@ set_location (GClueLocator  *locator,
         }
 
         g_debug ("New location available from %s", src_name);
-        gclue_location_source_set_location (GCLUE_LOCATION_SOURCE (locator),
-                                            location);
+
+        /* The satellites go along with the location they gave */
+        if (locator->priv->location_source != source) {
+                locator->priv->location_source = source;
+                gclue_location_source_set_satellites
+                        (GCLUE_LOCATION_SOURCE (locator),
+                         gclue_location_source_get_satellites (source));
+        }
+
+        gclue_location_source_set_location_data
+                (GCLUE_LOCATION_SOURCE (locator), location);
 }
 
 static gint
@@ -233,6 +251,23 @@ on_location_changed (GObject    *gobject,
         set_location (locator, source);
 }
 
+static void
+on_satellites_changed (GObject    *gobject,
+                       GParamSpec *pspec,
+                       gpointer    user_data)
+{
+        GClueLocator *locator = GCLUE_LOCATOR (user_data);
+        GClueLocationSource *source = GCLUE_LOCATION_SOURCE (gobject);
+
+        /* Another receiver's sky doesn't match the location we give */
+        if (source != locator->priv->location_source)
+                return;
+
+        gclue_location_source_set_satellites
+                (GCLUE_LOCATION_SOURCE (locator),
+                 gclue_location_source_get_satellites (source));
+}
+
 static gboolean
 is_source_active (GClueLocator        *locator,
                   GClueLocationSource *src)
@@ -244,14 +279,18 @@ static void
 start_source (GClueLocator        *locator,
               GClueLocationSource *src)
 {
-        GClueLocation *location;
+        const GClueLocationData *location;
 
         g_signal_connect (G_OBJECT (src),
                           "notify::location",
                           G_CALLBACK (on_location_changed),
                           locator);
+        g_signal_connect (G_OBJECT (src),
+                          "notify::satellites",
+                          G_CALLBACK (on_satellites_changed),
+                          locator);
 
-        location = gclue_location_source_get_location (src);
+        location = gclue_location_source_get_location_data (src);
         if (gclue_location_source_get_active (src) && location != NULL)
                 set_location (locator, src);
 
@@ -290,6 +329,9 @@ on_avail_accuracy_level_changed (GObject    *gobject,
                 g_signal_handlers_disconnect_by_func (G_OBJECT (src),
                                                       G_CALLBACK (on_location_changed),
                                                       locator);
+                g_signal_handlers_disconnect_by_func (G_OBJECT (src),
+                                                      G_CALLBACK (on_satellites_changed),
+                                                      locator);
                 gclue_location_source_stop (src);
                 priv->active_sources = g_list_remove (priv->active_sources,
                                                       src);
@@ -387,6 +429,10 @@ gclue_locator_finalize (GObject *gsource)
                         (G_OBJECT (node->data),
                          G_CALLBACK (on_location_changed),
                          locator);
+                g_signal_handlers_disconnect_by_func
+                        (G_OBJECT (node->data),
+                         G_CALLBACK (on_satellites_changed),
+                         locator);
                 gclue_location_source_stop (GCLUE_LOCATION_SOURCE (node->data));
         }
         g_list_free_full (priv->sources, g_object_unref);
@@ -465,6 +511,22 @@ gclue_locator_constructed (GObject *object)
                                                         gpsd);
         }
 #endif
+#if GCLUE_USE_UBX_SOURCE
+        if (gclue_config_get_enable_ubx_source (gconfig) &&
+            gclue_config_get_ubx_device (gconfig) != NULL) {
+                GClueUbxSource *ubx = gclue_ubx_source_get_singleton ();
+                locator->priv->sources = g_list_append (locator->priv->sources,
+                                                        ubx);
+        }
+#endif
+#if GCLUE_USE_REPLAY_SOURCE
+        if (gclue_config_get_enable_replay_source (gconfig) &&
+            gclue_config_get_replay_file (gconfig) != NULL) {
+                GClueReplaySource *replay = gclue_replay_source_get_singleton ();
+                locator->priv->sources = g_list_append (locator->priv->sources,
+                                                        replay);
+        }
+#endif
 
         if (gclue_config_get_enable_static_source (gconfig)) {
                 GClueStaticSource *static_source;
@@ -593,6 +655,9 @@ gclue_locator_stop (GClueLocationSource *source)
                 g_signal_handlers_disconnect_by_func (G_OBJECT (src),
                                                       G_CALLBACK (on_location_changed),
                                                       locator);
+                g_signal_handlers_disconnect_by_func (G_OBJECT (src),
+                                                      G_CALLBACK (on_satellites_changed),
+                                                      locator);
                 gclue_location_source_stop (src);
                 g_debug ("Requested %s to stop", G_OBJECT_TYPE_NAME (src));
         }
@@ -672,3 +737,165 @@ gclue_locator_set_time_threshold (GClueLocator *locator,
                               GCLUE_LOCATION_SOURCE (locator),
                               value);
 }
+
+/* The locations last signaled to the clients, which each have a locator of
+ * their own. The clients all get the same fixes at about the same time, so
+ * the first one to ask measures the distance of a fix from all of them in
+ * one go, and the others find theirs ready.
+ */
+static struct {
+        GArray           *latitude;
+        GArray           *longitude;
+        GArray           *cos_latitude;
+        GArray           *distances;
+        GArray           *free_ids;
+
+        /* The fix @distances are from, only its position is used */
+        GClueLocationData fix;
+        gboolean          have_distances;
+} references;
+
+static void
+get_reference_points (guint                first,
+                      guint                n_points,
+                      GClueLocationPoints *points)
+{
+        points->n_points = n_points;
+        points->latitude = &g_array_index (references.latitude,
+                                           gdouble,
+                                           first);
+        points->longitude = &g_array_index (references.longitude,
+                                            gdouble,
+                                            first);
+        points->cos_latitude = &g_array_index (references.cos_latitude,
+                                               gdouble,
+                                               first);
+}
+
+static void
+set_reference_point (guint   id,
+                     gdouble latitude,
+                     gdouble longitude)
+{
+        GClueLocationPoints point;
+
+        get_reference_points (id, 1, &point);
+        gclue_location_points_set (&point, 0, latitude, longitude);
+
+        /* Keeps the distances from the current fix good for everyone */
+        if (references.have_distances)
+                gclue_location_data_get_distances
+                        (&references.fix,
+                         &point,
+                         &g_array_index (references.distances, gdouble, id));
+}
+
+/**
+ * gclue_locator_add_reference:
+ *
+ * Adds a reference location to measure the distance of fixes from, see
+ * gclue_locator_get_reference_distance(). It's at 0, 0 until
+ * gclue_locator_set_reference() moves it.
+ *
+ * Returns: the ID of the reference, for gclue_locator_remove_reference()
+ * to free it.
+ **/
+guint
+gclue_locator_add_reference (void)
+{
+        guint id;
+
+        if (references.latitude == NULL) {
+                references.latitude = g_array_new (FALSE, TRUE, sizeof (gdouble));
+                references.longitude = g_array_new (FALSE, TRUE, sizeof (gdouble));
+                references.cos_latitude = g_array_new (FALSE, TRUE, sizeof (gdouble));
+                references.distances = g_array_new (FALSE, TRUE, sizeof (gdouble));
+                references.free_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+        }
+
+        if (references.free_ids->len > 0) {
+                id = g_array_index (references.free_ids,
+                                    guint,
+                                    references.free_ids->len - 1);
+                g_array_set_size (references.free_ids,
+                                  references.free_ids->len - 1);
+        } else {
+                id = references.latitude->len;
+                g_array_set_size (references.latitude, id + 1);
+                g_array_set_size (references.longitude, id + 1);
+                g_array_set_size (references.cos_latitude, id + 1);
+                g_array_set_size (references.distances, id + 1);
+        }
+
+        set_reference_point (id, 0.0, 0.0);
+
+        return id;
+}
+
+/**
+ * gclue_locator_remove_reference:
+ * @id: the ID of a reference location
+ *
+ * Frees the reference location @id, it may be given out again.
+ **/
+void
+gclue_locator_remove_reference (guint id)
+{
+        g_return_if_fail (references.latitude != NULL &&
+                          id < references.latitude->len);
+
+        g_array_append_val (references.free_ids, id);
+}
+
+/**
+ * gclue_locator_set_reference:
+ * @id: the ID of a reference location
+ * @location: where the reference location is now
+ **/
+void
+gclue_locator_set_reference (guint                    id,
+                             const GClueLocationData *location)
+{
+        g_return_if_fail (references.latitude != NULL &&
+                          id < references.latitude->len);
+
+        set_reference_point (id, location->latitude, location->longitude);
+}
+
+/**
+ * gclue_locator_get_reference_distance:
+ * @id: the ID of a reference location
+ * @location: a fix
+ *
+ * Measures the distance of @location from all the reference locations, if
+ * it's not where the last fix measured was, using the spherical Earth model
+ * of gclue_location_data_get_distances().
+ *
+ * Returns: the distance of @location from reference location @id, in
+ * meters.
+ **/
+gdouble
+gclue_locator_get_reference_distance (guint                    id,
+                                      const GClueLocationData *location)
+{
+        g_return_val_if_fail (references.latitude != NULL &&
+                              id < references.latitude->len, 0.0);
+
+        if (!references.have_distances ||
+            references.fix.latitude != location->latitude ||
+            references.fix.longitude != location->longitude) {
+                GClueLocationPoints points;
+
+                references.fix = *location;
+                references.fix.description = NULL;
+                references.have_distances = TRUE;
+
+                get_reference_points (0, references.latitude->len, &points);
+                gclue_location_data_get_distances
+                        (location,
+                         &points,
+                         &g_array_index (references.distances, gdouble, 0));
+        }
+
+        return g_array_index (references.distances, gdouble, id);
+}
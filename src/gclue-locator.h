@@ -63,6 +63,14 @@ guint               gclue_locator_get_time_threshold (GClueLocator *locator);
 void                gclue_locator_set_time_threshold (GClueLocator *locator,
                                                       guint         threshold);
 
+guint               gclue_locator_add_reference      (void);
+void                gclue_locator_remove_reference   (guint         id);
+void                gclue_locator_set_reference      (guint                    id,
+                                                      const GClueLocationData *location);
+gdouble             gclue_locator_get_reference_distance
+                                                     (guint                    id,
+                                                      const GClueLocationData *location);
+
 G_END_DECLS
 
 #endif /* GCLUE_LOCATOR_H */
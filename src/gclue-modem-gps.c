@@ -216,14 +216,12 @@ on_fix_gps (GClueModem *modem,
             gpointer    user_data)
 {
         GClueLocationSource *source = GCLUE_LOCATION_SOURCE (user_data);
-        GClueLocation *prev_location;
-        g_autoptr(GClueLocation) location = NULL;
+        const GClueLocationData *prev_location;
+        GClueLocationData location;
 
-        prev_location = gclue_location_source_get_location (source);
-        location = gclue_location_create_from_nmeas (nmeas, prev_location);
-
-        if (location) {
-                gclue_location_source_set_location (source, location);
+        prev_location = gclue_location_source_get_location_data (source);
+        if (gclue_location_data_from_nmeas (nmeas, prev_location, &location)) {
+                gclue_location_source_set_location_data (source, &location);
         }
 }
 
@@ -25,6 +25,7 @@
 #include <libmm-glib.h>
 #include "gclue-modem-manager.h"
 #include "gclue-nmea-utils.h"
+#include "gclue-config.h"
 #include "gclue-marshal.h"
 #include "gclue-3g-tower.h"
 
@@ -490,6 +491,52 @@ on_location_changed_get_cdma (GObject *modem_object,
 #endif
 }
 
+/* Returns the @type trace from the most preferred talker that has one,
+ * or from any talker if none of them does.
+ */
+static const char *
+get_nmea_trace (MMLocationGpsNmea *location_nmea,
+                const char        *type)
+{
+        const char * const *talkers;
+#if MM_CHECK_VERSION(1, 14, 0)
+        g_auto(GStrv) traces = NULL;
+#endif
+        guint i;
+
+        talkers = gclue_config_get_nmea_talker_priority
+                (gclue_config_get_singleton ());
+
+        for (i = 0; talkers[i] != NULL; i++) {
+                char prefix[7];
+                const char *trace;
+
+                g_snprintf (prefix, sizeof (prefix), "$%s%s", talkers[i], type);
+                trace = mm_location_gps_nmea_get_trace (location_nmea, prefix);
+                if (trace != NULL)
+                        return trace;
+        }
+
+#if MM_CHECK_VERSION(1, 14, 0)
+        /* Those are copies, look the trace up again for one that isn't */
+        traces = mm_location_gps_nmea_get_traces (location_nmea);
+        for (i = 0; traces != NULL && traces[i] != NULL; i++) {
+                char prefix[7];
+
+                if (!gclue_nmea_type_is (traces[i], type))
+                        continue;
+
+                g_strlcpy (prefix, traces[i], sizeof (prefix));
+                g_debug ("No %s trace from a preferred talker, using %s",
+                         type, prefix);
+
+                return mm_location_gps_nmea_get_trace (location_nmea, prefix);
+        }
+#endif
+
+        return NULL;
+}
+
 static gboolean
 is_location_gga_same (GClueModemManager *manager,
                        const char       *new_gga)
@@ -500,7 +547,7 @@ is_location_gga_same (GClueModemManager *manager,
         if (priv->location_nmea == NULL)
                 return FALSE;
 
-        gga = mm_location_gps_nmea_get_trace (priv->location_nmea, "$GPGGA");
+        gga = get_nmea_trace (priv->location_nmea, "GGA");
         return (g_strcmp0 (gga, new_gga) == 0);
 }
 
@@ -542,18 +589,18 @@ on_get_gps_nmea_ready (GObject      *source_object,
                 return;
         }
 
-        gga = mm_location_gps_nmea_get_trace (location_nmea, "$GPGGA");
+        gga = get_nmea_trace (location_nmea, "GGA");
         if (gga != NULL && gclue_nmea_type_is (gga, "GGA")) {
                 if (is_location_gga_same (manager, gga)) {
                         g_debug ("New GGA trace is same as last one: %s", gga);
                         return;
                 }
-                g_debug ("New GPGGA trace: %s", gga);
+                g_debug ("New GGA trace: %s", gga);
                 sentences[i++] = gga;
         }
-        rmc = mm_location_gps_nmea_get_trace (location_nmea, "$GPRMC");
+        rmc = get_nmea_trace (location_nmea, "RMC");
         if (rmc != NULL && gclue_nmea_type_is (rmc, "RMC")) {
-                g_debug ("New GPRMC trace: %s", rmc);
+                g_debug ("New RMC trace: %s", rmc);
                 sentences[i++] = rmc;
         }
         sentences[i] = NULL;
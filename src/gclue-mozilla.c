@@ -437,7 +437,7 @@ gclue_mozilla_create_submit_query (GClueMozilla  *mozilla,
         json_builder_begin_object (builder);
 
         json_builder_set_member_name (builder, "timestamp");
-        time_ms = 1000 * gclue_location_get_timestamp (location);
+        time_ms = gclue_location_get_timestamp_usec (location) / 1000;
         json_builder_add_int_value (builder, time_ms);
 
         json_builder_set_member_name (builder, "position");
@@ -21,6 +21,7 @@
  *          Ankit (Verma) <ankitstarski@gmail.com>
  */
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <glib.h>
@@ -28,6 +29,8 @@
 #include "gclue-location.h"
 #include "gclue-nmea-utils.h"
 #include "gclue-nmea-source.h"
+#include "gclue-clock.h"
+#include "gclue-serial.h"
 #include "gclue-utils.h"
 #include "config.h"
 #include "gclue-enum-types.h"
@@ -38,6 +41,7 @@
 #include <avahi-common/error.h>
 #include <avahi-glib/glib-watch.h>
 #include <gio/gunixsocketaddress.h>
+#include <gio/gunixinputstream.h>
 
 /* Once we run out of NMEA services to try how long to wait
  * until retrying all of them.
@@ -45,29 +49,90 @@
  */
 #define SERVICE_UNBREAK_TIME 5
 
+/* How long to wait for the rest of an epoch's sentences after the first one,
+ * in milliseconds. Usually the epoch is complete or the next one starts long
+ * before that.
+ */
+#define EPOCH_DEADLINE 500
+
+/* Fixes from different services whose times are closer than this are of
+ * the same epoch.
+ * In microseconds.
+ */
+#define FUSION_EPOCH_TOLERANCE (100 * 1000)
+
+/* How long to wait for the fixes of the other services once the first fix
+ * of an epoch is in.
+ * In milliseconds.
+ */
+#define FUSION_DEADLINE 200
+
+/* A service we haven't had a fix from for this long isn't waited for.
+ * In microseconds.
+ */
+#define SERVICE_STALE_TIME (3 * G_USEC_PER_SEC / 2)
+
 typedef struct AvahiServiceInfo AvahiServiceInfo;
 
-struct _GClueNMEASourcePrivate {
-        GSocketConnection *connection;
-        GDataInputStream *input_stream;
+/* A connection to one of the NMEA services we read from. Pending reads and
+ * connection attempts hold a reference on it, so it outlives being closed
+ * until they have been cancelled.
+ */
+typedef struct {
+        GClueNMEASource *source;        /* NULL once closed */
+        AvahiServiceInfo *service;
 
         GSocketClient *client;
-
+        GSocketConnection *connection;
+        GInputStream *input_stream;
         GCancellable *cancellable;
 
+        GClueNMEASkyView sky_view;
+
+        GClueNMEAFramer framer;
+
+        GClueNMEAEpoch epoch;
+        guint epoch_deadline;
+
+        /* This service's fix of the epoch being fused, if it sent one yet,
+         * and when we last got a fix from it (monotonic time, in
+         * microseconds).
+         */
+        GClueLocationData fix;
+        gboolean has_fix;
+        gint64 last_fix_seen;
+} NMEAConnection;
+
+struct _GClueNMEASourcePrivate {
         AvahiGLibPoll *glib_poll;
 
         AvahiClient *avahi_client;
 
-        AvahiServiceInfo *active_service;
+        /* Connections to the services at the head of try_services, as many
+         * of them as network-nmea/max-services allows.
+         */
+        GPtrArray *connections;
 
-        /* List of services to try but only the most accurate one is used. */
+        /* List of services to try, the most accurate ones first. */
         GList *try_services;
 
         /* List of known-broken services. */
         GList *broken_services;
 
         guint accuracy_refresh_source, unbreak_timer;
+
+        /* The connection whose satellites we publish */
+        NMEAConnection *sky_connection;
+
+        /* Time of the epoch whose fixes are being collected and of the last
+         * one fused, in microseconds since the Epoch. 0 if none.
+         */
+        guint64 fusion_time;
+        guint64 fused_time;
+        guint fusion_deadline;
+
+        /* Where the sentences we receive are recorded to, if anywhere */
+        GOutputStream *record_stream;
 };
 
 G_DEFINE_TYPE_WITH_CODE (GClueNMEASource,
@@ -82,11 +147,19 @@ gclue_nmea_source_stop (GClueLocationSource *source);
 
 static void
 try_connect_to_service (GClueNMEASource *source);
+static void
+service_broken (NMEAConnection *connection);
+
+typedef enum {
+    NMEA_SERVICE_AVAHI,
+    NMEA_SERVICE_SOCKET,
+    NMEA_SERVICE_SERIAL,
+} NMEAServiceType;
 
 struct AvahiServiceInfo {
     char *identifier;
-    char *host_name;
-    gboolean is_socket;
+    char *host_name;            /* Or path of the socket or serial device */
+    NMEAServiceType type;
     guint16 port;
     GClueAccuracyLevel accuracy;
     gint64 timestamp_add;
@@ -114,7 +187,7 @@ avahi_service_new (const char        *identifier,
         service->host_name = g_strdup (host_name);
         service->port = port;
         service->accuracy = accuracy;
-        service->timestamp_add = g_get_monotonic_time ();
+        service->timestamp_add = gclue_clock_get_monotonic_time ();
 
         return service;
 }
@@ -157,46 +230,127 @@ compare_avahi_service_by_accuracy_n_time (gconstpointer a,
                 return 0;
 }
 
+static guint
+get_max_services (void)
+{
+        return gclue_config_get_nmea_max_services
+                (gclue_config_get_singleton ());
+}
+
+static void
+close_connection (gpointer data)
+{
+        NMEAConnection *connection = data;
+        GClueNMEASourcePrivate *priv = connection->source->priv;
+
+        g_cancellable_cancel (connection->cancellable);
+
+        g_clear_object (&connection->input_stream);
+        g_clear_object (&connection->connection);
+        g_clear_object (&connection->client);
+        g_clear_object (&connection->cancellable);
+        connection->has_fix = FALSE;
+        if (connection->epoch_deadline) {
+                g_source_remove (connection->epoch_deadline);
+                connection->epoch_deadline = 0;
+        }
+
+        if (priv->sky_connection == connection)
+                priv->sky_connection = NULL;
+
+        connection->source = NULL;
+        connection->service = NULL;
+        g_rc_box_release (connection);
+}
+
+static NMEAConnection *
+find_connection (GClueNMEASource  *source,
+                 AvahiServiceInfo *service)
+{
+        GPtrArray *connections = source->priv->connections;
+        guint i;
+
+        for (i = 0; i < connections->len; i++) {
+                NMEAConnection *connection = g_ptr_array_index (connections, i);
+
+                if (connection->service == service)
+                        return connection;
+        }
+
+        return NULL;
+}
+
 static void
-disconnect_from_service (GClueNMEASource *source)
+disconnect_from_services (GClueNMEASource *source)
 {
         GClueNMEASourcePrivate *priv = source->priv;
 
-        if (!priv->active_service)
-                return;
+        g_ptr_array_set_size (priv->connections, 0);
 
-        g_cancellable_cancel (priv->cancellable);
+        if (priv->fusion_deadline) {
+                g_source_remove (priv->fusion_deadline);
+                priv->fusion_deadline = 0;
+        }
+        priv->fusion_time = 0;
+        priv->fused_time = 0;
+}
 
-        g_clear_object (&priv->input_stream);
-        g_clear_object (&priv->connection);
-        g_clear_object (&priv->client);
-        g_clear_object (&priv->cancellable);
-        priv->active_service = NULL;
+static gboolean
+service_is_wanted (GClueNMEASource  *source,
+                   AvahiServiceInfo *service)
+{
+        gint index;
+
+        index = g_list_index (source->priv->try_services, service);
+
+        return index >= 0 && (guint) index < get_max_services ();
 }
 
 static gboolean
 reconnection_required (GClueNMEASource *source)
 {
         GClueNMEASourcePrivate *priv = source->priv;
+        guint max_services, n;
+        GList *l;
 
         /* Basically, reconnection is required if either
          *
-         * 1. service in use went down.
+         * 1. a service in use went down.
          * 2. a more accurate service than one currently in use, is now
          *    available.
          */
-        return priv->active_service == NULL ||
-                priv->try_services == NULL ||
-                priv->active_service != priv->try_services->data;
+        max_services = get_max_services ();
+        for (l = priv->try_services, n = 0;
+             l != NULL && n < max_services;
+             l = l->next, n++) {
+                if (find_connection (source, l->data) == NULL)
+                        return TRUE;
+        }
+
+        return priv->connections->len != n;
 }
 
 static void
 reconnect_service (GClueNMEASource *source)
 {
+        GClueNMEASourcePrivate *priv = source->priv;
+        guint i;
+
         if (!reconnection_required (source))
                 return;
 
-        disconnect_from_service (source);
+        for (i = priv->connections->len; i > 0; i--) {
+                NMEAConnection *connection =
+                        g_ptr_array_index (priv->connections, i - 1);
+
+                if (service_is_wanted (source, connection->service))
+                        continue;
+
+                g_debug ("Disconnecting from NMEA service %s",
+                         connection->service->identifier);
+                g_ptr_array_remove_index_fast (priv->connections, i - 1);
+        }
+
         try_connect_to_service (source);
 }
 
@@ -252,6 +406,18 @@ refresh_accuracy_level (GClueNMEASource *source)
                                                     source);
 }
 
+/* Whether broken services are worth another try: some of the
+ * network-nmea/max-services connections we may have are unused.
+ */
+static gboolean
+needs_unbreaking (GClueNMEASource *source)
+{
+        GClueNMEASourcePrivate *priv = source->priv;
+
+        return priv->broken_services != NULL &&
+               g_list_length (priv->try_services) < get_max_services ();
+}
+
 static gboolean
 on_service_unbreak_time (gpointer source)
 {
@@ -259,10 +425,14 @@ on_service_unbreak_time (gpointer source)
 
         priv->unbreak_timer = 0;
 
-        if (!priv->try_services && priv->broken_services) {
+        if (needs_unbreaking (source)) {
                 g_debug ("Unbreaking existing NMEA services");
 
-                priv->try_services = priv->broken_services;
+                /* Behind the working ones, so they only take the unused
+                 * connections and don't push out a service that works.
+                 */
+                priv->try_services = g_list_concat (priv->try_services,
+                                                    priv->broken_services);
                 priv->broken_services = NULL;
 
                 reconnect_service (source);
@@ -276,7 +446,7 @@ check_unbreak_timer (GClueNMEASource *source)
 {
         GClueNMEASourcePrivate *priv = source->priv;
 
-        if (priv->try_services || !priv->broken_services) {
+        if (!needs_unbreaking (source)) {
                 if (priv->unbreak_timer) {
                         g_debug ("Removing unnecessary NMEA unbreaking timer");
 
@@ -344,7 +514,7 @@ add_new_service (GClueNMEASource *source,
                  const char *name,
                  const char *host_name,
                  uint16_t port,
-                 gboolean is_socket,
+                 NMEAServiceType type,
                  AvahiStringList *txt)
 {
         GClueAccuracyLevel accuracy = GCLUE_ACCURACY_LEVEL_NONE;
@@ -401,7 +571,7 @@ add_new_service (GClueNMEASource *source,
 
 CREATE_SERVICE:
         service = avahi_service_new (name, host_name, port, accuracy);
-        service->is_socket = is_socket;
+        service->type = type;
 
         source->priv->try_services = g_list_insert_sorted
                 (source->priv->try_services,
@@ -421,7 +591,7 @@ add_new_service_avahi (GClueNMEASource *source,
                        uint16_t port,
                        AvahiStringList *txt)
 {
-        add_new_service (source, name, host_name, port, FALSE, txt);
+        add_new_service (source, name, host_name, port, NMEA_SERVICE_AVAHI, txt);
 }
 
 static void
@@ -429,18 +599,27 @@ add_new_service_socket (GClueNMEASource *source,
                        const char *name,
                        const char *socket_path)
 {
-        add_new_service (source, name, socket_path, 0, TRUE, NULL);
+        add_new_service (source, name, socket_path, 0, NMEA_SERVICE_SOCKET, NULL);
+}
+
+static void
+add_new_service_serial (GClueNMEASource *source,
+                        const char *name,
+                        const char *device)
+{
+        add_new_service (source, name, device, 0, NMEA_SERVICE_SERIAL, NULL);
 }
 
 static void
-service_broken (GClueNMEASource *source)
+service_broken (NMEAConnection *connection)
 {
+        GClueNMEASource *source = connection->source;
         GClueNMEASourcePrivate *priv = source->priv;
-        AvahiServiceInfo *service = priv->active_service;
+        AvahiServiceInfo *service = connection->service;
 
         g_assert (service);
 
-        disconnect_from_service (source);
+        g_ptr_array_remove_fast (priv->connections, connection);
 
         priv->try_services = g_list_remove (priv->try_services,
                                             service);
@@ -480,9 +659,13 @@ remove_service_by_name (GClueNMEASource *source,
                                    service,
                                    compare_avahi_service_by_identifier);
         if (item) {
-                if (item->data == priv->active_service) {
-                        g_debug ("Active NMEA service removed, disconnecting.");
-                        disconnect_from_service (source);
+                NMEAConnection *connection;
+
+                connection = find_connection (source, item->data);
+                if (connection != NULL) {
+                        g_debug ("NMEA service in use removed, disconnecting.");
+                        g_ptr_array_remove_fast (priv->connections,
+                                                 connection);
                 }
 
                 remove_service_from_list (&priv->try_services,
@@ -492,7 +675,7 @@ remove_service_by_name (GClueNMEASource *source,
                                            service,
                                            compare_avahi_service_by_identifier);
                 if (item) {
-                        g_assert (item->data != priv->active_service);
+                        g_assert (find_connection (source, item->data) == NULL);
                         remove_service_from_list (&priv->broken_services,
                                                   item);
                 }
@@ -651,145 +834,400 @@ browse_callback (AvahiServiceBrowser   *service_browser,
         }
 }
 
-#define NMEA_LINE_END "\r\n"
-#define NMEA_LINE_END_CTR (sizeof (NMEA_LINE_END) - 1)
+static gdouble
+nmea_value_or_unknown (gdouble value)
+{
+        return isfinite (value) ? value : GCLUE_SATELLITES_UNKNOWN;
+}
 
-static void nmea_skip_delim (GBufferedInputStream *stream,
-                             GCancellable *cancellable)
+static void
+publish_sky_view (NMEAConnection *connection)
 {
-        const char *buf;
-        gsize buf_size;
-        size_t delim_skip;
+        GClueNMEASourcePrivate *priv = connection->source->priv;
+        GClueNMEASkyView *sky_view = &connection->sky_view;
+        GVariantBuilder builder;
+        guint i;
+
+        /* The next GSA starts a new set of used satellites */
+        sky_view->used_complete = TRUE;
+
+        /* Satellites of different receivers don't mix, we only publish
+         * the ones of the receiver whose fix was the best lately.
+         */
+        if (priv->sky_connection == NULL)
+                priv->sky_connection = connection;
+        else if (priv->sky_connection != connection)
+                return;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(udddb)"));
+        for (i = 0; i < sky_view->n_satellites; i++) {
+                const GClueNMEASatellite *satellite = &sky_view->satellites[i];
+
+                g_variant_builder_add
+                        (&builder,
+                         "(udddb)",
+                         (guint32) satellite->prn,
+                         nmea_value_or_unknown (satellite->elevation),
+                         nmea_value_or_unknown (satellite->azimuth),
+                         nmea_value_or_unknown (satellite->snr),
+                         gclue_nmea_sky_view_is_used (sky_view, satellite));
+        }
+
+        gclue_location_source_set_satellites
+                (GCLUE_LOCATION_SOURCE (connection->source),
+                 g_variant_new (GCLUE_SATELLITES_VARIANT_TYPE,
+                                nmea_value_or_unknown (sky_view->hdop),
+                                nmea_value_or_unknown (sky_view->vdop),
+                                nmea_value_or_unknown (sky_view->pdop),
+                                &builder));
+}
+
+static gboolean
+is_same_epoch (guint64 time,
+               guint64 other)
+{
+        guint64 diff = time > other ? time - other : other - time;
+
+        return diff < FUSION_EPOCH_TOLERANCE;
+}
+
+/* Publishes the fused fixes of the current epoch */
+static void
+fuse_fixes (GClueNMEASource *source)
+{
+        GClueNMEASourcePrivate *priv = source->priv;
+        GPtrArray *connections = priv->connections;
+        g_autofree const GClueLocationData **fixes = NULL;
+        GClueLocationData location;
+        guint i;
+        gint best;
+
+        if (priv->fusion_deadline) {
+                g_source_remove (priv->fusion_deadline);
+                priv->fusion_deadline = 0;
+        }
+
+        fixes = g_new (const GClueLocationData *, connections->len);
+        for (i = 0; i < connections->len; i++) {
+                NMEAConnection *connection = g_ptr_array_index (connections, i);
+
+                fixes[i] = connection->has_fix ? &connection->fix : NULL;
+        }
+
+        best = gclue_nmea_fuse_fixes (fixes, connections->len, &location);
+        if (best < 0) {
+                priv->fusion_time = 0;
+                return;
+        }
+
+        priv->sky_connection = g_ptr_array_index (connections, best);
+        for (i = 0; i < connections->len; i++) {
+                NMEAConnection *connection = g_ptr_array_index (connections, i);
+
+                connection->has_fix = FALSE;
+        }
+
+        priv->fused_time = priv->fusion_time;
+        priv->fusion_time = 0;
+
+        gclue_location_source_set_location_data (GCLUE_LOCATION_SOURCE (source),
+                                                 &location);
+}
+
+static gboolean
+on_fusion_deadline (gpointer user_data)
+{
+        GClueNMEASource *source = GCLUE_NMEA_SOURCE (user_data);
+
+        g_debug ("Not all NMEA services sent a fix in time, using what we have");
+        source->priv->fusion_deadline = 0;
+        fuse_fixes (source);
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Whether we have the fixes of the current epoch from all the services we
+ * are still expecting one from.
+ */
+static gboolean
+all_fixes_in (GClueNMEASource *source)
+{
+        GPtrArray *connections = source->priv->connections;
+        gint64 now = gclue_clock_get_monotonic_time ();
+        guint i;
+
+        for (i = 0; i < connections->len; i++) {
+                NMEAConnection *connection = g_ptr_array_index (connections, i);
+
+                if (connection->has_fix || connection->input_stream == NULL)
+                        continue;
+
+                if (now - connection->last_fix_seen < SERVICE_STALE_TIME)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+static void
+add_fix (NMEAConnection          *connection,
+         const GClueLocationData *location)
+{
+        GClueNMEASource *source = connection->source;
+        GClueNMEASourcePrivate *priv = source->priv;
+        guint64 time = location->timestamp;
+
+        connection->last_fix_seen = gclue_clock_get_monotonic_time ();
+
+        /* Too late, this epoch has been published already */
+        if (priv->fused_time != 0 && is_same_epoch (time, priv->fused_time))
+                return;
+
+        if (priv->fusion_time != 0 && !is_same_epoch (time, priv->fusion_time)) {
+                /* This service is lagging behind the others */
+                if (time < priv->fusion_time)
+                        return;
+
+                /* A new epoch, don't wait for the current one anymore */
+                fuse_fixes (source);
+        }
+
+        if (priv->fusion_time == 0)
+                priv->fusion_time = time;
+        connection->fix = *location;
+        connection->has_fix = TRUE;
+
+        if (all_fixes_in (source))
+                fuse_fixes (source);
+        else if (!priv->fusion_deadline)
+                priv->fusion_deadline = g_timeout_add (FUSION_DEADLINE,
+                                                       on_fusion_deadline,
+                                                       source);
+}
+
+static void
+on_read_nmea_chunk (GObject      *object,
+                    GAsyncResult *result,
+                    gpointer      user_data);
+
+static void
+finish_epoch (NMEAConnection *connection)
+{
+        const GClueLocationData *prev_location;
+        GClueLocationData location;
+        const char *sentences[GCLUE_NMEA_EPOCH_MAX_SENTENCES + 1];
+
+        if (connection->epoch_deadline) {
+                g_source_remove (connection->epoch_deadline);
+                connection->epoch_deadline = 0;
+        }
+
+        if (gclue_nmea_epoch_get_sentences (&connection->epoch, sentences) > 0) {
+                prev_location = gclue_location_source_get_location_data
+                        (GCLUE_LOCATION_SOURCE (connection->source));
+                if (gclue_location_data_from_nmeas (sentences,
+                                                    prev_location,
+                                                    &location))
+                        add_fix (connection, &location);
+        }
+
+        gclue_nmea_epoch_finish (&connection->epoch);
+}
+
+static gboolean
+on_epoch_deadline (gpointer user_data)
+{
+        NMEAConnection *connection = user_data;
+
+        g_debug ("NMEA epoch incomplete, using what we have");
+        connection->epoch_deadline = 0;
+        finish_epoch (connection);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+open_record_file (GClueNMEASource *source)
+{
+        GClueNMEASourcePrivate *priv = source->priv;
+        const char *path;
+        g_autoptr(GFile) file = NULL;
+        g_autoptr(GFileOutputStream) file_stream = NULL;
         g_autoptr(GError) error = NULL;
 
-        buf = (const char *) g_buffered_input_stream_peek_buffer (stream,
-                                                                  &buf_size);
+        path = gclue_config_get_nmea_record_file
+                (gclue_config_get_singleton ());
+        if (path == NULL || priv->record_stream != NULL)
+                return;
 
-        delim_skip = strnspn (buf, NMEA_LINE_END, buf_size);
-        for (size_t ctr = 0; ctr < delim_skip; ctr++) {
-                if (g_buffered_input_stream_read_byte (stream, cancellable, &error) < 0) {
-                        if (error && !g_error_matches (error, G_IO_ERROR,
-                                                       G_IO_ERROR_CANCELLED)) {
-                                g_warning ("Failed to skip %zu / %zu NMEA delimiter: %s",
-                                           ctr, delim_skip, error->message);
-                        }
-                        break;
-                }
+        file = g_file_new_for_path (path);
+        file_stream = g_file_append_to (file, G_FILE_CREATE_NONE, NULL, &error);
+        if (file_stream == NULL) {
+                g_warning ("Failed to open NMEA record file %s: %s",
+                           path, error->message);
+                return;
         }
+
+        /* Sentences are small, don't hit the disk for each of them */
+        priv->record_stream = g_buffered_output_stream_new
+                (G_OUTPUT_STREAM (file_stream));
+        if (!g_output_stream_printf (priv->record_stream,
+                                     NULL,
+                                     NULL,
+                                     &error,
+                                     GCLUE_NMEA_RECORD_HEADER "%" G_GINT64_FORMAT "\r\n",
+                                     gclue_clock_get_real_time ())) {
+                g_warning ("Failed to write to NMEA record file %s: %s",
+                           path, error->message);
+                g_clear_object (&priv->record_stream);
+                return;
+        }
+
+        g_debug ("Recording NMEA sentences to %s", path);
 }
 
-static gboolean nmea_check_delim (GBufferedInputStream *stream)
+static void
+close_record_file (GClueNMEASource *source)
 {
-        const char *buf;
-        gsize buf_size;
+        GClueNMEASourcePrivate *priv = source->priv;
+        g_autoptr(GError) error = NULL;
 
-        buf = (const char *) g_buffered_input_stream_peek_buffer (stream,
-                                                                  &buf_size);
+        if (priv->record_stream == NULL)
+                return;
 
-        return strnpbrk (buf, NMEA_LINE_END, buf_size) != NULL;
+        if (!g_output_stream_close (priv->record_stream, NULL, &error))
+                g_warning ("Failed to close NMEA record file: %s",
+                           error->message);
+        g_clear_object (&priv->record_stream);
 }
 
-#define NMEA_STR_LEN 128
 static void
-on_read_nmea_sentence (GObject      *object,
-                       GAsyncResult *result,
-                       gpointer      user_data)
+record_sentence (GClueNMEASource *source,
+                 const char      *message)
 {
-        GClueNMEASource *source = NULL;
-        GDataInputStream *data_input_stream = G_DATA_INPUT_STREAM (object);
+        GClueNMEASourcePrivate *priv = source->priv;
         g_autoptr(GError) error = NULL;
-        GClueLocation *prev_location;
-        g_autoptr(GClueLocation) location = NULL;
-        gsize data_size = 0 ;
-        g_autofree char *message = NULL;
-        gint i;
-        const gchar *sentences[3];
-        gchar gga[NMEA_STR_LEN];
-        gchar rmc[NMEA_STR_LEN];
-
-        message = g_data_input_stream_read_upto_finish (data_input_stream,
-                                                        result,
-                                                        &data_size,
-                                                        &error);
-
-        gga[0] = '\0';
-        rmc[0] = '\0';
-
-        do {
-                if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-                        return;
 
-                if (!source)
-                        source = GCLUE_NMEA_SOURCE (user_data);
-
-                if (message == NULL) {
-                        if (error != NULL) {
-                                if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CLOSED)) {
-                                        g_debug ("NMEA socket closed.");
-                                } else {
-                                        g_warning ("Error when receiving message: %s",
-                                                   error->message);
-                                }
-                                service_broken (source);
-                                return;
-                        } else {
-                                g_debug ("NMEA empty read");
-                                /* GLib has a bug where g_data_input_stream_read_upto_finish
-                                 * returns NULL when reading a line with only stop chars.
-                                 * Convert this NULL to a zero-length message. See:
-                                 * https://gitlab.gnome.org/GNOME/glib/-/issues/655
-                                 */
-                                message = g_strdup ("");
-                        }
+        if (priv->record_stream == NULL)
+                return;
 
-                }
-                g_debug ("Network source sent: \"%s\"", message);
+        if (!g_output_stream_printf (priv->record_stream,
+                                     NULL,
+                                     NULL,
+                                     &error,
+                                     "%s\r\n",
+                                     message)) {
+                g_warning ("Failed to write to NMEA record file, "
+                           "not recording anymore: %s",
+                           error->message);
+                g_clear_object (&priv->record_stream);
+        }
+}
 
-                if (gclue_nmea_type_is (message, "GGA")) {
-                        g_strlcpy (gga, message, NMEA_STR_LEN);
-                } else if (gclue_nmea_type_is (message, "RMC")) {
-                        g_strlcpy (rmc, message, NMEA_STR_LEN);
-                }
+static void
+read_nmea_chunk (NMEAConnection *connection)
+{
+        char *space;
+        gsize size;
+
+        space = gclue_nmea_framer_get_space (&connection->framer, &size);
+        g_input_stream_read_async (connection->input_stream,
+                                   space,
+                                   size,
+                                   G_PRIORITY_DEFAULT,
+                                   connection->cancellable,
+                                   on_read_nmea_chunk,
+                                   g_rc_box_acquire (connection));
+}
 
-                nmea_skip_delim (G_BUFFERED_INPUT_STREAM (data_input_stream),
-                                 source->priv->cancellable);
-
-                if (nmea_check_delim (G_BUFFERED_INPUT_STREAM (data_input_stream))) {
-                    g_clear_pointer (&message, g_free);
-                    message = g_data_input_stream_read_upto
-                            (data_input_stream,
-                             NMEA_LINE_END, NMEA_LINE_END_CTR,
-                             &data_size, NULL, &error);
-                } else {
-                    break;
-                }
-        } while (TRUE);
+static void
+on_read_nmea_chunk (GObject      *object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+        NMEAConnection *connection = user_data;
+        g_autoptr(GError) error = NULL;
+        gssize n_read;
+        const char *message;
+        const char * const *talkers;
+        gboolean sky_complete = FALSE;
+
+        n_read = g_input_stream_read_finish (G_INPUT_STREAM (object),
+                                             result,
+                                             &error);
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+            connection->source == NULL) {
+                g_rc_box_release (connection);
+                return;
+        }
+
+        if (n_read < 0) {
+                g_warning ("Error when receiving message: %s",
+                           error->message);
+                service_broken (connection);
+                g_rc_box_release (connection);
+                return;
+        } else if (n_read == 0) {
+                g_debug ("NMEA socket closed.");
+                service_broken (connection);
+                g_rc_box_release (connection);
+                return;
+        }
 
-        i = 0;
-        if (gga[0])
-                sentences[i++] = gga;
-        if (rmc[0])
-                sentences[i++] = rmc;
-        sentences[i] = NULL;
+        gclue_nmea_framer_commit (&connection->framer, n_read);
 
-        if (i > 0) {
-                prev_location = gclue_location_source_get_location
-                        (GCLUE_LOCATION_SOURCE (source));
-                location = gclue_location_create_from_nmeas (sentences,
-                                                             prev_location);
-                if (location) {
-                        gclue_location_source_set_location
-                                (GCLUE_LOCATION_SOURCE (source), location);
+        talkers = gclue_config_get_nmea_talker_priority
+                (gclue_config_get_singleton ());
+
+        /* The sentences point into the framer's buffer, so they stay valid
+         * until we read the next chunk into it. The epoch keeps copies of
+         * the ones it needs. Publishing a fix can get us stopped, so we
+         * check for the connection being closed as we go.
+         */
+        while (connection->source != NULL &&
+               (message = gclue_nmea_framer_next_sentence
+                                (&connection->framer)) != NULL) {
+                g_debug ("Network source %s sent: \"%s\"",
+                         connection->service->identifier,
+                         message);
+                record_sentence (connection->source, message);
+
+                if (gclue_nmea_type_is (message, "GSV")) {
+                        if (gclue_nmea_sky_view_add_gsv (&connection->sky_view,
+                                                         message))
+                                sky_complete = TRUE;
+                        continue;
                 }
+
+                if (gclue_nmea_type_is (message, "GSA"))
+                        gclue_nmea_sky_view_add_gsa (&connection->sky_view,
+                                                     message);
+
+                if (gclue_nmea_epoch_is_next (&connection->epoch, message))
+                        finish_epoch (connection);
+
+                if (connection->source != NULL &&
+                    gclue_nmea_epoch_add (&connection->epoch, message, talkers) &&
+                    gclue_nmea_epoch_is_complete (&connection->epoch))
+                        finish_epoch (connection);
         }
 
-        g_data_input_stream_read_upto_async (data_input_stream,
-                                             NMEA_LINE_END,
-                                             NMEA_LINE_END_CTR,
-                                             G_PRIORITY_DEFAULT,
-                                             source->priv->cancellable,
-                                             on_read_nmea_sentence,
-                                             source);
+        if (connection->source == NULL) {
+                g_rc_box_release (connection);
+                return;
+        }
+
+        if (!gclue_nmea_epoch_is_empty (&connection->epoch) &&
+            !connection->epoch_deadline)
+                connection->epoch_deadline = g_timeout_add (EPOCH_DEADLINE,
+                                                            on_epoch_deadline,
+                                                            connection);
+
+        if (sky_complete)
+                publish_sky_view (connection);
+
+        read_nmea_chunk (connection);
+        g_rc_box_release (connection);
 }
 
 static void
@@ -798,96 +1236,165 @@ on_connection_to_location_server (GObject      *object,
                                   gpointer      user_data)
 {
         GSocketClient *client = G_SOCKET_CLIENT (object);
-        GClueNMEASource *source;
-        g_autoptr(GSocketConnection) connection = NULL;
+        NMEAConnection *connection = user_data;
+        g_autoptr(GSocketConnection) socket_connection = NULL;
         g_autoptr(GError) error = NULL;
 
-        connection = g_socket_client_connect_to_host_finish
-                (client,
-                 result,
-                 &error);
+        socket_connection = g_socket_client_connect_to_host_finish (client,
+                                                                    result,
+                                                                    &error);
 
-        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+            connection->source == NULL) {
+                g_rc_box_release (connection);
                 return;
         }
 
-        source = GCLUE_NMEA_SOURCE (user_data);
-
         if (error != NULL) {
-                g_warning ("Failed to connect to NMEA service: %s", error->message);
-                service_broken (source);
+                g_warning ("Failed to connect to NMEA service %s: %s",
+                           connection->service->identifier,
+                           error->message);
+                service_broken (connection);
+                g_rc_box_release (connection);
                 return;
         }
 
-        g_assert (connection);
-        g_debug ("NMEA service connected.");
+        g_assert (socket_connection);
+        g_debug ("NMEA service %s connected.",
+                 connection->service->identifier);
 
-        g_assert (!source->priv->connection);
-        source->priv->connection = g_steal_pointer (&connection);
+        g_assert (!connection->connection);
+        connection->connection = g_steal_pointer (&socket_connection);
 
-        g_assert (!source->priv->input_stream);
-        source->priv->input_stream = g_data_input_stream_new
-                (g_io_stream_get_input_stream (G_IO_STREAM (source->priv->connection)));
+        g_assert (!connection->input_stream);
+        connection->input_stream = g_object_ref
+                (g_io_stream_get_input_stream (G_IO_STREAM (connection->connection)));
 
-        g_data_input_stream_read_upto_async (source->priv->input_stream,
-                                             NMEA_LINE_END,
-                                             NMEA_LINE_END_CTR,
-                                             G_PRIORITY_DEFAULT,
-                                             source->priv->cancellable,
-                                             on_read_nmea_sentence,
-                                             source);
+        gclue_nmea_framer_init (&connection->framer);
+        read_nmea_chunk (connection);
+        g_rc_box_release (connection);
 }
 
-static void
-try_connect_to_service (GClueNMEASource *source)
+static gboolean
+on_serial_device_failed (gpointer user_data)
 {
-        GClueNMEASourcePrivate *priv = source->priv;
+        NMEAConnection *connection = user_data;
 
-        if (!gclue_location_source_get_active (GCLUE_LOCATION_SOURCE (source))) {
-                g_warn_if_fail (!priv->active_service);
+        if (connection->source != NULL)
+                service_broken (connection);
 
+        return G_SOURCE_REMOVE;
+}
+
+static void
+open_serial_connection (NMEAConnection *connection)
+{
+        g_autoptr(GError) error = NULL;
+        guint baud_rate;
+        gint fd;
+
+        baud_rate = gclue_config_get_nmea_baud_rate
+                (gclue_config_get_singleton ());
+        fd = gclue_serial_open (connection->service->host_name,
+                                baud_rate,
+                                &error);
+        if (fd < 0) {
+                g_warning ("Failed to open NMEA serial device %s: %s",
+                           connection->service->host_name,
+                           error->message);
+
+                /* We are in the middle of going through the services to
+                 * connect to, so don't change their lists from here.
+                 */
+                g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                 on_serial_device_failed,
+                                 g_rc_box_acquire (connection),
+                                 (GDestroyNotify) g_rc_box_release);
                 return;
         }
 
-        if (priv->active_service)
-                return;
+        g_debug ("NMEA serial device %s opened at %u baud.",
+                 connection->service->host_name,
+                 baud_rate);
 
-        if (priv->try_services == NULL)
-                return;
+        /* The file descriptor is non-blocking, so the stream polls it and
+         * we read the sentences through the same path as the sockets.
+         */
+        connection->input_stream = g_unix_input_stream_new (fd, TRUE);
 
-        g_assert (!priv->cancellable);
-        priv->cancellable = g_cancellable_new ();
+        gclue_nmea_framer_init (&connection->framer);
+        read_nmea_chunk (connection);
+}
 
-        g_assert (!priv->client);
-        priv->client = g_socket_client_new ();
+static void
+connect_to_service (GClueNMEASource  *source,
+                    AvahiServiceInfo *service)
+{
+        NMEAConnection *connection;
+
+        connection = g_rc_box_new0 (NMEAConnection);
+        connection->source = source;
+        connection->service = service;
+        connection->cancellable = g_cancellable_new ();
+        gclue_nmea_sky_view_init (&connection->sky_view);
+        gclue_nmea_epoch_init (&connection->epoch);
+        g_ptr_array_add (source->priv->connections, connection);
+
+        if (service->type == NMEA_SERVICE_SERIAL) {
+                open_serial_connection (connection);
+                return;
+        }
 
-        /* The service with the highest accuracy will be stored in the beginning
-         * of the list.
-         */
-        priv->active_service = (AvahiServiceInfo *) priv->try_services->data;
+        connection->client = g_socket_client_new ();
 
         g_debug ("Trying to connect to NMEA %sservice %s:%u.",
-                 priv->active_service->is_socket ? "socket " : "",
-                 priv->active_service->host_name,
-                 (unsigned int) priv->active_service->port);
-
-        if (!priv->active_service->is_socket) {
-		g_socket_client_connect_to_host_async
-			(priv->client,
-			 priv->active_service->host_name,
-			 priv->active_service->port,
-			 priv->cancellable,
-			 on_connection_to_location_server,
-			 source);
+                 service->type == NMEA_SERVICE_SOCKET ? "socket " : "",
+                 service->host_name,
+                 (unsigned int) service->port);
+
+        if (service->type == NMEA_SERVICE_AVAHI) {
+                g_socket_client_connect_to_host_async
+                        (connection->client,
+                         service->host_name,
+                         service->port,
+                         connection->cancellable,
+                         on_connection_to_location_server,
+                         g_rc_box_acquire (connection));
         } else {
                 g_autoptr(GSocketAddress) addr = NULL;
 
-                addr = g_unix_socket_address_new (priv->active_service->host_name);
-		g_socket_client_connect_async (priv->client,
-                               G_SOCKET_CONNECTABLE (addr),
-                               priv->cancellable,
-                               on_connection_to_location_server,
-                               source);
+                addr = g_unix_socket_address_new (service->host_name);
+                g_socket_client_connect_async
+                        (connection->client,
+                         G_SOCKET_CONNECTABLE (addr),
+                         connection->cancellable,
+                         on_connection_to_location_server,
+                         g_rc_box_acquire (connection));
+        }
+}
+
+static void
+try_connect_to_service (GClueNMEASource *source)
+{
+        GClueNMEASourcePrivate *priv = source->priv;
+        guint max_services, n;
+        GList *l;
+
+        if (!gclue_location_source_get_active (GCLUE_LOCATION_SOURCE (source))) {
+                g_warn_if_fail (priv->connections->len == 0);
+
+                return;
+        }
+
+        /* The services with the highest accuracy are stored in the beginning
+         * of the list.
+         */
+        max_services = get_max_services ();
+        for (l = priv->try_services, n = 0;
+             l != NULL && n < max_services;
+             l = l->next, n++) {
+                if (find_connection (source, l->data) == NULL)
+                        connect_to_service (source, l->data);
         }
 }
 
@@ -895,18 +1402,22 @@ static gboolean
 remove_avahi_services_from_list (GClueNMEASource *source, GList **list)
 {
         GClueNMEASourcePrivate *priv = source->priv;
-        gboolean removed_active = FALSE;
+        gboolean removed_used = FALSE;
         GList *l = *list;
 
         while (l != NULL) {
                 GList *next = l->next;
                 AvahiServiceInfo *service = l->data;
 
-                if (!service->is_socket) {
-                        if (service == priv->active_service) {
-                                g_debug ("Active NMEA service was Avahi-provided, disconnecting.");
-                                disconnect_from_service (source);
-                                removed_active = TRUE;
+                if (service->type == NMEA_SERVICE_AVAHI) {
+                        NMEAConnection *connection;
+
+                        connection = find_connection (source, service);
+                        if (connection != NULL) {
+                                g_debug ("NMEA service in use was Avahi-provided, disconnecting.");
+                                g_ptr_array_remove_fast (priv->connections,
+                                                         connection);
+                                removed_used = TRUE;
                         }
 
                         remove_service_from_list (list, l);
@@ -915,7 +1426,7 @@ remove_avahi_services_from_list (GClueNMEASource *source, GList **list)
                 l = next;
         }
 
-        return removed_active;
+        return removed_used;
 }
 
 static void
@@ -942,7 +1453,8 @@ gclue_nmea_source_finalize (GObject *gnmea)
         G_OBJECT_CLASS (gclue_nmea_source_parent_class)->finalize (gnmea);
 
         disconnect_avahi_client (source);
-        disconnect_from_service (source);
+        disconnect_from_services (source);
+        close_record_file (source);
 
         if (priv->accuracy_refresh_source) {
                 g_source_remove (priv->accuracy_refresh_source);
@@ -960,6 +1472,7 @@ gclue_nmea_source_finalize (GObject *gnmea)
                           avahi_service_free);
         g_list_free_full (g_steal_pointer (&priv->broken_services),
                           avahi_service_free);
+        g_clear_pointer (&priv->connections, g_ptr_array_unref);
 }
 
 static void
@@ -1037,12 +1550,14 @@ gclue_nmea_source_init (GClueNMEASource *source)
 {
         GClueNMEASourcePrivate *priv;
         const char *nmea_socket;
+        const char *serial_device;
         GClueConfig *config;
 
         source->priv = gclue_nmea_source_get_instance_private (source);
         priv = source->priv;
 
         priv->glib_poll = avahi_glib_poll_new (NULL, G_PRIORITY_DEFAULT);
+        priv->connections = g_ptr_array_new_with_free_func (close_connection);
 
         config = gclue_config_get_singleton ();
 
@@ -1053,6 +1568,13 @@ gclue_nmea_source_init (GClueNMEASource *source)
                                         nmea_socket);
         }
 
+        serial_device = gclue_config_get_nmea_serial_device (config);
+        if (serial_device != NULL) {
+                add_new_service_serial (source,
+                                        "serial-device",
+                                        serial_device);
+        }
+
         try_connect_avahi_client (source);
 }
 
@@ -1097,6 +1619,7 @@ gclue_nmea_source_start (GClueLocationSource *source)
         if (base_result == GCLUE_LOCATION_SOURCE_START_RESULT_FAILED)
                 return base_result;
 
+        open_record_file (GCLUE_NMEA_SOURCE (source));
         try_connect_avahi_client (GCLUE_NMEA_SOURCE (source));
         reconnect_service (GCLUE_NMEA_SOURCE (source));
 
@@ -1116,7 +1639,8 @@ gclue_nmea_source_stop (GClueLocationSource *source)
         if (base_result == GCLUE_LOCATION_SOURCE_STOP_RESULT_STILL_USED)
                 return base_result;
 
-        disconnect_from_service (GCLUE_NMEA_SOURCE (source));
+        disconnect_from_services (GCLUE_NMEA_SOURCE (source));
+        close_record_file (GCLUE_NMEA_SOURCE (source));
 
         return base_result;
 }
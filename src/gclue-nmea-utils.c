@@ -16,7 +16,9 @@
  *
  */
 
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "gclue-nmea-utils.h"
 
 /**
@@ -36,6 +38,63 @@ gclue_nmea_type_is (const char *msg, const char *nmeatype)
                 g_str_has_prefix (msg+3, nmeatype);
 }
 
+/**
+ * gclue_nmea_talker_rank:
+ * @msg: NMEA sentence
+ * @talkers: talker IDs ("GN", "GP" etc.), most preferred first
+ *
+ * Returns: the position of the talker of @msg in @talkers, or the length of
+ * @talkers if it's not in there, so that sentences from the more preferred
+ * talkers rank lower.
+ **/
+guint
+gclue_nmea_talker_rank (const char         *msg,
+                        const char * const *talkers)
+{
+        guint i;
+
+        for (i = 0; talkers[i] != NULL; i++) {
+                if (msg[0] == '$' &&
+                    msg[1] == talkers[i][0] &&
+                    msg[1] != '\0' &&
+                    msg[2] == talkers[i][1])
+                        break;
+        }
+
+        return i;
+}
+
+/* The @len characters at @timestamp needn't be NUL-terminated */
+static GTimeSpan
+nmea_timestamp_to_timespan (const char *timestamp,
+                            gsize       len)
+{
+        gint its, hours, minutes;
+        gdouble ts, seconds_f;
+        gchar *endptr;
+
+        if (len == 0)
+                return -1;
+
+        ts = g_ascii_strtod (timestamp, &endptr);
+        if (endptr != timestamp + len ||
+            ts < 0.0 ||
+            ts >= 235960.0)
+                return -1;
+
+        its = (gint) ts;  /* Truncate towards zero */
+        hours = its / 10000;
+        minutes = (its - 10000 * hours) / 100;
+        seconds_f = ts - 10000 * hours - 100 * minutes;  /* Seconds plus fraction */
+
+        /* Round, so that e.g. "123456.70" doesn't come out a microsecond
+         * short of .7 seconds.
+         */
+        return (GTimeSpan) (G_USEC_PER_SEC * (3600 * hours +
+                                                60 * minutes +
+                                                     seconds_f) + 0.5);
+}
+
 /**
  * gclue_nmea_timestamp_to_timespan
  * @timestamp: NMEA timestamp string
@@ -49,26 +108,842 @@ gclue_nmea_type_is (const char *msg, const char *nmeatype)
 GTimeSpan
 gclue_nmea_timestamp_to_timespan (const gchar *timestamp)
 {
-        gint its, hours, minutes;
-        gdouble ts, seconds_f;
-        gchar *endptr;
-
         if (!timestamp || !*timestamp)
             return -1;
 
-        ts = g_ascii_strtod (timestamp, &endptr);
-        if (endptr != timestamp + g_utf8_strlen(timestamp, 12) ||
-            ts < 0.0 ||
-            ts >= 235960.0)
+        return nmea_timestamp_to_timespan (timestamp, strnlen (timestamp, 12));
+}
+
+static const char * const epoch_types[GCLUE_NMEA_EPOCH_N_TYPES] = {
+        [GCLUE_NMEA_EPOCH_GGA] = "GGA",
+        [GCLUE_NMEA_EPOCH_RMC] = "RMC",
+        [GCLUE_NMEA_EPOCH_GSA] = "GSA",
+        [GCLUE_NMEA_EPOCH_GST] = "GST",
+        [GCLUE_NMEA_EPOCH_VTG] = "VTG",
+};
+
+static gint
+epoch_type_of (const char *msg)
+{
+        gint i;
+
+        for (i = 0; i < GCLUE_NMEA_EPOCH_N_TYPES; i++) {
+                if (gclue_nmea_type_is (msg, epoch_types[i]))
+                        return i;
+        }
+
+        return -1;
+}
+
+/* The UTC time of @msg, or -1 for sentences that don't have one */
+static GTimeSpan
+epoch_time_of (const char *msg,
+               gint        type)
+{
+        GClueNMEAFields fields;
+
+        if (type == GCLUE_NMEA_EPOCH_GSA || type == GCLUE_NMEA_EPOCH_VTG)
                 return -1;
 
-        its = (gint) ts;  /* Truncate towards zero */
-        hours = its / 10000;
-        minutes = (its - 10000 * hours) / 100;
-        seconds_f = ts - 10000 * hours - 100 * minutes;  /* Seconds plus fraction */
+        if (!gclue_nmea_fields_parse (&fields, msg))
+                return -1;
+
+        return gclue_nmea_fields_get_timespan (&fields, 1);
+}
+
+/**
+ * gclue_nmea_epoch_init:
+ * @epoch: a #GClueNMEAEpoch
+ *
+ * Prepares @epoch for a new stream, forgetting which sentences it sends.
+ **/
+void
+gclue_nmea_epoch_init (GClueNMEAEpoch *epoch)
+{
+        epoch->time = -1;
+        epoch->last_time = -1;
+        epoch->seen = 0;
+        epoch->expected = 0;
+        epoch->n_gsa = 0;
+        epoch->expected_gsa = 0;
+}
+
+/**
+ * gclue_nmea_epoch_is_next:
+ * @epoch: a #GClueNMEAEpoch
+ * @msg: NMEA sentence
+ *
+ * Returns: whether @msg is from a later epoch than the sentences in @epoch,
+ * which then have to be taken out and @epoch finished before adding @msg.
+ **/
+gboolean
+gclue_nmea_epoch_is_next (GClueNMEAEpoch *epoch,
+                          const char     *msg)
+{
+        GTimeSpan time;
+        gint type;
+
+        if (epoch->time < 0)
+                return FALSE;
+
+        type = epoch_type_of (msg);
+        if (type < 0)
+                return FALSE;
+
+        time = epoch_time_of (msg, type);
+
+        return time >= 0 && time != epoch->time && time != epoch->last_time;
+}
+
+/**
+ * gclue_nmea_epoch_add:
+ * @epoch: a #GClueNMEAEpoch
+ * @msg: NMEA sentence
+ * @talkers: talker IDs, most preferred first
+ *
+ * Adds a copy of @msg to @epoch, if it's a GGA, RMC, GSA, GST or VTG
+ * sentence. Of several sentences of the same type, the one from the most
+ * preferred talker is kept, except for GSA sentences which all are, as
+ * long as they're from the same talker.
+ *
+ * Sentences of an epoch that's already been finished are dropped. That
+ * includes the ones without a time (GSA and VTG) that come before any
+ * with one: those are most likely late for the last epoch rather than
+ * early for this one.
+ *
+ * Returns: whether @msg was added.
+ **/
+gboolean
+gclue_nmea_epoch_add (GClueNMEAEpoch     *epoch,
+                      const char         *msg,
+                      const char * const *talkers)
+{
+        GTimeSpan time;
+        guint rank;
+        gint type;
+
+        type = epoch_type_of (msg);
+        if (type < 0)
+                return FALSE;
+
+        if (strlen (msg) >= GCLUE_NMEA_MAX_SENTENCE) {
+                g_debug ("NMEA sentence too long, ignoring: %s", msg);
+                return FALSE;
+        }
+
+        time = epoch_time_of (msg, type);
+        if (time >= 0) {
+                if (time == epoch->last_time && epoch->time != time) {
+                        g_debug ("NMEA sentence came too late for its epoch: %s",
+                                 msg);
+                        return FALSE;
+                }
+                epoch->time = time;
+        } else if (epoch->time < 0) {
+                g_debug ("NMEA sentence without a time outside of an epoch: %s",
+                         msg);
+                return FALSE;
+        }
+
+        rank = gclue_nmea_talker_rank (msg, talkers);
+        if (epoch->seen & (1 << type) && rank > epoch->rank[type])
+                return FALSE;
+
+        if (type == GCLUE_NMEA_EPOCH_GSA) {
+                /* A more preferred talker replaces the ones we had */
+                if (!(epoch->seen & (1 << type)) || rank < epoch->rank[type])
+                        epoch->n_gsa = 0;
+                if (epoch->n_gsa == GCLUE_NMEA_EPOCH_MAX_GSA)
+                        return FALSE;
+
+                g_strlcpy (epoch->gsa[epoch->n_gsa++], msg,
+                           GCLUE_NMEA_MAX_SENTENCE);
+        } else
+                g_strlcpy (epoch->sentences[type], msg, GCLUE_NMEA_MAX_SENTENCE);
+        epoch->rank[type] = rank;
+        epoch->seen |= 1 << type;
+
+        return TRUE;
+}
+
+/**
+ * gclue_nmea_epoch_is_empty:
+ * @epoch: a #GClueNMEAEpoch
+ *
+ * Returns: whether @epoch has no sentences.
+ **/
+gboolean
+gclue_nmea_epoch_is_empty (GClueNMEAEpoch *epoch)
+{
+        return epoch->seen == 0;
+}
+
+/**
+ * gclue_nmea_epoch_is_complete:
+ * @epoch: a #GClueNMEAEpoch
+ *
+ * Returns: whether @epoch has all the sentences types the last epoch had,
+ * as many GSA sentences, and a time. Without a last epoch to go by it's
+ * never complete.
+ **/
+gboolean
+gclue_nmea_epoch_is_complete (GClueNMEAEpoch *epoch)
+{
+        return epoch->time >= 0 &&
+               epoch->expected != 0 &&
+               (epoch->seen & epoch->expected) == epoch->expected &&
+               epoch->n_gsa >= epoch->expected_gsa;
+}
+
+/**
+ * gclue_nmea_epoch_get_sentences:
+ * @epoch: a #GClueNMEAEpoch
+ * @sentences: (out caller-allocates): array of at least
+ * %GCLUE_NMEA_EPOCH_MAX_SENTENCES + 1 elements
+ *
+ * Fills @sentences with the sentences of @epoch and a terminating %NULL,
+ * GGA and RMC first, the GSA sentences in the order they came. They stay
+ * valid until @epoch is finished.
+ *
+ * Returns: the number of sentences.
+ **/
+guint
+gclue_nmea_epoch_get_sentences (GClueNMEAEpoch *epoch,
+                                const char     *sentences[])
+{
+        guint i, j, n = 0;
+
+        for (i = 0; i < GCLUE_NMEA_EPOCH_N_TYPES; i++) {
+                if (!(epoch->seen & (1 << i)))
+                        continue;
+
+                if (i == GCLUE_NMEA_EPOCH_GSA) {
+                        for (j = 0; j < epoch->n_gsa; j++)
+                                sentences[n++] = epoch->gsa[j];
+                } else
+                        sentences[n++] = epoch->sentences[i];
+        }
+        sentences[n] = NULL;
+
+        return n;
+}
+
+/**
+ * gclue_nmea_epoch_finish:
+ * @epoch: a #GClueNMEAEpoch
+ *
+ * Drops the sentences of @epoch, to start collecting the next epoch. The
+ * types of sentences it had are expected in the following epochs.
+ **/
+void
+gclue_nmea_epoch_finish (GClueNMEAEpoch *epoch)
+{
+        if (epoch->seen != 0) {
+                epoch->expected = epoch->seen;
+                epoch->expected_gsa = epoch->n_gsa;
+        }
+        if (epoch->time >= 0)
+                epoch->last_time = epoch->time;
+        epoch->time = -1;
+        epoch->seen = 0;
+        epoch->n_gsa = 0;
+}
+
+/**
+ * gclue_nmea_framer_init:
+ * @framer: a #GClueNMEAFramer
+ *
+ * Prepares @framer for a new stream, dropping anything buffered.
+ **/
+void
+gclue_nmea_framer_init (GClueNMEAFramer *framer)
+{
+        framer->len = 0;
+        framer->pos = 0;
+        framer->discarding = FALSE;
+}
+
+/**
+ * gclue_nmea_framer_get_space:
+ * @framer: a #GClueNMEAFramer
+ * @size: (out): return location for the size of the space
+ *
+ * Makes room after the part of the last sentence that hasn't been completed
+ * yet. Only that part is moved, complete sentences are never copied.
+ *
+ * Returns: (transfer none): where the next read should go. Any sentence
+ * returned by gclue_nmea_framer_next_sentence() before is invalidated.
+ **/
+char *
+gclue_nmea_framer_get_space (GClueNMEAFramer *framer,
+                             gsize           *size)
+{
+        if (framer->pos > 0) {
+                memmove (framer->data,
+                         framer->data + framer->pos,
+                         framer->len - framer->pos);
+                framer->len -= framer->pos;
+                framer->pos = 0;
+        }
+
+        /* A sentence that doesn't fit is garbage, drop what we have of it
+         * and skip the rest up to the next line end.
+         */
+        if (framer->len == sizeof (framer->data) - 1) {
+                framer->len = 0;
+                framer->discarding = TRUE;
+        }
+
+        *size = sizeof (framer->data) - 1 - framer->len;
+
+        return framer->data + framer->len;
+}
+
+/**
+ * gclue_nmea_framer_commit:
+ * @framer: a #GClueNMEAFramer
+ * @n_read: how many bytes were read into the space from
+ * gclue_nmea_framer_get_space()
+ **/
+void
+gclue_nmea_framer_commit (GClueNMEAFramer *framer,
+                          gsize            n_read)
+{
+        g_return_if_fail (framer->len + n_read < sizeof (framer->data));
+
+        framer->len += n_read;
+}
+
+/**
+ * gclue_nmea_framer_next_sentence:
+ * @framer: a #GClueNMEAFramer
+ *
+ * Sentences may be terminated by "\r\n", or by either of them alone. Empty
+ * lines are skipped.
+ *
+ * Returns: (transfer none) (nullable): the next complete sentence in the
+ * buffer, NUL-terminated in place, or %NULL if there isn't one yet. The
+ * sentence stays valid until the next call to
+ * gclue_nmea_framer_get_space().
+ **/
+const char *
+gclue_nmea_framer_next_sentence (GClueNMEAFramer *framer)
+{
+        while (framer->pos < framer->len) {
+                char *sentence = framer->data + framer->pos;
+                gsize left = framer->len - framer->pos;
+                char *end, *cr;
+
+                end = memchr (sentence, '\n', left);
+                if (end != NULL)
+                        left = end - sentence;
+                /* Usually right before the '\n', but some receivers end
+                 * sentences with a lone '\r'.
+                 */
+                cr = memchr (sentence, '\r', left);
+                if (cr != NULL)
+                        end = cr;
+                if (end == NULL)
+                        return NULL;
 
-        return (GTimeSpan) G_USEC_PER_SEC * (3600 * hours +
-                                               60 * minutes +
-                                                    seconds_f);
+                *end = '\0';
+                framer->pos = end - framer->data + 1;
+
+                if (framer->discarding) {
+                        framer->discarding = FALSE;
+                        continue;
+                }
+
+                if (*sentence == '\0')
+                        continue;
+
+                return sentence;
+        }
+
+        return NULL;
+}
+
+/**
+ * gclue_nmea_fields_parse:
+ * @fields: return location for the fields
+ * @msg: NMEA sentence
+ *
+ * Finds the fields of @msg, without copying any of them. If @msg has a
+ * checksum it is checked as well.
+ *
+ * Returns: %FALSE if @msg isn't a sentence, has too many fields or its
+ * checksum doesn't match.
+ **/
+gboolean
+gclue_nmea_fields_parse (GClueNMEAFields *fields,
+                         const char      *msg)
+{
+        const char *p;
+        guint8 checksum = 0;
+        gint high, low;
+
+        if (msg[0] != '$')
+                return FALSE;
+
+        fields->sentence = msg;
+        fields->n_fields = 1;
+        fields->start[0] = 1;
+
+        for (p = msg + 1; *p != '\0' && *p != '*'; p++) {
+                checksum ^= (guint8) *p;
+
+                if (*p != ',')
+                        continue;
+
+                if (fields->n_fields == GCLUE_NMEA_MAX_FIELDS ||
+                    p - msg >= G_MAXUINT16)
+                        return FALSE;
+
+                fields->len[fields->n_fields - 1] =
+                        p - msg - fields->start[fields->n_fields - 1];
+                fields->start[fields->n_fields++] = p - msg + 1;
+        }
+        fields->len[fields->n_fields - 1] =
+                p - msg - fields->start[fields->n_fields - 1];
+
+        if (*p == '\0')
+                return TRUE;
+
+        high = g_ascii_xdigit_value (p[1]);
+        low = high < 0 ? -1 : g_ascii_xdigit_value (p[2]);
+        if (low < 0) {
+                g_debug ("Malformed NMEA checksum: %s", msg);
+                return FALSE;
+        }
+
+        if (((high << 4) | low) != checksum) {
+                g_debug ("NMEA checksum mismatch, expected %02X: %s",
+                         checksum, msg);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+/**
+ * gclue_nmea_fields_get:
+ * @fields: a #GClueNMEAFields
+ * @i: index of the field
+ * @len: (out): return location for the length of the field
+ *
+ * Returns: (transfer none): the start of field @i, which is not
+ * NUL-terminated. Fields the sentence doesn't have are empty.
+ **/
+const char *
+gclue_nmea_fields_get (const GClueNMEAFields *fields,
+                       guint                  i,
+                       gsize                 *len)
+{
+        if (i >= fields->n_fields) {
+                *len = 0;
+                return "";
+        }
+
+        *len = fields->len[i];
+        return fields->sentence + fields->start[i];
+}
+
+/**
+ * gclue_nmea_fields_get_char:
+ * @fields: a #GClueNMEAFields
+ * @i: index of the field
+ *
+ * Returns: the first character of field @i, or '\0' if it's empty.
+ **/
+char
+gclue_nmea_fields_get_char (const GClueNMEAFields *fields,
+                            guint                  i)
+{
+        const char *field;
+        gsize len;
+
+        field = gclue_nmea_fields_get (fields, i, &len);
+
+        return len > 0 ? field[0] : '\0';
+}
+
+/**
+ * gclue_nmea_fields_get_double:
+ * @fields: a #GClueNMEAFields
+ * @i: index of the field
+ * @value: (out): return location for the value
+ *
+ * Returns: whether field @i is a number. If not, @value is set to NAN.
+ **/
+gboolean
+gclue_nmea_fields_get_double (const GClueNMEAFields *fields,
+                              guint                  i,
+                              gdouble               *value)
+{
+        const char *field;
+        char *end;
+        gsize len;
+
+        *value = NAN;
+
+        field = gclue_nmea_fields_get (fields, i, &len);
+        if (len == 0)
+                return FALSE;
+
+        /* Stops at the ',' or '*' after the field at the latest */
+        *value = g_ascii_strtod (field, &end);
+        if (end != field + len || !isfinite (*value)) {
+                *value = NAN;
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+/**
+ * gclue_nmea_fields_get_uint:
+ * @fields: a #GClueNMEAFields
+ * @i: index of the field
+ * @value: (out): return location for the value
+ *
+ * Returns: whether field @i is a non-negative integer. If not, @value is set
+ * to 0.
+ **/
+gboolean
+gclue_nmea_fields_get_uint (const GClueNMEAFields *fields,
+                            guint                  i,
+                            guint                 *value)
+{
+        const char *field;
+        gsize len, j;
+
+        *value = 0;
+
+        field = gclue_nmea_fields_get (fields, i, &len);
+        if (len == 0 || len > 9)
+                return FALSE;
+
+        for (j = 0; j < len; j++) {
+                if (!g_ascii_isdigit (field[j])) {
+                        *value = 0;
+                        return FALSE;
+                }
+                *value = *value * 10 + (field[j] - '0');
+        }
+
+        return TRUE;
+}
+
+/**
+ * gclue_nmea_fields_get_timespan:
+ * @fields: a #GClueNMEAFields
+ * @i: index of the field
+ *
+ * Returns: the NMEA timestamp in field @i as microseconds since midnight,
+ * or -1 if it's empty or invalid.
+ **/
+GTimeSpan
+gclue_nmea_fields_get_timespan (const GClueNMEAFields *fields,
+                                guint                  i)
+{
+        const char *field;
+        gsize len;
+
+        field = gclue_nmea_fields_get (fields, i, &len);
+
+        return nmea_timestamp_to_timespan (field, len);
+}
+
+static GClueNMEASystem
+nmea_talker_system (const char *talker)
+{
+        static const struct {
+                char            talker[3];
+                GClueNMEASystem system;
+        } talkers[] = {
+                { "GP", GCLUE_NMEA_SYSTEM_GPS },
+                { "GL", GCLUE_NMEA_SYSTEM_GLONASS },
+                { "GA", GCLUE_NMEA_SYSTEM_GALILEO },
+                { "GB", GCLUE_NMEA_SYSTEM_BEIDOU },
+                { "BD", GCLUE_NMEA_SYSTEM_BEIDOU },
+                { "GQ", GCLUE_NMEA_SYSTEM_QZSS },
+                { "GI", GCLUE_NMEA_SYSTEM_NAVIC },
+        };
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (talkers); i++) {
+                if (memcmp (talker, talkers[i].talker, 2) == 0)
+                        return talkers[i].system;
+        }
+
+        /* "GN" for any combination of them */
+        return GCLUE_NMEA_SYSTEM_UNKNOWN;
+}
+
+/**
+ * gclue_nmea_sky_view_init:
+ * @sky_view: a #GClueNMEASkyView
+ *
+ * Resets @sky_view to having no satellites.
+ */
+void
+gclue_nmea_sky_view_init (GClueNMEASkyView *sky_view)
+{
+        memset (sky_view, 0, sizeof (GClueNMEASkyView));
+        sky_view->hdop = NAN;
+        sky_view->vdop = NAN;
+        sky_view->pdop = NAN;
 }
 
+/**
+ * gclue_nmea_sky_view_add_gsv:
+ * @sky_view: a #GClueNMEASkyView
+ * @msg: a GSV sentence
+ *
+ * Adds the satellites in @msg to @sky_view. The first sentence of a group
+ * replaces the satellites previously given by the same talker for the same
+ * signal.
+ *
+ * Returns: whether @msg was the last sentence of its group.
+ */
+gboolean
+gclue_nmea_sky_view_add_gsv (GClueNMEASkyView *sky_view,
+                             const char       *msg)
+{
+        GClueNMEAFields fields;
+        guint n_fields, total, num, i, j;
+        char signal = '0';
+
+        if (!gclue_nmea_fields_parse (&fields, msg))
+                return FALSE;
+        n_fields = fields.n_fields;
+        if (n_fields < 4 || fields.len[0] < 3)
+                return FALSE;
+
+        gclue_nmea_fields_get_uint (&fields, 1, &total);
+        gclue_nmea_fields_get_uint (&fields, 2, &num);
+
+        /* NMEA 4.1 ends the sentence with the signal ID */
+        if ((n_fields - 4) % 4 == 1 &&
+            gclue_nmea_fields_get_char (&fields, n_fields - 1) != '\0') {
+                signal = gclue_nmea_fields_get_char (&fields, n_fields - 1);
+                n_fields--;
+        }
+
+        if (num == 1) {
+                for (i = 0, j = 0; i < sky_view->n_satellites; i++) {
+                        GClueNMEASatellite *satellite = &sky_view->satellites[i];
+
+                        if (memcmp (satellite->talker, msg + 1, 2) == 0 &&
+                            satellite->signal == signal)
+                                continue;
+                        sky_view->satellites[j++] = *satellite;
+                }
+                sky_view->n_satellites = j;
+        }
+
+        for (i = 4; i < n_fields; i += 4) {
+                GClueNMEASatellite *satellite;
+                guint prn;
+
+                if (!gclue_nmea_fields_get_uint (&fields, i, &prn))
+                        continue;
+
+                if (sky_view->n_satellites == GCLUE_NMEA_MAX_SATELLITES)
+                        break;
+
+                satellite = &sky_view->satellites[sky_view->n_satellites++];
+                memcpy (satellite->talker, msg + 1, 2);
+                satellite->signal = signal;
+                satellite->prn = prn;
+                gclue_nmea_fields_get_double (&fields, i + 1,
+                                              &satellite->elevation);
+                gclue_nmea_fields_get_double (&fields, i + 2,
+                                              &satellite->azimuth);
+                gclue_nmea_fields_get_double (&fields, i + 3,
+                                              &satellite->snr);
+        }
+
+        return total > 0 && num == total;
+}
+
+/**
+ * gclue_nmea_sky_view_add_gsa:
+ * @sky_view: a #GClueNMEASkyView
+ * @msg: a GSA sentence
+ *
+ * Adds the satellites used in the fix and the DOP values in @msg to
+ * @sky_view. Receivers tracking several constellations send one GSA
+ * sentence for each, they all add up until @sky_view has been published
+ * and used_complete set.
+ *
+ * The system of the satellites is the one in the NMEA 4.1 system ID field,
+ * or else the one of the talker. Without either, as in GNGSA sentences
+ * from before NMEA 4.1, the PRNs are the ones of the NMEA numbering, which
+ * doesn't reuse them across systems.
+ */
+void
+gclue_nmea_sky_view_add_gsa (GClueNMEASkyView *sky_view,
+                             const char       *msg)
+{
+        GClueNMEAFields fields;
+        GClueNMEASystem system;
+        guint i, system_id;
+
+        if (!gclue_nmea_fields_parse (&fields, msg) || fields.n_fields < 18 ||
+            fields.len[0] < 3)
+                return;
+
+        if (gclue_nmea_fields_get_uint (&fields, 18, &system_id) &&
+            system_id <= GCLUE_NMEA_SYSTEM_NAVIC)
+                system = system_id;
+        else
+                system = nmea_talker_system (msg + 1);
+
+        if (sky_view->used_complete) {
+                sky_view->n_used = 0;
+                sky_view->used_complete = FALSE;
+        }
+
+        for (i = 3; i < 15; i++) {
+                guint prn;
+
+                if (!gclue_nmea_fields_get_uint (&fields, i, &prn))
+                        continue;
+                if (sky_view->n_used == GCLUE_NMEA_MAX_SATELLITES)
+                        break;
+
+                sky_view->used[sky_view->n_used].system = system;
+                sky_view->used[sky_view->n_used].prn = prn;
+                sky_view->n_used++;
+        }
+
+        gclue_nmea_fields_get_double (&fields, 15, &sky_view->pdop);
+        gclue_nmea_fields_get_double (&fields, 16, &sky_view->hdop);
+        gclue_nmea_fields_get_double (&fields, 17, &sky_view->vdop);
+}
+
+/**
+ * gclue_nmea_sky_view_is_used:
+ * @sky_view: a #GClueNMEASkyView
+ * @satellite: one of the satellites of @sky_view
+ *
+ * Returns: whether @satellite was used in the fix. Where the system of
+ * either side isn't known, only the PRNs are compared.
+ */
+gboolean
+gclue_nmea_sky_view_is_used (GClueNMEASkyView         *sky_view,
+                             const GClueNMEASatellite *satellite)
+{
+        GClueNMEASystem system = nmea_talker_system (satellite->talker);
+        guint i;
+
+        for (i = 0; i < sky_view->n_used; i++) {
+                if (sky_view->used[i].prn != satellite->prn)
+                        continue;
+
+                if (system == GCLUE_NMEA_SYSTEM_UNKNOWN ||
+                    sky_view->used[i].system == GCLUE_NMEA_SYSTEM_UNKNOWN ||
+                    sky_view->used[i].system == system)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+static gboolean
+fix_is_better (const GClueLocationData *fix,
+               const GClueLocationData *other)
+{
+        gdouble accuracy = fix->accuracy;
+        gdouble other_accuracy = other->accuracy;
+
+        if (accuracy == GCLUE_LOCATION_ACCURACY_UNKNOWN)
+                return FALSE;
+        if (other_accuracy == GCLUE_LOCATION_ACCURACY_UNKNOWN)
+                return TRUE;
+
+        return accuracy < other_accuracy;
+}
+
+/**
+ * gclue_nmea_fuse_fixes:
+ * @fixes: the fixes of one epoch from several receivers, %NULL for the ones
+ * that didn't send any
+ * @n_fixes: the length of @fixes
+ * @fused: (out): the fused fix
+ *
+ * Fuses the fixes into the best one, with the average of all of them with a
+ * known accuracy as its position, weighted by the inverse of their variance.
+ *
+ * Returns: the index of the best fix in @fixes, whose values other than the
+ * position @fused has, or -1 if there were no fixes.
+ **/
+gint
+gclue_nmea_fuse_fixes (const GClueLocationData *fixes[],
+                       guint                    n_fixes,
+                       GClueLocationData       *fused)
+{
+        gdouble best_longitude;
+        gdouble latitude = 0, longitude = 0, weights = 0;
+        guint i, n_weighted = 0;
+        gint best = -1;
+
+        for (i = 0; i < n_fixes; i++) {
+                if (fixes[i] == NULL)
+                        continue;
+
+                if (best < 0 || fix_is_better (fixes[i], fixes[best]))
+                        best = i;
+        }
+
+        if (best < 0)
+                return -1;
+
+        /* Longitudes are averaged as offsets from the best one, so fixes on
+         * both sides of the antimeridian don't cancel each other out.
+         */
+        best_longitude = fixes[best]->longitude;
+        for (i = 0; i < n_fixes; i++) {
+                gdouble accuracy, weight, offset;
+
+                if (fixes[i] == NULL)
+                        continue;
+
+                accuracy = fixes[i]->accuracy;
+                if (accuracy == GCLUE_LOCATION_ACCURACY_UNKNOWN)
+                        continue;
+
+                accuracy = MAX (accuracy, 1.0);
+                weight = 1.0 / (accuracy * accuracy);
+
+                offset = fixes[i]->longitude - best_longitude;
+                if (offset > 180.0)
+                        offset -= 360.0;
+                else if (offset < -180.0)
+                        offset += 360.0;
+
+                latitude += weight * fixes[i]->latitude;
+                longitude += weight * offset;
+                weights += weight;
+                n_weighted++;
+        }
+
+        *fused = *fixes[best];
+        if (n_weighted > 1) {
+                longitude = best_longitude + longitude / weights;
+                if (longitude > 180.0)
+                        longitude -= 360.0;
+                else if (longitude < -180.0)
+                        longitude += 360.0;
+
+                /* The receivers are close to each other and share most of
+                 * their errors, so we don't claim the average to be any more
+                 * accurate than the best fix.
+                 */
+                fused->latitude = latitude / weights;
+                fused->longitude = longitude;
+        }
+
+        return best;
+}
@@ -20,11 +20,171 @@
 #define GCLUE_NMEA_UTILS_H
 
 #include <glib.h>
+#include "gclue-location.h"
 
 G_BEGIN_DECLS
 
+#define GCLUE_NMEA_MAX_SATELLITES 64
+
+/* Starts the line put at the head of each session in an NMEA record file,
+ * followed by the time recording started at, in microseconds since the
+ * Epoch. The sentences themselves only carry the time of day.
+ */
+#define GCLUE_NMEA_RECORD_HEADER "# geoclue-record start="
+
+/* Satellite systems, numbered like the NMEA 4.1 system IDs */
+typedef enum {
+        GCLUE_NMEA_SYSTEM_UNKNOWN,
+        GCLUE_NMEA_SYSTEM_GPS,
+        GCLUE_NMEA_SYSTEM_GLONASS,
+        GCLUE_NMEA_SYSTEM_GALILEO,
+        GCLUE_NMEA_SYSTEM_BEIDOU,
+        GCLUE_NMEA_SYSTEM_QZSS,
+        GCLUE_NMEA_SYSTEM_NAVIC,
+} GClueNMEASystem;
+
+typedef struct {
+        char     talker[2];
+        char     signal;        /* NMEA 4.1 signal ID, '0' if not given */
+        guint    prn;
+        gdouble  elevation;     /* All NAN if not given */
+        gdouble  azimuth;
+        gdouble  snr;
+} GClueNMEASatellite;
+
+/* Satellites in view, assembled from GSV and GSA sentences */
+typedef struct {
+        GClueNMEASatellite satellites[GCLUE_NMEA_MAX_SATELLITES];
+        guint    n_satellites;
+
+        /* Satellites used in the fix, from the GSA sentences of the last
+         * epoch. The same PRN can be in use in several systems.
+         */
+        struct {
+                GClueNMEASystem system;
+                guint           prn;
+        }        used[GCLUE_NMEA_MAX_SATELLITES];
+        guint    n_used;
+        gboolean used_complete;
+
+        gdouble  hdop;
+        gdouble  vdop;
+        gdouble  pdop;
+} GClueNMEASkyView;
+
+/* Room for a whole epoch of a 10 Hz multi-constellation receiver. NMEA 0183
+ * caps sentences at 82 characters, but proprietary ones may be longer.
+ */
+#define GCLUE_NMEA_FRAMER_SIZE 4096
+
+/* Splits a byte stream into sentences, in place */
+typedef struct {
+        char     data[GCLUE_NMEA_FRAMER_SIZE];
+        gsize    len;
+        gsize    pos;
+        gboolean discarding;
+} GClueNMEAFramer;
+
+/* Enough for all the standard sentences, GSV with NMEA 4.1 signal IDs being
+ * the longest.
+ */
+#define GCLUE_NMEA_MAX_FIELDS 32
+
+/* The fields of a sentence, as offsets into it. Field 0 is the address
+ * ("GPGGA" etc.), the checksum is not a field.
+ */
+typedef struct {
+        const char *sentence;
+        guint       n_fields;
+        guint16     start[GCLUE_NMEA_MAX_FIELDS];
+        guint16     len[GCLUE_NMEA_MAX_FIELDS];
+} GClueNMEAFields;
+
+/* Longest sentence an epoch keeps a copy of */
+#define GCLUE_NMEA_MAX_SENTENCE 128
+
+typedef enum {
+        GCLUE_NMEA_EPOCH_GGA,
+        GCLUE_NMEA_EPOCH_RMC,
+        GCLUE_NMEA_EPOCH_GSA,
+        GCLUE_NMEA_EPOCH_GST,
+        GCLUE_NMEA_EPOCH_VTG,
+        GCLUE_NMEA_EPOCH_N_TYPES
+} GClueNMEAEpochType;
+
+/* Receivers tracking several satellite systems send a GSA sentence for
+ * each of them.
+ */
+#define GCLUE_NMEA_EPOCH_MAX_GSA 8
+
+/* Most sentences in an epoch: one of each type, but all the GSAs */
+#define GCLUE_NMEA_EPOCH_MAX_SENTENCES \
+        (GCLUE_NMEA_EPOCH_N_TYPES - 1 + GCLUE_NMEA_EPOCH_MAX_GSA)
+
+/* The fix sentences of one epoch, i.e. one UTC time */
+typedef struct {
+        GTimeSpan time;         /* -1 until a sentence with a time came */
+        GTimeSpan last_time;    /* Of the last finished epoch */
+        guint     seen;         /* Bitmask of GClueNMEAEpochType */
+        guint     expected;     /* What the last finished epoch had */
+        guint     n_gsa;
+        guint     expected_gsa;
+        guint     rank[GCLUE_NMEA_EPOCH_N_TYPES];
+        char      sentences[GCLUE_NMEA_EPOCH_N_TYPES][GCLUE_NMEA_MAX_SENTENCE];
+        char      gsa[GCLUE_NMEA_EPOCH_MAX_GSA][GCLUE_NMEA_MAX_SENTENCE];
+} GClueNMEAEpoch;
+
 gboolean         gclue_nmea_type_is              (const char *msg, const char *nmeatype);
 GTimeSpan        gclue_nmea_timestamp_to_timespan (const gchar *timestamp);
+guint            gclue_nmea_talker_rank          (const char          *msg,
+                                                  const char * const  *talkers);
+
+gboolean         gclue_nmea_fields_parse         (GClueNMEAFields       *fields,
+                                                  const char            *msg);
+const char *     gclue_nmea_fields_get           (const GClueNMEAFields *fields,
+                                                  guint                  i,
+                                                  gsize                 *len);
+char             gclue_nmea_fields_get_char      (const GClueNMEAFields *fields,
+                                                  guint                  i);
+gboolean         gclue_nmea_fields_get_double    (const GClueNMEAFields *fields,
+                                                  guint                  i,
+                                                  gdouble               *value);
+gboolean         gclue_nmea_fields_get_uint      (const GClueNMEAFields *fields,
+                                                  guint                  i,
+                                                  guint                 *value);
+GTimeSpan        gclue_nmea_fields_get_timespan  (const GClueNMEAFields *fields,
+                                                  guint                  i);
+
+void             gclue_nmea_epoch_init           (GClueNMEAEpoch      *epoch);
+gboolean         gclue_nmea_epoch_is_next        (GClueNMEAEpoch      *epoch,
+                                                  const char          *msg);
+gboolean         gclue_nmea_epoch_add            (GClueNMEAEpoch      *epoch,
+                                                  const char          *msg,
+                                                  const char * const  *talkers);
+gboolean         gclue_nmea_epoch_is_empty       (GClueNMEAEpoch      *epoch);
+gboolean         gclue_nmea_epoch_is_complete    (GClueNMEAEpoch      *epoch);
+guint            gclue_nmea_epoch_get_sentences  (GClueNMEAEpoch      *epoch,
+                                                  const char          *sentences[]);
+void             gclue_nmea_epoch_finish         (GClueNMEAEpoch      *epoch);
+
+void             gclue_nmea_framer_init          (GClueNMEAFramer *framer);
+char *           gclue_nmea_framer_get_space     (GClueNMEAFramer *framer,
+                                                  gsize           *size);
+void             gclue_nmea_framer_commit        (GClueNMEAFramer *framer,
+                                                  gsize            n_read);
+const char *     gclue_nmea_framer_next_sentence (GClueNMEAFramer *framer);
+
+void             gclue_nmea_sky_view_init        (GClueNMEASkyView *sky_view);
+gboolean         gclue_nmea_sky_view_add_gsv     (GClueNMEASkyView *sky_view,
+                                                  const char       *msg);
+void             gclue_nmea_sky_view_add_gsa     (GClueNMEASkyView *sky_view,
+                                                  const char       *msg);
+gboolean         gclue_nmea_sky_view_is_used     (GClueNMEASkyView         *sky_view,
+                                                  const GClueNMEASatellite *satellite);
+
+gint             gclue_nmea_fuse_fixes           (const GClueLocationData *fixes[],
+                                                  guint                    n_fixes,
+                                                  GClueLocationData       *fused);
 
 G_END_DECLS
 
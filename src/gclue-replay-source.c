@@ -0,0 +1,568 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+#include "gclue-replay-source.h"
+#include "gclue-nmea-utils.h"
+#include "gclue-gpsd-json.h"
+#include "gclue-location.h"
+#include "gclue-clock.h"
+#include "gclue-config.h"
+#include "config.h"
+
+/* Longest wait between two fixes, so that a log made of several recording
+ * sessions doesn't stall for as long as there was between them.
+ * In microseconds.
+ */
+#define REPLAY_MAX_GAP (10 * G_USEC_PER_SEC)
+
+/* Wait between fixes whose times we can't tell apart.
+ * In microseconds.
+ */
+#define REPLAY_DEFAULT_GAP G_USEC_PER_SEC
+
+/* gpsd TPV modes */
+#define REPLAY_MODE_2D 2
+
+struct _GClueReplaySourcePrivate {
+        const char     *path;
+        GMappedFile    *file;
+        gsize           pos;            /* Of the next line to read */
+        char            line[GCLUE_GPSD_JSON_MAX_LINE];
+
+        GClueNMEAEpoch  epoch;
+
+        /* Fixes read from the log ahead of their time, of
+         * #GClueLocationData
+         */
+        GArray         *fixes;
+
+        /* The next fix, published once timer fires, and the one published
+         * before it.
+         */
+        GClueLocationData next_fix;
+        gboolean        has_next_fix;
+        GClueLocationData last_fix;
+        gboolean        has_last_fix;
+        guint           timer;
+
+        /* Times in the log, in microseconds since the Epoch, 0 if unknown:
+         * the one the dates of NMEA sentences are worked out from, i.e. that
+         * of the last fix read or of the record header, and those of the
+         * first and last fixes published in this pass over the log.
+         */
+        gint64          log_time;
+        gint64          first_time;
+        gint64          last_time;
+
+        /* Added to the times in the log to get those fixes are published
+         * with, so that the log plays back from when we were started on and
+         * keeps moving forward every time it starts over. The daemon's clock
+         * is left alone, other sources may be running off it.
+         */
+        gint64          time_offset;
+        gboolean        has_time_offset;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueReplaySource,
+                         gclue_replay_source,
+                         GCLUE_TYPE_LOCATION_SOURCE,
+                         G_ADD_PRIVATE (GClueReplaySource))
+
+static GClueLocationSourceStartResult
+gclue_replay_source_start (GClueLocationSource *source);
+static GClueLocationSourceStopResult
+gclue_replay_source_stop (GClueLocationSource *source);
+
+static gdouble
+replay_value_or (gdouble value,
+                 gdouble unknown)
+{
+        return isfinite (value) ? value : unknown;
+}
+
+static void
+set_accuracy_level (GClueReplaySource  *source,
+                    GClueAccuracyLevel  level)
+{
+        GClueAccuracyLevel existing;
+
+        existing = gclue_location_source_get_available_accuracy_level
+                        (GCLUE_LOCATION_SOURCE (source));
+        if (level == existing)
+                return;
+
+        g_debug ("Available accuracy level from %s: %u",
+                 G_OBJECT_TYPE_NAME (source), level);
+        g_object_set (G_OBJECT (source),
+                      "available-accuracy-level", level,
+                      NULL);
+}
+
+/* Copies the next line of the log into priv->line, without its line
+ * ending. Lines too long to be anything we know are cut short, which
+ * makes them fail to parse.
+ */
+static gboolean
+read_line (GClueReplaySource *source)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+        const char *contents, *end;
+        gsize size, len;
+
+        contents = g_mapped_file_get_contents (priv->file);
+        size = g_mapped_file_get_length (priv->file);
+        if (contents == NULL || priv->pos >= size)
+                return FALSE;
+
+        end = memchr (contents + priv->pos, '\n', size - priv->pos);
+        len = (end != NULL ? end - contents : size) - priv->pos;
+
+        if (len > 0 && contents[priv->pos + len - 1] == '\r')
+                len--;
+        if (len >= sizeof (priv->line))
+                len = sizeof (priv->line) - 1;
+
+        memcpy (priv->line, contents + priv->pos, len);
+        priv->line[len] = '\0';
+
+        priv->pos = end != NULL ? (gsize) (end - contents) + 1 : size;
+
+        return TRUE;
+}
+
+static const GClueLocationData *
+get_prev_location (GClueReplaySource *source)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+
+        if (priv->fixes->len > 0)
+                return &g_array_index (priv->fixes,
+                                       GClueLocationData,
+                                       priv->fixes->len - 1);
+        if (priv->has_next_fix)
+                return &priv->next_fix;
+        if (priv->has_last_fix)
+                return &priv->last_fix;
+
+        return NULL;
+}
+
+static void
+add_fix (GClueReplaySource       *source,
+         const GClueLocationData *fix)
+{
+        g_array_append_val (source->priv->fixes, *fix);
+        if (fix->timestamp > 0)
+                source->priv->log_time = fix->timestamp;
+}
+
+static void
+finish_epoch (GClueReplaySource *source)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+        GClueLocationData location;
+        const char *sentences[GCLUE_NMEA_EPOCH_MAX_SENTENCES + 1];
+
+        if (gclue_nmea_epoch_get_sentences (&priv->epoch, sentences) > 0 &&
+            gclue_location_data_from_nmeas_at (sentences,
+                                               get_prev_location (source),
+                                               priv->log_time,
+                                               &location))
+                add_fix (source, &location);
+
+        gclue_nmea_epoch_finish (&priv->epoch);
+}
+
+static void
+handle_header (GClueReplaySource *source,
+               const char        *line)
+{
+        const char *time_str = line + strlen (GCLUE_NMEA_RECORD_HEADER);
+        char *end;
+        gint64 time;
+
+        time = g_ascii_strtoll (time_str, &end, 10);
+        if (end == time_str || *end != '\0' || time <= 0) {
+                g_debug ("Invalid record header in %s: \"%s\"",
+                         source->priv->path, line);
+                return;
+        }
+
+        /* What was read before is of the previous recording session */
+        finish_epoch (source);
+
+        /* The sentences that follow only have the time of day, this tells
+         * them which day it is.
+         */
+        source->priv->log_time = time;
+}
+
+static void
+handle_nmea (GClueReplaySource *source,
+             const char        *line)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+        const char * const *talkers;
+
+        talkers = gclue_config_get_nmea_talker_priority
+                (gclue_config_get_singleton ());
+
+        if (gclue_nmea_epoch_is_next (&priv->epoch, line))
+                finish_epoch (source);
+
+        if (gclue_nmea_epoch_add (&priv->epoch, line, talkers) &&
+            gclue_nmea_epoch_is_complete (&priv->epoch))
+                finish_epoch (source);
+}
+
+static void
+handle_json (GClueReplaySource *source,
+             const char        *line)
+{
+        GClueGpsdReport report;
+        GClueLocationData location;
+        gdouble accuracy;
+
+        if (!gclue_gpsd_json_parse (line, &report) ||
+            report.report_class != GCLUE_GPSD_REPORT_TPV ||
+            report.mode < REPLAY_MODE_2D ||
+            !isfinite (report.latitude) ||
+            !isfinite (report.longitude))
+                return;
+
+        if (isfinite (report.eph))
+                accuracy = report.eph;
+        else if (isfinite (report.epx) && isfinite (report.epy))
+                accuracy = MAX (report.epx, report.epy);
+        else
+                accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN;
+
+        location = (GClueLocationData) {
+                .latitude = report.latitude,
+                .longitude = report.longitude,
+                .accuracy = accuracy,
+                .altitude = replay_value_or (report.altitude,
+                                             GCLUE_LOCATION_ALTITUDE_UNKNOWN),
+                .altitude_accuracy = replay_value_or
+                        (report.epv, GCLUE_LOCATION_ACCURACY_UNKNOWN),
+                .speed = replay_value_or (report.speed,
+                                          GCLUE_LOCATION_SPEED_UNKNOWN),
+                .speed_accuracy = replay_value_or
+                        (report.eps, GCLUE_LOCATION_ACCURACY_UNKNOWN),
+                .heading = replay_value_or (report.track,
+                                            GCLUE_LOCATION_HEADING_UNKNOWN),
+                .heading_accuracy = replay_value_or
+                        (report.epd, GCLUE_LOCATION_ACCURACY_UNKNOWN),
+                .climb = replay_value_or (report.climb,
+                                          GCLUE_LOCATION_CLIMB_UNKNOWN),
+                .timestamp = report.time,
+                .description = "Replayed location",
+        };
+        add_fix (source, &location);
+}
+
+/* Reads the log up to its next fix. Returns FALSE at its end. */
+static gboolean
+read_next_fix (GClueReplaySource *source,
+               GClueLocationData *fix)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+
+        while (priv->fixes->len == 0 && read_line (source)) {
+                const char *line = priv->line;
+
+                if (g_str_has_prefix (line, GCLUE_NMEA_RECORD_HEADER))
+                        handle_header (source, line);
+                else if (line[0] == '$')
+                        handle_nmea (source, line);
+                else if (line[0] == '{')
+                        handle_json (source, line);
+        }
+
+        /* The last epoch of the log has nothing coming after it */
+        if (priv->fixes->len == 0)
+                finish_epoch (source);
+
+        if (priv->fixes->len == 0)
+                return FALSE;
+
+        *fix = g_array_index (priv->fixes, GClueLocationData, 0);
+        g_array_remove_index (priv->fixes, 0);
+
+        return TRUE;
+}
+
+static void
+rewind_log (GClueReplaySource *source)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+
+        priv->pos = 0;
+        priv->has_last_fix = FALSE;
+        priv->log_time = 0;
+        priv->first_time = 0;
+        priv->last_time = 0;
+        gclue_nmea_epoch_init (&priv->epoch);
+        g_array_set_size (priv->fixes, 0);
+}
+
+/* Starts the log over, its fixes being published as if it had been
+ * recorded right after what was played back so far.
+ */
+static void
+loop_log (GClueReplaySource *source)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+
+        if (priv->has_time_offset && priv->first_time > 0)
+                priv->time_offset += priv->last_time - priv->first_time +
+                                     REPLAY_DEFAULT_GAP;
+        rewind_log (source);
+}
+
+static void
+schedule_next_fix (GClueReplaySource *source);
+
+static gboolean
+on_replay_timer (gpointer user_data)
+{
+        GClueReplaySource *source = GCLUE_REPLAY_SOURCE (user_data);
+        GClueReplaySourcePrivate *priv = source->priv;
+        GClueLocationData location = priv->next_fix;
+
+        priv->timer = 0;
+        priv->has_next_fix = FALSE;
+        priv->last_fix = location;
+        priv->has_last_fix = TRUE;
+
+        if (location.timestamp > 0) {
+                if (!priv->has_time_offset) {
+                        priv->time_offset = gclue_clock_get_real_time () -
+                                            location.timestamp;
+                        priv->has_time_offset = TRUE;
+                }
+                if (priv->first_time == 0)
+                        priv->first_time = location.timestamp;
+                priv->last_time = location.timestamp;
+
+                location.timestamp += priv->time_offset;
+        }
+
+        g_debug ("Replaying fix from %s: Latitude: %f, Longitude: %f, "
+                 "Accuracy: %f meters",
+                 priv->path,
+                 location.latitude,
+                 location.longitude,
+                 location.accuracy);
+
+        gclue_location_source_set_location_data (GCLUE_LOCATION_SOURCE (source),
+                                                 &location);
+
+        /* Publishing a fix can get us stopped */
+        if (priv->file != NULL)
+                schedule_next_fix (source);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_next_fix (GClueReplaySource *source)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+        gdouble speed;
+        gint64 time;
+        GTimeSpan delay;
+
+        priv->has_next_fix = read_next_fix (source, &priv->next_fix);
+        if (!priv->has_next_fix &&
+            gclue_config_get_replay_loop (gclue_config_get_singleton ())) {
+                g_debug ("End of %s, starting over", priv->path);
+                loop_log (source);
+                priv->has_next_fix = read_next_fix (source, &priv->next_fix);
+        }
+
+        if (!priv->has_next_fix) {
+                g_debug ("End of %s, no more fixes to replay", priv->path);
+                return;
+        }
+
+        time = priv->next_fix.timestamp;
+        if (priv->last_time == 0)
+                delay = 0;
+        else if (time <= 0)
+                delay = REPLAY_DEFAULT_GAP;
+        else
+                delay = CLAMP (time - priv->last_time, 0, REPLAY_MAX_GAP);
+
+        speed = gclue_config_get_replay_speed (gclue_config_get_singleton ());
+        if (speed > 0)
+                delay = delay / speed;
+        else
+                delay = 0;
+
+        priv->timer = g_timeout_add (delay / 1000, on_replay_timer, source);
+}
+
+static gboolean
+open_log (GClueReplaySource *source)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+        g_autoptr(GError) error = NULL;
+
+        priv->file = g_mapped_file_new (priv->path, FALSE, &error);
+        if (priv->file == NULL) {
+                g_warning ("Failed to open replay log %s: %s",
+                           priv->path, error->message);
+                return FALSE;
+        }
+
+        g_debug ("Replaying %s", priv->path);
+        rewind_log (source);
+        priv->has_time_offset = FALSE;
+
+        return TRUE;
+}
+
+static void
+close_log (GClueReplaySource *source)
+{
+        GClueReplaySourcePrivate *priv = source->priv;
+
+        if (priv->timer) {
+                g_source_remove (priv->timer);
+                priv->timer = 0;
+        }
+        priv->has_next_fix = FALSE;
+        g_array_set_size (priv->fixes, 0);
+        g_clear_pointer (&priv->file, g_mapped_file_unref);
+}
+
+static void
+gclue_replay_source_finalize (GObject *greplay)
+{
+        GClueReplaySourcePrivate *priv = GCLUE_REPLAY_SOURCE (greplay)->priv;
+
+        close_log (GCLUE_REPLAY_SOURCE (greplay));
+        g_clear_pointer (&priv->fixes, g_array_unref);
+
+        G_OBJECT_CLASS (gclue_replay_source_parent_class)->finalize (greplay);
+}
+
+static void
+gclue_replay_source_class_init (GClueReplaySourceClass *klass)
+{
+        GClueLocationSourceClass *source_class = GCLUE_LOCATION_SOURCE_CLASS (klass);
+        GObjectClass *greplay_class = G_OBJECT_CLASS (klass);
+
+        greplay_class->finalize = gclue_replay_source_finalize;
+
+        source_class->start = gclue_replay_source_start;
+        source_class->stop = gclue_replay_source_stop;
+}
+
+static void
+gclue_replay_source_init (GClueReplaySource *source)
+{
+        GClueReplaySourcePrivate *priv;
+
+        source->priv = gclue_replay_source_get_instance_private (source);
+        priv = source->priv;
+
+        priv->path = gclue_config_get_replay_file
+                (gclue_config_get_singleton ());
+        priv->fixes = g_array_new (FALSE, FALSE, sizeof (GClueLocationData));
+        gclue_nmea_epoch_init (&priv->epoch);
+
+        if (priv->path != NULL &&
+            g_file_test (priv->path, G_FILE_TEST_IS_REGULAR))
+                set_accuracy_level (source, GCLUE_ACCURACY_LEVEL_EXACT);
+}
+
+/**
+ * gclue_replay_source_get_singleton:
+ *
+ * Get the #GClueReplaySource singleton.
+ *
+ * Returns: (transfer full): a new ref to #GClueReplaySource. Use g_object_unref()
+ * when done.
+ **/
+GClueReplaySource *
+gclue_replay_source_get_singleton (void)
+{
+        static GClueReplaySource *source = NULL;
+
+        if (source == NULL) {
+                source = g_object_new (GCLUE_TYPE_REPLAY_SOURCE,
+                                       "priority-source", TRUE,
+                                       NULL);
+                g_object_add_weak_pointer (G_OBJECT (source),
+                                           (gpointer) &source);
+        } else
+                g_object_ref (source);
+
+        return source;
+}
+
+static GClueLocationSourceStartResult
+gclue_replay_source_start (GClueLocationSource *source)
+{
+        GClueLocationSourceClass *base_class;
+        GClueLocationSourceStartResult base_result;
+        GClueReplaySource *replay;
+
+        g_return_val_if_fail (GCLUE_IS_REPLAY_SOURCE (source),
+                              GCLUE_LOCATION_SOURCE_START_RESULT_FAILED);
+        replay = GCLUE_REPLAY_SOURCE (source);
+
+        base_class = GCLUE_LOCATION_SOURCE_CLASS (gclue_replay_source_parent_class);
+        base_result = base_class->start (source);
+        if (base_result != GCLUE_LOCATION_SOURCE_START_RESULT_OK)
+                return base_result;
+
+        /* Every time we are started, the log is played from its beginning */
+        if (open_log (replay))
+                schedule_next_fix (replay);
+        else
+                set_accuracy_level (replay, GCLUE_ACCURACY_LEVEL_NONE);
+
+        return base_result;
+}
+
+static GClueLocationSourceStopResult
+gclue_replay_source_stop (GClueLocationSource *source)
+{
+        GClueLocationSourceClass *base_class;
+        GClueLocationSourceStopResult base_result;
+
+        g_return_val_if_fail (GCLUE_IS_REPLAY_SOURCE (source), FALSE);
+
+        base_class = GCLUE_LOCATION_SOURCE_CLASS (gclue_replay_source_parent_class);
+        base_result = base_class->stop (source);
+        if (base_result != GCLUE_LOCATION_SOURCE_STOP_RESULT_OK)
+                return base_result;
+
+        close_log (GCLUE_REPLAY_SOURCE (source));
+
+        return base_result;
+}
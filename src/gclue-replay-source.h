@@ -0,0 +1,69 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#ifndef GCLUE_REPLAY_SOURCE_H
+#define GCLUE_REPLAY_SOURCE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "gclue-location-source.h"
+
+G_BEGIN_DECLS
+
+GType gclue_replay_source_get_type (void) G_GNUC_CONST;
+
+#define GCLUE_TYPE_REPLAY_SOURCE            (gclue_replay_source_get_type ())
+#define GCLUE_REPLAY_SOURCE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_REPLAY_SOURCE, GClueReplaySource))
+#define GCLUE_IS_REPLAY_SOURCE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_REPLAY_SOURCE))
+#define GCLUE_REPLAY_SOURCE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GCLUE_TYPE_REPLAY_SOURCE, GClueReplaySourceClass))
+#define GCLUE_IS_REPLAY_SOURCE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GCLUE_TYPE_REPLAY_SOURCE))
+#define GCLUE_REPLAY_SOURCE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GCLUE_TYPE_REPLAY_SOURCE, GClueReplaySourceClass))
+
+/**
+ * GClueReplaySource:
+ *
+ * All the fields in the #GClueReplaySource structure are private and should never be accessed directly.
+**/
+typedef struct _GClueReplaySource GClueReplaySource;
+typedef struct _GClueReplaySourceClass GClueReplaySourceClass;
+typedef struct _GClueReplaySourcePrivate GClueReplaySourcePrivate;
+
+struct _GClueReplaySource {
+        /* <private> */
+        GClueLocationSource parent_instance;
+        GClueReplaySourcePrivate *priv;
+};
+
+/**
+ * GClueReplaySourceClass:
+ *
+ * All the fields in the #GClueReplaySourceClass structure are private and should never be accessed directly.
+**/
+struct _GClueReplaySourceClass {
+        /* <private> */
+        GClueLocationSourceClass parent_class;
+};
+
+GClueReplaySource *gclue_replay_source_get_singleton (void);
+
+G_END_DECLS
+
+#endif /* GCLUE_REPLAY_SOURCE_H */
@@ -0,0 +1,126 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <gio/gio.h>
+#include "gclue-serial.h"
+
+static speed_t
+baud_rate_to_speed (guint baud_rate)
+{
+        switch (baud_rate) {
+        case 4800:
+                return B4800;
+        case 9600:
+                return B9600;
+        case 19200:
+                return B19200;
+        case 38400:
+                return B38400;
+        case 57600:
+                return B57600;
+        case 115200:
+                return B115200;
+        case 230400:
+                return B230400;
+        default:
+                return B0;
+        }
+}
+
+/**
+ * gclue_serial_open:
+ * @path: the serial device
+ * @baud_rate: the baud rate the receiver on @path sends at
+ * @error: return location for a #GError, or %NULL
+ *
+ * Opens @path for non-blocking reads of raw 8N1 data at @baud_rate.
+ *
+ * Returns: the file descriptor, or -1 on failure.
+ **/
+gint
+gclue_serial_open (const char *path,
+                   guint       baud_rate,
+                   GError    **error)
+{
+        struct termios tio;
+        speed_t speed;
+        gint fd, errsv;
+
+        speed = baud_rate_to_speed (baud_rate);
+        if (speed == B0) {
+                g_set_error (error,
+                             G_IO_ERROR,
+                             G_IO_ERROR_INVALID_ARGUMENT,
+                             "Unsupported baud rate %u",
+                             baud_rate);
+                return -1;
+        }
+
+        fd = open (path, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0)
+                goto fail;
+
+        if (tcgetattr (fd, &tio) < 0)
+                goto fail_close;
+
+        cfmakeraw (&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        if (cfsetispeed (&tio, speed) < 0 ||
+            cfsetospeed (&tio, speed) < 0 ||
+            tcsetattr (fd, TCSANOW, &tio) < 0)
+                goto fail_close;
+
+        gclue_serial_flush (fd);
+
+        return fd;
+
+fail_close:
+        errsv = errno;
+        close (fd);
+        errno = errsv;
+fail:
+        errsv = errno;
+        g_set_error (error,
+                     G_IO_ERROR,
+                     g_io_error_from_errno (errsv),
+                     "%s",
+                     g_strerror (errsv));
+        return -1;
+}
+
+/**
+ * gclue_serial_flush:
+ * @fd: a serial device opened with gclue_serial_open()
+ *
+ * Drops whatever the receiver sent while nobody was reading, it's stale.
+ **/
+void
+gclue_serial_flush (gint fd)
+{
+        tcflush (fd, TCIFLUSH);
+}
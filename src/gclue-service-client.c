@@ -24,6 +24,7 @@
 
 #include "gclue-service-client.h"
 #include "gclue-service-location.h"
+#include "gclue-service-satellites.h"
 #include "gclue-locator.h"
 #include "gclue-enum-types.h"
 #include "gclue-config.h"
@@ -49,7 +50,12 @@ struct _GClueServiceClientPrivate
 
         GClueServiceLocation *location;
         GClueServiceLocation *prev_location;
-        GClueLocation *signaled_location;
+        /* Without its description, which isn't ours */
+        GClueLocationData signaled_location;
+        gboolean has_signaled_location;
+        /* Where signaled_location is, for gclue_locator_get_reference_distance() */
+        guint reference;
+        GClueServiceSatellites *satellites;
         guint distance_threshold;
         guint time_threshold;
 
@@ -121,8 +127,8 @@ emit_location_updated (GClueServiceClient *client,
 }
 
 static gboolean
-distance_below_threshold (GClueServiceClient *client,
-                          GClueLocation      *location)
+distance_below_threshold (GClueServiceClient      *client,
+                          const GClueLocationData *location)
 {
         GClueServiceClientPrivate *priv = client->priv;
         gdouble distance;
@@ -131,11 +137,11 @@ distance_below_threshold (GClueServiceClient *client,
         if (priv->distance_threshold == 0)
                 return FALSE;
 
-        if (!priv->signaled_location)
+        if (!priv->has_signaled_location)
                 return FALSE;
 
-        distance = gclue_location_get_distance_from (priv->signaled_location,
-                                                     location);
+        distance = gclue_locator_get_reference_distance (priv->reference,
+                                                         location);
         threshold = priv->distance_threshold;
         if (distance < threshold) {
                 g_debug ("Distance from previous location is %f m and "
@@ -148,8 +154,8 @@ distance_below_threshold (GClueServiceClient *client,
 }
 
 static gboolean
-time_below_threshold (GClueServiceClient *client,
-                      GClueLocation      *location)
+time_below_threshold (GClueServiceClient      *client,
+                      const GClueLocationData *location)
 {
         GClueServiceClientPrivate *priv = client->priv;
         gint64 cur_ts, new_ts;
@@ -158,16 +164,16 @@ time_below_threshold (GClueServiceClient *client,
         if (priv->time_threshold == 0)
                 return FALSE;
 
-        if (!priv->signaled_location)
+        if (!priv->has_signaled_location)
                 return FALSE;
 
-        cur_ts = gclue_location_get_timestamp (priv->signaled_location);
-        new_ts = gclue_location_get_timestamp (location);
+        cur_ts = priv->signaled_location.timestamp;
+        new_ts = location->timestamp;
         diff_ts = ABS (new_ts - cur_ts);
 
-        if (diff_ts < priv->time_threshold) {
+        if (diff_ts < (guint64) priv->time_threshold * G_USEC_PER_SEC) {
                 g_debug ("Time difference between previous and new location"
-                         " is %" G_GUINT64_FORMAT " seconds and"
+                         " is %" G_GUINT64_FORMAT " microseconds and"
                          " below threshold of %" G_GUINT32_FORMAT " seconds.",
                          diff_ts, priv->time_threshold);
                 return TRUE;
@@ -177,8 +183,8 @@ time_below_threshold (GClueServiceClient *client,
 }
 
 static gboolean
-below_threshold (GClueServiceClient *client,
-                 GClueLocation      *location)
+below_threshold (GClueServiceClient      *client,
+                 const GClueLocationData *location)
 {
         return (distance_below_threshold (client, location) ||
                 time_below_threshold (client, location));
@@ -200,20 +206,19 @@ on_locator_location_changed (GObject    *gobject,
         GClueServiceClient *client = GCLUE_SERVICE_CLIENT (user_data);
         GClueServiceClientPrivate *priv = client->priv;
         GClueLocationSource *locator = GCLUE_LOCATION_SOURCE (gobject);
-        GClueLocation *new_location;
+        const GClueLocationData *new_location;
         g_autofree char *path = NULL;
         const char *prev_path;
         g_autoptr(GError) error = NULL;
 
-        new_location = gclue_location_source_get_location (locator);
+        new_location = gclue_location_source_get_location_data (locator);
         if (new_location == NULL)
                 return; /* No location found yet */
 
         if (priv->location != NULL && below_threshold (client, new_location)) {
                 g_debug ("Updating location, below threshold");
-                g_object_set (priv->location,
-                              "location", new_location,
-                              NULL);
+                gclue_service_location_set_location_data (priv->location,
+                                                          new_location);
                 return;
         }
 
@@ -239,8 +244,10 @@ on_locator_location_changed (GObject    *gobject,
 
         gclue_dbus_client_set_location (GCLUE_DBUS_CLIENT (client), path);
 
-        g_clear_object (&priv->signaled_location);
-        priv->signaled_location = g_object_ref (new_location);
+        priv->signaled_location = *new_location;
+        priv->signaled_location.description = NULL;
+        priv->has_signaled_location = TRUE;
+        gclue_locator_set_reference (priv->reference, new_location);
 
         if (!emit_location_updated (client, prev_path, path, &error))
                 goto error_out;
@@ -251,6 +258,19 @@ error_out:
         g_warning ("Failed to update location info: %s", error->message);
 }
 
+static void
+on_locator_satellites_changed (GObject    *gobject,
+                               GParamSpec *pspec,
+                               gpointer    user_data)
+{
+        GClueServiceClient *client = GCLUE_SERVICE_CLIENT (user_data);
+        GClueLocationSource *locator = GCLUE_LOCATION_SOURCE (gobject);
+
+        gclue_service_satellites_update
+                (client->priv->satellites,
+                 gclue_location_source_get_satellites (locator));
+}
+
 static void
 start_client (GClueServiceClient *client, GClueAccuracyLevel accuracy_level)
 {
@@ -263,6 +283,10 @@ start_client (GClueServiceClient *client, GClueAccuracyLevel accuracy_level)
                                  "notify::location",
                                  G_CALLBACK (on_locator_location_changed),
                                  client, 0);
+        g_signal_connect_object (priv->locator,
+                                 "notify::satellites",
+                                 G_CALLBACK (on_locator_satellites_changed),
+                                 client, 0);
 
         gclue_location_source_start (GCLUE_LOCATION_SOURCE (priv->locator));
 }
@@ -650,8 +674,9 @@ gclue_service_client_finalize (GObject *object)
         g_clear_object (&priv->locator);
         g_clear_object (&priv->location);
         g_clear_object (&priv->prev_location);
-        g_clear_object (&priv->signaled_location);
+        g_clear_object (&priv->satellites);
         g_clear_object (&priv->client_info);
+        gclue_locator_remove_reference (priv->reference);
 
         /* Chain up to the parent class */
         G_OBJECT_CLASS (gclue_service_client_parent_class)->finalize (object);
@@ -923,13 +948,24 @@ gclue_service_client_initable_init (GInitable    *initable,
                                     GCancellable *cancellable,
                                     GError      **error)
 {
+        GClueServiceClientPrivate *priv = GCLUE_SERVICE_CLIENT (initable)->priv;
+        g_autofree char *satellites_path = NULL;
+
         if (!g_dbus_interface_skeleton_export
                                 (G_DBUS_INTERFACE_SKELETON (initable),
-                                 GCLUE_SERVICE_CLIENT (initable)->priv->connection,
-                                 GCLUE_SERVICE_CLIENT (initable)->priv->path,
+                                 priv->connection,
+                                 priv->path,
                                  error))
                 return FALSE;
 
+        satellites_path = g_strjoin ("/", priv->path, "Satellites", NULL);
+        priv->satellites = gclue_service_satellites_new (priv->client_info,
+                                                         satellites_path,
+                                                         priv->connection,
+                                                         error);
+        if (priv->satellites == NULL)
+                return FALSE;
+
         return TRUE;
 }
 
@@ -943,6 +979,7 @@ static void
 gclue_service_client_init (GClueServiceClient *client)
 {
         client->priv = gclue_service_client_get_instance_private (client);
+        client->priv->reference = gclue_locator_add_reference ();
         gclue_dbus_client_set_requested_accuracy_level
                 (GCLUE_DBUS_CLIENT (client), DEFAULT_ACCURACY_LEVEL);
 }
@@ -106,7 +106,11 @@ gclue_service_location_get_property (GObject    *object,
                          gclue_dbus_location_get_speed (location),
                          gclue_dbus_location_get_heading (location),
                          gclue_dbus_location_get_altitude (location),
-                         sec,
+                         gclue_dbus_location_get_altitude_accuracy (location),
+                         gclue_dbus_location_get_speed_accuracy (location),
+                         gclue_dbus_location_get_heading_accuracy (location),
+                         gclue_dbus_location_get_climb (location),
+                         sec * G_USEC_PER_SEC + usec,
                          gclue_dbus_location_get_description (location));
 
                 g_value_take_object (value, loc);
@@ -140,37 +144,9 @@ gclue_service_location_set_property (GObject      *object,
                 break;
 
         case PROP_LOCATION:
-        {
-                GClueDBusLocation *location;
-                GClueLocation *loc;
-                gdouble altitude;
-                GVariant *timestamp;
-
-                location = GCLUE_DBUS_LOCATION (object);
-                loc = g_value_get_object (value);
-                gclue_dbus_location_set_latitude
-                        (location, gclue_location_get_latitude (loc));
-                gclue_dbus_location_set_longitude
-                        (location, gclue_location_get_longitude (loc));
-                gclue_dbus_location_set_accuracy
-                        (location, gclue_location_get_accuracy (loc));
-                gclue_dbus_location_set_description
-                        (location, gclue_location_get_description (loc));
-                gclue_dbus_location_set_speed
-                        (location, gclue_location_get_speed (loc));
-                gclue_dbus_location_set_heading
-                        (location, gclue_location_get_heading (loc));
-                timestamp = g_variant_new
-                        ("(tt)",
-                         (guint64) gclue_location_get_timestamp (loc),
-                         (guint64) 0);
-                gclue_dbus_location_set_timestamp
-                        (location, timestamp);
-                altitude = gclue_location_get_altitude (loc);
-                if (altitude != GCLUE_LOCATION_ALTITUDE_UNKNOWN)
-                        gclue_dbus_location_set_altitude (location, altitude);
+                gclue_service_location_set_location_data
+                        (self, gclue_location_peek_data (g_value_get_object (value)));
                 break;
-        }
 
         default:
                 G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -372,20 +348,69 @@ gclue_service_location_initable_iface_init (GInitableIface *iface)
 }
 
 GClueServiceLocation *
-gclue_service_location_new (GClueClientInfo *info,
-                            const char      *path,
-                            GDBusConnection *connection,
-                            GClueLocation   *location,
-                            GError         **error)
+gclue_service_location_new (GClueClientInfo         *info,
+                            const char              *path,
+                            GDBusConnection         *connection,
+                            const GClueLocationData *location,
+                            GError                 **error)
+{
+        GClueServiceLocation *self;
+
+        self = g_object_new (GCLUE_TYPE_SERVICE_LOCATION,
+                             "client-info", info,
+                             "path", path,
+                             "connection", connection,
+                             NULL);
+
+        /* Set before exporting, so clients never see it without one */
+        gclue_service_location_set_location_data (self, location);
+
+        if (!g_initable_init (G_INITABLE (self), NULL, error)) {
+                g_object_unref (self);
+
+                return NULL;
+        }
+
+        return self;
+}
+
+/**
+ * gclue_service_location_set_location_data:
+ * @location: a #GClueServiceLocation
+ * @data: the new location
+ *
+ * Updates the D-Bus properties of @location to @data.
+ **/
+void
+gclue_service_location_set_location_data (GClueServiceLocation    *location,
+                                          const GClueLocationData *data)
 {
-        return g_initable_new (GCLUE_TYPE_SERVICE_LOCATION,
-                               NULL,
-                               error,
-                               "client-info", info,
-                               "path", path,
-                               "connection", connection,
-                               "location", location,
-                               NULL);
+        GClueDBusLocation *dbus_location;
+
+        g_return_if_fail (GCLUE_IS_SERVICE_LOCATION (location));
+
+        dbus_location = GCLUE_DBUS_LOCATION (location);
+        gclue_dbus_location_set_latitude (dbus_location, data->latitude);
+        gclue_dbus_location_set_longitude (dbus_location, data->longitude);
+        gclue_dbus_location_set_accuracy (dbus_location, data->accuracy);
+        gclue_dbus_location_set_description (dbus_location, data->description);
+        gclue_dbus_location_set_speed (dbus_location, data->speed);
+        gclue_dbus_location_set_heading (dbus_location, data->heading);
+        gclue_dbus_location_set_altitude_accuracy (dbus_location,
+                                                   data->altitude_accuracy);
+        gclue_dbus_location_set_speed_accuracy (dbus_location,
+                                                data->speed_accuracy);
+        gclue_dbus_location_set_heading_accuracy (dbus_location,
+                                                  data->heading_accuracy);
+        gclue_dbus_location_set_climb (dbus_location, data->climb);
+        gclue_dbus_location_set_timestamp
+                (dbus_location,
+                 g_variant_new ("(tt)",
+                                data->timestamp / G_USEC_PER_SEC,
+                                data->timestamp % G_USEC_PER_SEC));
+        if (data->altitude != GCLUE_LOCATION_ALTITUDE_UNKNOWN)
+                gclue_dbus_location_set_altitude (dbus_location,
+                                                  data->altitude);
 }
 
 const gchar *
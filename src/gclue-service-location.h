@@ -60,9 +60,12 @@ GType gclue_service_location_get_type (void) G_GNUC_CONST;
 GClueServiceLocation * gclue_service_location_new      (GClueClientInfo      *info,
                                                         const char           *path,
                                                         GDBusConnection      *connection,
-                                                        GClueLocation        *location,
+                                                        const GClueLocationData *location,
                                                         GError              **error);
 const char *           gclue_service_location_get_path (GClueServiceLocation *location);
+void                   gclue_service_location_set_location_data
+                                                       (GClueServiceLocation    *location,
+                                                        const GClueLocationData *data);
 
 G_END_DECLS
 
@@ -0,0 +1,399 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-service-satellites.c
+ *
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <glib/gi18n.h>
+
+#include "gclue-service-satellites.h"
+#include "gclue-location-source.h"
+#include "gclue-clock.h"
+
+static void
+gclue_service_satellites_initable_iface_init (GInitableIface *iface);
+
+struct _GClueServiceSatellitesPrivate
+{
+        GClueClientInfo *client_info;
+        char *path;
+        GDBusConnection *connection;
+
+        /* Monotonic time of the last update, in microseconds */
+        gint64 last_update;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueServiceSatellites,
+                         gclue_service_satellites,
+                         GCLUE_DBUS_TYPE_SATELLITES_SKELETON,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE,
+                                                gclue_service_satellites_initable_iface_init)
+                         G_ADD_PRIVATE (GClueServiceSatellites));
+
+enum
+{
+        PROP_0,
+        PROP_CLIENT_INFO,
+        PROP_PATH,
+        PROP_CONNECTION,
+        LAST_PROP
+};
+
+static GParamSpec *gParamSpecs[LAST_PROP];
+
+static void
+gclue_service_satellites_finalize (GObject *object)
+{
+        GClueServiceSatellitesPrivate *priv = GCLUE_SERVICE_SATELLITES (object)->priv;
+
+        g_clear_pointer (&priv->path, g_free);
+        g_clear_object (&priv->connection);
+        g_clear_object (&priv->client_info);
+
+        /* Chain up to the parent class */
+        G_OBJECT_CLASS (gclue_service_satellites_parent_class)->finalize (object);
+}
+
+static void
+gclue_service_satellites_get_property (GObject    *object,
+                                       guint       prop_id,
+                                       GValue     *value,
+                                       GParamSpec *pspec)
+{
+        GClueServiceSatellites *self = GCLUE_SERVICE_SATELLITES (object);
+
+        switch (prop_id) {
+        case PROP_CLIENT_INFO:
+                g_value_set_object (value, self->priv->client_info);
+                break;
+
+        case PROP_PATH:
+                g_value_set_string (value, self->priv->path);
+                break;
+
+        case PROP_CONNECTION:
+                g_value_set_object (value, self->priv->connection);
+                break;
+
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        }
+}
+
+static void
+gclue_service_satellites_set_property (GObject      *object,
+                                       guint         prop_id,
+                                       const GValue *value,
+                                       GParamSpec   *pspec)
+{
+        GClueServiceSatellites *self = GCLUE_SERVICE_SATELLITES (object);
+
+        switch (prop_id) {
+        case PROP_CLIENT_INFO:
+                self->priv->client_info = g_value_dup_object (value);
+                break;
+
+        case PROP_PATH:
+                self->priv->path = g_value_dup_string (value);
+                break;
+
+        case PROP_CONNECTION:
+                self->priv->connection = g_value_dup_object (value);
+                break;
+
+        default:
+                G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        }
+}
+
+static void
+gclue_service_satellites_handle_method_call (GDBusConnection       *connection,
+                                             const gchar           *sender,
+                                             const gchar           *object_path,
+                                             const gchar           *interface_name,
+                                             const gchar           *method_name,
+                                             GVariant              *parameters,
+                                             GDBusMethodInvocation *invocation,
+                                             gpointer               user_data)
+{
+        GClueServiceSatellitesPrivate *priv = GCLUE_SERVICE_SATELLITES (user_data)->priv;
+        GDBusInterfaceSkeletonClass *skeleton_class;
+        GDBusInterfaceVTable *skeleton_vtable;
+
+        if (!gclue_client_info_check_bus_name (priv->client_info, sender)) {
+                g_dbus_method_invocation_return_error_literal (invocation,
+                                                               G_DBUS_ERROR,
+                                                               G_DBUS_ERROR_ACCESS_DENIED,
+                                                               "Access denied");
+                return;
+        }
+
+        skeleton_class = G_DBUS_INTERFACE_SKELETON_CLASS (gclue_service_satellites_parent_class);
+        skeleton_vtable = skeleton_class->get_vtable (G_DBUS_INTERFACE_SKELETON (user_data));
+        skeleton_vtable->method_call (connection,
+                                      sender,
+                                      object_path,
+                                      interface_name,
+                                      method_name,
+                                      parameters,
+                                      invocation,
+                                      user_data);
+}
+
+static GVariant *
+gclue_service_satellites_handle_get_property (GDBusConnection *connection,
+                                              const gchar     *sender,
+                                              const gchar     *object_path,
+                                              const gchar     *interface_name,
+                                              const gchar     *property_name,
+                                              GError         **error,
+                                              gpointer        user_data)
+{
+        GClueServiceSatellitesPrivate *priv = GCLUE_SERVICE_SATELLITES (user_data)->priv;
+        GDBusInterfaceSkeletonClass *skeleton_class;
+        GDBusInterfaceVTable *skeleton_vtable;
+
+        if (!gclue_client_info_check_bus_name (priv->client_info, sender)) {
+                g_set_error (error,
+                             G_DBUS_ERROR,
+                             G_DBUS_ERROR_ACCESS_DENIED,
+                             "Access denied");
+                return NULL;
+        }
+
+        skeleton_class = G_DBUS_INTERFACE_SKELETON_CLASS (gclue_service_satellites_parent_class);
+        skeleton_vtable = skeleton_class->get_vtable (G_DBUS_INTERFACE_SKELETON (user_data));
+        return skeleton_vtable->get_property (connection,
+                                              sender,
+                                              object_path,
+                                              interface_name,
+                                              property_name,
+                                              error,
+                                              user_data);
+}
+
+static gboolean
+gclue_service_satellites_handle_set_property (GDBusConnection *connection,
+                                              const gchar     *sender,
+                                              const gchar     *object_path,
+                                              const gchar     *interface_name,
+                                              const gchar     *property_name,
+                                              GVariant        *variant,
+                                              GError         **error,
+                                              gpointer        user_data)
+{
+        GClueServiceSatellitesPrivate *priv = GCLUE_SERVICE_SATELLITES (user_data)->priv;
+        GDBusInterfaceSkeletonClass *skeleton_class;
+        GDBusInterfaceVTable *skeleton_vtable;
+
+        if (!gclue_client_info_check_bus_name (priv->client_info, sender)) {
+                g_set_error (error,
+                             G_DBUS_ERROR,
+                             G_DBUS_ERROR_ACCESS_DENIED,
+                             "Access denied");
+                return FALSE;
+        }
+
+        skeleton_class = G_DBUS_INTERFACE_SKELETON_CLASS (gclue_service_satellites_parent_class);
+        skeleton_vtable = skeleton_class->get_vtable (G_DBUS_INTERFACE_SKELETON (user_data));
+        return skeleton_vtable->set_property (connection,
+                                              sender,
+                                              object_path,
+                                              interface_name,
+                                              property_name,
+                                              variant,
+                                              error,
+                                              user_data);
+}
+
+static const GDBusInterfaceVTable gclue_service_satellites_vtable =
+{
+        gclue_service_satellites_handle_method_call,
+        gclue_service_satellites_handle_get_property,
+        gclue_service_satellites_handle_set_property,
+        {NULL}
+};
+
+static GDBusInterfaceVTable *
+gclue_service_satellites_get_vtable (GDBusInterfaceSkeleton *skeleton G_GNUC_UNUSED)
+{
+        return (GDBusInterfaceVTable *) &gclue_service_satellites_vtable;
+}
+
+static void
+gclue_service_satellites_class_init (GClueServiceSatellitesClass *klass)
+{
+        GObjectClass *object_class;
+        GDBusInterfaceSkeletonClass *skeleton_class;
+
+        object_class = G_OBJECT_CLASS (klass);
+        object_class->finalize = gclue_service_satellites_finalize;
+        object_class->get_property = gclue_service_satellites_get_property;
+        object_class->set_property = gclue_service_satellites_set_property;
+
+        skeleton_class = G_DBUS_INTERFACE_SKELETON_CLASS (klass);
+        skeleton_class->get_vtable = gclue_service_satellites_get_vtable;
+
+        gParamSpecs[PROP_CLIENT_INFO] = g_param_spec_object ("client-info",
+                                                             "ClientInfo",
+                                                             "Information on client",
+                                                             GCLUE_TYPE_CLIENT_INFO,
+                                                             G_PARAM_READWRITE |
+                                                             G_PARAM_CONSTRUCT_ONLY);
+        g_object_class_install_property (object_class,
+                                         PROP_CLIENT_INFO,
+                                         gParamSpecs[PROP_CLIENT_INFO]);
+
+        gParamSpecs[PROP_PATH] = g_param_spec_string ("path",
+                                                      "Path",
+                                                      "Path",
+                                                      NULL,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_CONSTRUCT_ONLY);
+        g_object_class_install_property (object_class,
+                                         PROP_PATH,
+                                         gParamSpecs[PROP_PATH]);
+
+        gParamSpecs[PROP_CONNECTION] = g_param_spec_object ("connection",
+                                                            "Connection",
+                                                            "DBus Connection",
+                                                            G_TYPE_DBUS_CONNECTION,
+                                                            G_PARAM_READWRITE |
+                                                            G_PARAM_CONSTRUCT_ONLY);
+        g_object_class_install_property (object_class,
+                                         PROP_CONNECTION,
+                                         gParamSpecs[PROP_CONNECTION]);
+}
+
+static void
+gclue_service_satellites_init (GClueServiceSatellites *satellites)
+{
+        GClueDBusSatellites *dbus = GCLUE_DBUS_SATELLITES (satellites);
+
+        satellites->priv = gclue_service_satellites_get_instance_private (satellites);
+
+        gclue_dbus_satellites_set_satellites
+                (dbus, g_variant_new_array (G_VARIANT_TYPE ("(udddb)"), NULL, 0));
+        gclue_dbus_satellites_set_hdop (dbus, GCLUE_SATELLITES_UNKNOWN);
+        gclue_dbus_satellites_set_vdop (dbus, GCLUE_SATELLITES_UNKNOWN);
+        gclue_dbus_satellites_set_pdop (dbus, GCLUE_SATELLITES_UNKNOWN);
+        gclue_dbus_satellites_set_timestamp
+                (dbus, g_variant_new ("(tt)", (guint64) 0, (guint64) 0));
+}
+
+static gboolean
+gclue_service_satellites_initable_init (GInitable    *initable,
+                                        GCancellable *cancellable,
+                                        GError      **error)
+{
+        return g_dbus_interface_skeleton_export
+                (G_DBUS_INTERFACE_SKELETON (initable),
+                 GCLUE_SERVICE_SATELLITES (initable)->priv->connection,
+                 GCLUE_SERVICE_SATELLITES (initable)->priv->path,
+                 error);
+}
+
+static void
+gclue_service_satellites_initable_iface_init (GInitableIface *iface)
+{
+        iface->init = gclue_service_satellites_initable_init;
+}
+
+GClueServiceSatellites *
+gclue_service_satellites_new (GClueClientInfo *info,
+                              const char      *path,
+                              GDBusConnection *connection,
+                              GError         **error)
+{
+        return g_initable_new (GCLUE_TYPE_SERVICE_SATELLITES,
+                               NULL,
+                               error,
+                               "client-info", info,
+                               "path", path,
+                               "connection", connection,
+                               NULL);
+}
+
+const gchar *
+gclue_service_satellites_get_path (GClueServiceSatellites *satellites)
+{
+        g_return_val_if_fail (GCLUE_IS_SERVICE_SATELLITES (satellites), NULL);
+
+        return satellites->priv->path;
+}
+
+/**
+ * gclue_service_satellites_update:
+ * @satellites: a #GClueServiceSatellites
+ * @value: a %GCLUE_SATELLITES_VARIANT_TYPE #GVariant
+ *
+ * Update the satellites, unless the client's time threshold hasn't passed
+ * since the last update.
+ **/
+void
+gclue_service_satellites_update (GClueServiceSatellites *satellites,
+                                 GVariant               *value)
+{
+        GClueServiceSatellitesPrivate *priv;
+        GClueDBusSatellites *dbus;
+        g_autoptr(GVariant) list = NULL;
+        g_autoptr(GError) error = NULL;
+        gdouble hdop, vdop, pdop;
+        gint64 now, timestamp;
+        guint64 threshold;
+
+        g_return_if_fail (GCLUE_IS_SERVICE_SATELLITES (satellites));
+
+        if (value == NULL)
+                return;
+
+        priv = satellites->priv;
+        dbus = GCLUE_DBUS_SATELLITES (satellites);
+
+        now = gclue_clock_get_monotonic_time ();
+        threshold = (guint64) gclue_dbus_satellites_get_time_threshold (dbus) *
+                    G_USEC_PER_SEC;
+        if (priv->last_update != 0 &&
+            (guint64) (now - priv->last_update) < threshold)
+                return;
+        priv->last_update = now;
+
+        g_variant_get (value, "(ddd@a(udddb))", &hdop, &vdop, &pdop, &list);
+        gclue_dbus_satellites_set_satellites (dbus, list);
+        gclue_dbus_satellites_set_hdop (dbus, hdop);
+        gclue_dbus_satellites_set_vdop (dbus, vdop);
+        gclue_dbus_satellites_set_pdop (dbus, pdop);
+        timestamp = gclue_clock_get_real_time ();
+        gclue_dbus_satellites_set_timestamp
+                (dbus,
+                 g_variant_new ("(tt)",
+                                (guint64) (timestamp / G_USEC_PER_SEC),
+                                (guint64) (timestamp % G_USEC_PER_SEC)));
+
+        /* Like LocationUpdated, only the client gets to hear about it */
+        if (!g_dbus_connection_emit_signal
+                        (priv->connection,
+                         gclue_client_info_get_bus_name (priv->client_info),
+                         priv->path,
+                         "org.freedesktop.GeoClue2.Satellites",
+                         "Updated",
+                         NULL,
+                         &error))
+                g_warning ("Failed to update satellites: %s", error->message);
+}
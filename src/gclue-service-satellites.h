@@ -0,0 +1,71 @@
+/* vim: set et ts=8 sw=8: */
+/* gclue-service-satellites.h
+ *
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+
+#ifndef GCLUE_SERVICE_SATELLITES_H
+#define GCLUE_SERVICE_SATELLITES_H
+
+#include <glib-object.h>
+#include "gclue-client-info.h"
+#include "gclue-satellites-interface.h"
+
+G_BEGIN_DECLS
+
+#define GCLUE_TYPE_SERVICE_SATELLITES            (gclue_service_satellites_get_type())
+#define GCLUE_SERVICE_SATELLITES(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_SERVICE_SATELLITES, GClueServiceSatellites))
+#define GCLUE_SERVICE_SATELLITES_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_SERVICE_SATELLITES, GClueServiceSatellites const))
+#define GCLUE_SERVICE_SATELLITES_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GCLUE_TYPE_SERVICE_SATELLITES, GClueServiceSatellitesClass))
+#define GCLUE_IS_SERVICE_SATELLITES(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_SERVICE_SATELLITES))
+#define GCLUE_IS_SERVICE_SATELLITES_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GCLUE_TYPE_SERVICE_SATELLITES))
+#define GCLUE_SERVICE_SATELLITES_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GCLUE_TYPE_SERVICE_SATELLITES, GClueServiceSatellitesClass))
+
+typedef struct _GClueServiceSatellites        GClueServiceSatellites;
+typedef struct _GClueServiceSatellitesClass   GClueServiceSatellitesClass;
+typedef struct _GClueServiceSatellitesPrivate GClueServiceSatellitesPrivate;
+
+struct _GClueServiceSatellites
+{
+        GClueDBusSatellitesSkeleton parent;
+
+        /*< private >*/
+        GClueServiceSatellitesPrivate *priv;
+};
+
+struct _GClueServiceSatellitesClass
+{
+        GClueDBusSatellitesSkeletonClass parent_class;
+};
+
+GType gclue_service_satellites_get_type (void) G_GNUC_CONST;
+
+GClueServiceSatellites * gclue_service_satellites_new    (GClueClientInfo        *info,
+                                                          const char             *path,
+                                                          GDBusConnection        *connection,
+                                                          GError                **error);
+const char *             gclue_service_satellites_get_path
+                                                         (GClueServiceSatellites *satellites);
+void                     gclue_service_satellites_update (GClueServiceSatellites *satellites,
+                                                          GVariant               *value);
+
+G_END_DECLS
+
+#endif /* GCLUE_SERVICE_SATELLITES_H */
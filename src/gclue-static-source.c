@@ -105,15 +105,14 @@ on_location_set_timer (gpointer user_data)
 {
         GClueStaticSource *source = GCLUE_STATIC_SOURCE (user_data);
         GClueStaticSourcePrivate *priv = get_priv (source);
-        g_autoptr(GClueLocation) prev_location = NULL;
+        GClueLocationData location;
 
         priv->location_set_timer = 0;
 
         g_assert (priv->location);
-        prev_location = g_steal_pointer (&priv->location);
-        priv->location = gclue_location_duplicate_fresh (prev_location);
-        gclue_location_source_set_location
-                (GCLUE_LOCATION_SOURCE (source), priv->location);
+        gclue_location_duplicate_fresh (priv->location, &location);
+        gclue_location_source_set_location_data
+                (GCLUE_LOCATION_SOURCE (source), &location);
 
         return G_SOURCE_REMOVE;
 }
@@ -313,6 +312,10 @@ on_line_read (GObject *object,
                                                   GCLUE_LOCATION_SPEED_UNKNOWN,
                                                   GCLUE_LOCATION_HEADING_UNKNOWN,
                                                   priv->altitude,
+                                                  GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                                                  GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                                                  GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                                                  GCLUE_LOCATION_CLIMB_UNKNOWN,
                                                   0, "Static location");
         g_assert (priv->location);
         location_updated (source);
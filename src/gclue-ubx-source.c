@@ -0,0 +1,511 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+#include "gclue-ubx-source.h"
+#include "gclue-ubx.h"
+#include "gclue-serial.h"
+#include "gclue-location.h"
+#include "gclue-config.h"
+#include "config.h"
+
+/* How long to wait before trying to open the receiver again after failing
+ * to or losing it.
+ * In seconds.
+ */
+#define UBX_RECONNECT_TIME 5
+
+/* Upper bound on the frames handled in a single wakeup, so a flood of
+ * buffered frames can't starve the rest of the main loop.
+ */
+#define UBX_MAX_FRAMES_PER_WAKEUP 16
+
+struct _GClueUbxSourcePrivate {
+        /* Serial device the receiver is on, or UNIX socket relaying it */
+        const char     *device;
+
+        gint            fd;
+        gboolean        is_tty;
+        guint           watch_id;
+        guint           reconnect_timer;
+
+        GClueUbxReader  reader;
+
+        /* Latest NAV-DOP, sent along with the satellites */
+        GClueUbxNavDop  dop;
+
+        /* Time of the last fix, in microseconds */
+        gint64          last_fix_time;
+};
+
+G_DEFINE_TYPE_WITH_CODE (GClueUbxSource,
+                         gclue_ubx_source,
+                         GCLUE_TYPE_LOCATION_SOURCE,
+                         G_ADD_PRIVATE (GClueUbxSource))
+
+static GClueLocationSourceStartResult
+gclue_ubx_source_start (GClueLocationSource *source);
+static GClueLocationSourceStopResult
+gclue_ubx_source_stop (GClueLocationSource *source);
+
+static void
+open_device (GClueUbxSource *source);
+
+static gdouble
+ubx_value_or (gdouble value,
+              gdouble unknown)
+{
+        return isfinite (value) ? value : unknown;
+}
+
+static void
+set_accuracy_level (GClueUbxSource     *source,
+                    GClueAccuracyLevel  level)
+{
+        GClueAccuracyLevel existing;
+
+        existing = gclue_location_source_get_available_accuracy_level
+                        (GCLUE_LOCATION_SOURCE (source));
+        if (level == existing)
+                return;
+
+        g_debug ("Available accuracy level from %s: %u",
+                 G_OBJECT_TYPE_NAME (source), level);
+        g_object_set (G_OBJECT (source),
+                      "available-accuracy-level", level,
+                      NULL);
+}
+
+static void
+on_nav_pvt (GClueUbxSource       *source,
+            const GClueUbxNavPvt *pvt)
+{
+        GClueUbxSourcePrivate *priv = source->priv;
+        GClueLocationData location;
+
+        if (!isfinite (pvt->latitude) || !isfinite (pvt->longitude))
+                return;
+
+        if (pvt->time != 0 && pvt->time <= priv->last_fix_time) {
+                g_debug ("Ignoring repeated or out of order fix from %s",
+                         priv->device);
+                return;
+        }
+        priv->last_fix_time = pvt->time;
+
+        location = (GClueLocationData) {
+                .latitude = pvt->latitude,
+                .longitude = pvt->longitude,
+                .accuracy = pvt->accuracy,
+                .altitude = ubx_value_or (pvt->altitude,
+                                          GCLUE_LOCATION_ALTITUDE_UNKNOWN),
+                .altitude_accuracy = ubx_value_or (pvt->altitude_accuracy,
+                                                   GCLUE_LOCATION_ACCURACY_UNKNOWN),
+                .speed = pvt->speed,
+                .speed_accuracy = pvt->speed_accuracy,
+                .heading = pvt->heading,
+                .heading_accuracy = pvt->heading_accuracy,
+                .climb = ubx_value_or (pvt->climb,
+                                       GCLUE_LOCATION_CLIMB_UNKNOWN),
+                .timestamp = pvt->time,
+                .description = "UBX location",
+        };
+
+        g_debug ("UBX (%s): Fix type: %u, Satellites: %u, Latitude: %f, "
+                 "Longitude: %f, Accuracy: %f meters",
+                 priv->device,
+                 pvt->fix_type,
+                 pvt->n_satellites,
+                 pvt->latitude,
+                 pvt->longitude,
+                 pvt->accuracy);
+
+        gclue_location_source_set_location_data (GCLUE_LOCATION_SOURCE (source),
+                                                 &location);
+}
+
+static void
+on_nav_sat (GClueUbxSource       *source,
+            const GClueUbxNavSat *sat)
+{
+        GClueUbxNavDop *dop = &source->priv->dop;
+        GVariantBuilder builder;
+        guint i;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(udddb)"));
+        for (i = 0; i < sat->n_satellites; i++) {
+                const GClueUbxSatellite *satellite = &sat->satellites[i];
+
+                g_variant_builder_add
+                        (&builder,
+                         "(udddb)",
+                         (guint32) satellite->prn,
+                         satellite->elevation,
+                         satellite->azimuth,
+                         ubx_value_or (satellite->snr, GCLUE_SATELLITES_UNKNOWN),
+                         satellite->used);
+        }
+
+        gclue_location_source_set_satellites
+                (GCLUE_LOCATION_SOURCE (source),
+                 g_variant_new (GCLUE_SATELLITES_VARIANT_TYPE,
+                                ubx_value_or (dop->hdop, GCLUE_SATELLITES_UNKNOWN),
+                                ubx_value_or (dop->vdop, GCLUE_SATELLITES_UNKNOWN),
+                                ubx_value_or (dop->pdop, GCLUE_SATELLITES_UNKNOWN),
+                                &builder));
+}
+
+static void
+on_ubx_frame (GClueUbxSource      *source,
+              const GClueUbxFrame *frame)
+{
+        GClueUbxSourcePrivate *priv = source->priv;
+        union {
+                GClueUbxNavPvt pvt;
+                GClueUbxNavSat sat;
+        } message;
+
+        if (frame->msg_class != GCLUE_UBX_CLASS_NAV)
+                return;
+
+        switch (frame->msg_id) {
+        case GCLUE_UBX_ID_NAV_PVT:
+                if (gclue_ubx_parse_nav_pvt (frame, &message.pvt))
+                        on_nav_pvt (source, &message.pvt);
+                break;
+
+        case GCLUE_UBX_ID_NAV_DOP:
+                gclue_ubx_parse_nav_dop (frame, &priv->dop);
+                break;
+
+        case GCLUE_UBX_ID_NAV_SAT:
+                if (gclue_ubx_parse_nav_sat (frame, &message.sat))
+                        on_nav_sat (source, &message.sat);
+                break;
+
+        default:
+                break;
+        }
+}
+
+static gboolean
+on_reconnect_timer (gpointer user_data)
+{
+        GClueUbxSource *source = GCLUE_UBX_SOURCE (user_data);
+
+        source->priv->reconnect_timer = 0;
+        open_device (source);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_reconnect (GClueUbxSource *source)
+{
+        GClueUbxSourcePrivate *priv = source->priv;
+
+        if (priv->reconnect_timer)
+                return;
+
+        g_debug ("Retrying UBX receiver at %s in %u seconds",
+                 priv->device, UBX_RECONNECT_TIME);
+        priv->reconnect_timer = g_timeout_add_seconds (UBX_RECONNECT_TIME,
+                                                       on_reconnect_timer,
+                                                       source);
+}
+
+static void
+stop_reading (GClueUbxSource *source)
+{
+        GClueUbxSourcePrivate *priv = source->priv;
+
+        if (priv->watch_id) {
+                g_source_remove (priv->watch_id);
+                priv->watch_id = 0;
+        }
+}
+
+static void
+close_device (GClueUbxSource *source)
+{
+        GClueUbxSourcePrivate *priv = source->priv;
+
+        stop_reading (source);
+
+        if (priv->fd >= 0) {
+                close (priv->fd);
+                priv->fd = -1;
+        }
+}
+
+static gboolean
+on_ubx_readable (gint         fd,
+                 GIOCondition condition,
+                 gpointer     user_data)
+{
+        GClueUbxSource *source = GCLUE_UBX_SOURCE (user_data);
+        GClueUbxSourcePrivate *priv = source->priv;
+        GClueUbxFrame frame;
+        gssize ret;
+        guint i;
+
+        ret = gclue_ubx_reader_fill (&priv->reader, fd);
+        if (ret == 0 || (ret < 0 && errno != EAGAIN)) {
+                g_debug ("Lost UBX receiver at %s: %s",
+                         priv->device,
+                         ret == 0 ? "end of file" : g_strerror (errno));
+
+                /* The watch goes away along with this source */
+                priv->watch_id = 0;
+                close_device (source);
+                schedule_reconnect (source);
+                set_accuracy_level (source, GCLUE_ACCURACY_LEVEL_NONE);
+
+                return G_SOURCE_REMOVE;
+        }
+
+        for (i = 0; i < UBX_MAX_FRAMES_PER_WAKEUP; i++) {
+                if (!gclue_ubx_reader_next_frame (&priv->reader, &frame))
+                        break;
+
+                on_ubx_frame (source, &frame);
+
+                /* Publishing a fix can get us stopped */
+                if (!priv->watch_id)
+                        return G_SOURCE_REMOVE;
+        }
+
+        return G_SOURCE_CONTINUE;
+}
+
+static void
+start_reading (GClueUbxSource *source)
+{
+        GClueUbxSourcePrivate *priv = source->priv;
+
+        if (priv->fd < 0 || priv->watch_id)
+                return;
+
+        /* What the receiver sent while we were stopped is stale */
+        if (priv->is_tty) {
+                gclue_serial_flush (priv->fd);
+        } else {
+                while (gclue_ubx_reader_fill (&priv->reader, priv->fd) > 0)
+                        gclue_ubx_reader_init (&priv->reader);
+        }
+        gclue_ubx_reader_init (&priv->reader);
+        priv->dop.hdop = priv->dop.vdop = priv->dop.pdop = NAN;
+
+        priv->watch_id = g_unix_fd_add (priv->fd,
+                                        G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                        on_ubx_readable,
+                                        source);
+}
+
+static gint
+open_unix_socket (const char *path)
+{
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        int fd, errsv;
+
+        if (strlen (path) >= sizeof (addr.sun_path)) {
+                errno = ENAMETOOLONG;
+                return -1;
+        }
+        strcpy (addr.sun_path, path);
+
+        fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd < 0)
+                return -1;
+
+        if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0) {
+                errsv = errno;
+                close (fd);
+                errno = errsv;
+                return -1;
+        }
+
+        return fd;
+}
+
+static void
+open_device (GClueUbxSource *source)
+{
+        GClueUbxSourcePrivate *priv = source->priv;
+        struct stat st;
+
+        if (priv->fd >= 0)
+                return;
+
+        if (stat (priv->device, &st) == 0 && S_ISSOCK (st.st_mode)) {
+                priv->fd = open_unix_socket (priv->device);
+                if (priv->fd < 0)
+                        g_debug ("Failed to connect to UBX receiver at %s: %s",
+                                 priv->device, g_strerror (errno));
+                priv->is_tty = FALSE;
+        } else {
+                g_autoptr(GError) error = NULL;
+                guint baud_rate;
+
+                baud_rate = gclue_config_get_ubx_baud_rate
+                        (gclue_config_get_singleton ());
+                priv->fd = gclue_serial_open (priv->device, baud_rate, &error);
+                if (priv->fd < 0)
+                        g_debug ("Failed to open UBX receiver at %s: %s",
+                                 priv->device, error->message);
+                priv->is_tty = TRUE;
+        }
+
+        if (priv->fd < 0) {
+                schedule_reconnect (source);
+                set_accuracy_level (source, GCLUE_ACCURACY_LEVEL_NONE);
+                return;
+        }
+
+        g_debug ("Opened UBX receiver at %s", priv->device);
+        priv->last_fix_time = 0;
+
+        if (gclue_location_source_get_active (GCLUE_LOCATION_SOURCE (source)))
+                start_reading (source);
+
+        set_accuracy_level (source, GCLUE_ACCURACY_LEVEL_EXACT);
+}
+
+static void
+gclue_ubx_source_finalize (GObject *gubx)
+{
+        GClueUbxSource *source = GCLUE_UBX_SOURCE (gubx);
+        GClueUbxSourcePrivate *priv = source->priv;
+
+        close_device (source);
+        if (priv->reconnect_timer) {
+                g_source_remove (priv->reconnect_timer);
+                priv->reconnect_timer = 0;
+        }
+
+        G_OBJECT_CLASS (gclue_ubx_source_parent_class)->finalize (gubx);
+}
+
+static void
+gclue_ubx_source_class_init (GClueUbxSourceClass *klass)
+{
+        GClueLocationSourceClass *source_class = GCLUE_LOCATION_SOURCE_CLASS (klass);
+        GObjectClass *gubx_class = G_OBJECT_CLASS (klass);
+
+        gubx_class->finalize = gclue_ubx_source_finalize;
+
+        source_class->start = gclue_ubx_source_start;
+        source_class->stop = gclue_ubx_source_stop;
+}
+
+static void
+gclue_ubx_source_init (GClueUbxSource *source)
+{
+        GClueUbxSourcePrivate *priv;
+
+        source->priv = gclue_ubx_source_get_instance_private (source);
+        priv = source->priv;
+
+        priv->device = gclue_config_get_ubx_device
+                (gclue_config_get_singleton ());
+        priv->fd = -1;
+
+        /* Stays at NONE until the receiver can be opened */
+        open_device (source);
+}
+
+/**
+ * gclue_ubx_source_get_singleton:
+ *
+ * Get the #GClueUbxSource singleton.
+ *
+ * Returns: (transfer full): a new ref to #GClueUbxSource. Use g_object_unref()
+ * when done.
+ **/
+GClueUbxSource *
+gclue_ubx_source_get_singleton (void)
+{
+        static GClueUbxSource *source = NULL;
+
+        if (source == NULL) {
+                source = g_object_new (GCLUE_TYPE_UBX_SOURCE,
+                                       "priority-source", TRUE,
+                                       NULL);
+                g_object_add_weak_pointer (G_OBJECT (source),
+                                           (gpointer) &source);
+        } else
+                g_object_ref (source);
+
+        return source;
+}
+
+static GClueLocationSourceStartResult
+gclue_ubx_source_start (GClueLocationSource *source)
+{
+        GClueLocationSourceClass *base_class;
+        GClueLocationSourceStartResult base_result;
+
+        g_return_val_if_fail (GCLUE_IS_UBX_SOURCE (source),
+                              GCLUE_LOCATION_SOURCE_START_RESULT_FAILED);
+
+        base_class = GCLUE_LOCATION_SOURCE_CLASS (gclue_ubx_source_parent_class);
+        base_result = base_class->start (source);
+        if (base_result != GCLUE_LOCATION_SOURCE_START_RESULT_OK)
+                return base_result;
+
+        /* If the receiver isn't there yet, we start reading as soon as it
+         * can be opened.
+         */
+        start_reading (GCLUE_UBX_SOURCE (source));
+
+        return base_result;
+}
+
+static GClueLocationSourceStopResult
+gclue_ubx_source_stop (GClueLocationSource *source)
+{
+        GClueLocationSourceClass *base_class;
+        GClueLocationSourceStopResult base_result;
+
+        g_return_val_if_fail (GCLUE_IS_UBX_SOURCE (source), FALSE);
+
+        base_class = GCLUE_LOCATION_SOURCE_CLASS (gclue_ubx_source_parent_class);
+        base_result = base_class->stop (source);
+        if (base_result != GCLUE_LOCATION_SOURCE_STOP_RESULT_OK)
+                return base_result;
+
+        /* The device stays open, to keep track of whether the receiver is
+         * there.
+         */
+        stop_reading (GCLUE_UBX_SOURCE (source));
+
+        return base_result;
+}
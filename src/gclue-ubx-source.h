@@ -0,0 +1,69 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#ifndef GCLUE_UBX_SOURCE_H
+#define GCLUE_UBX_SOURCE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "gclue-location-source.h"
+
+G_BEGIN_DECLS
+
+GType gclue_ubx_source_get_type (void) G_GNUC_CONST;
+
+#define GCLUE_TYPE_UBX_SOURCE            (gclue_ubx_source_get_type ())
+#define GCLUE_UBX_SOURCE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GCLUE_TYPE_UBX_SOURCE, GClueUbxSource))
+#define GCLUE_IS_UBX_SOURCE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GCLUE_TYPE_UBX_SOURCE))
+#define GCLUE_UBX_SOURCE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GCLUE_TYPE_UBX_SOURCE, GClueUbxSourceClass))
+#define GCLUE_IS_UBX_SOURCE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GCLUE_TYPE_UBX_SOURCE))
+#define GCLUE_UBX_SOURCE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GCLUE_TYPE_UBX_SOURCE, GClueUbxSourceClass))
+
+/**
+ * GClueUbxSource:
+ *
+ * All the fields in the #GClueUbxSource structure are private and should never be accessed directly.
+**/
+typedef struct _GClueUbxSource GClueUbxSource;
+typedef struct _GClueUbxSourceClass GClueUbxSourceClass;
+typedef struct _GClueUbxSourcePrivate GClueUbxSourcePrivate;
+
+struct _GClueUbxSource {
+        /* <private> */
+        GClueLocationSource parent_instance;
+        GClueUbxSourcePrivate *priv;
+};
+
+/**
+ * GClueUbxSourceClass:
+ *
+ * All the fields in the #GClueUbxSourceClass structure are private and should never be accessed directly.
+**/
+struct _GClueUbxSourceClass {
+        /* <private> */
+        GClueLocationSourceClass parent_class;
+};
+
+GClueUbxSource *gclue_ubx_source_get_singleton (void);
+
+G_END_DECLS
+
+#endif /* GCLUE_UBX_SOURCE_H */
@@ -0,0 +1,407 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "gclue-ubx.h"
+
+#define UBX_SYNC_1 0xb5
+#define UBX_SYNC_2 0x62
+
+/* Sync characters, class, id and length in front of the payload, and the
+ * two checksum bytes after it.
+ */
+#define UBX_HEADER_SIZE   6
+#define UBX_CHECKSUM_SIZE 2
+#define UBX_MAX_PAYLOAD   (GCLUE_UBX_READER_SIZE - UBX_HEADER_SIZE - UBX_CHECKSUM_SIZE)
+
+/* NAV-PVT grew from 84 to 92 bytes in protocol version 15, we don't use
+ * anything from the newer fields.
+ */
+#define UBX_NAV_PVT_MIN_LEN 84
+#define UBX_NAV_DOP_LEN     18
+#define UBX_NAV_SAT_HEADER  8
+#define UBX_NAV_SAT_BLOCK   12
+
+#define UBX_PVT_VALID_DATE  0x01
+#define UBX_PVT_VALID_TIME  0x02
+#define UBX_PVT_GNSS_FIX_OK 0x01
+#define UBX_SAT_SV_USED     0x08
+
+#define UBX_GNSS_GPS     0
+#define UBX_GNSS_SBAS    1
+#define UBX_GNSS_GALILEO 2
+#define UBX_GNSS_BEIDOU  3
+#define UBX_GNSS_QZSS    5
+#define UBX_GNSS_GLONASS 6
+
+/* All multi-byte values are little endian and the payloads aren't aligned,
+ * so fields are copied out rather than the payload cast to a struct. The
+ * callers check the payload length once, up front.
+ */
+
+static guint8
+ubx_u1 (const guint8 *payload,
+        gsize         offset)
+{
+        return payload[offset];
+}
+
+static gint8
+ubx_i1 (const guint8 *payload,
+        gsize         offset)
+{
+        return (gint8) payload[offset];
+}
+
+static guint16
+ubx_u2 (const guint8 *payload,
+        gsize         offset)
+{
+        guint16 value;
+
+        memcpy (&value, payload + offset, sizeof (value));
+
+        return GUINT16_FROM_LE (value);
+}
+
+static gint16
+ubx_i2 (const guint8 *payload,
+        gsize         offset)
+{
+        return (gint16) ubx_u2 (payload, offset);
+}
+
+static guint32
+ubx_u4 (const guint8 *payload,
+        gsize         offset)
+{
+        guint32 value;
+
+        memcpy (&value, payload + offset, sizeof (value));
+
+        return GUINT32_FROM_LE (value);
+}
+
+static gint32
+ubx_i4 (const guint8 *payload,
+        gsize         offset)
+{
+        return (gint32) ubx_u4 (payload, offset);
+}
+
+/* Days between 1970-01-01 and the given date of the proleptic Gregorian
+ * calendar.
+ */
+static gint64
+days_from_civil (gint  year,
+                 guint month,
+                 guint day)
+{
+        gint64 era, yoe, doy, doe;
+
+        if (month <= 2)
+                year--;
+        era = (year >= 0 ? year : year - 399) / 400;
+        yoe = year - era * 400;
+        doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+        return era * 146097 + doe - 719468;
+}
+
+/**
+ * gclue_ubx_parse_nav_pvt:
+ * @frame: a UBX-NAV-PVT frame
+ * @pvt: (out caller-allocates): the decoded fix
+ *
+ * Returns: %TRUE if @frame is a NAV-PVT frame.
+ **/
+gboolean
+gclue_ubx_parse_nav_pvt (const GClueUbxFrame *frame,
+                         GClueUbxNavPvt      *pvt)
+{
+        const guint8 *p = frame->payload;
+        guint8 valid, month, day, hour, minute, second;
+        gint64 days;
+
+        if (frame->msg_class != GCLUE_UBX_CLASS_NAV ||
+            frame->msg_id != GCLUE_UBX_ID_NAV_PVT ||
+            frame->len < UBX_NAV_PVT_MIN_LEN)
+                return FALSE;
+
+        pvt->time = 0;
+        valid = ubx_u1 (p, 11);
+        month = ubx_u1 (p, 6);
+        day = ubx_u1 (p, 7);
+        hour = ubx_u1 (p, 8);
+        minute = ubx_u1 (p, 9);
+        second = ubx_u1 (p, 10);
+        if ((valid & (UBX_PVT_VALID_DATE | UBX_PVT_VALID_TIME)) ==
+            (UBX_PVT_VALID_DATE | UBX_PVT_VALID_TIME) &&
+            month >= 1 && month <= 12 && day >= 1 && day <= 31 &&
+            hour < 24 && minute < 60 && second <= 60) {
+                days = days_from_civil (ubx_u2 (p, 4), month, day);
+                pvt->time = ((days * 24 + hour) * 60 + minute) * 60 + second;
+                pvt->time = pvt->time * G_USEC_PER_SEC +
+                            ubx_i4 (p, 16) / 1000;
+        }
+
+        pvt->fix_type = ubx_u1 (p, 20);
+        pvt->fix_ok = (ubx_u1 (p, 21) & UBX_PVT_GNSS_FIX_OK) != 0;
+        pvt->n_satellites = ubx_u1 (p, 23);
+        pvt->longitude = ubx_i4 (p, 24) * 1e-7;
+        pvt->latitude = ubx_i4 (p, 28) * 1e-7;
+        pvt->altitude = ubx_i4 (p, 36) / 1000.0;
+        pvt->accuracy = ubx_u4 (p, 40) / 1000.0;
+        pvt->altitude_accuracy = ubx_u4 (p, 44) / 1000.0;
+        pvt->climb = -ubx_i4 (p, 56) / 1000.0;
+        pvt->speed = ubx_i4 (p, 60) / 1000.0;
+        pvt->heading = ubx_i4 (p, 64) * 1e-5;
+        pvt->speed_accuracy = ubx_u4 (p, 68) / 1000.0;
+        pvt->heading_accuracy = ubx_u4 (p, 72) * 1e-5;
+        pvt->pdop = ubx_u2 (p, 76) * 0.01;
+
+        /* Not a position we can use, whatever the receiver extrapolated */
+        if (!pvt->fix_ok || pvt->fix_type < 2 || pvt->fix_type > 4) {
+                pvt->latitude = NAN;
+                pvt->longitude = NAN;
+        }
+
+        if (pvt->fix_type != 3 && pvt->fix_type != 4) {
+                pvt->altitude = NAN;
+                pvt->altitude_accuracy = NAN;
+                pvt->climb = NAN;
+        }
+
+        return TRUE;
+}
+
+/**
+ * gclue_ubx_parse_nav_dop:
+ * @frame: a UBX-NAV-DOP frame
+ * @dop: (out caller-allocates): the decoded dilutions of precision
+ *
+ * Returns: %TRUE if @frame is a NAV-DOP frame.
+ **/
+gboolean
+gclue_ubx_parse_nav_dop (const GClueUbxFrame *frame,
+                         GClueUbxNavDop      *dop)
+{
+        const guint8 *p = frame->payload;
+
+        if (frame->msg_class != GCLUE_UBX_CLASS_NAV ||
+            frame->msg_id != GCLUE_UBX_ID_NAV_DOP ||
+            frame->len < UBX_NAV_DOP_LEN)
+                return FALSE;
+
+        dop->pdop = ubx_u2 (p, 6) * 0.01;
+        dop->vdop = ubx_u2 (p, 10) * 0.01;
+        dop->hdop = ubx_u2 (p, 12) * 0.01;
+
+        return TRUE;
+}
+
+/* Numbers satellites the way NMEA 0183 4.x receivers do in their GSV
+ * sentences, so they are the same whichever of the sources reports them.
+ */
+static guint
+satellite_prn (guint8 gnss_id,
+               guint8 sv_id)
+{
+        switch (gnss_id) {
+        case UBX_GNSS_GPS:
+        case UBX_GNSS_SBAS:
+                return sv_id;
+        case UBX_GNSS_GALILEO:
+                return 300 + sv_id;
+        case UBX_GNSS_BEIDOU:
+                return 400 + sv_id;
+        case UBX_GNSS_QZSS:
+                return 192 + sv_id;
+        case UBX_GNSS_GLONASS:
+                return 64 + sv_id;
+        default:
+                return 0;
+        }
+}
+
+/**
+ * gclue_ubx_parse_nav_sat:
+ * @frame: a UBX-NAV-SAT frame
+ * @sat: (out caller-allocates): the decoded satellites
+ *
+ * Returns: %TRUE if @frame is a NAV-SAT frame.
+ **/
+gboolean
+gclue_ubx_parse_nav_sat (const GClueUbxFrame *frame,
+                         GClueUbxNavSat      *sat)
+{
+        const guint8 *p = frame->payload;
+        guint n, i;
+
+        if (frame->msg_class != GCLUE_UBX_CLASS_NAV ||
+            frame->msg_id != GCLUE_UBX_ID_NAV_SAT ||
+            frame->len < UBX_NAV_SAT_HEADER)
+                return FALSE;
+
+        n = ubx_u1 (p, 5);
+        if (frame->len < UBX_NAV_SAT_HEADER + n * UBX_NAV_SAT_BLOCK)
+                return FALSE;
+
+        sat->n_satellites = 0;
+        for (i = 0; i < n && sat->n_satellites < GCLUE_UBX_MAX_SATELLITES; i++) {
+                const guint8 *block = p + UBX_NAV_SAT_HEADER + i * UBX_NAV_SAT_BLOCK;
+                GClueUbxSatellite *satellite;
+                guint prn;
+                guint8 cno;
+
+                prn = satellite_prn (ubx_u1 (block, 0), ubx_u1 (block, 1));
+                if (prn == 0)
+                        continue;
+
+                satellite = &sat->satellites[sat->n_satellites++];
+                satellite->prn = prn;
+                satellite->elevation = ubx_i1 (block, 3);
+                satellite->azimuth = ubx_i2 (block, 4);
+                cno = ubx_u1 (block, 2);
+                satellite->snr = cno > 0 ? cno : NAN;
+                satellite->used = (ubx_u4 (block, 8) & UBX_SAT_SV_USED) != 0;
+        }
+
+        return TRUE;
+}
+
+void
+gclue_ubx_reader_init (GClueUbxReader *reader)
+{
+        reader->len = 0;
+        reader->pos = 0;
+}
+
+/**
+ * gclue_ubx_reader_fill:
+ * @reader: a #GClueUbxReader
+ * @fd: the receiver's serial device or socket
+ *
+ * Reads whatever is available on @fd into @reader's buffer, after the
+ * part of the last frame that hasn't been completed yet.
+ *
+ * Returns: what read() returned.
+ **/
+gssize
+gclue_ubx_reader_fill (GClueUbxReader *reader,
+                       gint            fd)
+{
+        gssize ret;
+
+        if (reader->pos > 0) {
+                memmove (reader->data,
+                         reader->data + reader->pos,
+                         reader->len - reader->pos);
+                reader->len -= reader->pos;
+                reader->pos = 0;
+        }
+
+        /* Can't happen with the frame length capped, but never stop
+         * reading because of a full buffer.
+         */
+        if (reader->len == sizeof (reader->data))
+                reader->len = 0;
+
+        do {
+                ret = read (fd,
+                            reader->data + reader->len,
+                            sizeof (reader->data) - reader->len);
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret > 0)
+                reader->len += ret;
+
+        return ret;
+}
+
+/**
+ * gclue_ubx_reader_next_frame:
+ * @reader: a #GClueUbxReader
+ * @frame: (out caller-allocates): the frame
+ *
+ * Finds the next complete frame with a valid checksum in the buffer,
+ * skipping anything else the receiver interleaves with them, NMEA
+ * sentences for instance. The payload stays valid until the next call to
+ * gclue_ubx_reader_fill().
+ *
+ * Returns: %TRUE if there was a complete frame.
+ **/
+gboolean
+gclue_ubx_reader_next_frame (GClueUbxReader *reader,
+                             GClueUbxFrame  *frame)
+{
+        while (reader->len - reader->pos >= UBX_HEADER_SIZE) {
+                const guint8 *p = reader->data + reader->pos;
+                gsize available = reader->len - reader->pos;
+                guint8 ck_a = 0, ck_b = 0;
+                guint16 len;
+                gsize i;
+
+                if (p[0] != UBX_SYNC_1 || p[1] != UBX_SYNC_2) {
+                        const guint8 *sync;
+
+                        sync = memchr (p + 1, UBX_SYNC_1, available - 1);
+                        reader->pos = sync != NULL ?
+                                      (gsize) (sync - reader->data) :
+                                      reader->len;
+                        continue;
+                }
+
+                len = ubx_u2 (p, 4);
+                if (len > UBX_MAX_PAYLOAD) {
+                        reader->pos++;
+                        continue;
+                }
+
+                if (available < UBX_HEADER_SIZE + len + UBX_CHECKSUM_SIZE)
+                        return FALSE;
+
+                /* 8-bit Fletcher over class, id, length and payload */
+                for (i = 2; i < UBX_HEADER_SIZE + len; i++) {
+                        ck_a += p[i];
+                        ck_b += ck_a;
+                }
+                if (ck_a != p[UBX_HEADER_SIZE + len] ||
+                    ck_b != p[UBX_HEADER_SIZE + len + 1]) {
+                        reader->pos++;
+                        continue;
+                }
+
+                frame->msg_class = p[2];
+                frame->msg_id = p[3];
+                frame->len = len;
+                frame->payload = p + UBX_HEADER_SIZE;
+                reader->pos += UBX_HEADER_SIZE + len + UBX_CHECKSUM_SIZE;
+
+                return TRUE;
+        }
+
+        return FALSE;
+}
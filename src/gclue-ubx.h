@@ -0,0 +1,116 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#ifndef GCLUE_UBX_H
+#define GCLUE_UBX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define GCLUE_UBX_CLASS_NAV   0x01
+#define GCLUE_UBX_ID_NAV_DOP  0x04
+#define GCLUE_UBX_ID_NAV_PVT  0x07
+#define GCLUE_UBX_ID_NAV_SAT  0x35
+
+/* Large enough for a NAV-SAT frame with every satellite a receiver can
+ * track, the largest of the frames we decode.
+ */
+#define GCLUE_UBX_READER_SIZE 4096
+
+#define GCLUE_UBX_MAX_SATELLITES 64
+
+/* A frame in a #GClueUbxReader's buffer, with a valid checksum */
+typedef struct {
+        guint8        msg_class;
+        guint8        msg_id;
+        guint16       len;
+        const guint8 *payload;
+} GClueUbxFrame;
+
+/* NAV-PVT, in the units geoclue uses. Values the receiver doesn't vouch
+ * for are left at NAN.
+ */
+typedef struct {
+        gint64   time;          /* Microseconds since the epoch, 0 if unknown */
+        guint8   fix_type;      /* 0: none, 2: 2D, 3: 3D, ... as sent */
+        gboolean fix_ok;        /* Within the receiver's accuracy masks */
+        guint8   n_satellites;
+        gdouble  latitude;
+        gdouble  longitude;
+        gdouble  altitude;      /* Above mean sea level */
+        gdouble  accuracy;
+        gdouble  altitude_accuracy;
+        gdouble  speed;         /* Over ground, in m/s */
+        gdouble  speed_accuracy;
+        gdouble  heading;       /* Of motion, in degrees */
+        gdouble  heading_accuracy;
+        gdouble  climb;         /* In m/s */
+        gdouble  pdop;
+} GClueUbxNavPvt;
+
+typedef struct {
+        gdouble hdop;
+        gdouble vdop;
+        gdouble pdop;
+} GClueUbxNavDop;
+
+typedef struct {
+        guint    prn;           /* NMEA style, unique across systems */
+        gdouble  elevation;
+        gdouble  azimuth;
+        gdouble  snr;
+        gboolean used;
+} GClueUbxSatellite;
+
+typedef struct {
+        guint             n_satellites;
+        GClueUbxSatellite satellites[GCLUE_UBX_MAX_SATELLITES];
+} GClueUbxNavSat;
+
+gboolean
+gclue_ubx_parse_nav_pvt (const GClueUbxFrame *frame,
+                         GClueUbxNavPvt      *pvt);
+gboolean
+gclue_ubx_parse_nav_dop (const GClueUbxFrame *frame,
+                         GClueUbxNavDop      *dop);
+gboolean
+gclue_ubx_parse_nav_sat (const GClueUbxFrame *frame,
+                         GClueUbxNavSat      *sat);
+
+typedef struct {
+        guint8 data[GCLUE_UBX_READER_SIZE];
+        gsize  len;
+        gsize  pos;
+} GClueUbxReader;
+
+void
+gclue_ubx_reader_init (GClueUbxReader *reader);
+gssize
+gclue_ubx_reader_fill (GClueUbxReader *reader,
+                       gint            fd);
+gboolean
+gclue_ubx_reader_next_frame (GClueUbxReader *reader,
+                             GClueUbxFrame  *frame);
+
+G_END_DECLS
+
+#endif /* GCLUE_UBX_H */
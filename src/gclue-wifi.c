@@ -28,6 +28,7 @@
 #include "gclue-config.h"
 #include "gclue-error.h"
 #include "gclue-mozilla.h"
+#include "gclue-clock.h"
 
 #define WIFI_SCAN_TIMEOUT_HIGH_ACCURACY 10
 /* Since this is only used for city-level accuracy, 5 minutes between each
@@ -695,7 +696,7 @@ cache_prune (GClueWifi *wifi)
         guint old_cache_size, removed_elements = 0;
 
         old_cache_size = g_hash_table_size (priv->location_cache);
-        cutoff_seconds = g_get_real_time () / G_USEC_PER_SEC - CACHE_ENTRY_MAX_AGE_SECONDS;
+        cutoff_seconds = gclue_clock_get_real_time () / G_USEC_PER_SEC - CACHE_ENTRY_MAX_AGE_SECONDS;
 
         g_hash_table_iter_init (&iter, priv->location_cache);
         while (g_hash_table_iter_next (&iter, NULL, &value)) {
@@ -1430,15 +1431,15 @@ gclue_wifi_refresh_async (GClueWebSource      *source,
         if (gclue_location_source_get_active (GCLUE_LOCATION_SOURCE (source))) {
                 /* Try the cache. */
                 if (cached_location != NULL) {
-                        g_autoptr(GClueLocation) new_location = NULL;
+                        GClueLocationData location;
 
                         wifi->priv->cache_hits++;
 
-                        /* Duplicate the location so its timestamp is updated. */
-                        new_location = gclue_location_duplicate_fresh (cached_location);
-                        gclue_location_source_set_location (GCLUE_LOCATION_SOURCE (source), new_location);
+                        /* Copy the location so its timestamp is updated. */
+                        gclue_location_duplicate_fresh (cached_location, &location);
+                        gclue_location_source_set_location_data (GCLUE_LOCATION_SOURCE (source), &location);
 
-                        g_task_return_pointer (task, g_steal_pointer (&new_location), g_object_unref);
+                        g_task_return_pointer (task, g_object_ref (cached_location), g_object_unref);
                         return;
                 }
 
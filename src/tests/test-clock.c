@@ -0,0 +1,129 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <glib.h>
+#include "gclue-clock.h"
+
+/* 2024-03-01 00:00:00 UTC, the day after a leap day */
+#define MARCH_1 (G_GINT64_CONSTANT (1709251200) * G_TIME_SPAN_SECOND)
+
+typedef struct {
+        const char *name;
+        gint64      now;
+        gint64      midnight;
+} MidnightCase;
+
+/* Run one after the other, so each one starts with the midnight of the
+ * last one cached.
+ */
+static const MidnightCase midnight_cases[] = {
+        { "noon", MARCH_1 + 12 * G_TIME_SPAN_HOUR, MARCH_1 },
+        { "same-day", MARCH_1 + 23 * G_TIME_SPAN_HOUR, MARCH_1 },
+        { "last-microsecond", MARCH_1 + G_TIME_SPAN_DAY - 1, MARCH_1 },
+        { "next-day", MARCH_1 + G_TIME_SPAN_DAY, MARCH_1 + G_TIME_SPAN_DAY },
+        { "back-at-midnight", MARCH_1, MARCH_1 },
+        { "day-before", MARCH_1 - 1, MARCH_1 - G_TIME_SPAN_DAY },
+        { "epoch", 0, 0 },
+        { "before-epoch", -12 * G_TIME_SPAN_HOUR, -G_TIME_SPAN_DAY },
+        { "day-before-epoch", -G_TIME_SPAN_DAY, -G_TIME_SPAN_DAY },
+};
+
+static void
+test_midnight (void)
+{
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (midnight_cases); i++) {
+                const MidnightCase *test = &midnight_cases[i];
+
+                g_test_message ("%s", test->name);
+                gclue_clock_set_virtual (test->now);
+                g_assert_cmpint (gclue_clock_get_real_time (), ==, test->now);
+                g_assert_cmpint (gclue_clock_get_utc_midnight (),
+                                 ==,
+                                 test->midnight);
+        }
+
+        gclue_clock_set_system ();
+}
+
+static void
+test_midnight_advance (void)
+{
+        gint64 monotonic;
+
+        gclue_clock_set_virtual (MARCH_1 - G_TIME_SPAN_SECOND);
+        g_assert_true (gclue_clock_is_virtual ());
+        g_assert_cmpint (gclue_clock_get_utc_midnight (),
+                         ==,
+                         MARCH_1 - G_TIME_SPAN_DAY);
+
+        /* Stands still until advanced, both clocks together */
+        monotonic = gclue_clock_get_monotonic_time ();
+        g_assert_cmpint (gclue_clock_get_monotonic_time (), ==, monotonic);
+
+        gclue_clock_advance (G_TIME_SPAN_SECOND);
+        g_assert_cmpint (gclue_clock_get_real_time (), ==, MARCH_1);
+        g_assert_cmpint (gclue_clock_get_monotonic_time (),
+                         ==,
+                         monotonic + G_TIME_SPAN_SECOND);
+        g_assert_cmpint (gclue_clock_get_utc_midnight (), ==, MARCH_1);
+
+        gclue_clock_advance (G_TIME_SPAN_DAY + G_TIME_SPAN_HOUR);
+        g_assert_cmpint (gclue_clock_get_utc_midnight (),
+                         ==,
+                         MARCH_1 + G_TIME_SPAN_DAY);
+
+        gclue_clock_set_system ();
+}
+
+static void
+test_system (void)
+{
+        gint64 before, now, after, midnight;
+
+        gclue_clock_set_virtual (MARCH_1);
+        gclue_clock_set_system ();
+        g_assert_false (gclue_clock_is_virtual ());
+
+        before = g_get_real_time ();
+        now = gclue_clock_get_real_time ();
+        midnight = gclue_clock_get_utc_midnight ();
+        after = g_get_real_time ();
+
+        g_assert_cmpint (now, >=, before);
+        g_assert_cmpint (now, <=, after);
+        g_assert_cmpint (midnight % G_TIME_SPAN_DAY, ==, 0);
+        g_assert_cmpint (midnight, <=, after);
+        g_assert_cmpint (before - midnight, <, G_TIME_SPAN_DAY);
+}
+
+int
+main (int argc, char **argv)
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/clock/utc-midnight", test_midnight);
+        g_test_add_func ("/clock/utc-midnight/advance", test_midnight_advance);
+        g_test_add_func ("/clock/system", test_system);
+
+        return g_test_run ();
+}
@@ -0,0 +1,150 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <math.h>
+#include <glib.h>
+#include "gclue-geodesy.h"
+
+#define DMS(degrees, minutes, seconds) \
+        ((degrees) + (minutes) / 60.0 + (seconds) / 3600.0)
+
+typedef struct {
+        const char *name;
+        gdouble     latitude1;
+        gdouble     longitude1;
+        gdouble     latitude2;
+        gdouble     longitude2;
+        gboolean    converges;
+        gdouble     distance;   /* In meters, to a millimeter */
+        gdouble     bearing;    /* NAN for none */
+} InverseCase;
+
+static const InverseCase inverse_cases[] = {
+        /* The example of Vincenty's paper, Flinders Peak to Buninyong */
+        { "flinders-peak",
+          -DMS (37, 57, 3.72030), DMS (144, 25, 29.52440),
+          -DMS (37, 39, 10.15610), DMS (143, 55, 35.38390),
+          TRUE, 54972.271, DMS (306, 52, 5.373) },
+        { "equator", 0, 0, 0, 1, TRUE, 111319.491, 90 },
+        { "antimeridian", 0, 179.5, 0, -179.5, TRUE, 111319.491, 90 },
+        { "meridian-south", 0, 0, -1, 0, TRUE, 110574.389, 180 },
+        { "quarter-meridian", 0, 0, 90, 0, TRUE, 10001965.729, 0 },
+        { "same-point", 10, 10, 10, 10, TRUE, 0, NAN },
+        { "nearly-antipodal", 0, 0, 0.5, 179.7, FALSE },
+};
+
+static void
+test_ellipsoid_inverse (gconstpointer data)
+{
+        const InverseCase *test = data;
+        gdouble distance = -1, bearing = -1;
+        gboolean converges;
+
+        converges = gclue_geodesy_ellipsoid_inverse (test->latitude1,
+                                                     test->longitude1,
+                                                     test->latitude2,
+                                                     test->longitude2,
+                                                     &distance,
+                                                     &bearing);
+        g_assert_cmpint (converges, ==, test->converges);
+        if (!converges) {
+                g_assert_cmpfloat (distance, ==, -1);
+                g_assert_cmpfloat (bearing, ==, -1);
+                return;
+        }
+
+        g_assert_cmpfloat_with_epsilon (distance, test->distance, 1e-3);
+        if (isnan (test->bearing))
+                g_assert_true (isnan (bearing));
+        else
+                g_assert_cmpfloat_with_epsilon (bearing, test->bearing, 1e-6);
+
+        /* Both outputs are optional */
+        g_assert_true (gclue_geodesy_ellipsoid_inverse (test->latitude1,
+                                                        test->longitude1,
+                                                        test->latitude2,
+                                                        test->longitude2,
+                                                        NULL,
+                                                        NULL));
+}
+
+typedef struct {
+        const char *name;
+        gdouble     latitude2;
+        gdouble     longitude2;
+        gdouble     bearing;
+} BearingCase;
+
+/* From 0, 0 */
+static const BearingCase bearing_cases[] = {
+        { "north", 1, 0, 0 },
+        { "east", 0, 1, 90 },
+        { "south", -1, 0, 180 },
+        { "west", 0, -1, 270 },
+        { "north-east", 1, 1, 45 },
+        { "same-point", 0, 0, NAN },
+};
+
+static void
+test_sphere_bearing (gconstpointer data)
+{
+        const BearingCase *test = data;
+        gdouble bearing;
+
+        bearing = gclue_geodesy_sphere_bearing (0, 0,
+                                                test->latitude2,
+                                                test->longitude2);
+        if (isnan (test->bearing)) {
+                g_assert_true (isnan (bearing));
+                return;
+        }
+
+        /* Within a fraction of a degree of the ellipsoid's */
+        g_assert_cmpfloat_with_epsilon (bearing, test->bearing, 0.01);
+}
+
+int
+main (int argc, char **argv)
+{
+        guint i;
+
+        g_test_init (&argc, &argv, NULL);
+
+        for (i = 0; i < G_N_ELEMENTS (inverse_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/geodesy/ellipsoid-inverse/%s",
+                                        inverse_cases[i].name);
+                g_test_add_data_func (path, &inverse_cases[i],
+                                      test_ellipsoid_inverse);
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (bearing_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/geodesy/sphere-bearing/%s",
+                                        bearing_cases[i].name);
+                g_test_add_data_func (path, &bearing_cases[i],
+                                      test_sphere_bearing);
+        }
+
+        return g_test_run ();
+}
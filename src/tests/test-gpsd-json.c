@@ -0,0 +1,320 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include "gclue-gpsd-json.h"
+
+/* 2024-05-01T12:34:56Z */
+#define TEST_TIME (G_GINT64_CONSTANT (1714566896) * G_USEC_PER_SEC)
+
+#define SKY "{\"class\":\"SKY\",\"hdop\":0.9,\"satellites\":[" \
+            "{\"PRN\":5,\"el\":45,\"az\":120,\"ss\":38,\"used\":true}," \
+            "{\"PRN\":7,\"el\":10,\"az\":300,\"ss\":0,\"used\":false}]}"
+
+typedef struct {
+        const char          *name;
+        const char          *line;
+        gboolean             valid;
+        GClueGpsdReportClass report_class;
+        gint                 mode;
+        gint64               time;
+        gdouble              latitude;  /* NAN if it's to be unknown */
+        gdouble              longitude;
+        gdouble              altitude;
+        gdouble              eph;
+        guint                n_satellites;
+} ParseCase;
+
+static const ParseCase parse_cases[] = {
+        { "tpv",
+          "{\"class\":\"TPV\",\"device\":\"/dev/ttyACM0\",\"mode\":3,"
+          "\"time\":\"2024-05-01T12:34:56.789Z\",\"lat\":52.5,\"lon\":13.4,"
+          "\"altHAE\":80.1,\"altMSL\":34.2,\"eph\":4.5,\"speed\":1.5}",
+          TRUE, GCLUE_GPSD_REPORT_TPV, 3, TEST_TIME + 789000,
+          52.5, 13.4, 34.2, 4.5, 0 },
+        { "tpv-whitespace",
+          " { \"class\" : \"TPV\" , \"mode\" : 2 , \"lat\" : -1e1 ,"
+          " \"lon\" : 0 }\r",
+          TRUE, GCLUE_GPSD_REPORT_TPV, 2, 0, -10, 0, NAN, NAN, 0 },
+        { "tpv-no-fix",
+          "{\"class\":\"TPV\",\"mode\":1,\"time\":\"2024-05-01T12:34:56Z\"}",
+          TRUE, GCLUE_GPSD_REPORT_TPV, 1, TEST_TIME, NAN, NAN, NAN, NAN, 0 },
+        { "tpv-old-protocol",
+          "{\"class\":\"TPV\",\"mode\":3,\"time\":1714566896.5,"
+          "\"lat\":1,\"lon\":2,\"alt\":3}",
+          TRUE, GCLUE_GPSD_REPORT_TPV, 3, TEST_TIME + G_USEC_PER_SEC / 2,
+          1, 2, 3, NAN, 0 },
+        { "tpv-bad-time",
+          "{\"class\":\"TPV\",\"mode\":3,\"time\":\"2024-13-01T12:34:56Z\"}",
+          TRUE, GCLUE_GPSD_REPORT_TPV, 3, 0, NAN, NAN, NAN, NAN, 0 },
+        { "tpv-time-without-zone",
+          "{\"class\":\"TPV\",\"mode\":3,\"time\":\"2024-05-01T12:34:56.789\"}",
+          TRUE, GCLUE_GPSD_REPORT_TPV, 3, 0, NAN, NAN, NAN, NAN, 0 },
+        { "tpv-nested",
+          "{\"class\":\"TPV\",\"x\":{\"y\":[1,true,null,\"}\"]},\"lat\":1}",
+          TRUE, GCLUE_GPSD_REPORT_TPV, 0, 0, 1, NAN, NAN, NAN, 0 },
+        { "tpv-escaped-string",
+          "{\"device\":\"a\\\"b\",\"class\":\"TPV\",\"lat\":1}",
+          TRUE, GCLUE_GPSD_REPORT_TPV, 0, 0, 1, NAN, NAN, NAN, 0 },
+        { "sky", SKY,
+          TRUE, GCLUE_GPSD_REPORT_SKY, 0, 0, NAN, NAN, NAN, NAN, 2 },
+        { "sky-empty",
+          "{\"class\":\"SKY\",\"satellites\":[ ]}",
+          TRUE, GCLUE_GPSD_REPORT_SKY, 0, 0, NAN, NAN, NAN, NAN, 0 },
+        { "sky-empty-satellite",
+          "{\"class\":\"SKY\",\"satellites\":[{}]}",
+          TRUE, GCLUE_GPSD_REPORT_SKY, 0, 0, NAN, NAN, NAN, NAN, 1 },
+        { "sky-bad-used",
+          "{\"class\":\"SKY\",\"satellites\":[{\"PRN\":5,\"used\":1}]}",
+          FALSE },
+        { "sky-unterminated-satellites",
+          "{\"class\":\"SKY\",\"satellites\":[{\"PRN\":5}",
+          FALSE },
+        { "version",
+          "{\"class\":\"VERSION\",\"release\":\"3.25\",\"proto_major\":3}",
+          TRUE, GCLUE_GPSD_REPORT_UNKNOWN, 0, 0, NAN, NAN, NAN, NAN, 0 },
+        { "empty-object", "{}",
+          TRUE, GCLUE_GPSD_REPORT_UNKNOWN, 0, 0, NAN, NAN, NAN, NAN, 0 },
+        { "empty", "", FALSE },
+        { "array", "[1]", FALSE },
+        { "truncated", "{\"class\":\"TPV\",\"lat\":", FALSE },
+        { "unterminated", "{\"class\":\"TPV\",\"lat\":1", FALSE },
+        { "unterminated-string", "{\"class\":\"TP", FALSE },
+        { "missing-colon", "{\"class\" \"TPV\"}", FALSE },
+        { "bad-number", "{\"class\":\"TPV\",\"lat\":abc}", FALSE },
+        { "number-exponent",
+          "{\"class\":\"TPV\",\"lat\":-0.25E+2,\"lon\":1e-1}",
+          TRUE, GCLUE_GPSD_REPORT_TPV, 0, 0, -25, 0.1, NAN, NAN, 0 },
+        { "number-nan", "{\"class\":\"TPV\",\"lat\":nan}", FALSE },
+        { "number-inf", "{\"class\":\"TPV\",\"lat\":-inf}", FALSE },
+        { "number-hex", "{\"class\":\"TPV\",\"lat\":0x1A}", FALSE },
+        { "number-plus", "{\"class\":\"TPV\",\"lat\":+1}", FALSE },
+        { "number-leading-zero", "{\"class\":\"TPV\",\"lat\":01}", FALSE },
+        { "number-no-fraction", "{\"class\":\"TPV\",\"lat\":1.}", FALSE },
+        { "number-no-integer", "{\"class\":\"TPV\",\"lat\":.5}", FALSE },
+        { "number-no-exponent", "{\"class\":\"TPV\",\"lat\":1e}", FALSE },
+        { "number-overflow", "{\"class\":\"TPV\",\"lat\":1e999}", FALSE },
+        { "mode-out-of-range", "{\"class\":\"TPV\",\"mode\":1e10}", FALSE },
+        { "prn-out-of-range",
+          "{\"class\":\"SKY\",\"satellites\":[{\"PRN\":-3e9}]}",
+          FALSE },
+        { "trailing-comma", "{\"class\":\"TPV\",}", FALSE },
+        { "trailing-comma-array", "{\"class\":\"TPV\",\"x\":[1,]}", FALSE },
+        { "trailing-comma-object", "{\"class\":\"TPV\",\"x\":{\"y\":1,}}", FALSE },
+        { "trailing-comma-satellites",
+          "{\"class\":\"SKY\",\"satellites\":[{\"PRN\":5},]}",
+          FALSE },
+        { "trailing-comma-satellite",
+          "{\"class\":\"SKY\",\"satellites\":[{\"PRN\":5,}]}",
+          FALSE },
+        { "trailing-garbage", "{\"class\":\"TPV\"} x", FALSE },
+        { "two-objects", "{}{}", FALSE },
+        { "bad-literal", "{\"class\":\"TPV\",\"x\":nul}", FALSE },
+        { "too-deep", "{\"x\":[[[[[[[[[1]]]]]]]]]}", FALSE },
+};
+
+static void
+assert_value (gdouble value,
+              gdouble expected)
+{
+        if (isnan (expected))
+                g_assert_true (isnan (value));
+        else
+                g_assert_cmpfloat_with_epsilon (value, expected, 1e-9);
+}
+
+static void
+test_parse (gconstpointer data)
+{
+        const ParseCase *test = data;
+        GClueGpsdReport report;
+        gboolean valid;
+
+        valid = gclue_gpsd_json_parse (test->line, &report);
+        g_assert_cmpint (valid, ==, test->valid);
+        if (!valid)
+                return;
+
+        g_assert_cmpint (report.report_class, ==, test->report_class);
+        g_assert_cmpint (report.mode, ==, test->mode);
+        g_assert_cmpint (report.time, ==, test->time);
+        assert_value (report.latitude, test->latitude);
+        assert_value (report.longitude, test->longitude);
+        assert_value (report.altitude, test->altitude);
+        assert_value (report.eph, test->eph);
+        g_assert_cmpuint (report.n_satellites, ==, test->n_satellites);
+}
+
+static void
+test_parse_sky_satellites (void)
+{
+        GClueGpsdReport report;
+
+        g_assert_true (gclue_gpsd_json_parse (SKY, &report));
+        g_assert_cmpfloat (report.hdop, ==, 0.9);
+        g_assert_true (isnan (report.vdop));
+
+        g_assert_cmpint (report.satellites[0].prn, ==, 5);
+        g_assert_cmpfloat (report.satellites[0].elevation, ==, 45);
+        g_assert_cmpfloat (report.satellites[0].azimuth, ==, 120);
+        g_assert_cmpfloat (report.satellites[0].snr, ==, 38);
+        g_assert_true (report.satellites[0].used);
+        g_assert_cmpint (report.satellites[1].prn, ==, 7);
+        g_assert_false (report.satellites[1].used);
+}
+
+static void
+test_parse_sky_too_many (void)
+{
+        g_autoptr(GString) line = g_string_new ("{\"class\":\"SKY\",\"satellites\":[");
+        GClueGpsdReport report;
+        guint i;
+
+        for (i = 0; i < GCLUE_GPSD_JSON_MAX_SATELLITES + 6; i++)
+                g_string_append_printf (line, "%s{\"PRN\":%u,\"used\":false}",
+                                        i > 0 ? "," : "", i + 1);
+        g_string_append (line, "],\"hdop\":1.5}");
+
+        /* The rest are skipped, not the report */
+        g_assert_true (gclue_gpsd_json_parse (line->str, &report));
+        g_assert_cmpuint (report.n_satellites, ==, GCLUE_GPSD_JSON_MAX_SATELLITES);
+        g_assert_cmpint (report.satellites[GCLUE_GPSD_JSON_MAX_SATELLITES - 1].prn,
+                         ==, GCLUE_GPSD_JSON_MAX_SATELLITES);
+        g_assert_cmpfloat (report.hdop, ==, 1.5);
+}
+
+static void
+test_parse_gst (void)
+{
+        GClueGpsdReport report;
+
+        /* In a GST, these are the errors of the position */
+        g_assert_true (gclue_gpsd_json_parse
+                        ("{\"class\":\"GST\",\"rms\":2.1,\"lat\":3.0,"
+                         "\"lon\":4.0,\"alt\":5.0}",
+                         &report));
+        g_assert_cmpint (report.report_class, ==, GCLUE_GPSD_REPORT_GST);
+        g_assert_cmpfloat (report.rms, ==, 2.1);
+        g_assert_cmpfloat (report.lat_err, ==, 3.0);
+        g_assert_cmpfloat (report.lon_err, ==, 4.0);
+        g_assert_cmpfloat (report.alt_err, ==, 5.0);
+        g_assert_true (isnan (report.latitude));
+        g_assert_true (isnan (report.longitude));
+}
+
+/* Reads everything written to @input back, one line per element */
+static GPtrArray *
+read_lines (const char *input,
+            gsize       input_len)
+{
+        GClueGpsdJsonReader reader;
+        GPtrArray *lines = g_ptr_array_new_with_free_func (g_free);
+        gint fds[2];
+        gsize done = 0;
+
+        g_assert_cmpint (pipe (fds), ==, 0);
+        gclue_gpsd_json_reader_init (&reader);
+
+        while (TRUE) {
+                const char *line;
+                gssize ret;
+
+                /* A pipe takes more than a buffer's worth at a time */
+                if (done < input_len) {
+                        gsize n = MIN (input_len - done,
+                                       GCLUE_GPSD_JSON_MAX_LINE / 2);
+
+                        g_assert_cmpint (write (fds[1], input + done, n), ==, n);
+                        done += n;
+                        if (done == input_len)
+                                close (fds[1]);
+                }
+
+                ret = gclue_gpsd_json_reader_fill (&reader, fds[0]);
+                g_assert_cmpint (ret, >=, 0);
+                if (ret == 0 && done == input_len)
+                        break;
+
+                while ((line = gclue_gpsd_json_reader_next_line (&reader)))
+                        g_ptr_array_add (lines, g_strdup (line));
+        }
+        close (fds[0]);
+
+        return lines;
+}
+
+static void
+test_reader (void)
+{
+        const char *input = "{\"class\":\"TPV\"}\n\n{\"class\":\"SKY\"}\n{\"class\"";
+        g_autoptr(GPtrArray) lines = NULL;
+
+        /* The incomplete line at the end never shows up */
+        lines = read_lines (input, strlen (input));
+        g_assert_cmpuint (lines->len, ==, 3);
+        g_assert_cmpstr (g_ptr_array_index (lines, 0), ==, "{\"class\":\"TPV\"}");
+        g_assert_cmpstr (g_ptr_array_index (lines, 1), ==, "");
+        g_assert_cmpstr (g_ptr_array_index (lines, 2), ==, "{\"class\":\"SKY\"}");
+}
+
+static void
+test_reader_overlong (void)
+{
+        g_autoptr(GString) input = g_string_new ("{\"class\":\"TPV\"}\n{");
+        g_autoptr(GPtrArray) lines = NULL;
+
+        while (input->len < 3 * GCLUE_GPSD_JSON_MAX_LINE)
+                g_string_append_c (input, ' ');
+        g_string_append (input, "}\n{\"class\":\"SKY\"}\n");
+
+        lines = read_lines (input->str, input->len);
+        g_assert_cmpuint (lines->len, ==, 2);
+        g_assert_cmpstr (g_ptr_array_index (lines, 0), ==, "{\"class\":\"TPV\"}");
+        g_assert_cmpstr (g_ptr_array_index (lines, 1), ==, "{\"class\":\"SKY\"}");
+}
+
+int
+main (int argc, char **argv)
+{
+        guint i;
+
+        g_test_init (&argc, &argv, NULL);
+
+        for (i = 0; i < G_N_ELEMENTS (parse_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/gpsd-json/parse/%s",
+                                        parse_cases[i].name);
+                g_test_add_data_func (path, &parse_cases[i], test_parse);
+        }
+        g_test_add_func ("/gpsd-json/parse/sky-satellites",
+                         test_parse_sky_satellites);
+        g_test_add_func ("/gpsd-json/parse/sky-too-many",
+                         test_parse_sky_too_many);
+        g_test_add_func ("/gpsd-json/parse/gst", test_parse_gst);
+        g_test_add_func ("/gpsd-json/reader/lines", test_reader);
+        g_test_add_func ("/gpsd-json/reader/overlong", test_reader_overlong);
+
+        return g_test_run ();
+}
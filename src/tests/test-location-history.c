@@ -0,0 +1,277 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <math.h>
+#include <glib.h>
+#include "gclue-location-history.h"
+
+/* 2024-03-01 00:00:00 UTC */
+#define MARCH_1 (G_GINT64_CONSTANT (1709251200) * G_TIME_SPAN_SECOND)
+
+/* A degree at the equator on the WGS-84 ellipsoid, east and north */
+#define EQUATOR_DEGREE  111319.491
+#define MERIDIAN_DEGREE 110574.389
+
+static GClueLocationData
+fix_at (gdouble latitude, gdouble longitude, gint64 seconds)
+{
+        return (GClueLocationData) {
+                .latitude = latitude,
+                .longitude = longitude,
+                .accuracy = 5,
+                .altitude = GCLUE_LOCATION_ALTITUDE_UNKNOWN,
+                .altitude_accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                .speed = GCLUE_LOCATION_SPEED_UNKNOWN,
+                .speed_accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                .heading = GCLUE_LOCATION_HEADING_UNKNOWN,
+                .heading_accuracy = GCLUE_LOCATION_ACCURACY_UNKNOWN,
+                .climb = GCLUE_LOCATION_CLIMB_UNKNOWN,
+                .timestamp = MARCH_1 + seconds * G_TIME_SPAN_SECOND,
+                .description = "test",
+        };
+}
+
+static void
+assert_timestamps (const GClueLocationHistory *history,
+                   const gint64               *seconds,
+                   guint                       n_seconds)
+{
+        guint i;
+
+        g_assert_cmpuint (gclue_location_history_get_length (history),
+                          ==,
+                          n_seconds);
+        for (i = 0; i < n_seconds; i++) {
+                const GClueLocationData *fix;
+
+                fix = gclue_location_history_get (history, i);
+                g_assert_cmpint (fix->timestamp,
+                                 ==,
+                                 MARCH_1 + seconds[i] * G_TIME_SPAN_SECOND);
+                g_assert_null (fix->description);
+        }
+}
+
+typedef struct {
+        const char *name;
+        gint64      added[6];
+        guint       n_added;
+        gint64      kept[6];
+        guint       n_kept;
+} AddCase;
+
+static const AddCase add_cases[] = {
+        { "empty", { 0 }, 0, { 0 }, 0 },
+        { "increasing", { 1, 2, 3 }, 3, { 1, 2, 3 }, 3 },
+        { "same-timestamp-replaces", { 1, 2, 2 }, 3, { 1, 2 }, 2 },
+        { "older-starts-over", { 1, 2, 3, 1, 2 }, 5, { 1, 2 }, 2 },
+};
+
+static void
+test_add (gconstpointer data)
+{
+        const AddCase *test = data;
+        GClueLocationHistory history;
+        guint i;
+
+        gclue_location_history_init (&history);
+        for (i = 0; i < test->n_added; i++) {
+                GClueLocationData fix = fix_at (i, 0, test->added[i]);
+
+                gclue_location_history_add (&history, &fix);
+        }
+
+        assert_timestamps (&history, test->kept, test->n_kept);
+
+        /* The replacing fix is the one kept */
+        if (test->n_kept > 0) {
+                const GClueLocationData *latest;
+
+                latest = gclue_location_history_get (&history,
+                                                     test->n_kept - 1);
+                g_assert_cmpfloat (latest->latitude, ==, test->n_added - 1);
+        }
+}
+
+static void
+test_add_wraps (void)
+{
+        GClueLocationHistory history;
+        gint64 kept[GCLUE_LOCATION_HISTORY_SIZE];
+        guint i, n_added = GCLUE_LOCATION_HISTORY_SIZE * 2 + 3;
+
+        gclue_location_history_init (&history);
+        for (i = 0; i < n_added; i++) {
+                GClueLocationData fix = fix_at (0, 0, i);
+
+                gclue_location_history_add (&history, &fix);
+        }
+
+        for (i = 0; i < GCLUE_LOCATION_HISTORY_SIZE; i++)
+                kept[i] = n_added - GCLUE_LOCATION_HISTORY_SIZE + i;
+        assert_timestamps (&history, kept, GCLUE_LOCATION_HISTORY_SIZE);
+}
+
+typedef struct {
+        const char *name;
+        gint64      timestamp;
+        guint       index;
+} FindCase;
+
+/* In a history of fixes at 10, 20, 30 and 40 s */
+static const FindCase find_cases[] = {
+        { "before-all", 5, 0 },
+        { "oldest", 10, 0 },
+        { "between", 25, 2 },
+        { "latest", 40, 3 },
+        { "after-all", 45, 4 },
+};
+
+static void
+test_find (gconstpointer data)
+{
+        const FindCase *test = data;
+        GClueLocationHistory history;
+        guint i;
+
+        gclue_location_history_init (&history);
+        for (i = 1; i <= 4; i++) {
+                GClueLocationData fix = fix_at (0, 0, i * 10);
+
+                gclue_location_history_add (&history, &fix);
+        }
+
+        g_assert_cmpuint (gclue_location_history_find (&history,
+                                                       MARCH_1 +
+                                                       test->timestamp *
+                                                       G_TIME_SPAN_SECOND),
+                          ==,
+                          test->index);
+}
+
+typedef struct {
+        const char *name;
+        guint       n_fixes;    /* In the history, one a second */
+        gdouble     north;      /* Degrees a second */
+        gdouble     east;
+        guint       start;
+        gint64      latest;     /* Seconds after the first fix */
+        gboolean    valid;
+        gdouble     speed;
+        gdouble     heading;
+} VelocityCase;
+
+static const VelocityCase velocity_cases[] = {
+        { "east", 5, 0, 1e-4, 0, 5,
+          TRUE, EQUATOR_DEGREE * 1e-4, 90 },
+        { "north", 5, 1e-4, 0, 0, 5,
+          TRUE, MERIDIAN_DEGREE * 1e-4, 0 },
+        { "west", 5, 0, -1e-4, 0, 5,
+          TRUE, EQUATOR_DEGREE * 1e-4, 270 },
+        { "two-fixes", 1, 1e-4, 0, 0, 1,
+          TRUE, MERIDIAN_DEGREE * 1e-4, 0 },
+        { "from-start", 5, 0, 1e-4, 3, 5,
+          TRUE, EQUATOR_DEGREE * 1e-4, 90 },
+        { "stationary", 5, 0, 0, 0, 5,
+          TRUE, 0, GCLUE_LOCATION_HEADING_UNKNOWN },
+        { "no-history", 0, 0, 1e-4, 0, 5, FALSE },
+        { "start-past-end", 5, 0, 1e-4, 5, 5, FALSE },
+
+        /* The fix at the same time as the latest is replaced by it */
+        { "same-timestamp", 5, 0, 1e-4, 0, 4,
+          TRUE, EQUATOR_DEGREE * 1e-4, 90 },
+        { "same-timestamp-only", 1, 0, 1e-4, 0, 0, FALSE },
+
+        /* Adding the latest starts the history over */
+        { "clock-set-back", 5, 0, 1e-4, 0, 2, FALSE },
+};
+
+static void
+test_get_velocity (gconstpointer data)
+{
+        const VelocityCase *test = data;
+        GClueLocationHistory history;
+        GClueLocationData latest;
+        gdouble speed = -1, heading = -1;
+        gboolean valid;
+        guint i;
+
+        gclue_location_history_init (&history);
+        for (i = 0; i < test->n_fixes; i++) {
+                GClueLocationData fix = fix_at (test->north * i,
+                                                test->east * i,
+                                                i);
+
+                gclue_location_history_add (&history, &fix);
+        }
+        latest = fix_at (test->north * test->latest,
+                         test->east * test->latest,
+                         test->latest);
+
+        valid = gclue_location_history_get_velocity (&history,
+                                                     test->start,
+                                                     &latest,
+                                                     &speed,
+                                                     &heading);
+        g_assert_cmpint (valid, ==, test->valid);
+        if (!valid)
+                return;
+
+        g_assert_cmpfloat_with_epsilon (speed, test->speed, 1e-3);
+        g_assert_cmpfloat_with_epsilon (heading, test->heading, 1e-6);
+}
+
+int
+main (int argc, char **argv)
+{
+        guint i;
+
+        g_test_init (&argc, &argv, NULL);
+
+        for (i = 0; i < G_N_ELEMENTS (add_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/location-history/add/%s",
+                                        add_cases[i].name);
+                g_test_add_data_func (path, &add_cases[i], test_add);
+        }
+        g_test_add_func ("/location-history/add/wraps", test_add_wraps);
+
+        for (i = 0; i < G_N_ELEMENTS (find_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/location-history/find/%s",
+                                        find_cases[i].name);
+                g_test_add_data_func (path, &find_cases[i], test_find);
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (velocity_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/location-history/get-velocity/%s",
+                                        velocity_cases[i].name);
+                g_test_add_data_func (path,
+                                      &velocity_cases[i],
+                                      test_get_velocity);
+        }
+
+        return g_test_run ();
+}
@@ -0,0 +1,173 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <math.h>
+#include <glib.h>
+#include "gclue-location.h"
+
+/* 2024-03-01 00:00:00 UTC */
+#define MARCH_1 (G_GINT64_CONSTANT (1709251200) * G_TIME_SPAN_SECOND)
+#define AT(hours, minutes, seconds) \
+        (MARCH_1 + (hours) * G_TIME_SPAN_HOUR + \
+         (minutes) * G_TIME_SPAN_MINUTE + (seconds) * G_TIME_SPAN_SECOND)
+
+#define GGA_AT(time) \
+        "$GPGGA," time ",4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,"
+#define GGA GGA_AT ("123519")
+#define RMC "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A"
+
+/* 4807.038 N 01131.000 E */
+#define LATITUDE  (48.0 + 7.038 / 60.0)
+#define LONGITUDE (11.0 + 31.0 / 60.0)
+
+#define UNKNOWN_ACCURACY GCLUE_LOCATION_ACCURACY_UNKNOWN
+#define UNKNOWN_ALTITUDE GCLUE_LOCATION_ALTITUDE_UNKNOWN
+#define UNKNOWN_SPEED    GCLUE_LOCATION_SPEED_UNKNOWN
+#define UNKNOWN_HEADING  GCLUE_LOCATION_HEADING_UNKNOWN
+
+typedef struct {
+        const char *name;
+        const char *nmeas[5];
+        gint64      reference;
+        gboolean    valid;
+        gint64      timestamp;
+        gdouble     accuracy;
+        gdouble     altitude;
+        gdouble     altitude_accuracy;
+        gdouble     speed;
+        gdouble     heading;
+        const char *description;
+} NMEACase;
+
+static const NMEACase nmea_cases[] = {
+        { "gga", { GGA }, AT (12, 35, 20),
+          TRUE, AT (12, 35, 19), 4.5, 545.4, UNKNOWN_ACCURACY,
+          UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+        { "rmc", { RMC }, AT (12, 35, 20),
+          TRUE, AT (12, 35, 19), 5, UNKNOWN_ALTITUDE, UNKNOWN_ACCURACY,
+          22.4 * 0.51444, 84.4, "GPS RMC" },
+        { "gga-rmc", { GGA, RMC }, AT (12, 35, 20),
+          TRUE, AT (12, 35, 19), 4.5, 545.4, UNKNOWN_ACCURACY,
+          22.4 * 0.51444, 84.4, "GPS GGA+RMC" },
+        { "gga-vtg", { GGA, "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K,A" },
+          AT (12, 35, 20),
+          TRUE, AT (12, 35, 19), 4.5, 545.4, UNKNOWN_ACCURACY,
+          10.2 / 3.6, 54.7, "GPS GGA" },
+        { "gst", { GGA, "$GPGST,123519,1.0,3.0,4.0,0.0,3.0,4.0,2.5" },
+          AT (12, 35, 20),
+          TRUE, AT (12, 35, 19), 5, 545.4, 2.5,
+          UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+        { "gst-other-fix", { GGA, "$GPGST,123518,1.0,3.0,4.0,0.0,3.0,4.0,2.5" },
+          AT (12, 35, 20),
+          TRUE, AT (12, 35, 19), 4.5, 545.4, UNKNOWN_ACCURACY,
+          UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+        { "gsa-per-system",
+          { GGA,
+            "$GNGSA,A,1,,,,,,,,,,,,,99.9,99.9,99.9,1",
+            "$GNGSA,A,3,05,07,,,,,,,,,,,1.5,2.0,1.2,2" },
+          AT (12, 35, 20),
+          TRUE, AT (12, 35, 19), 10, 545.4, 6,
+          UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+        { "gsa-2d", { GGA, "$GPGSA,A,2,05,07,,,,,,,,,,,1.5,2.0,1.2" },
+          AT (12, 35, 20),
+          TRUE, AT (12, 35, 19), 10, UNKNOWN_ALTITUDE, UNKNOWN_ACCURACY,
+          UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+        { "gga-no-fix",
+          { "$GPGGA,123519,4807.038,N,01131.000,E,0,00,,,M,,M,," },
+          AT (12, 35, 20), FALSE },
+        { "rmc-void",
+          { "$GPRMC,123519,V,4807.038,N,01131.000,E,,,230394,,,N" },
+          AT (12, 35, 20), FALSE },
+        { "no-fix-sentences", { "$GPGSA,A,3,05,07,,,,,,,,,,,1.5,2.0,1.2" },
+          AT (12, 35, 20), FALSE },
+
+        /* The reference only tells the day, the closest time of day to
+         * it wins, whichever side of midnight that is.
+         */
+        { "same-day-earlier", { GGA_AT ("000100") }, AT (12, 0, 0),
+          TRUE, AT (0, 1, 0), 4.5, 545.4, UNKNOWN_ACCURACY,
+          UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+        { "same-day-later", { GGA_AT ("235900") }, AT (12, 0, 0),
+          TRUE, AT (23, 59, 0), 4.5, 545.4, UNKNOWN_ACCURACY,
+          UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+        { "midnight-forward", { GGA_AT ("000000.50") }, AT (23, 59, 59),
+          TRUE, AT (24, 0, 0) + G_TIME_SPAN_MILLISECOND * 500, 4.5, 545.4,
+          UNKNOWN_ACCURACY, UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+        { "midnight-backward", { GGA_AT ("235959") }, AT (24, 0, 1),
+          TRUE, AT (23, 59, 59), 4.5, 545.4, UNKNOWN_ACCURACY,
+          UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+        { "half-a-day-later", { GGA_AT ("120000") }, AT (0, 0, 0),
+          TRUE, AT (-12, 0, 0), 4.5, 545.4, UNKNOWN_ACCURACY,
+          UNKNOWN_SPEED, UNKNOWN_HEADING, "GPS GGA" },
+};
+
+static void
+test_from_nmeas_at (gconstpointer data)
+{
+        const NMEACase *test = data;
+        const char *nmeas[G_N_ELEMENTS (test->nmeas)];
+        GClueLocationData location;
+        gboolean valid;
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS (nmeas); i++)
+                nmeas[i] = test->nmeas[i];
+
+        valid = gclue_location_data_from_nmeas_at (nmeas,
+                                                   NULL,
+                                                   test->reference,
+                                                   &location);
+        g_assert_cmpint (valid, ==, test->valid);
+        if (!valid)
+                return;
+
+        g_assert_cmpfloat_with_epsilon (location.latitude, LATITUDE, 1e-9);
+        g_assert_cmpfloat_with_epsilon (location.longitude, LONGITUDE, 1e-9);
+        g_assert_cmpint (location.timestamp, ==, test->timestamp);
+        g_assert_cmpfloat_with_epsilon (location.accuracy,
+                                        test->accuracy,
+                                        1e-9);
+        g_assert_cmpfloat (location.altitude, ==, test->altitude);
+        g_assert_cmpfloat_with_epsilon (location.altitude_accuracy,
+                                        test->altitude_accuracy,
+                                        1e-9);
+        g_assert_cmpfloat_with_epsilon (location.speed, test->speed, 1e-9);
+        g_assert_cmpfloat_with_epsilon (location.heading, test->heading, 1e-9);
+        g_assert_cmpstr (location.description, ==, test->description);
+}
+
+int
+main (int argc, char **argv)
+{
+        guint i;
+
+        g_test_init (&argc, &argv, NULL);
+
+        for (i = 0; i < G_N_ELEMENTS (nmea_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/location/from-nmeas-at/%s",
+                                        nmea_cases[i].name);
+                g_test_add_data_func (path, &nmea_cases[i], test_from_nmeas_at);
+        }
+
+        return g_test_run ();
+}
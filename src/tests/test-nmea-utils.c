@@ -0,0 +1,457 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+#include "gclue-nmea-utils.h"
+
+#define GGA "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,"
+
+typedef struct {
+        const char *name;
+        const char *sentence;
+        gboolean    valid;
+        guint       n_fields;
+} FieldsCase;
+
+static const FieldsCase fields_cases[] = {
+        { "checksum", GGA "*47", TRUE, 15 },
+        { "checksum-lowercase", "$GPGSA,A,3,05,07,,,,,,,,,,,1.5,0.9,1.2*3e", TRUE, 18 },
+        { "no-checksum", GGA, TRUE, 15 },
+        { "checksum-mismatch", GGA "*48", FALSE, 0 },
+        { "checksum-one-digit", GGA "*4", FALSE, 0 },
+        { "checksum-missing", GGA "*", FALSE, 0 },
+        { "checksum-not-hex", GGA "*4G", FALSE, 0 },
+        { "no-dollar", "GPGGA,123519*47", FALSE, 0 },
+        { "empty", "", FALSE, 0 },
+        { "address-only", "$GPGGA", TRUE, 1 },
+        { "too-many-fields",
+          "$GPXXX,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,", FALSE, 0 },
+        { "most-fields",
+          "$GPXXX,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,", TRUE, 32 },
+};
+
+static void
+test_fields_parse (gconstpointer data)
+{
+        const FieldsCase *test = data;
+        GClueNMEAFields fields;
+        gboolean valid;
+
+        valid = gclue_nmea_fields_parse (&fields, test->sentence);
+        g_assert_cmpint (valid, ==, test->valid);
+        if (valid)
+                g_assert_cmpuint (fields.n_fields, ==, test->n_fields);
+}
+
+static void
+test_fields_get (void)
+{
+        GClueNMEAFields fields;
+        const char *field;
+        gdouble value;
+        guint number;
+        gsize len;
+
+        g_assert_true (gclue_nmea_fields_parse (&fields, GGA "*47"));
+
+        field = gclue_nmea_fields_get (&fields, 0, &len);
+        g_assert_cmpuint (len, ==, 5);
+        g_assert_cmpint (strncmp (field, "GPGGA", len), ==, 0);
+
+        g_assert_true (gclue_nmea_fields_get_double (&fields, 2, &value));
+        g_assert_cmpfloat (value, ==, 4807.038);
+        g_assert_cmpint (gclue_nmea_fields_get_char (&fields, 3), ==, 'N');
+        g_assert_true (gclue_nmea_fields_get_uint (&fields, 7, &number));
+        g_assert_cmpuint (number, ==, 8);
+        g_assert_cmpint (gclue_nmea_fields_get_timespan (&fields, 1), ==,
+                         ((12 * 60 + 35) * 60 + 19) * G_TIME_SPAN_SECOND);
+
+        /* The last field stops at the checksum */
+        g_assert_cmpuint (fields.len[14], ==, 0);
+
+        /* Empty, and past the end of the sentence */
+        g_assert_false (gclue_nmea_fields_get_double (&fields, 13, &value));
+        g_assert_true (isnan (value));
+        g_assert_cmpint (gclue_nmea_fields_get_char (&fields, 14), ==, '\0');
+        field = gclue_nmea_fields_get (&fields, 20, &len);
+        g_assert_cmpuint (len, ==, 0);
+        g_assert_false (gclue_nmea_fields_get_uint (&fields, 20, &number));
+}
+
+typedef struct {
+        const char *name;
+        const char *input;
+        gsize       chunk;      /* Bytes per read, 0 for all at once */
+        const char *sentences;  /* Separated by '|' */
+} FramerCase;
+
+static const FramerCase framer_cases[] = {
+        { "crlf", "$GPA\r\n$GPB\r\n", 0, "$GPA|$GPB" },
+        { "lf", "$GPA\n$GPB\n", 0, "$GPA|$GPB" },
+        { "cr", "$GPA\r$GPB\r", 0, "$GPA|$GPB" },
+        { "cr-split", "$GPA\r$GPB\r", 1, "$GPA|$GPB" },
+        { "crlf-split", "$GPA\r\n$GPB\r\n", 1, "$GPA|$GPB" },
+        { "empty-lines", "\r\n\r\n$GPA\r\n\n\r$GPB\n", 0, "$GPA|$GPB" },
+        { "incomplete", "$GPA\r\n$GPB", 0, "$GPA" },
+        { "nothing", "$GPA", 0, "" },
+};
+
+static void
+feed_framer (GClueNMEAFramer *framer,
+             const char      *input,
+             gsize            input_len,
+             gsize            chunk,
+             GString         *out)
+{
+        gsize done = 0;
+
+        while (done < input_len) {
+                const char *sentence;
+                gsize size, n;
+                char *space;
+
+                space = gclue_nmea_framer_get_space (framer, &size);
+                n = MIN (input_len - done, size);
+                if (chunk != 0)
+                        n = MIN (n, chunk);
+                memcpy (space, input + done, n);
+                gclue_nmea_framer_commit (framer, n);
+                done += n;
+
+                while ((sentence = gclue_nmea_framer_next_sentence (framer))) {
+                        if (out->len > 0)
+                                g_string_append_c (out, '|');
+                        g_string_append (out, sentence);
+                }
+        }
+}
+
+static void
+test_framer (gconstpointer data)
+{
+        const FramerCase *test = data;
+        GClueNMEAFramer framer;
+        g_autoptr(GString) out = g_string_new (NULL);
+
+        gclue_nmea_framer_init (&framer);
+        feed_framer (&framer, test->input, strlen (test->input),
+                     test->chunk, out);
+        g_assert_cmpstr (out->str, ==, test->sentences);
+}
+
+static void
+test_framer_overlong (void)
+{
+        GClueNMEAFramer framer;
+        g_autoptr(GString) input = g_string_new ("$GPA\r\n$GPX,");
+        g_autoptr(GString) out = g_string_new (NULL);
+
+        /* Dropped along with the rest of its line, without losing the
+         * sentences around it.
+         */
+        while (input->len < 2 * GCLUE_NMEA_FRAMER_SIZE)
+                g_string_append_c (input, '0');
+        g_string_append (input, "\r\n$GPB\r\n");
+
+        gclue_nmea_framer_init (&framer);
+        feed_framer (&framer, input->str, input->len, 0, out);
+        g_assert_cmpstr (out->str, ==, "$GPA|$GPB");
+}
+
+#define GPGSV "$GPGSV,1,1,02,05,40,083,46,07,17,308,41"
+#define GLGSV "$GLGSV,1,1,02,05,62,120,38,07,11,201,30"
+
+/* 12 PRN fields, then PDOP, HDOP and VDOP */
+#define GSA_05 ",A,3,05,,,,,,,,,,,,1.5,0.9,1.2"
+#define GSA_07 ",A,3,07,,,,,,,,,,,,1.5,0.9,1.2"
+
+typedef struct {
+        const char *name;
+        const char *sentences[5];
+        /* GPS 05, GPS 07, GLONASS 05, GLONASS 07 */
+        gboolean    used[4];
+} SkyViewCase;
+
+static const SkyViewCase sky_view_cases[] = {
+        { "talker", { GPGSV, GLGSV, "$GPGSA" GSA_05 },
+          { TRUE, FALSE, FALSE, FALSE } },
+        { "system-id", { GPGSV, GLGSV, "$GNGSA" GSA_05 ",2" },
+          { FALSE, FALSE, TRUE, FALSE } },
+        { "system-id-per-gsa",
+          { GPGSV, GLGSV, "$GNGSA" GSA_05 ",1", "$GNGSA" GSA_07 ",2" },
+          { TRUE, FALSE, FALSE, TRUE } },
+        { "unknown-system", { GPGSV, GLGSV, "$GNGSA" GSA_05 },
+          { TRUE, FALSE, TRUE, FALSE } },
+        { "unknown-system-id", { GPGSV, GLGSV, "$GPGSA" GSA_05 ",9" },
+          { TRUE, FALSE, FALSE, FALSE } },
+};
+
+static void
+test_sky_view_used (gconstpointer data)
+{
+        const SkyViewCase *test = data;
+        GClueNMEASkyView sky_view;
+        guint i;
+
+        gclue_nmea_sky_view_init (&sky_view);
+        for (i = 0; test->sentences[i] != NULL; i++) {
+                if (gclue_nmea_type_is (test->sentences[i], "GSV"))
+                        gclue_nmea_sky_view_add_gsv (&sky_view,
+                                                     test->sentences[i]);
+                else
+                        gclue_nmea_sky_view_add_gsa (&sky_view,
+                                                     test->sentences[i]);
+        }
+
+        g_assert_cmpuint (sky_view.n_satellites, ==, 4);
+        for (i = 0; i < 4; i++)
+                g_assert_cmpint (gclue_nmea_sky_view_is_used
+                                        (&sky_view, &sky_view.satellites[i]),
+                                 ==,
+                                 test->used[i]);
+        g_assert_cmpfloat (sky_view.hdop, ==, 0.9);
+}
+
+#define GGA_AT(talker, time) \
+        "$" talker "GGA," time ",4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,"
+#define RMC_AT(talker, time) \
+        "$" talker "RMC," time ",A,4807.038,N,01131.000,E,022.4,084.4,230394,,"
+#define VTG "$GPVTG,084.4,T,,M,022.4,N,041.5,K"
+
+static const char * const epoch_talkers[] = { "GN", "GP", NULL };
+
+typedef struct {
+        const char *name;
+        const char *sentences[16];
+        const char *epochs;     /* Addresses, epochs separated by '|' */
+} EpochCase;
+
+static const EpochCase epoch_cases[] = {
+        { "next-time",
+          { GGA_AT ("GP", "120000"), RMC_AT ("GP", "120000"),
+            GGA_AT ("GP", "120001"), RMC_AT ("GP", "120001"),
+            GGA_AT ("GP", "120002") },
+          "GPGGA GPRMC|GPGGA GPRMC|GPGGA" },
+        { "too-late",
+          { GGA_AT ("GP", "120000"), RMC_AT ("GP", "120000"),
+            GGA_AT ("GP", "120001"), RMC_AT ("GP", "120000"),
+            RMC_AT ("GP", "120001") },
+          "GPGGA GPRMC|GPGGA GPRMC" },
+        { "timeless-in-epoch",
+          { GGA_AT ("GP", "120000"), "$GPGSA" GSA_05, VTG, RMC_AT ("GP", "120000"),
+            GGA_AT ("GP", "120001"), "$GPGSA" GSA_05, VTG, RMC_AT ("GP", "120001") },
+          "GPGGA GPRMC GPGSA GPVTG|GPGGA GPRMC GPGSA GPVTG" },
+        { "timeless-after-epoch",
+          { GGA_AT ("GP", "120000"), RMC_AT ("GP", "120000"),
+            GGA_AT ("GP", "120001"), RMC_AT ("GP", "120001"), "$GPGSA" GSA_05,
+            GGA_AT ("GP", "120002"), RMC_AT ("GP", "120002") },
+          "GPGGA GPRMC|GPGGA GPRMC|GPGGA GPRMC" },
+        { "timeless-first",
+          { "$GPGSA" GSA_05, GGA_AT ("GP", "120000"), RMC_AT ("GP", "120000") },
+          "GPGGA GPRMC" },
+        { "multi-gsa",
+          { RMC_AT ("GN", "120000"), GGA_AT ("GN", "120000"),
+            "$GNGSA" GSA_05 ",1", "$GNGSA" GSA_07 ",2", "$GNGSA" GSA_05 ",3",
+            RMC_AT ("GN", "120001"), GGA_AT ("GN", "120001"),
+            "$GNGSA" GSA_05 ",1", "$GNGSA" GSA_07 ",2", "$GNGSA" GSA_05 ",3",
+            RMC_AT ("GN", "120002"), GGA_AT ("GN", "120002"),
+            "$GNGSA" GSA_05 ",1", "$GNGSA" GSA_07 ",2", "$GNGSA" GSA_05 ",3" },
+          "GNGGA GNRMC GNGSA GNGSA GNGSA|"
+          "GNGGA GNRMC GNGSA GNGSA GNGSA|"
+          "GNGGA GNRMC GNGSA GNGSA GNGSA" },
+        { "gsa-preferred-talker",
+          { GGA_AT ("GP", "120000"), "$GPGSA" GSA_05, "$GNGSA" GSA_05 ",1",
+            "$GNGSA" GSA_07 ",2", "$GPGSA" GSA_07 },
+          "GPGGA GNGSA GNGSA" },
+};
+
+/* Appends the addresses of the sentences of @epoch and finishes it */
+static void
+finish_epoch (GClueNMEAEpoch *epoch,
+              GString        *out)
+{
+        const char *sentences[GCLUE_NMEA_EPOCH_MAX_SENTENCES + 1];
+        guint i;
+
+        gclue_nmea_epoch_get_sentences (epoch, sentences);
+        if (out->len > 0)
+                g_string_append_c (out, '|');
+        for (i = 0; sentences[i] != NULL; i++) {
+                if (i > 0)
+                        g_string_append_c (out, ' ');
+                g_string_append_len (out, sentences[i] + 1, 5);
+        }
+
+        gclue_nmea_epoch_finish (epoch);
+}
+
+static void
+test_epoch (gconstpointer data)
+{
+        const EpochCase *test = data;
+        GClueNMEAEpoch epoch;
+        g_autoptr(GString) out = g_string_new (NULL);
+        guint i;
+
+        /* Like the NMEA source does it, with the deadline at the end */
+        gclue_nmea_epoch_init (&epoch);
+        for (i = 0; i < G_N_ELEMENTS (test->sentences); i++) {
+                const char *msg = test->sentences[i];
+
+                if (msg == NULL)
+                        break;
+
+                if (gclue_nmea_epoch_is_next (&epoch, msg))
+                        finish_epoch (&epoch, out);
+                if (gclue_nmea_epoch_add (&epoch, msg, epoch_talkers) &&
+                    gclue_nmea_epoch_is_complete (&epoch))
+                        finish_epoch (&epoch, out);
+        }
+        if (!gclue_nmea_epoch_is_empty (&epoch))
+                finish_epoch (&epoch, out);
+
+        g_assert_cmpstr (out->str, ==, test->epochs);
+}
+
+#define NO_FIX { FALSE }
+#define FIX(latitude, longitude, accuracy) \
+        { TRUE, latitude, longitude, accuracy }
+#define UNKNOWN GCLUE_LOCATION_ACCURACY_UNKNOWN
+
+typedef struct {
+        const char *name;
+        struct {
+                gboolean has_fix;
+                gdouble  latitude;
+                gdouble  longitude;
+                gdouble  accuracy;
+        } fixes[4];
+        gint        best;
+        gdouble     latitude;
+        gdouble     longitude;
+} FusionCase;
+
+static const FusionCase fusion_cases[] = {
+        { "none", { NO_FIX, NO_FIX }, -1 },
+        { "single", { FIX (10, 20, 5) }, 0, 10, 20 },
+        { "missing", { NO_FIX, FIX (10, 20, 5), NO_FIX, FIX (12, 22, 5) },
+          1, 11, 21 },
+        { "equal", { FIX (10, 20, 5), FIX (12, 22, 5) }, 0, 11, 21 },
+        { "weighted", { FIX (13, 23, 2), FIX (10, 20, 1) }, 1, 10.6, 20.6 },
+        { "at-least-a-meter", { FIX (10, 20, 1), FIX (12, 22, 0.1) },
+          1, 11, 21 },
+        { "unknown-accuracy", { FIX (10, 20, UNKNOWN), FIX (12, 22, 5) },
+          1, 12, 22 },
+        { "all-unknown", { FIX (10, 20, UNKNOWN), FIX (12, 22, UNKNOWN) },
+          0, 10, 20 },
+        { "antimeridian", { FIX (0, 179.8, 5), FIX (0, -179.6, 5) },
+          0, 0, -179.9 },
+        { "antimeridian-west", { FIX (0, -179.8, 5), FIX (0, 179.6, 5) },
+          0, 0, 179.9 },
+};
+
+static void
+test_fusion (gconstpointer data)
+{
+        const FusionCase *test = data;
+        GClueLocationData locations[G_N_ELEMENTS (test->fixes)];
+        const GClueLocationData *fixes[G_N_ELEMENTS (test->fixes)];
+        GClueLocationData fused;
+        guint i;
+        gint best;
+
+        for (i = 0; i < G_N_ELEMENTS (test->fixes); i++) {
+                fixes[i] = NULL;
+                if (!test->fixes[i].has_fix)
+                        continue;
+
+                locations[i] = (GClueLocationData) {
+                        .latitude = test->fixes[i].latitude,
+                        .longitude = test->fixes[i].longitude,
+                        .accuracy = test->fixes[i].accuracy,
+                        .timestamp = i,
+                };
+                fixes[i] = &locations[i];
+        }
+
+        best = gclue_nmea_fuse_fixes (fixes, G_N_ELEMENTS (fixes), &fused);
+        g_assert_cmpint (best, ==, test->best);
+        if (best < 0)
+                return;
+
+        /* Everything but the position is the best fix's */
+        g_assert_cmpfloat (fused.accuracy, ==, fixes[best]->accuracy);
+        g_assert_cmpuint (fused.timestamp, ==, fixes[best]->timestamp);
+        g_assert_cmpfloat_with_epsilon (fused.latitude, test->latitude, 1e-9);
+        g_assert_cmpfloat_with_epsilon (fused.longitude, test->longitude, 1e-9);
+}
+
+int
+main (int argc, char **argv)
+{
+        guint i;
+
+        g_test_init (&argc, &argv, NULL);
+
+        for (i = 0; i < G_N_ELEMENTS (fields_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/nmea/fields/parse/%s",
+                                        fields_cases[i].name);
+                g_test_add_data_func (path, &fields_cases[i], test_fields_parse);
+        }
+        g_test_add_func ("/nmea/fields/get", test_fields_get);
+
+        for (i = 0; i < G_N_ELEMENTS (framer_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/nmea/framer/%s", framer_cases[i].name);
+                g_test_add_data_func (path, &framer_cases[i], test_framer);
+        }
+        g_test_add_func ("/nmea/framer/overlong", test_framer_overlong);
+
+        for (i = 0; i < G_N_ELEMENTS (sky_view_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/nmea/sky-view/used/%s",
+                                        sky_view_cases[i].name);
+                g_test_add_data_func (path, &sky_view_cases[i],
+                                      test_sky_view_used);
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (fusion_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/nmea/fusion/%s", fusion_cases[i].name);
+                g_test_add_data_func (path, &fusion_cases[i], test_fusion);
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (epoch_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/nmea/epoch/%s", epoch_cases[i].name);
+                g_test_add_data_func (path, &epoch_cases[i], test_epoch);
+        }
+
+        return g_test_run ();
+}
@@ -0,0 +1,487 @@
+/* vim: set et ts=8 sw=8: */
+/*
+ * Copyright 2024 Bardia Moshiri
+ *
+ * Geoclue is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * Geoclue is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with Geoclue; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors: Bardia Moshiri <fakeshell@bardia.tech>
+ */
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include "gclue-ubx.h"
+
+/* 2024-05-01T12:34:56Z */
+#define TEST_TIME (G_GINT64_CONSTANT (1714566896) * G_USEC_PER_SEC)
+
+#define NAV_PVT_LEN 92
+#define NAV_SAT_BLOCK 12
+
+static void
+put_u2 (guint8 *p, gsize offset, guint16 value)
+{
+        p[offset] = value & 0xff;
+        p[offset + 1] = value >> 8;
+}
+
+static void
+put_u4 (guint8 *p, gsize offset, guint32 value)
+{
+        put_u2 (p, offset, value & 0xffff);
+        put_u2 (p, offset + 2, value >> 16);
+}
+
+/* Appends a whole frame, sync characters and checksum included */
+static void
+append_frame (GByteArray   *stream,
+              guint8        msg_class,
+              guint8        msg_id,
+              const guint8 *payload,
+              guint16       len)
+{
+        guint8 header[6] = { 0xb5, 0x62, msg_class, msg_id };
+        guint8 checksum[2] = { 0, 0 };
+        guint start, i;
+
+        put_u2 (header, 4, len);
+        start = stream->len;
+        g_byte_array_append (stream, header, sizeof (header));
+        if (len > 0)
+                g_byte_array_append (stream, payload, len);
+
+        for (i = start + 2; i < stream->len; i++) {
+                checksum[0] += stream->data[i];
+                checksum[1] += checksum[0];
+        }
+        g_byte_array_append (stream, checksum, sizeof (checksum));
+}
+
+static void
+append_dop (GByteArray *stream)
+{
+        guint8 payload[18] = { 0 };
+
+        append_frame (stream, GCLUE_UBX_CLASS_NAV, GCLUE_UBX_ID_NAV_DOP,
+                      payload, sizeof (payload));
+}
+
+static void
+build_valid (GByteArray *stream)
+{
+        append_dop (stream);
+}
+
+static void
+build_empty_payload (GByteArray *stream)
+{
+        append_frame (stream, 0x05, 0x01, NULL, 0);
+}
+
+static void
+build_after_nmea (GByteArray *stream)
+{
+        const char *nmea = "$GNGGA,,,,,,0,00,99.99,,,,,,*56\r\n";
+
+        g_byte_array_append (stream, (const guint8 *) nmea, strlen (nmea));
+        append_dop (stream);
+}
+
+static void
+build_bad_checksum (GByteArray *stream)
+{
+        append_dop (stream);
+        stream->data[stream->len - 1] ^= 0xff;
+}
+
+static void
+build_bad_checksum_then_valid (GByteArray *stream)
+{
+        build_bad_checksum (stream);
+        append_dop (stream);
+}
+
+static void
+build_bad_length_then_valid (GByteArray *stream)
+{
+        static const guint8 header[] = { 0xb5, 0x62, 0x01, 0x07, 0xff, 0xff };
+
+        /* Longer than any frame could be, not something to wait for */
+        g_byte_array_append (stream, header, sizeof (header));
+        append_dop (stream);
+}
+
+static void
+build_truncated (GByteArray *stream)
+{
+        append_dop (stream);
+        g_byte_array_set_size (stream, stream->len - 3);
+}
+
+static void
+build_header_only (GByteArray *stream)
+{
+        static const guint8 header[] = { 0xb5, 0x62, 0x01 };
+
+        g_byte_array_append (stream, header, sizeof (header));
+}
+
+static void
+build_lone_sync (GByteArray *stream)
+{
+        static const guint8 garbage[] = { 0xb5, 0x00, 0xb5, 0xb5 };
+
+        g_byte_array_append (stream, garbage, sizeof (garbage));
+        append_dop (stream);
+}
+
+typedef struct {
+        const char *name;
+        void      (*build) (GByteArray *stream);
+        guint       n_frames;
+} ReaderCase;
+
+static const ReaderCase reader_cases[] = {
+        { "valid", build_valid, 1 },
+        { "empty-payload", build_empty_payload, 1 },
+        { "after-nmea", build_after_nmea, 1 },
+        { "bad-checksum", build_bad_checksum, 0 },
+        { "bad-checksum-then-valid", build_bad_checksum_then_valid, 1 },
+        { "bad-length-then-valid", build_bad_length_then_valid, 1 },
+        { "truncated", build_truncated, 0 },
+        { "header-only", build_header_only, 0 },
+        { "lone-sync", build_lone_sync, 1 },
+};
+
+static void
+test_reader (gconstpointer data)
+{
+        const ReaderCase *test = data;
+        g_autoptr(GByteArray) stream = g_byte_array_new ();
+        GClueUbxReader reader;
+        GClueUbxFrame frame;
+        guint n_frames = 0;
+        gint fds[2];
+
+        test->build (stream);
+
+        g_assert_cmpint (pipe (fds), ==, 0);
+        g_assert_cmpint (write (fds[1], stream->data, stream->len), ==,
+                         stream->len);
+        close (fds[1]);
+
+        gclue_ubx_reader_init (&reader);
+        while (gclue_ubx_reader_fill (&reader, fds[0]) > 0) {
+                while (gclue_ubx_reader_next_frame (&reader, &frame))
+                        n_frames++;
+        }
+        close (fds[0]);
+
+        g_assert_cmpuint (n_frames, ==, test->n_frames);
+}
+
+static void
+test_reader_split (void)
+{
+        g_autoptr(GByteArray) stream = g_byte_array_new ();
+        GClueUbxReader reader;
+        GClueUbxFrame frame;
+        guint n_frames = 0, i;
+        gint fds[2];
+
+        append_dop (stream);
+        append_dop (stream);
+
+        /* A byte at a time, the way a slow serial line may give them */
+        g_assert_cmpint (pipe (fds), ==, 0);
+        gclue_ubx_reader_init (&reader);
+        for (i = 0; i < stream->len; i++) {
+                g_assert_cmpint (write (fds[1], stream->data + i, 1), ==, 1);
+                g_assert_cmpint (gclue_ubx_reader_fill (&reader, fds[0]), ==, 1);
+
+                while (gclue_ubx_reader_next_frame (&reader, &frame)) {
+                        g_assert_cmpuint (frame.msg_class, ==, GCLUE_UBX_CLASS_NAV);
+                        g_assert_cmpuint (frame.msg_id, ==, GCLUE_UBX_ID_NAV_DOP);
+                        g_assert_cmpuint (frame.len, ==, 18);
+                        n_frames++;
+                }
+        }
+        close (fds[0]);
+        close (fds[1]);
+
+        g_assert_cmpuint (n_frames, ==, 2);
+}
+
+typedef struct {
+        const char *name;
+        guint8      msg_id;
+        guint16     len;
+        guint8      valid;      /* Validity flags of the date and time */
+        guint8      fix_type;
+        guint8      flags;
+        gboolean    parsed;
+        gboolean    has_time;
+        gboolean    has_position;
+        gboolean    has_altitude;
+} PvtCase;
+
+static const PvtCase pvt_cases[] = {
+        { "3d", GCLUE_UBX_ID_NAV_PVT, NAV_PVT_LEN, 0x03, 3, 0x01,
+          TRUE, TRUE, TRUE, TRUE },
+        { "old-protocol", GCLUE_UBX_ID_NAV_PVT, 84, 0x03, 3, 0x01,
+          TRUE, TRUE, TRUE, TRUE },
+        { "gnss-dead-reckoning", GCLUE_UBX_ID_NAV_PVT, NAV_PVT_LEN, 0x03, 4, 0x01,
+          TRUE, TRUE, TRUE, TRUE },
+        { "2d", GCLUE_UBX_ID_NAV_PVT, NAV_PVT_LEN, 0x03, 2, 0x01,
+          TRUE, TRUE, TRUE, FALSE },
+        { "no-fix", GCLUE_UBX_ID_NAV_PVT, NAV_PVT_LEN, 0x03, 0, 0x00,
+          TRUE, TRUE, FALSE, FALSE },
+        { "dead-reckoning-only", GCLUE_UBX_ID_NAV_PVT, NAV_PVT_LEN, 0x03, 1, 0x01,
+          TRUE, TRUE, FALSE, FALSE },
+        { "fix-not-ok", GCLUE_UBX_ID_NAV_PVT, NAV_PVT_LEN, 0x03, 3, 0x00,
+          TRUE, TRUE, FALSE, TRUE },
+        { "time-only", GCLUE_UBX_ID_NAV_PVT, NAV_PVT_LEN, 0x07, 5, 0x01,
+          TRUE, TRUE, FALSE, FALSE },
+        { "no-date", GCLUE_UBX_ID_NAV_PVT, NAV_PVT_LEN, 0x02, 3, 0x01,
+          TRUE, FALSE, TRUE, TRUE },
+        { "no-time", GCLUE_UBX_ID_NAV_PVT, NAV_PVT_LEN, 0x01, 3, 0x01,
+          TRUE, FALSE, TRUE, TRUE },
+        { "short", GCLUE_UBX_ID_NAV_PVT, 83, 0x03, 3, 0x01,
+          FALSE },
+        { "other-message", GCLUE_UBX_ID_NAV_DOP, NAV_PVT_LEN, 0x03, 3, 0x01,
+          FALSE },
+};
+
+static void
+test_nav_pvt (gconstpointer data)
+{
+        const PvtCase *test = data;
+        guint8 payload[NAV_PVT_LEN] = { 0 };
+        GClueUbxFrame frame = {
+                .msg_class = GCLUE_UBX_CLASS_NAV,
+                .msg_id = test->msg_id,
+                .len = test->len,
+                .payload = payload,
+        };
+        GClueUbxNavPvt pvt;
+
+        /* Offsets as in the u-blox M8 protocol specification */
+        put_u2 (payload, 4, 2024);
+        payload[6] = 5;
+        payload[7] = 1;
+        payload[8] = 12;
+        payload[9] = 34;
+        payload[10] = 56;
+        payload[11] = test->valid;
+        put_u4 (payload, 16, 789000000);        /* nano */
+        payload[20] = test->fix_type;
+        payload[21] = test->flags;
+        payload[23] = 12;                       /* numSV */
+        put_u4 (payload, 24, 134000000);        /* lon */
+        put_u4 (payload, 28, (guint32) -525000000); /* lat */
+        put_u4 (payload, 32, 80100);            /* height, above the ellipsoid */
+        put_u4 (payload, 36, 34200);            /* hMSL */
+        put_u4 (payload, 40, 4500);             /* hAcc */
+        put_u4 (payload, 44, 6000);             /* vAcc */
+        put_u4 (payload, 56, (guint32) -250);   /* velD */
+        put_u4 (payload, 60, 1500);             /* gSpeed */
+        put_u4 (payload, 64, 27000000);         /* headMot */
+        put_u4 (payload, 68, 300);              /* sAcc */
+        put_u4 (payload, 72, 1500000);          /* headAcc */
+        put_u2 (payload, 76, 145);              /* pDOP */
+
+        g_assert_cmpint (gclue_ubx_parse_nav_pvt (&frame, &pvt), ==, test->parsed);
+        if (!test->parsed)
+                return;
+
+        g_assert_cmpint (pvt.time, ==, test->has_time ? TEST_TIME + 789000 : 0);
+        g_assert_cmpuint (pvt.fix_type, ==, test->fix_type);
+        g_assert_cmpuint (pvt.n_satellites, ==, 12);
+
+        if (test->has_position) {
+                g_assert_cmpfloat_with_epsilon (pvt.latitude, -52.5, 1e-9);
+                g_assert_cmpfloat_with_epsilon (pvt.longitude, 13.4, 1e-9);
+        } else {
+                g_assert_true (isnan (pvt.latitude));
+                g_assert_true (isnan (pvt.longitude));
+        }
+
+        if (test->has_altitude) {
+                g_assert_cmpfloat_with_epsilon (pvt.altitude, 34.2, 1e-9);
+                g_assert_cmpfloat_with_epsilon (pvt.altitude_accuracy, 6.0, 1e-9);
+                g_assert_cmpfloat_with_epsilon (pvt.climb, 0.25, 1e-9);
+        } else {
+                g_assert_true (isnan (pvt.altitude));
+                g_assert_true (isnan (pvt.altitude_accuracy));
+                g_assert_true (isnan (pvt.climb));
+        }
+
+        g_assert_cmpfloat_with_epsilon (pvt.accuracy, 4.5, 1e-9);
+        g_assert_cmpfloat_with_epsilon (pvt.speed, 1.5, 1e-9);
+        g_assert_cmpfloat_with_epsilon (pvt.speed_accuracy, 0.3, 1e-9);
+        g_assert_cmpfloat_with_epsilon (pvt.heading, 270.0, 1e-9);
+        g_assert_cmpfloat_with_epsilon (pvt.heading_accuracy, 15.0, 1e-9);
+        g_assert_cmpfloat_with_epsilon (pvt.pdop, 1.45, 1e-9);
+}
+
+typedef struct {
+        guint8   gnss_id;
+        guint8   sv_id;
+        guint8   cno;
+        gint8    elevation;
+        gint16   azimuth;
+        guint32  flags;
+} SatBlock;
+
+static const SatBlock sat_blocks[] = {
+        { 0, 5, 38, 45, 120, 0x08 },    /* GPS, used */
+        { 2, 11, 30, 20, 250, 0x00 },   /* Galileo */
+        { 4, 1, 20, 10, 10, 0x08 },     /* IMES, not numbered by NMEA */
+        { 6, 3, 0, -5, 359, 0x00 },     /* GLONASS, not heard */
+        { 3, 19, 25, 80, 0, 0x08 },     /* BeiDou */
+};
+
+/* What sat_blocks decode to, IMES being skipped */
+static const GClueUbxSatellite sat_expected[] = {
+        { 5, 45, 120, 38, TRUE },
+        { 311, 20, 250, 30, FALSE },
+        { 67, -5, 359, NAN, FALSE },
+        { 419, 80, 0, 25, TRUE },
+};
+
+typedef struct {
+        const char *name;
+        guint8      msg_id;
+        guint8      num_svs;    /* As given in the header */
+        guint       n_blocks;   /* As there are in the payload */
+        gboolean    parsed;
+} SatCase;
+
+static const SatCase sat_cases[] = {
+        { "satellites", GCLUE_UBX_ID_NAV_SAT, 5, 5, TRUE },
+        { "none", GCLUE_UBX_ID_NAV_SAT, 0, 0, TRUE },
+        { "missing-blocks", GCLUE_UBX_ID_NAV_SAT, 5, 4, FALSE },
+        { "other-message", GCLUE_UBX_ID_NAV_DOP, 5, 5, FALSE },
+};
+
+static void
+test_nav_sat (gconstpointer data)
+{
+        const SatCase *test = data;
+        guint8 payload[8 + G_N_ELEMENTS (sat_blocks) * NAV_SAT_BLOCK] = { 0 };
+        GClueUbxFrame frame = {
+                .msg_class = GCLUE_UBX_CLASS_NAV,
+                .msg_id = test->msg_id,
+                .len = 8 + test->n_blocks * NAV_SAT_BLOCK,
+                .payload = payload,
+        };
+        GClueUbxNavSat sat;
+        guint i;
+
+        payload[4] = 1;                         /* version */
+        payload[5] = test->num_svs;
+        for (i = 0; i < test->n_blocks; i++) {
+                guint8 *block = payload + 8 + i * NAV_SAT_BLOCK;
+
+                block[0] = sat_blocks[i].gnss_id;
+                block[1] = sat_blocks[i].sv_id;
+                block[2] = sat_blocks[i].cno;
+                block[3] = (guint8) sat_blocks[i].elevation;
+                put_u2 (block, 4, (guint16) sat_blocks[i].azimuth);
+                put_u4 (block, 8, sat_blocks[i].flags);
+        }
+
+        g_assert_cmpint (gclue_ubx_parse_nav_sat (&frame, &sat), ==, test->parsed);
+        if (!test->parsed)
+                return;
+
+        if (test->num_svs == 0) {
+                g_assert_cmpuint (sat.n_satellites, ==, 0);
+                return;
+        }
+
+        g_assert_cmpuint (sat.n_satellites, ==, G_N_ELEMENTS (sat_expected));
+        for (i = 0; i < G_N_ELEMENTS (sat_expected); i++) {
+                const GClueUbxSatellite *expected = &sat_expected[i];
+
+                g_assert_cmpuint (sat.satellites[i].prn, ==, expected->prn);
+                g_assert_cmpfloat (sat.satellites[i].elevation, ==, expected->elevation);
+                g_assert_cmpfloat (sat.satellites[i].azimuth, ==, expected->azimuth);
+                if (isnan (expected->snr))
+                        g_assert_true (isnan (sat.satellites[i].snr));
+                else
+                        g_assert_cmpfloat (sat.satellites[i].snr, ==, expected->snr);
+                g_assert_cmpint (sat.satellites[i].used, ==, expected->used);
+        }
+}
+
+static void
+test_nav_dop (void)
+{
+        guint8 payload[18] = { 0 };
+        GClueUbxFrame frame = {
+                .msg_class = GCLUE_UBX_CLASS_NAV,
+                .msg_id = GCLUE_UBX_ID_NAV_DOP,
+                .len = sizeof (payload),
+                .payload = payload,
+        };
+        GClueUbxNavDop dop;
+
+        put_u2 (payload, 6, 145);               /* pDOP */
+        put_u2 (payload, 10, 120);              /* vDOP */
+        put_u2 (payload, 12, 87);               /* hDOP */
+
+        g_assert_true (gclue_ubx_parse_nav_dop (&frame, &dop));
+        g_assert_cmpfloat_with_epsilon (dop.pdop, 1.45, 1e-9);
+        g_assert_cmpfloat_with_epsilon (dop.vdop, 1.2, 1e-9);
+        g_assert_cmpfloat_with_epsilon (dop.hdop, 0.87, 1e-9);
+
+        frame.len = sizeof (payload) - 1;
+        g_assert_false (gclue_ubx_parse_nav_dop (&frame, &dop));
+}
+
+int
+main (int argc, char **argv)
+{
+        guint i;
+
+        g_test_init (&argc, &argv, NULL);
+
+        for (i = 0; i < G_N_ELEMENTS (reader_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/ubx/reader/%s", reader_cases[i].name);
+                g_test_add_data_func (path, &reader_cases[i], test_reader);
+        }
+        g_test_add_func ("/ubx/reader/split", test_reader_split);
+
+        for (i = 0; i < G_N_ELEMENTS (pvt_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/ubx/nav-pvt/%s", pvt_cases[i].name);
+                g_test_add_data_func (path, &pvt_cases[i], test_nav_pvt);
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (sat_cases); i++) {
+                g_autofree char *path = NULL;
+
+                path = g_strdup_printf ("/ubx/nav-sat/%s", sat_cases[i].name);
+                g_test_add_data_func (path, &sat_cases[i], test_nav_sat);
+        }
+        g_test_add_func ("/ubx/nav-dop", test_nav_dop);
+
+        return g_test_run ();
+}